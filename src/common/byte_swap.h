@@ -1,6 +1,7 @@
 #pragma once
 #include "platform.h"
 #include "bit_cast.h"
+#include <cstddef>
 #include <cstdint>
 
 #ifdef PLATFORM_LINUX
@@ -75,3 +76,14 @@ byte_swap(Type src)
 {
    return byte_swap_t<Type>::swap(src);
 }
+
+// Swaps endian of count values from src into dst, src and dst may be the same
+// pointer but must not otherwise overlap. Uses SIMD where the host supports it.
+void
+byte_swap_to(uint16_t *dst, const uint16_t *src, size_t count);
+
+void
+byte_swap_to(uint32_t *dst, const uint32_t *src, size_t count);
+
+void
+byte_swap_to(uint64_t *dst, const uint64_t *src, size_t count);
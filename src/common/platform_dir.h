@@ -1,4 +1,6 @@
 #pragma once
+#include <cstdint>
+#include <functional>
 #include <string>
 
 namespace platform
@@ -19,6 +21,17 @@ isFile(const std::string &path);
 bool
 isDirectory(const std::string &path);
 
+/**
+ * Call func with the name, size and last write time of every file directly
+ * inside path, returns false if path could not be listed.
+ *
+ * Write times are in host specific units, they are only for comparing with
+ * each other.
+ */
+bool
+listFiles(const std::string &path,
+          const std::function<void(const std::string &name, uint64_t size, uint64_t writeTime)> &func);
+
 std::string
 getConfigDirectory();
 
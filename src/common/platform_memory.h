@@ -43,6 +43,10 @@ bool
 unmapViewOfFile(void *view,
                 size_t size);
 
+void
+prefetchViewOfFile(const void *view,
+                   size_t size);
+
 bool
 reserveMemory(uintptr_t address,
               size_t size);
@@ -0,0 +1,264 @@
+#include "byte_swap.h"
+
+#if defined(__x86_64__) || defined(_M_X64)
+#define BYTE_SWAP_X86
+#include <immintrin.h>
+
+#ifdef _MSC_VER
+#include <intrin.h>
+#define BYTE_SWAP_TARGET(name)
+#else
+#define BYTE_SWAP_TARGET(name) __attribute__((target(name)))
+#endif
+#elif defined(__aarch64__) || defined(_M_ARM64)
+#define BYTE_SWAP_NEON
+#include <arm_neon.h>
+#endif
+
+/*
+ * Bulk endian swaps, used for command buffers, index buffers and anything
+ * else which is converted from guest memory in large runs.
+ *
+ * On x86 the widest supported of AVX2, SSSE3 or SSE2 is picked at runtime,
+ * as we do not build with anything above SSE2 enabled. Every kernel only
+ * handles whole vectors, the remainder is always finished with the scalar
+ * byte_swap.
+ */
+
+template<typename Type>
+static void
+byteSwapScalar(Type *dst,
+               const Type *src,
+               size_t count)
+{
+   for (auto i = size_t { 0 }; i < count; ++i) {
+      dst[i] = byte_swap(src[i]);
+   }
+}
+
+#ifdef BYTE_SWAP_X86
+
+using ByteSwapKernel = size_t (*)(uint8_t *dst, const uint8_t *src, size_t bytes, size_t elementSize);
+
+// pshufb mask which reverses the bytes of every elementSize element
+static __m128i
+shuffleMask(size_t elementSize)
+{
+   alignas(16) uint8_t mask[16];
+
+   for (auto i = 0u; i < 16; ++i) {
+      mask[i] = static_cast<uint8_t>((i / elementSize) * elementSize + (elementSize - 1 - i % elementSize));
+   }
+
+   return _mm_load_si128(reinterpret_cast<const __m128i *>(mask));
+}
+
+static size_t
+byteSwapSSE2(uint8_t *dst,
+             const uint8_t *src,
+             size_t bytes,
+             size_t elementSize)
+{
+   auto pos = size_t { 0 };
+
+   for (; pos + 16 <= bytes; pos += 16) {
+      auto value = _mm_loadu_si128(reinterpret_cast<const __m128i *>(src + pos));
+
+      // Swap the bytes in each 16 bit lane
+      value = _mm_or_si128(_mm_slli_epi16(value, 8), _mm_srli_epi16(value, 8));
+
+      // Then swap the 16 bit lanes within each element
+      if (elementSize >= 4) {
+         value = _mm_shufflelo_epi16(value, _MM_SHUFFLE(2, 3, 0, 1));
+         value = _mm_shufflehi_epi16(value, _MM_SHUFFLE(2, 3, 0, 1));
+      }
+
+      if (elementSize == 8) {
+         value = _mm_shuffle_epi32(value, _MM_SHUFFLE(2, 3, 0, 1));
+      }
+
+      _mm_storeu_si128(reinterpret_cast<__m128i *>(dst + pos), value);
+   }
+
+   return pos;
+}
+
+BYTE_SWAP_TARGET("ssse3")
+static size_t
+byteSwapSSSE3(uint8_t *dst,
+              const uint8_t *src,
+              size_t bytes,
+              size_t elementSize)
+{
+   auto mask = shuffleMask(elementSize);
+   auto pos = size_t { 0 };
+
+   for (; pos + 16 <= bytes; pos += 16) {
+      auto value = _mm_loadu_si128(reinterpret_cast<const __m128i *>(src + pos));
+      _mm_storeu_si128(reinterpret_cast<__m128i *>(dst + pos), _mm_shuffle_epi8(value, mask));
+   }
+
+   return pos;
+}
+
+BYTE_SWAP_TARGET("avx2")
+static size_t
+byteSwapAVX2(uint8_t *dst,
+             const uint8_t *src,
+             size_t bytes,
+             size_t elementSize)
+{
+   auto mask128 = shuffleMask(elementSize);
+   auto mask = _mm256_broadcastsi128_si256(mask128);
+   auto pos = size_t { 0 };
+
+   for (; pos + 64 <= bytes; pos += 64) {
+      auto value0 = _mm256_loadu_si256(reinterpret_cast<const __m256i *>(src + pos));
+      auto value1 = _mm256_loadu_si256(reinterpret_cast<const __m256i *>(src + pos + 32));
+      _mm256_storeu_si256(reinterpret_cast<__m256i *>(dst + pos), _mm256_shuffle_epi8(value0, mask));
+      _mm256_storeu_si256(reinterpret_cast<__m256i *>(dst + pos + 32), _mm256_shuffle_epi8(value1, mask));
+   }
+
+   for (; pos + 16 <= bytes; pos += 16) {
+      auto value = _mm_loadu_si128(reinterpret_cast<const __m128i *>(src + pos));
+      _mm_storeu_si128(reinterpret_cast<__m128i *>(dst + pos), _mm_shuffle_epi8(value, mask128));
+   }
+
+   return pos;
+}
+
+static bool
+hostSupportsSSSE3()
+{
+#ifdef _MSC_VER
+   int info[4];
+   __cpuid(info, 1);
+   return !!(info[2] & (1 << 9));
+#else
+   return __builtin_cpu_supports("ssse3");
+#endif
+}
+
+static bool
+hostSupportsAVX2()
+{
+#ifdef _MSC_VER
+   int info[4];
+   __cpuid(info, 0);
+   if (info[0] < 7) {
+      return false;
+   }
+
+   // AVX2 also requires the OS to save the ymm registers
+   __cpuid(info, 1);
+   if (!(info[2] & (1 << 27)) || (_xgetbv(0) & 6) != 6) {
+      return false;
+   }
+
+   __cpuidex(info, 7, 0);
+   return !!(info[1] & (1 << 5));
+#else
+   return __builtin_cpu_supports("avx2");
+#endif
+}
+
+static ByteSwapKernel
+selectKernel()
+{
+#ifndef _MSC_VER
+   __builtin_cpu_init();
+#endif
+
+   if (hostSupportsAVX2()) {
+      return &byteSwapAVX2;
+   } else if (hostSupportsSSSE3()) {
+      return &byteSwapSSSE3;
+   } else {
+      return &byteSwapSSE2;
+   }
+}
+
+template<typename Type>
+static void
+byteSwapBulk(Type *dst,
+             const Type *src,
+             size_t count)
+{
+   static const auto kernel = selectKernel();
+   auto bytes = count * sizeof(Type);
+   auto done = kernel(reinterpret_cast<uint8_t *>(dst),
+                      reinterpret_cast<const uint8_t *>(src),
+                      bytes, sizeof(Type)) / sizeof(Type);
+   byteSwapScalar(dst + done, src + done, count - done);
+}
+
+#elif defined(BYTE_SWAP_NEON)
+
+static inline uint8x16_t
+byteSwapVector(uint8x16_t value, size_t elementSize)
+{
+   switch (elementSize) {
+   case 2:
+      return vrev16q_u8(value);
+   case 4:
+      return vrev32q_u8(value);
+   default:
+      return vrev64q_u8(value);
+   }
+}
+
+template<typename Type>
+static void
+byteSwapBulk(Type *dst,
+             const Type *src,
+             size_t count)
+{
+   auto dstBytes = reinterpret_cast<uint8_t *>(dst);
+   auto srcBytes = reinterpret_cast<const uint8_t *>(src);
+   auto bytes = count * sizeof(Type);
+   auto pos = size_t { 0 };
+
+   for (; pos + 16 <= bytes; pos += 16) {
+      vst1q_u8(dstBytes + pos, byteSwapVector(vld1q_u8(srcBytes + pos), sizeof(Type)));
+   }
+
+   auto done = pos / sizeof(Type);
+   byteSwapScalar(dst + done, src + done, count - done);
+}
+
+#else
+
+template<typename Type>
+static void
+byteSwapBulk(Type *dst,
+             const Type *src,
+             size_t count)
+{
+   byteSwapScalar(dst, src, count);
+}
+
+#endif
+
+void
+byte_swap_to(uint16_t *dst,
+             const uint16_t *src,
+             size_t count)
+{
+   byteSwapBulk(dst, src, count);
+}
+
+void
+byte_swap_to(uint32_t *dst,
+             const uint32_t *src,
+             size_t count)
+{
+   byteSwapBulk(dst, src, count);
+}
+
+void
+byte_swap_to(uint64_t *dst,
+             const uint64_t *src,
+             size_t count)
+{
+   byteSwapBulk(dst, src, count);
+}
@@ -2,6 +2,7 @@
 #include "platform_dir.h"
 
 #ifdef PLATFORM_POSIX
+#include <dirent.h>
 #include <errno.h>
 #include <fmt/format.h>
 #include <stdlib.h>
@@ -66,6 +67,30 @@ isDirectory(const std::string &path)
    return S_ISDIR(info.st_mode);
 }
 
+bool
+listFiles(const std::string &path,
+          const std::function<void(const std::string &name, uint64_t size, uint64_t writeTime)> &func)
+{
+   auto dir = opendir(path.c_str());
+
+   if (!dir) {
+      return false;
+   }
+
+   while (auto entry = readdir(dir)) {
+      struct stat info;
+      auto filePath = fmt::format("{}/{}", path, entry->d_name);
+
+      if (stat(filePath.c_str(), &info) == 0 && S_ISREG(info.st_mode)) {
+         func(entry->d_name, static_cast<uint64_t>(info.st_size),
+              static_cast<uint64_t>(info.st_mtime));
+      }
+   }
+
+   closedir(dir);
+   return true;
+}
+
 std::string
 getConfigDirectory()
 {
@@ -35,18 +35,16 @@ static void
 dispatchException(Exception *exception,
                   void *context,
                   int signum,
-                  const struct sigaction *ourHandler,
                   const struct sigaction *sysHandler)
 {
-   // Reset to the original signal handler in case an exception handler
-   //  generates a signal of its own
-   sigaction(signum, sysHandler, nullptr);
-
-   static bool sInSignal = false;
+   // Exceptions can be raised on several threads at once, for example
+   //  writes to write tracked memory, so this must be per thread.
+   static thread_local bool sInSignal = false;
 
    // Avoid recursive signal handling (in case an exception handler looking
    //  at a SIGILL causes a SIGSEGV, for example)
    if (sInSignal) {
+      sigaction(signum, sysHandler, nullptr);
       return;
    }
 
@@ -62,9 +60,6 @@ dispatchException(Exception *exception,
 
       sInSignal = false;
 
-      // Reinstall our signal handler
-      sigaction(signum, ourHandler, nullptr);
-
       if (func == HandledException) {
          // Exception handled, resume execution
          return;
@@ -80,8 +75,10 @@ dispatchException(Exception *exception,
       }
    }
 
-   // No exception handlers, found, so re-run the failing instruction to
-   //  call the original signal handler
+   // No exception handlers, found, so reset to the original signal handler
+   //  and re-run the failing instruction to call it
+   sInSignal = false;
+   sigaction(signum, sysHandler, nullptr);
    return;
 }
 
@@ -89,14 +86,14 @@ static void
 segvHandler(int signum, siginfo_t *info, void *context)
 {
    auto exception = AccessViolationException { reinterpret_cast<uint64_t>(info->si_addr) };
-   dispatchException(&exception, context, signum, &sSegvHandler, &sSystemSegvHandler);
+   dispatchException(&exception, context, signum, &sSystemSegvHandler);
 }
 
 static void
 illHandler(int signum, siginfo_t *info, void *context)
 {
    auto exception = InvalidInstructionException { };
-   dispatchException(&exception, context, signum, &sIllHandler, &sSystemIllHandler);
+   dispatchException(&exception, context, signum, &sSystemIllHandler);
 }
 
 bool
@@ -107,9 +104,10 @@ installExceptionHandler(ExceptionHandler handler)
    if (!addedHandlers) {
       sigemptyset(&sSegvHandler.sa_mask);
 
-      // Set SA_RESETHAND so that a SEGV in the handler will terminate the
-      // program rather than going into an infinite loop.
-      sSegvHandler.sa_flags = SA_SIGINFO | SA_RESETHAND;
+      // We do not use SA_RESETHAND as another thread could fault while we
+      // are handling an exception. A SEGV in the handler itself will still
+      // terminate the program as the signal is blocked while handling it.
+      sSegvHandler.sa_flags = SA_SIGINFO;
 
       sSegvHandler.sa_sigaction = segvHandler;
       if (sigaction(SIGSEGV, &sSegvHandler, &sSystemSegvHandler) != 0) {
@@ -1,17 +1,166 @@
 #include "platform.h"
 #include "platform_fiber.h"
+#include "decaf_assert.h"
 #include "log.h"
 
 #ifdef PLATFORM_POSIX
-#include <array>
+#include <cstdint>
 #include <errno.h>
-#include <signal.h>
-#include <ucontext.h>
+#include <sys/mman.h>
+#include <unistd.h>
 
 #ifdef DECAF_VALGRIND
    #include <valgrind/valgrind.h>
 #endif
 
+/*
+ * Fibers are switched with a small hand written register swap rather than
+ * ucontext, as swapcontext does a sigprocmask syscall on every switch.
+ *
+ * decafSwitchFiber pushes the callee saved registers onto the current stack,
+ * saves the stack pointer, then loads the target stack pointer and pops its
+ * registers. A new fiber's stack is set up so that the first switch to it
+ * "returns" into decafFiberTrampoline, with the fiber pointer in a callee
+ * saved register, which then calls decafFiberStart.
+ *
+ * Like swapcontext the floating point control registers are saved and
+ * restored as part of the switch.
+ */
+
+#ifdef PLATFORM_APPLE
+#  define FIBER_SYMBOL(name) "_" #name
+#  define FIBER_FUNCTION(name) ".globl " FIBER_SYMBOL(name) "\n" FIBER_SYMBOL(name) ":\n"
+#else
+#  define FIBER_SYMBOL(name) #name
+#  define FIBER_FUNCTION(name) ".globl " FIBER_SYMBOL(name) "\n" \
+                               ".type " FIBER_SYMBOL(name) ", @function\n" \
+                               FIBER_SYMBOL(name) ":\n"
+#endif
+
+extern "C"
+{
+
+// Saves the current stack pointer to *saveStack and switches to loadStack.
+void
+decafSwitchFiber(void **saveStack, void *loadStack);
+
+void
+decafFiberTrampoline();
+
+void
+decafFiberStart(platform::Fiber *fiber);
+
+}
+
+#if defined(__x86_64__)
+
+// Saved state, from the lowest address: mxcsr, x87 control word, r15, r14,
+// r13, r12, rbx, rbp, return address.
+static constexpr auto FiberFrameSize = 8 * 8;
+static constexpr auto FiberFrameEntryParam = 4;
+static constexpr auto FiberFrameReturnAddress = 7;
+
+asm(
+   ".text\n"
+   ".p2align 4\n"
+   FIBER_FUNCTION(decafSwitchFiber)
+   "   pushq %rbp\n"
+   "   pushq %rbx\n"
+   "   pushq %r12\n"
+   "   pushq %r13\n"
+   "   pushq %r14\n"
+   "   pushq %r15\n"
+   "   subq $8, %rsp\n"
+   "   stmxcsr (%rsp)\n"
+   "   fnstcw 4(%rsp)\n"
+   "   movq %rsp, (%rdi)\n"
+   "   movq %rsi, %rsp\n"
+   "   ldmxcsr (%rsp)\n"
+   "   fldcw 4(%rsp)\n"
+   "   addq $8, %rsp\n"
+   "   popq %r15\n"
+   "   popq %r14\n"
+   "   popq %r13\n"
+   "   popq %r12\n"
+   "   popq %rbx\n"
+   "   popq %rbp\n"
+   "   ret\n"
+
+   ".p2align 4\n"
+   FIBER_FUNCTION(decafFiberTrampoline)
+   "   movq %r12, %rdi\n"
+   "   call " FIBER_SYMBOL(decafFiberStart) "\n"
+   "   ud2\n"
+);
+
+static void
+initialiseFiberFrame(uint64_t *frame)
+{
+   // Default mxcsr with all exceptions masked, default x87 control word
+   frame[0] = 0x1F80 | (uint64_t { 0x037F } << 32);
+}
+
+#elif defined(__aarch64__)
+
+// Saved state, from the lowest address: x19-x28, x29, x30, d8-d15, fpcr,
+// padding to keep sp 16 byte aligned.
+static constexpr auto FiberFrameSize = 22 * 8;
+static constexpr auto FiberFrameEntryParam = 0;
+static constexpr auto FiberFrameReturnAddress = 11;
+
+asm(
+   ".text\n"
+   ".p2align 4\n"
+   FIBER_FUNCTION(decafSwitchFiber)
+   "   sub sp, sp, #176\n"
+   "   stp x19, x20, [sp, #0]\n"
+   "   stp x21, x22, [sp, #16]\n"
+   "   stp x23, x24, [sp, #32]\n"
+   "   stp x25, x26, [sp, #48]\n"
+   "   stp x27, x28, [sp, #64]\n"
+   "   stp x29, x30, [sp, #80]\n"
+   "   stp d8, d9, [sp, #96]\n"
+   "   stp d10, d11, [sp, #112]\n"
+   "   stp d12, d13, [sp, #128]\n"
+   "   stp d14, d15, [sp, #144]\n"
+   "   mrs x9, fpcr\n"
+   "   str x9, [sp, #160]\n"
+   "   mov x9, sp\n"
+   "   str x9, [x0]\n"
+   "   mov sp, x1\n"
+   "   ldp x19, x20, [sp, #0]\n"
+   "   ldp x21, x22, [sp, #16]\n"
+   "   ldp x23, x24, [sp, #32]\n"
+   "   ldp x25, x26, [sp, #48]\n"
+   "   ldp x27, x28, [sp, #64]\n"
+   "   ldp x29, x30, [sp, #80]\n"
+   "   ldp d8, d9, [sp, #96]\n"
+   "   ldp d10, d11, [sp, #112]\n"
+   "   ldp d12, d13, [sp, #128]\n"
+   "   ldp d14, d15, [sp, #144]\n"
+   "   ldr x9, [sp, #160]\n"
+   "   msr fpcr, x9\n"
+   "   add sp, sp, #176\n"
+   "   ret\n"
+
+   ".p2align 4\n"
+   FIBER_FUNCTION(decafFiberTrampoline)
+   "   mov x0, x19\n"
+   "   bl " FIBER_SYMBOL(decafFiberStart) "\n"
+   "   brk #0\n"
+);
+
+static void
+initialiseFiberFrame(uint64_t *frame)
+{
+   // Default fpcr, round to nearest with no traps
+   frame[20] = 0;
+}
+
+#else
+#  error "Fiber switching is not implemented for this architecture"
+#endif
+
 namespace platform
 {
 
@@ -20,13 +169,19 @@ DefaultStackSize = 1024 * 1024;
 
 struct Fiber
 {
-   ucontext_t context;
+   //! Saved stack pointer while this fiber is not running.
+   void *stackPointer = nullptr;
+
    FiberEntryPoint entry = nullptr;
    void *entryParam = nullptr;
+
+   //! Stack allocation, including the guard page, nullptr for thread fibers.
+   uint8_t *stack = nullptr;
+   size_t stackAllocSize = 0;
+
 #ifdef DECAF_VALGRIND
    unsigned int valgrindStackId;
 #endif
-   std::array<char, DefaultStackSize> stack;
 };
 
 Fiber *
@@ -36,10 +191,42 @@ getThreadFiber()
    return fiber;
 }
 
-static void
-fiberEntryPoint(Fiber *fiber)
+
+/**
+ * Allocate a fiber stack with a guard page below it.
+ *
+ * The stack is reserved with MAP_NORESERVE so pages are only committed as
+ * they are first touched.
+ */
+static bool
+allocateFiberStack(Fiber *fiber,
+                   size_t stackSize)
 {
-   fiber->entry(fiber->entryParam);
+   auto pageSize = static_cast<size_t>(sysconf(_SC_PAGESIZE));
+   auto allocSize = stackSize + pageSize;
+   auto flags = MAP_PRIVATE | MAP_ANONYMOUS;
+
+#ifdef MAP_NORESERVE
+   flags |= MAP_NORESERVE;
+#endif
+
+#ifdef MAP_STACK
+   flags |= MAP_STACK;
+#endif
+
+   auto stack = mmap(nullptr, allocSize, PROT_READ | PROT_WRITE, flags, -1, 0);
+   if (stack == MAP_FAILED) {
+      gLog->error("Failed to allocate fiber stack of size 0x{:X}, error: {}", allocSize, errno);
+      return false;
+   }
+
+   if (mprotect(stack, pageSize, PROT_NONE) == -1) {
+      gLog->warn("Failed to protect fiber stack guard page, error: {}", errno);
+   }
+
+   fiber->stack = reinterpret_cast<uint8_t *>(stack);
+   fiber->stackAllocSize = allocSize;
+   return true;
 }
 
 Fiber *
@@ -49,16 +236,27 @@ createFiber(FiberEntryPoint entry, void *entryParam)
    fiber->entry = entry;
    fiber->entryParam = entryParam;
 
+   if (!allocateFiberStack(fiber, DefaultStackSize)) {
+      delete fiber;
+      return nullptr;
+   }
+
+   auto stackTop = fiber->stack + fiber->stackAllocSize;
+
 #ifdef DECAF_VALGRIND
-   fiber->valgrindStackId = VALGRIND_STACK_REGISTER(&fiber->stack[0], &fiber->stack[fiber->stack.size() - 1]);
+   fiber->valgrindStackId = VALGRIND_STACK_REGISTER(stackTop - DefaultStackSize, stackTop);
 #endif
 
-   getcontext(&fiber->context);
-   fiber->context.uc_stack.ss_sp = &fiber->stack[0];
-   fiber->context.uc_stack.ss_size = fiber->stack.size();
-   fiber->context.uc_link = nullptr;
+   // Set up the initial frame which decafSwitchFiber will pop from
+   auto frame = reinterpret_cast<uint64_t *>(stackTop - FiberFrameSize);
+   for (auto i = 0; i < FiberFrameSize / 8; ++i) {
+      frame[i] = 0;
+   }
 
-   makecontext(&fiber->context, reinterpret_cast<void(*)()>(&fiberEntryPoint), 1, fiber);
+   initialiseFiberFrame(frame);
+   frame[FiberFrameEntryParam] = reinterpret_cast<uint64_t>(fiber);
+   frame[FiberFrameReturnAddress] = reinterpret_cast<uint64_t>(&decafFiberTrampoline);
+   fiber->stackPointer = frame;
    return fiber;
 }
 
@@ -66,9 +264,15 @@ void
 destroyFiber(Fiber *fiber)
 {
 #ifdef DECAF_VALGRIND
-   VALGRIND_STACK_DEREGISTER(fiber->valgrindStackId);
+   if (fiber->stack) {
+      VALGRIND_STACK_DEREGISTER(fiber->valgrindStackId);
+   }
 #endif
 
+   if (fiber->stack) {
+      munmap(fiber->stack, fiber->stackAllocSize);
+   }
+
    delete fiber;
 }
 
@@ -76,12 +280,20 @@ void
 swapToFiber(Fiber *current, Fiber *target)
 {
    if (!current) {
-      setcontext(&target->context);
+      void *unused = nullptr;
+      decafSwitchFiber(&unused, target->stackPointer);
    } else {
-      swapcontext(&current->context, &target->context);
+      decafSwitchFiber(&current->stackPointer, target->stackPointer);
    }
 }
 
 } // namespace platform
 
+void
+decafFiberStart(platform::Fiber *fiber)
+{
+   fiber->entry(fiber->entryParam);
+   decaf_abort("Fiber entry point must never return");
+}
+
 #endif
@@ -158,7 +158,7 @@ mapViewOfFile(MapFileHandle handle,
       return nullptr;
    }
 
-   if (result != dst) {
+   if (dst && result != dst) {
       gLog->error("mapViewOfFile(offset: 0x{:X}, size: 0x{:X}, dst: {}) mmap returned unexpected address: {}",
                   offset, size, dst, result);
 
@@ -184,6 +184,18 @@ unmapViewOfFile(void *view,
 }
 
 
+void
+prefetchViewOfFile(const void *view,
+                   size_t size)
+{
+   // madvise needs a page aligned start address
+   static const auto pageSize = getSystemPageSize();
+   auto start = reinterpret_cast<uintptr_t>(view) & ~(pageSize - 1);
+   auto end = reinterpret_cast<uintptr_t>(view) + size;
+   madvise(reinterpret_cast<void *>(start), end - start, MADV_WILLNEED);
+}
+
+
 bool
 reserveMemory(uintptr_t address,
               size_t size)
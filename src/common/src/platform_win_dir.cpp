@@ -83,6 +83,36 @@ isDirectory(const std::string &path)
    return !!(info.st_mode & _S_IFDIR);
 }
 
+bool
+listFiles(const std::string &path,
+          const std::function<void(const std::string &name, uint64_t size, uint64_t writeTime)> &func)
+{
+   WIN32_FIND_DATAW data;
+   auto winPath = platform::toWinApiString(path + "\\*");
+   auto handle = FindFirstFileW(winPath.c_str(), &data);
+
+   if (handle == INVALID_HANDLE_VALUE) {
+      return false;
+   }
+
+   do {
+      if (data.dwFileAttributes & FILE_ATTRIBUTE_DIRECTORY) {
+         continue;
+      }
+
+      auto size = uint64_t { data.nFileSizeLow };
+      size |= static_cast<uint64_t>(data.nFileSizeHigh) << 32;
+
+      auto writeTime = uint64_t { data.ftLastWriteTime.dwLowDateTime };
+      writeTime |= static_cast<uint64_t>(data.ftLastWriteTime.dwHighDateTime) << 32;
+
+      func(platform::fromWinApiString(data.cFileName), size, writeTime);
+   } while (FindNextFileW(handle, &data));
+
+   FindClose(handle);
+   return true;
+}
+
 std::string
 getConfigDirectory()
 {
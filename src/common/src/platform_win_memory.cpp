@@ -2,6 +2,7 @@
 #include "log.h"
 #include "platform.h"
 #include "platform_memory.h"
+#include "platform_winapi_string.h"
 
 #ifdef PLATFORM_WINDOWS
 #include <map>
@@ -96,10 +97,15 @@ openMemoryMappedFile(const std::string &path,
 {
    // Only support READ ONLY for now
    decaf_check(flags == ProtectFlags::ReadOnly);
-   OFSTRUCT of;
-   auto fileHandle = reinterpret_cast<HANDLE>(static_cast<uintptr_t>(OpenFile(path.c_str(), &of, OF_READ)));
-   if (!fileHandle) {
-      gLog->error("openMemoryMappedFile(\"{}\") OpenFile failed with error: {}",
+   auto fileHandle = CreateFileW(toWinApiString(path).c_str(),
+                                 GENERIC_READ,
+                                 FILE_SHARE_READ,
+                                 NULL,
+                                 OPEN_EXISTING,
+                                 FILE_ATTRIBUTE_NORMAL,
+                                 NULL);
+   if (fileHandle == INVALID_HANDLE_VALUE) {
+      gLog->error("openMemoryMappedFile(\"{}\") CreateFile failed with error: {}",
                   path, GetLastError());
       return InvalidMapFileHandle;
    }
@@ -195,6 +201,14 @@ unmapViewOfFile(void *view,
 }
 
 
+void
+prefetchViewOfFile(const void *view,
+                   size_t size)
+{
+   // Nothing to do, the pages are faulted in as they are read
+}
+
+
 bool
 reserveMemory(uintptr_t address,
               size_t size)
@@ -20,10 +20,17 @@ loadFromTOML(std::shared_ptr<cpptoml::table> config)
    readArray(config, "gpu.debug_filters", gpu::config::debug_filters);
    readValue(config, "gpu.dump_shaders", gpu::config::dump_shaders);
    readValue(config, "gpu.debuggable_shaders", gpu::config::debuggable_shaders);
+   readValue(config, "gpu.tiling_threads", gpu::config::tiling_threads);
+   readValue(config, "gpu.shader_cache_path", gpu::config::shader_cache_path);
+   readValue(config, "gpu.pipeline_compile_threads", gpu::config::pipeline_compile_threads);
+   readValue(config, "gpu.pipeline_fallback", gpu::config::pipeline_fallback);
+   readValue(config, "gpu.cpu_write_tracking", gpu::config::cpu_write_tracking);
 
    readValue(config, "gx2.dump_textures", decaf::config::gx2::dump_textures);
    readValue(config, "gx2.dump_shaders", decaf::config::gx2::dump_shaders);
 
+   readValue(config, "interpreter.block_cache", cpu::config::interpreter::block_cache);
+
    readValue(config, "jit.enabled", cpu::config::jit::enabled);
    readValue(config, "jit.verify", cpu::config::jit::verify);
    readValue(config, "jit.verify_addr", cpu::config::jit::verify_addr);
@@ -31,6 +38,10 @@ loadFromTOML(std::shared_ptr<cpptoml::table> config)
    readValue(config, "jit.data_cache_size_mb", cpu::config::jit::data_cache_size_mb);
    readArray(config, "jit.opt_flags", cpu::config::jit::opt_flags);
    readValue(config, "jit.rodata_read_only", cpu::config::jit::rodata_read_only);
+   readValue(config, "jit.cache_path", cpu::config::jit::cache_path);
+   readValue(config, "jit.compile_threads", cpu::config::jit::compile_threads);
+   readValue(config, "jit.tier_up_threshold", cpu::config::jit::tier_up_threshold);
+   readArray(config, "jit.baseline_opt_flags", cpu::config::jit::baseline_opt_flags);
 
    readValue(config, "log.async", decaf::config::log::async);
    readValue(config, "log.branch_trace", decaf::config::log::branch_trace);
@@ -43,6 +54,8 @@ loadFromTOML(std::shared_ptr<cpptoml::table> config)
    readValue(config, "log.to_stdout", decaf::config::log::to_stdout);
 
    readValue(config, "sound.dump_sounds", decaf::config::sound::dump_sounds);
+   readValue(config, "sound.verify_mix", decaf::config::sound::verify_mix);
+   readValue(config, "sound.mix_threads", decaf::config::sound::mix_threads);
 
    readValue(config, "system.region", decaf::config::system::region);
    readValue(config, "system.hfio_path", decaf::config::system::hfio_path);
@@ -52,6 +65,11 @@ loadFromTOML(std::shared_ptr<cpptoml::table> config)
    readValue(config, "system.slc_path", decaf::config::system::slc_path);
    readValue(config, "system.content_path", decaf::config::system::content_path);
    readValue(config, "system.time_scale", decaf::config::system::time_scale);
+   readValue(config, "system.io_threads", decaf::config::system::io_threads);
+   readValue(config, "system.fs_readahead_kb", decaf::config::system::fs_readahead_kb);
+   readValue(config, "system.loader_threads", decaf::config::system::loader_threads);
+   readValue(config, "system.loader_cache_path", decaf::config::system::loader_cache_path);
+   readValue(config, "system.loader_cache_max_mb", decaf::config::system::loader_cache_max_mb);
    readArray(config, "system.lle_modules", decaf::config::system::lle_modules);
    readValue(config, "system.dump_hle_rpl", decaf::config::system::dump_hle_rpl);
    return true;
@@ -80,6 +98,11 @@ saveToTOML(std::shared_ptr<cpptoml::table> config)
 
    gpu->insert("debug", gpu::config::debug);
    gpu->insert("dump_shaders", gpu::config::dump_shaders);
+   gpu->insert("tiling_threads", gpu::config::tiling_threads);
+   gpu->insert("shader_cache_path", gpu::config::shader_cache_path);
+   gpu->insert("pipeline_compile_threads", gpu::config::pipeline_compile_threads);
+   gpu->insert("pipeline_fallback", gpu::config::pipeline_fallback);
+   gpu->insert("cpu_write_tracking", gpu::config::cpu_write_tracking);
 
    auto debug_filters = cpptoml::make_array();
    for (auto &filter : gpu::config::debug_filters) {
@@ -99,6 +122,15 @@ saveToTOML(std::shared_ptr<cpptoml::table> config)
    gx2->insert("dump_shaders", decaf::config::gx2::dump_shaders);
    config->insert("gx2", gx2);
 
+   // interpreter
+   auto interpreter = config->get_table("interpreter");
+   if (!interpreter) {
+      interpreter = cpptoml::make_table();
+   }
+
+   interpreter->insert("block_cache", cpu::config::interpreter::block_cache);
+   config->insert("interpreter", interpreter);
+
    // jit
    auto jit = config->get_table("jit");
    if (!jit) {
@@ -111,6 +143,8 @@ saveToTOML(std::shared_ptr<cpptoml::table> config)
    jit->insert("code_cache_size_mb", cpu::config::jit::code_cache_size_mb);
    jit->insert("data_cache_size_mb", cpu::config::jit::data_cache_size_mb);
    jit->insert("rodata_read_only", cpu::config::jit::rodata_read_only);
+   jit->insert("cache_path", cpu::config::jit::cache_path);
+   jit->insert("compile_threads", cpu::config::jit::compile_threads);
 
    auto opt_flags = cpptoml::make_array();
    for (auto &flag : cpu::config::jit::opt_flags) {
@@ -118,6 +152,14 @@ saveToTOML(std::shared_ptr<cpptoml::table> config)
    }
 
    jit->insert("opt_flags", opt_flags);
+
+   auto baseline_opt_flags = cpptoml::make_array();
+   for (auto &flag : cpu::config::jit::baseline_opt_flags) {
+      baseline_opt_flags->push_back(flag);
+   }
+
+   jit->insert("baseline_opt_flags", baseline_opt_flags);
+   jit->insert("tier_up_threshold", cpu::config::jit::tier_up_threshold);
    config->insert("jit", jit);
 
    // log
@@ -150,6 +192,8 @@ saveToTOML(std::shared_ptr<cpptoml::table> config)
    }
 
    sound->insert("dump_sounds", decaf::config::sound::dump_sounds);
+   sound->insert("verify_mix", decaf::config::sound::verify_mix);
+   sound->insert("mix_threads", decaf::config::sound::mix_threads);
    config->insert("sound", sound);
 
    // system
@@ -166,6 +210,11 @@ saveToTOML(std::shared_ptr<cpptoml::table> config)
    system->insert("slc_path", decaf::config::system::slc_path);
    system->insert("content_path", decaf::config::system::content_path);
    system->insert("time_scale", decaf::config::system::time_scale);
+   system->insert("io_threads", decaf::config::system::io_threads);
+   system->insert("fs_readahead_kb", decaf::config::system::fs_readahead_kb);
+   system->insert("loader_threads", decaf::config::system::loader_threads);
+   system->insert("loader_cache_path", decaf::config::system::loader_cache_path);
+   system->insert("loader_cache_max_mb", decaf::config::system::loader_cache_max_mb);
 
    auto lle_modules = cpptoml::make_array();
    for (auto &name : decaf::config::system::lle_modules) {
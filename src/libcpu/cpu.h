@@ -40,6 +40,13 @@ using SegfaultHandler = void(*)(Core *core, uint32_t address, platform::StackTra
 using IllInstHandler = void(*)(Core *core, platform::StackTrace *hostStackTrace);
 using BranchTraceHandler = void(*)(Core *core, uint32_t target);
 using KernelCallHandler = void(*)(Core *core, uint32_t id);
+using KernelCallFunction = void(*)(Core *core, void *userData);
+
+struct KernelCallEntry
+{
+   KernelCallFunction func = nullptr;
+   void *userData = nullptr;
+};
 
 void
 initialise();
@@ -73,6 +80,18 @@ setBranchTraceHandler(BranchTraceHandler handler);
 void
 setKernelCallHandler(KernelCallHandler handler);
 
+void
+registerKernelCall(uint32_t id,
+                   KernelCallEntry entry,
+                   KernelCallEntry traceEntry);
+
+void
+setKernelCallTraceEnabled(bool enabled);
+
+void
+onKernelCall(Core *core,
+             uint32_t id);
+
 void
 start();
 
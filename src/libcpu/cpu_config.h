@@ -9,6 +9,14 @@ namespace cpu
 namespace config
 {
 
+namespace interpreter
+{
+
+//! Cache predecoded basic blocks in the interpreter
+extern bool block_cache;
+
+} // namespace interpreter
+
 namespace jit
 {
 
@@ -33,6 +41,18 @@ extern std::vector<std::string> opt_flags;
 //! Treat .rodata sections as read-only regardless of RPL/RPX flags
 extern bool rodata_read_only;
 
+//! Path to persistent translation cache file (empty = disabled)
+extern std::string cache_path;
+
+//! Number of background compile threads (0 = compile synchronously on the core)
+extern unsigned int compile_threads;
+
+//! Executions before a baseline block is recompiled with opt_flags (0 = disable tiered compile)
+extern unsigned int tier_up_threshold;
+
+//! List of JIT optimizations used for the first compile of a block when tiered compile is enabled
+extern std::vector<std::string> baseline_opt_flags;
+
 } // namespace jit
 
 } // namespace config
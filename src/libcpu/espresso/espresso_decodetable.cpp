@@ -0,0 +1,241 @@
+#include "espresso_instructionset.h"
+
+#include <array>
+#include <cstdint>
+#include <initializer_list>
+
+namespace espresso
+{
+
+namespace decode
+{
+
+/*
+ * A flat decode table generated at compile time from
+ * espresso_instruction_definitions.inl.
+ *
+ * Every instruction definition is reduced to a DecodeRule, a single mask and
+ * value over the whole instruction word. The table is indexed first by the
+ * primary opcode and then, for primary opcodes which have extended opcodes, by
+ * bits 21-30 of the instruction. Each slot holds a short list of rules, which
+ * are checked in definition order to validate the remaining fields.
+ */
+
+struct OpcodeMatch
+{
+   uint32_t mask;
+   uint32_t value;
+};
+
+struct Field
+{
+   constexpr Field(uint32_t first, uint32_t last) :
+      mask(static_cast<uint32_t>(((1ull << (last - first + 1)) - 1) << (31 - last))),
+      shift(31 - last)
+   {
+   }
+
+   constexpr OpcodeMatch
+   operator==(uint32_t value) const
+   {
+      return { mask, (value << shift) & mask };
+   }
+
+   constexpr OpcodeMatch
+   operator!() const
+   {
+      return { mask, 0 };
+   }
+
+   uint32_t mask;
+   uint32_t shift;
+};
+
+struct DecodeRule
+{
+   InstructionID id;
+   uint32_t mask;
+   uint32_t value;
+};
+
+static constexpr DecodeRule
+makeRule(InstructionID id, std::initializer_list<OpcodeMatch> opcodes)
+{
+   auto rule = DecodeRule { id, 0, 0 };
+
+   for (auto &op : opcodes) {
+      rule.mask |= op.mask;
+      rule.value |= op.value;
+   }
+
+   return rule;
+}
+
+// Create a Field for each of the field names used inside the spec files
+#define FLD(x, y, z, ...) static constexpr Field x { y, z };
+#define MRKR(x, ...)
+#include "espresso_instruction_fields.inl"
+#undef FLD
+#undef MRKR
+
+#define PRINTOPS(...) __VA_ARGS__
+#define INS(name, write, read, flags, opcodes, fullname) \
+   makeRule(InstructionID::name, { PRINTOPS opcodes }),
+
+static constexpr DecodeRule
+sDecodeRules[] = {
+#  include "espresso_instruction_definitions.inl"
+};
+
+#undef INS
+#undef PRINTOPS
+
+static constexpr auto NumRules = sizeof(sDecodeRules) / sizeof(sDecodeRules[0]);
+static constexpr auto PrimaryShift = 26u;
+static constexpr auto PrimaryMask = 0xFC000000u;
+static constexpr auto NumPrimary = 64u;
+static constexpr auto SecondaryShift = 1u;
+static constexpr auto SecondaryMask = 0x000007FEu;
+static constexpr auto NumSecondary = 1024u;
+static constexpr auto MaxSlotRules = 4u;
+static constexpr auto NoSecondaryTable = uint8_t { 0xFF };
+
+static_assert(NumRules < 0xFFFF, "Rule index must fit in a uint16_t");
+
+struct DecodeSlot
+{
+   //! Index + 1 into sDecodeRules, 0 terminates the list.
+   std::array<uint16_t, MaxSlotRules> rules;
+};
+
+static constexpr bool
+hasSecondaryTable(uint32_t primary)
+{
+   for (auto i = 0u; i < NumRules; ++i) {
+      auto &rule = sDecodeRules[i];
+
+      if ((rule.value & PrimaryMask) >> PrimaryShift == primary &&
+          (rule.mask & SecondaryMask)) {
+         return true;
+      }
+   }
+
+   return false;
+}
+
+static constexpr uint32_t
+countSecondaryTables()
+{
+   auto count = 0u;
+
+   for (auto i = 0u; i < NumPrimary; ++i) {
+      if (hasSecondaryTable(i)) {
+         ++count;
+      }
+   }
+
+   return count;
+}
+
+static constexpr auto NumSecondaryTables = countSecondaryTables();
+
+struct DecodeTable
+{
+   std::array<uint8_t, NumPrimary> secondaryIndex;
+   std::array<DecodeSlot, NumPrimary> primary;
+   std::array<std::array<DecodeSlot, NumSecondary>, NumSecondaryTables> secondary;
+};
+
+static constexpr void
+addRule(DecodeSlot &slot, uint32_t ruleIndex)
+{
+   for (auto i = 0u; i < MaxSlotRules; ++i) {
+      if (slot.rules[i] == 0) {
+         slot.rules[i] = static_cast<uint16_t>(ruleIndex + 1);
+         return;
+      }
+   }
+
+   // Increase MaxSlotRules, this fails compilation when evaluated as constexpr.
+   throw "Too many rules for decode table slot";
+}
+
+static constexpr DecodeTable
+buildDecodeTable()
+{
+   auto table = DecodeTable { };
+   auto numSecondaryTables = 0u;
+
+   for (auto i = 0u; i < NumPrimary; ++i) {
+      if (hasSecondaryTable(i)) {
+         table.secondaryIndex[i] = static_cast<uint8_t>(numSecondaryTables++);
+      } else {
+         table.secondaryIndex[i] = NoSecondaryTable;
+      }
+   }
+
+   for (auto i = 0u; i < NumRules; ++i) {
+      auto &rule = sDecodeRules[i];
+      auto primary = (rule.value & PrimaryMask) >> PrimaryShift;
+      auto secondaryIndex = table.secondaryIndex[primary];
+
+      if (secondaryIndex == NoSecondaryTable) {
+         addRule(table.primary[primary], i);
+         continue;
+      }
+
+      // Add to every secondary slot the rule's extended opcode bits match
+      auto &secondary = table.secondary[secondaryIndex];
+
+      for (auto j = 0u; j < NumSecondary; ++j) {
+         auto bits = j << SecondaryShift;
+
+         if ((bits & rule.mask) == (rule.value & rule.mask & SecondaryMask)) {
+            addRule(secondary[j], i);
+         }
+      }
+   }
+
+   return table;
+}
+
+static constexpr DecodeTable
+sDecodeTable = buildDecodeTable();
+
+} // namespace decode
+
+
+/**
+ * Decode an instruction to its InstructionID using the flat decode table.
+ *
+ * Returns InstructionID::Invalid if the instruction does not decode.
+ */
+InstructionID
+decodeInstructionID(Instruction instr)
+{
+   using namespace decode;
+   auto primary = instr.value >> PrimaryShift;
+   auto secondaryIndex = sDecodeTable.secondaryIndex[primary];
+   auto slot = &sDecodeTable.primary[primary];
+
+   if (secondaryIndex != NoSecondaryTable) {
+      auto secondary = (instr.value & SecondaryMask) >> SecondaryShift;
+      slot = &sDecodeTable.secondary[secondaryIndex][secondary];
+   }
+
+   for (auto ruleIndex : slot->rules) {
+      if (!ruleIndex) {
+         break;
+      }
+
+      auto &rule = sDecodeRules[ruleIndex - 1];
+
+      if ((instr.value & rule.mask) == rule.value) {
+         return rule.id;
+      }
+   }
+
+   return InstructionID::Invalid;
+}
+
+} // namespace espresso
@@ -164,6 +164,20 @@ encodeSPR(Instruction &instr, SPR spr)
 // Decode Instruction to InstructionInfo
 InstructionInfo *
 decodeInstruction(Instruction instr)
+{
+   auto id = decodeInstructionID(instr);
+
+   if (id == InstructionID::Invalid) {
+      return nullptr;
+   }
+
+   return &sInstructionInfo[static_cast<size_t>(id)];
+}
+
+// Decode Instruction to InstructionInfo by walking the instruction table,
+// only used to verify the flat decode table in decodeInstructionID.
+InstructionInfo *
+decodeInstructionTree(Instruction instr)
 {
    auto table = &sInstructionTable;
 
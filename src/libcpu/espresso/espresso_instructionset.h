@@ -66,6 +66,12 @@ initialiseInstructionSet();
 InstructionInfo *
 decodeInstruction(Instruction instr);
 
+InstructionID
+decodeInstructionID(Instruction instr);
+
+InstructionInfo *
+decodeInstructionTree(Instruction instr);
+
 Instruction
 encodeInstruction(InstructionID id);
 
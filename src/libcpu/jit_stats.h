@@ -35,6 +35,15 @@ struct CodeBlockProfileData
    std::atomic<uint64_t> time;
 };
 
+enum class CodeBlockTier : uint32_t
+{
+   //! Compiled with the baseline optimisation flags, may be recompiled.
+   Baseline,
+
+   //! Compiled with the full optimisation flags.
+   Optimised,
+};
+
 struct CodeBlock
 {
    //! Guest address of PPC code.
@@ -46,6 +55,12 @@ struct CodeBlock
    //! Size of compiled code.
    uint32_t codeSize;
 
+   //! Optimisation tier of compiled code.
+   CodeBlockTier tier;
+
+   //! Number of executions counted towards recompiling a baseline block.
+   std::atomic<uint32_t> tierUpCount;
+
    //! Profiling data.
    CodeBlockProfileData profileData;
 
@@ -64,6 +79,10 @@ struct JitStats
    uint64_t totalTimeInCodeBlocks = 0;
    uint64_t usedCodeCacheSize = 0;
    uint64_t usedDataCacheSize = 0;
+   uint64_t persistentCacheHits = 0;
+   uint64_t persistentCacheMisses = 0;
+   uint64_t persistentCacheRejects = 0;
+   uint64_t tierUpCompiles = 0;
    gsl::span<CodeBlock> compiledBlocks;
 };
 
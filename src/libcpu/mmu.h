@@ -55,6 +55,9 @@ enum class PhysicalMemoryType
 
 constexpr auto PageSize = uint32_t { 128 * 1024 };
 
+//! Granularity of physical memory write tracking.
+constexpr auto WriteTrackPageSize = uint32_t { 4 * 1024 };
+
 bool
 initialiseMemory();
 
@@ -98,6 +101,38 @@ bool
 virtualToPhysicalAddress(VirtualAddress virtualAddress,
                          PhysicalAddress &out);
 
+/*
+ * Physical memory write tracking.
+ *
+ * Tracked pages are write protected on every virtual mapping and on the
+ * physical view, so writes from the interpreter, JIT compiled code and host
+ * code using either kind of pointer are all recorded.
+ *
+ * Host writes which can not fault, such as a system call reading into guest
+ * memory, would fail on a protected page. They must be wrapped in
+ * beginHostWrite and endHostWrite, which keep the range writable.
+ */
+
+bool
+trackPhysicalWrites(PhysicalAddress address,
+                    uint32_t size);
+
+uint64_t
+getPhysicalWriteGeneration();
+
+bool
+hasPhysicalWriteSince(PhysicalAddress address,
+                      uint32_t size,
+                      uint64_t generation);
+
+void
+beginHostWrite(PhysicalAddress address,
+               uint32_t size);
+
+void
+endHostWrite(PhysicalAddress address,
+             uint32_t size);
+
 template<typename Type>
 inline VirtualAddress
 translate(Type *pointer)
@@ -16,6 +16,7 @@
 #include <common/platform_thread.h>
 #include <condition_variable>
 #include <memory>
+#include <mutex>
 #include <vector>
 
 namespace cpu
@@ -92,6 +93,20 @@ initialise()
    if (gJitMode != cpu::jit_mode::disabled) {
       auto backend = new jit::BinrecBackend { sJitCodeCacheSize, sJitDataCacheSize };
       backend->setOptFlags(config::jit::opt_flags);
+
+      if (gJitMode == jit_mode::enabled && !config::jit::cache_path.empty()) {
+         backend->openPersistentCache(config::jit::cache_path);
+      }
+
+      if (gJitMode == jit_mode::enabled && config::jit::compile_threads) {
+         backend->setAsyncCompile(config::jit::compile_threads);
+      }
+
+      if (gJitMode == jit_mode::enabled && config::jit::tier_up_threshold) {
+         backend->setTieredCompile(config::jit::baseline_opt_flags,
+                                   config::jit::tier_up_threshold);
+      }
+
       jit::setBackend(backend);
    }
 
@@ -102,6 +117,7 @@ void
 clearInstructionCache()
 {
    cpu::jit::clearCache(0, 0xFFFFFFFF);
+   cpu::interpreter::clearCache(0, 0xFFFFFFFF);
 }
 
 void
@@ -109,6 +125,7 @@ invalidateInstructionCache(uint32_t address,
                            uint32_t size)
 {
    cpu::jit::clearCache(address, size);
+   cpu::interpreter::clearCache(address, size);
 }
 
 void
@@ -157,21 +174,27 @@ exceptionHandler(platform::Exception *exception)
       return platform::UnhandledException;
    }
 
-   // Only handle exceptions from the CPU cores
-   if (this_core::id() >= 0xFF) {
-      return platform::UnhandledException;
-   }
-
    // Retreive the exception information
    auto info = reinterpret_cast<platform::AccessViolationException *>(exception);
    auto address = info->address;
 
+   // Writes to write tracked pages can come from any thread, through either
+   // the virtual or the physical address space
+   if (address != 0 && handleWriteTrackFault(address)) {
+      return platform::HandledException;
+   }
+
    // Only handle exceptions within the virtual memory bounds
    auto memBase = getBaseVirtualAddress();
    if (address != 0 && (address < memBase || address >= memBase + 0x100000000)) {
       return platform::UnhandledException;
    }
 
+   // Only handle exceptions from the CPU cores
+   if (this_core::id() >= 0xFF) {
+      return platform::UnhandledException;
+   }
+
    sSegfaultAddr = static_cast<uint32_t>(address - memBase);
    sSegfaultStackTrace = platform::captureStackTrace();
    return coreSegfaultEntry;
@@ -180,11 +203,11 @@ exceptionHandler(platform::Exception *exception)
 void
 installExceptionHandler()
 {
-   static bool handlerInstalled = false;
-   if (!handlerInstalled) {
-      handlerInstalled = true;
+   // This can be called from both start and the first trackPhysicalWrites
+   static std::once_flag handlerInstalled;
+   std::call_once(handlerInstalled, []() {
       platform::installExceptionHandler(exceptionHandler);
-   }
+   });
 }
 
 void
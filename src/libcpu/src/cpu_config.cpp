@@ -6,6 +6,13 @@ namespace cpu
 namespace config
 {
 
+namespace interpreter
+{
+
+bool block_cache = false;
+
+} // namespace interpreter
+
 namespace jit
 {
 
@@ -15,6 +22,9 @@ uint32_t verify_addr = 0;
 unsigned int code_cache_size_mb = 1024;
 unsigned int data_cache_size_mb = 512;
 bool rodata_read_only = true;
+std::string cache_path = "";
+unsigned int compile_threads = 0;
+unsigned int tier_up_threshold = 0;
 
 std::vector<std::string> opt_flags =
 {
@@ -30,6 +40,11 @@ std::vector<std::string> opt_flags =
    "X86_STORE_IMMEDIATE",
 };
 
+std::vector<std::string> baseline_opt_flags =
+{
+   "BASIC",
+};
+
 } // namespace jit
 
 } // namespace config
@@ -38,12 +38,14 @@ gTimerThread;
 void
 timerEntryPoint();
 
+bool
+initialiseMemory();
+
 void
-onKernelCall(cpu::Core *core,
-             uint32_t id);
+installExceptionHandler();
 
 bool
-initialiseMemory();
+handleWriteTrackFault(uintptr_t hostAddress);
 
 namespace this_core
 {
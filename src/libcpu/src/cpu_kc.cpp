@@ -1,10 +1,25 @@
 #include "cpu.h"
+#include <atomic>
 #include <vector>
 
 namespace cpu
 {
 
+/*
+ * A kc is dispatched straight to the host function registered for its id,
+ * ids without one go to the kernel call handler.
+ *
+ * There are two tables, the trace table is used while kernel call tracing is
+ * enabled so that the plain table does not have to check whether to trace
+ * on every call. Both are only resized by registerKernelCall before the cores
+ * are started, switching between them is a single pointer store.
+ */
 static KernelCallHandler sHandler = nullptr;
+static std::vector<KernelCallEntry> sKernelCalls;
+static std::vector<KernelCallEntry> sTraceKernelCalls;
+static std::atomic<const KernelCallEntry *> sKernelCallTable { nullptr };
+static std::atomic<bool> sKernelCallTraceEnabled { false };
+static uint32_t sNumKernelCalls = 0;
 
 void
 setKernelCallHandler(KernelCallHandler handler)
@@ -12,10 +27,46 @@ setKernelCallHandler(KernelCallHandler handler)
    sHandler = handler;
 }
 
+void
+registerKernelCall(uint32_t id,
+                   KernelCallEntry entry,
+                   KernelCallEntry traceEntry)
+{
+   if (id >= sKernelCalls.size()) {
+      sKernelCalls.resize(id + 1);
+      sTraceKernelCalls.resize(id + 1);
+   }
+
+   sKernelCalls[id] = entry;
+   sTraceKernelCalls[id] = traceEntry;
+   sNumKernelCalls = static_cast<uint32_t>(sKernelCalls.size());
+   setKernelCallTraceEnabled(sKernelCallTraceEnabled.load());
+}
+
+void
+setKernelCallTraceEnabled(bool enabled)
+{
+   sKernelCallTraceEnabled.store(enabled);
+
+   if (enabled) {
+      sKernelCallTable.store(sTraceKernelCalls.data());
+   } else {
+      sKernelCallTable.store(sKernelCalls.data());
+   }
+}
+
 void
 onKernelCall(cpu::Core *core,
              uint32_t id)
 {
+   if (id < sNumKernelCalls) {
+      auto &entry = sKernelCallTable.load(std::memory_order_relaxed)[id];
+      if (entry.func) {
+         entry.func(core, entry.userData);
+         return;
+      }
+   }
+
    if (sHandler) {
       sHandler(core, id);
    }
@@ -1,3 +1,4 @@
+#include "cpu_internal.h"
 #include "mmu.h"
 #include "memorymap.h"
 
@@ -84,4 +85,47 @@ virtualToPhysicalAddress(VirtualAddress virtualAddress,
    return sMemoryMap.virtualToPhysicalAddress(virtualAddress, out);
 }
 
+bool
+trackPhysicalWrites(PhysicalAddress address,
+                    uint32_t size)
+{
+   // Tracking can start before the cores, make sure write faults are handled
+   installExceptionHandler();
+   return sMemoryMap.trackWrites(address, size);
+}
+
+uint64_t
+getPhysicalWriteGeneration()
+{
+   return sMemoryMap.getWriteGeneration();
+}
+
+bool
+hasPhysicalWriteSince(PhysicalAddress address,
+                      uint32_t size,
+                      uint64_t generation)
+{
+   return sMemoryMap.hasWriteSince(address, size, generation);
+}
+
+void
+beginHostWrite(PhysicalAddress address,
+               uint32_t size)
+{
+   sMemoryMap.beginHostWrite(address, size);
+}
+
+void
+endHostWrite(PhysicalAddress address,
+             uint32_t size)
+{
+   sMemoryMap.endHostWrite(address, size);
+}
+
+bool
+handleWriteTrackFault(uintptr_t hostAddress)
+{
+   return sMemoryMap.handleWriteFault(hostAddress);
+}
+
 } // namespace cpu
@@ -1,4 +1,5 @@
 #include "cpu_breakpoints.h"
+#include "cpu_config.h"
 #include "cpu_internal.h"
 #include "espresso/espresso_instructionset.h"
 #include "interpreter.h"
@@ -108,9 +109,17 @@ resume()
    std::feclearexcept(FE_ALL_EXCEPT);
 
    auto core = cpu::this_core::state();
-   while (core->nia != cpu::CALLBACK_ADDR) {
-      this_core::checkInterrupts();
-      core = step_one(this_core::state());
+
+   if (config::interpreter::block_cache) {
+      while (core->nia != cpu::CALLBACK_ADDR) {
+         this_core::checkInterrupts();
+         core = step_block(this_core::state());
+      }
+   } else {
+      while (core->nia != cpu::CALLBACK_ADDR) {
+         this_core::checkInterrupts();
+         core = step_one(this_core::state());
+      }
    }
 }
 
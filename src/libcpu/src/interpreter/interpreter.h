@@ -13,6 +13,13 @@ initialise();
 Core *
 step_one(Core *core);
 
+Core *
+step_block(Core *core);
+
+void
+clearCache(uint32_t address,
+           uint32_t size);
+
 void
 resume();
 
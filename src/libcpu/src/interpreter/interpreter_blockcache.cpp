@@ -0,0 +1,297 @@
+#include "cpu_breakpoints.h"
+#include "cpu_internal.h"
+#include "espresso/espresso_instructionset.h"
+#include "interpreter.h"
+#include "interpreter_insreg.h"
+#include "mem.h"
+
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <cstring>
+#include <common/fastregionmap.h>
+#include <common/platform_compiler.h>
+#include <limits>
+#include <mutex>
+#include <vector>
+
+namespace cpu
+{
+
+namespace interpreter
+{
+
+/**
+ * A basic block of predecoded instructions.
+ *
+ * A block ends after the first instruction which can change nia or the
+ * current core, or at the end of a page so invalidation stays simple.
+ */
+struct DecodedBlock
+{
+   struct Entry
+   {
+      instrfptr_t fptr;
+      Instruction instr;
+   };
+
+   uint32_t address;
+   uint32_t size;
+   std::vector<Entry> instrs;
+
+   //! Value of sRetireEpoch once this block was removed from sBlockCache.
+   uint64_t retireEpoch;
+};
+
+static constexpr auto MaxBlockInstructions = 64u;
+static constexpr auto BlockPageSize = 0x1000u;
+
+//! Value of sCoreEpoch for a core which is not executing a block.
+static constexpr auto QuiescentEpoch = std::numeric_limits<uint64_t>::max();
+
+static FastRegionMap<DecodedBlock *>
+sBlockCache;
+
+static std::mutex
+sBlockListMutex;
+
+//! Blocks which might be in sBlockCache.
+static std::vector<DecodedBlock *>
+sBlockList;
+
+//! Blocks removed from sBlockCache which a core might still be executing.
+static std::vector<DecodedBlock *>
+sRetiredBlocks;
+
+//! Incremented after every removal of blocks from sBlockCache.
+static std::atomic<uint64_t>
+sRetireEpoch { 0 };
+
+//! Incremented by every clearCache, a block decoded while it changed may be
+//! of stale code and is not published.
+static std::atomic<uint64_t>
+sInvalidateGeneration { 0 };
+
+//! The value of sRetireEpoch when each core started executing its current
+//! block, or QuiescentEpoch.
+static std::array<std::atomic<uint64_t>, 3>
+sCoreEpoch { QuiescentEpoch, QuiescentEpoch, QuiescentEpoch };
+
+static bool
+isBlockTerminator(InstructionID id)
+{
+   switch (id) {
+   case InstructionID::b:
+   case InstructionID::bc:
+   case InstructionID::bcctr:
+   case InstructionID::bclr:
+   case InstructionID::kc:
+   case InstructionID::sc:
+   case InstructionID::rfi:
+   case InstructionID::tw:
+   case InstructionID::twi:
+      return true;
+   default:
+      return false;
+   }
+}
+
+
+/**
+ * Decode the basic block starting at address and insert it into the cache.
+ *
+ * Returns nullptr if the first instruction can not be decoded, or the cache
+ * was invalidated while decoding, in which case the caller should fall back
+ * to step_one.
+ */
+static DecodedBlock *
+decodeBlock(uint32_t address)
+{
+   // Taken before reading any guest code, so an invalidation for a write we
+   // may have missed always changes it before we publish.
+   auto generation = sInvalidateGeneration.load();
+   auto block = new DecodedBlock { };
+   block->address = address;
+   block->instrs.reserve(MaxBlockInstructions);
+
+   for (auto cia = address; block->instrs.size() < MaxBlockInstructions; cia += 4) {
+      auto instr = mem::read<Instruction>(cia);
+      auto data = espresso::decodeInstruction(instr);
+
+      if (!data) {
+         break;
+      }
+
+      auto fptr = getInstructionHandler(data->id);
+      if (!fptr) {
+         break;
+      }
+
+      block->instrs.push_back({ fptr, instr });
+
+      if (isBlockTerminator(data->id)) {
+         break;
+      }
+
+      if (((cia + 4) & (BlockPageSize - 1)) == 0) {
+         break;
+      }
+   }
+
+   if (block->instrs.empty()) {
+      delete block;
+      return nullptr;
+   }
+
+   block->size = static_cast<uint32_t>(block->instrs.size() * 4);
+
+   // Published under the lock so clearCache either sees the block in
+   // sBlockList, or has already changed the generation.
+   std::unique_lock<std::mutex> lock { sBlockListMutex };
+
+   if (generation != sInvalidateGeneration.load()) {
+      delete block;
+      return nullptr;
+   }
+
+   sBlockList.push_back(block);
+   sBlockCache.set(address, block);
+   return block;
+}
+
+
+/**
+ * Execute one predecoded basic block.
+ *
+ * Falls back to step_one when tracing or when breakpoints are set.
+ */
+Core *
+step_block(Core *core)
+{
+   if (UNLIKELY(core->tracer || hasBreakpoints())) {
+      return step_one(core);
+   }
+
+   // Any block retired after this point can not be found by this lookup, so
+   // it may be freed once we are done with this block.
+   sCoreEpoch[core->id].store(sRetireEpoch.load());
+
+   auto block = sBlockCache.find(core->nia);
+
+   if (UNLIKELY(!block)) {
+      block = decodeBlock(core->nia);
+
+      if (!block) {
+         sCoreEpoch[core->id].store(QuiescentEpoch, std::memory_order_release);
+         return step_one(core);
+      }
+   }
+
+   for (auto &entry : block->instrs) {
+      auto cia = core->nia;
+      core->cia = cia;
+      core->nia = cia + 4;
+      entry.fptr(core, entry.instr);
+
+      if (core->nia != cia + 4) {
+         break;
+      }
+   }
+
+   // The last instruction might have been a kc, so we could be on a
+   // different core now. Only the last instruction of a block can switch
+   // cores, and the block is not touched after it, so marking whichever
+   // core we are on now is safe.
+   core = this_core::state();
+   sCoreEpoch[core->id].store(QuiescentEpoch, std::memory_order_release);
+   return core;
+}
+
+
+/**
+ * Free the retired blocks which no core can still be executing.
+ *
+ * Must be called with sBlockListMutex held.
+ */
+static void
+freeRetiredBlocks()
+{
+   auto oldestEpoch = QuiescentEpoch;
+
+   for (auto &coreEpoch : sCoreEpoch) {
+      oldestEpoch = std::min(oldestEpoch, coreEpoch.load());
+   }
+
+   auto itr = std::remove_if(sRetiredBlocks.begin(), sRetiredBlocks.end(),
+                             [&](DecodedBlock *block) {
+                                if (block->retireEpoch > oldestEpoch) {
+                                   return false;
+                                }
+
+                                delete block;
+                                return true;
+                             });
+   sRetiredBlocks.erase(itr, sRetiredBlocks.end());
+}
+
+
+/**
+ * Invalidate any decoded blocks overlapping the address range.
+ *
+ * A partial invalidation retires the blocks, as they might still be
+ * executing on another core. Retired blocks are freed by a later
+ * invalidation once every core has moved on from them. A full clear frees
+ * everything, so it must not be called while any core is executing.
+ */
+void
+clearCache(uint32_t address,
+           uint32_t size)
+{
+   std::unique_lock<std::mutex> lock { sBlockListMutex };
+   sInvalidateGeneration.fetch_add(1);
+
+   if (address == 0 && size == 0xFFFFFFFF) {
+      sBlockCache.clear();
+
+      for (auto block : sBlockList) {
+         delete block;
+      }
+
+      for (auto block : sRetiredBlocks) {
+         delete block;
+      }
+
+      sBlockList.clear();
+      sRetiredBlocks.clear();
+      return;
+   }
+
+   auto end = static_cast<uint64_t>(address) + size;
+   auto retireEpoch = sRetireEpoch.load() + 1;
+   auto itr = std::remove_if(sBlockList.begin(), sBlockList.end(),
+                             [&](DecodedBlock *block) {
+                                if (block->address >= end ||
+                                    static_cast<uint64_t>(block->address) + block->size <= address) {
+                                   return false;
+                                }
+
+                                if (sBlockCache.find(block->address) == block) {
+                                   sBlockCache.set(block->address, nullptr);
+                                }
+
+                                block->retireEpoch = retireEpoch;
+                                sRetiredBlocks.push_back(block);
+                                return true;
+                             });
+
+   if (itr != sBlockList.end()) {
+      sBlockList.erase(itr, sBlockList.end());
+      sRetireEpoch.store(retireEpoch);
+   }
+
+   freeRetiredBlocks();
+}
+
+} // namespace interpreter
+
+} // namespace cpu
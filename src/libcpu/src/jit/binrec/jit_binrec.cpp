@@ -1,5 +1,6 @@
 #include "cpu.h"
 #include "cpu_breakpoints.h"
+#include "cpu_config.h"
 #include "cpu_internal.h"
 #include "espresso/espresso_instructionset.h"
 #include "jit_binrec.h"
@@ -7,10 +8,13 @@
 #include "mem.h"
 #include "mmu.h"
 
+#include <algorithm>
 #include <cfenv>
 #include <common/bitutils.h>
+#include <common/datahash.h>
 #include <common/decaf_assert.h>
 #include <common/log.h>
+#include <common/platform_thread.h>
 #include <cstdlib>
 #include <fmt/format.h>
 
@@ -46,6 +50,7 @@ BinrecBackend::BinrecBackend(size_t codeCacheSize,
 
 BinrecBackend::~BinrecBackend()
 {
+   stopCompileThreads();
    mCodeCache.free();
 }
 
@@ -94,12 +99,18 @@ BinrecBackend::initialiseCore(uint32_t id)
 void
 BinrecBackend::addReadOnlyRange(uint32_t address, uint32_t size)
 {
+   // The range is already loaded, hash it now for getTranslationConfigHash
+   auto memBase = reinterpret_cast<const uint8_t *>(getBaseVirtualAddress());
    mReadOnlyRanges.emplace_back(address, size);
+   mReadOnlyDataHash.write(memBase + address, size);
 }
 
 void
 BinrecBackend::clearCache(uint32_t address, uint32_t size)
 {
+   // Make sure no compile thread publishes a block for stale code
+   flushCompileQueue();
+
    if (address == 0 && size == 0xFFFFFFFF) {
       mCodeCache.clear();
       mTotalProfileTime = 0;
@@ -108,10 +119,277 @@ BinrecBackend::clearCache(uint32_t address, uint32_t size)
    }
 }
 
-BinrecHandle *
-BinrecBackend::createBinrecHandle()
+bool
+BinrecBackend::openPersistentCache(const std::string &path)
+{
+   return mPersistentCache.open(path, getBackendHash());
+}
+
+
+/**
+ * Enable asynchronous compilation on a pool of compile threads.
+ *
+ * In this mode a core which hits an uncompiled address queues it for
+ * compilation and continues in the interpreter until the block is published
+ * into the fast index.
+ */
+void
+BinrecBackend::setAsyncCompile(unsigned numThreads)
+{
+   mAsyncCompile = numThreads > 0;
+   startCompileThreads(numThreads);
+}
+
+
+/**
+ * Enable tiered compilation.
+ *
+ * Blocks are first compiled with the cheap baseline optimisation flags, once
+ * a block has been executed tierUpThreshold times it is recompiled with the
+ * full optimisation flags on a compile thread and swapped into the fast index.
+ *
+ * If async compile has not been enabled then a single compile thread is
+ * started to handle tier up compiles only.
+ */
+void
+BinrecBackend::setTieredCompile(const std::vector<std::string> &baselineOptList,
+                                unsigned tierUpThreshold)
+{
+   mBaselineOptFlags = parseOptFlags(baselineOptList);
+   mTierUpThreshold = tierUpThreshold;
+
+   if (mTierUpThreshold && mCompileThreads.empty()) {
+      startCompileThreads(1);
+   }
+}
+
+
+/**
+ * Start the compile thread pool, replacing any existing threads.
+ */
+void
+BinrecBackend::startCompileThreads(unsigned numThreads)
+{
+   stopCompileThreads();
+
+   if (!numThreads) {
+      return;
+   }
+
+   mCompileThreadsRunning = true;
+
+   for (auto i = 0u; i < numThreads; ++i) {
+      auto compileThread = std::make_unique<CompileThread>();
+      compileThread->thread = std::thread { &BinrecBackend::compileThreadEntry, this, compileThread.get() };
+      platform::setThreadName(&compileThread->thread, fmt::format("JIT Compile {}", i));
+      mCompileThreads.emplace_back(std::move(compileThread));
+   }
+}
+
+
+/**
+ * Stop and join all compile threads.
+ */
+void
+BinrecBackend::stopCompileThreads()
+{
+   {
+      std::unique_lock<std::mutex> lock { mCompileMutex };
+      mCompileThreadsRunning = false;
+      mCompileQueue.clear();
+   }
+
+   mCompileCondition.notify_all();
+
+   for (auto &compileThread : mCompileThreads) {
+      if (compileThread->thread.joinable()) {
+         compileThread->thread.join();
+      }
+
+      delete compileThread->handle;
+      delete compileThread->optimisedHandle;
+   }
+
+   mCompileThreads.clear();
+}
+
+
+/**
+ * Queue an address for compilation.
+ *
+ * Baseline requests must already be marked as CodeBlockIndexCompiling by the
+ * caller, optimised requests replace an existing baseline block.
+ */
+void
+BinrecBackend::queueCompile(uint32_t address,
+                            CodeBlockTier tier)
+{
+   {
+      std::unique_lock<std::mutex> lock { mCompileMutex };
+      mCompileQueue.push_back({ address, tier });
+   }
+
+   mCompileCondition.notify_one();
+}
+
+
+/**
+ * Discard any queued compiles and wait for in-flight compiles to finish.
+ */
+void
+BinrecBackend::flushCompileQueue()
+{
+   if (mCompileThreads.empty()) {
+      return;
+   }
+
+   std::unique_lock<std::mutex> lock { mCompileMutex };
+
+   for (auto &request : mCompileQueue) {
+      if (request.tier == CodeBlockTier::Baseline) {
+         mCodeCache.getIndexPointer(request.address)->store(CodeBlockIndexUncompiled);
+      }
+   }
+
+   mCompileQueue.clear();
+   mCompileIdleCondition.wait(lock, [&]() { return mCompileActiveCount == 0; });
+}
+
+
+/**
+ * Entry point for compile threads, each has its own BinrecHandle per tier.
+ */
+void
+BinrecBackend::compileThreadEntry(CompileThread *compileThread)
+{
+   std::unique_lock<std::mutex> lock { mCompileMutex };
+
+   while (true) {
+      mCompileCondition.wait(lock, [&]() {
+         return !mCompileThreadsRunning || !mCompileQueue.empty();
+      });
+
+      if (!mCompileThreadsRunning) {
+         break;
+      }
+
+      auto request = mCompileQueue.front();
+      mCompileQueue.pop_front();
+      mCompileActiveCount++;
+      lock.unlock();
+
+      if (request.tier == CodeBlockTier::Baseline) {
+         if (!compileThread->handle) {
+            compileThread->handle = createBinrecHandle(getBaselineOptFlags());
+            compileThread->configHash = getTranslationConfigHash(getBaselineOptFlags());
+         }
+
+         if (!translateBlock(nullptr, compileThread->handle, compileThread->configHash,
+                             request.address, getBaselineTier())) {
+            mCodeCache.getIndexPointer(request.address)->store(CodeBlockIndexError);
+         }
+      } else {
+         if (!compileThread->optimisedHandle) {
+            compileThread->optimisedHandle = createBinrecHandle(mOptFlags);
+            compileThread->optimisedConfigHash = getTranslationConfigHash(mOptFlags);
+         }
+
+         // Only replace the block if it is still the baseline block, if the
+         // optimised translation fails we just keep using the baseline block.
+         auto block = mCodeCache.getBlockByAddress(request.address);
+         if (block && block->tier == CodeBlockTier::Baseline) {
+            if (translateBlock(nullptr, compileThread->optimisedHandle,
+                               compileThread->optimisedConfigHash,
+                               request.address, CodeBlockTier::Optimised)) {
+               mTierUpCompiles++;
+            }
+         }
+      }
+
+      lock.lock();
+      mCompileActiveCount--;
+
+      if (mCompileActiveCount == 0) {
+         mCompileIdleCondition.notify_all();
+      }
+   }
+}
+
+
+/**
+ * The optimisation flags used for a block's first compile.
+ */
+const BinrecOptimisationFlags &
+BinrecBackend::getBaselineOptFlags()
+{
+   return mTierUpThreshold ? mBaselineOptFlags : mOptFlags;
+}
+
+
+/**
+ * The tier of a block compiled with getBaselineOptFlags.
+ */
+CodeBlockTier
+BinrecBackend::getBaselineTier()
+{
+   return mTierUpThreshold ? CodeBlockTier::Baseline : CodeBlockTier::Optimised;
+}
+
+
+/**
+ * Hash of the libbinrec version and the setup it is given.
+ *
+ * Translated code depends on both, it calls back into decaf through the
+ * handlers and reads guest state at the offsets in the setup, so a cache
+ * written by a different libbinrec or BinrecCore layout cannot be used.
+ */
+PersistentCodeCache::Hash
+BinrecBackend::getBackendHash()
 {
    binrec::Setup setup;
+   initBinrecSetup(setup);
+
+   // These change on every run and are not baked into the code
+   setup.guest_memory_base = nullptr;
+   setup.log = nullptr;
+
+   auto version = std::string { binrec_version() };
+   return DataHash { }
+      .write(version.data(), version.size())
+      .write(setup)
+      .value();
+}
+
+
+/**
+ * Hash of all settings which affect the output of createBinrecHandle.
+ *
+ * This includes the data of the read-only ranges, as loads from them are
+ * folded into the translated code. Note read-only ranges are captured when
+ * a core's handle is created, so this must be called at the same time.
+ */
+PersistentCodeCache::Hash
+BinrecBackend::getTranslationConfigHash(const BinrecOptimisationFlags &optFlags)
+{
+   auto hash = DataHash { };
+   hash.write(optFlags.useChaining);
+   hash.write(optFlags.common);
+   hash.write(optFlags.guest);
+   hash.write(optFlags.host);
+   hash.write(binrec::native_features());
+
+   for (const auto &range : mReadOnlyRanges) {
+      hash.write(range.first);
+      hash.write(range.second);
+   }
+
+   hash.write(mReadOnlyDataHash.value());
+   return hash.value();
+}
+
+void
+BinrecBackend::initBinrecSetup(binrec::Setup &setup)
+{
    std::memset(&setup, 0, sizeof(setup));
    setup.guest = binrec::Arch::BINREC_ARCH_PPC_7XX;
 
@@ -144,6 +422,13 @@ BinrecBackend::createBinrecHandle()
    setup.state_offset_pvr = offsetof2(BinrecCore, pvr);
    setup.state_offset_pir = offsetof2(BinrecCore, id);
    setup.log = brLog;
+}
+
+BinrecHandle *
+BinrecBackend::createBinrecHandle(const BinrecOptimisationFlags &optFlags)
+{
+   binrec::Setup setup;
+   initBinrecSetup(setup);
 
    auto handle = new BinrecHandle {};
    if (!handle->initialize(setup)) {
@@ -151,9 +436,9 @@ BinrecBackend::createBinrecHandle()
       return nullptr;
    }
 
-   handle->set_optimization_flags(mOptFlags.common, mOptFlags.guest, mOptFlags.host);
+   handle->set_optimization_flags(optFlags.common, optFlags.guest, optFlags.host);
    handle->enable_branch_exit_test(true);
-   handle->enable_chaining(mOptFlags.useChaining);
+   handle->enable_chaining(optFlags.useChaining);
 
    if (gJitMode == jit_mode::verify && gJitVerifyAddress == 0) {
       handle->set_pre_insn_callback(brVerifyPreHandler);
@@ -217,8 +502,9 @@ BinrecBackend::getCodeBlock(BinrecCore *core, uint32_t address)
    // If block is uncompiled, let's try mark it as compiling!
    if (UNLIKELY(blockIndex == CodeBlockIndexUncompiled)) {
       if (!indexPtr->compare_exchange_strong(blockIndex, CodeBlockIndexCompiling)) {
-         // Another thread has started compiling, wait for it to finish.
-         while (blockIndex == CodeBlockIndexCompiling) {
+         // Another thread has started compiling, wait for it to finish. In
+         // async mode we return to the interpreter rather than waiting.
+         while (blockIndex == CodeBlockIndexCompiling && !mAsyncCompile) {
             using namespace std::chrono_literals;
             std::this_thread::sleep_for(10us);
             blockIndex = indexPtr->load();
@@ -237,6 +523,11 @@ BinrecBackend::getCodeBlock(BinrecCore *core, uint32_t address)
       return nullptr;
    }
 
+   // Block is still queued on a compile thread
+   if (UNLIKELY(blockIndex == CodeBlockIndexCompiling && mAsyncCompile)) {
+      return nullptr;
+   }
+
    // Do not compile if there is a breakpoint at address.
    if (UNLIKELY(hasBreakpoint(address))) {
       return nullptr;
@@ -247,10 +538,16 @@ BinrecBackend::getCodeBlock(BinrecCore *core, uint32_t address)
       return block;
    }
 
+   if (mAsyncCompile) {
+      queueCompile(address, CodeBlockTier::Baseline);
+      return nullptr;
+   }
+
    auto handle = mHandles[core->id];
    if (!handle) {
-      handle = createBinrecHandle();
+      handle = createBinrecHandle(getBaselineOptFlags());
       mHandles[core->id] = handle;
+      mHandleConfigHashes[core->id] = getTranslationConfigHash(getBaselineOptFlags());
    }
 
    if (gJitMode == jit_mode::verify && gJitVerifyAddress != 0) {
@@ -263,6 +560,88 @@ BinrecBackend::getCodeBlock(BinrecCore *core, uint32_t address)
       }
    }
 
+   auto block = translateBlock(core, handle, mHandleConfigHashes[core->id],
+                               address, getBaselineTier());
+
+   if (!block) {
+      indexPtr->store(CodeBlockIndexError);
+   }
+
+   return block;
+}
+
+
+/**
+ * Number of guest bytes from address which libbinrec translates into one
+ * block when given size bytes to translate.
+ *
+ * libbinrec ends a block at the first unconditional branch which no earlier
+ * branch in the block jumps past. This stops only there too, calls, system
+ * calls and traps are all treated as part of the block, so the result can be
+ * longer than the block but never shorter.
+ */
+static uint32_t
+getTranslatedGuestSize(uint32_t address,
+                       uint32_t size)
+{
+   auto end = uint64_t { address } + size;
+   auto furthestTarget = uint64_t { address };
+
+   for (auto pc = uint64_t { address }; pc + 4 <= end; pc += 4) {
+      auto instr = espresso::Instruction { mem::read<uint32_t>(static_cast<uint32_t>(pc)) };
+      auto target = uint64_t { 0 };
+      auto unconditional = false;
+
+      if (instr.opcd == 18) {
+         // b
+         target = sign_extend<26>(instr.li << 2) + (instr.aa ? 0 : static_cast<uint32_t>(pc));
+         unconditional = !instr.lk;
+      } else if (instr.opcd == 16) {
+         // bc
+         target = sign_extend<16>(instr.bd << 2) + (instr.aa ? 0 : static_cast<uint32_t>(pc));
+         unconditional = !instr.lk && (instr.bo & 0x14) == 0x14;
+      } else if (instr.opcd == 19 && (instr.xo1 == 16 || instr.xo1 == 528)) {
+         // bclr, bcctr
+         unconditional = !instr.lk && (instr.bo & 0x14) == 0x14;
+      }
+
+      if (target > pc) {
+         furthestTarget = std::max(furthestTarget, target);
+      }
+
+      if (unconditional && pc >= furthestTarget) {
+         return static_cast<uint32_t>(pc + 4 - address);
+      }
+   }
+
+   return size;
+}
+
+
+/**
+ * Translate the block at address and register it in the code cache.
+ */
+CodeBlock *
+BinrecBackend::translateBlock(BinrecCore *core,
+                              BinrecHandle *handle,
+                              const PersistentCodeCache::Hash &configHash,
+                              uint32_t address,
+                              CodeBlockTier tier)
+{
+   // Check for a previously translated block in the persistent cache
+   if (mPersistentCache.isOpen()) {
+      if (auto entry = mPersistentCache.find(address, configHash)) {
+         auto block = mCodeCache.registerCodeBlock(address,
+                                                   const_cast<uint8_t *>(entry->code.data()),
+                                                   entry->code.size(),
+                                                   const_cast<uint8_t *>(entry->unwindInfo.data()),
+                                                   entry->unwindInfo.size(),
+                                                   tier);
+         decaf_check(block);
+         return block;
+      }
+   }
+
    // In extreme cases (such as dense floating-point code with no
    // optimizations enabled), translation could fail due to internal
    // libbinrec limits, so try repeatedly with smaller code ranges if
@@ -276,7 +655,6 @@ BinrecBackend::getCodeBlock(BinrecCore *core, uint32_t address)
 
       if (limit < 256) {
          gLog->warn("Failed to translate code at 0x{:X}", address);
-         indexPtr->store(CodeBlockIndexError);
          return nullptr;
       }
    }
@@ -295,8 +673,16 @@ BinrecBackend::getCodeBlock(BinrecCore *core, uint32_t address)
    auto unwindSize = size_t { 0 };
 #endif
 
-   auto block = mCodeCache.registerCodeBlock(address, code, codeSize, unwindInfo, unwindSize);
+   auto block = mCodeCache.registerCodeBlock(address, code, codeSize, unwindInfo, unwindSize, tier);
    decaf_check(block);
+
+   if (mPersistentCache.isOpen()) {
+      auto guestSize = PersistentCodeCache::getGuestSize(address, limit);
+      mPersistentCache.store(address, configHash,
+                             getTranslatedGuestSize(address, guestSize),
+                             code, codeSize, unwindInfo, unwindSize);
+   }
+
    free(buffer);
 
    // Clear any floating-point exceptions raised by the translation so
@@ -321,6 +707,59 @@ BinrecBackend::getCodeBlockFast(BinrecCore *core, uint32_t address)
    return getCodeBlock(core, address);
 }
 
+/**
+ * Interpret guest code whilst waiting for a block to be compiled.
+ *
+ * Stops at the first taken branch so the branch target gets queued for
+ * compilation, or as soon as a compiled block exists for the next address.
+ */
+BinrecCore *
+BinrecBackend::interpretUntilBranch(BinrecCore *core)
+{
+   if (!mAsyncCompile) {
+      // Step over the current instruction, in case it's confusing
+      // the translator.  TODO: Consider blacklisting the address to
+      // avoid trying to translate it every time we encounter it.
+      return reinterpret_cast<BinrecCore *>(interpreter::step_one(core));
+   }
+
+   if (config::interpreter::block_cache) {
+      // A predecoded block already ends at the first branch.
+      return reinterpret_cast<BinrecCore *>(interpreter::step_block(core));
+   }
+
+   for (auto i = 0u; i < 1024; ++i) {
+      auto cia = core->nia;
+      auto next = reinterpret_cast<BinrecCore *>(interpreter::step_one(core));
+
+      if (next != core || core->nia != cia + 4 || core->interrupt.load()) {
+         // Rescheduled, branched or interrupted.
+         return next;
+      }
+
+      auto indexPtr = mCodeCache.getConstIndexPointer(core->nia);
+      if (indexPtr && indexPtr->load() >= 0) {
+         break;
+      }
+   }
+
+   return core;
+}
+
+/**
+ * Count an execution of a baseline block, queueing it to be recompiled with
+ * full optimisations once it reaches the tier up threshold.
+ */
+void
+BinrecBackend::checkTierUp(CodeBlock *block)
+{
+   auto count = block->tierUpCount.fetch_add(1, std::memory_order_relaxed);
+
+   if (UNLIKELY(count + 1 == mTierUpThreshold)) {
+      queueCompile(block->address, CodeBlockTier::Optimised);
+   }
+}
+
 static inline uint64_t
 rdtsc()
 {
@@ -375,13 +814,14 @@ BinrecBackend::resumeExecution()
 #endif
 
          if (LIKELY(block)) {
+            if (UNLIKELY(block->tier == CodeBlockTier::Baseline)) {
+               checkTierUp(block);
+            }
+
             auto entry = reinterpret_cast<BinrecEntry>(block->code);
             entry(core, memBase);
          } else {
-            // Step over the current instruction, in case it's confusing
-            // the translator.  TODO: Consider blacklisting the address to
-            // avoid trying to translate it every time we encounter it.
-            interpreter::step_one(core);
+            interpretUntilBranch(core);
          }
 
          // If we just returned from a system call, we might have been
@@ -391,10 +831,14 @@ BinrecBackend::resumeExecution()
          const uint64_t start = rdtsc();
 
          if (block) {
+            if (UNLIKELY(block->tier == CodeBlockTier::Baseline)) {
+               checkTierUp(block);
+            }
+
             auto entry = reinterpret_cast<BinrecEntry>(block->code);
             entry(core, memBase);
          } else {
-            interpreter::step_one(core);
+            interpretUntilBranch(core);
          }
 
          core = reinterpret_cast<BinrecCore *>(this_core::state());
@@ -426,6 +870,10 @@ BinrecBackend::sampleStats(JitStats &stats)
    stats.compiledBlocks = mCodeCache.getCompiledCodeBlocks();
    stats.usedCodeCacheSize = mCodeCache.getCodeCacheSize();
    stats.usedDataCacheSize = mCodeCache.getDataCacheSize();
+   stats.persistentCacheHits = mPersistentCache.stats().hits;
+   stats.persistentCacheMisses = mPersistentCache.stats().misses;
+   stats.persistentCacheRejects = mPersistentCache.stats().rejects;
+   stats.tierUpCompiles = mTierUpCompiles;
    return true;
 }
 
@@ -1,9 +1,16 @@
 #pragma once
 #include "state.h"
 #include "jit/jit_codecache.h"
+#include "jit/jit_persistentcache.h"
 #include "jit/jit_backend.h"
 
 #include <binrec++.h>
+#include <common/datahash.h>
+#include <condition_variable>
+#include <deque>
+#include <memory>
+#include <mutex>
+#include <thread>
 #include <vector>
 #include <string>
 
@@ -90,11 +97,82 @@ public:
    void
    setOptFlags(const std::vector<std::string> &optList);
 
+   bool
+   openPersistentCache(const std::string &path);
+
+   void
+   setAsyncCompile(unsigned numThreads);
+
+   void
+   setTieredCompile(const std::vector<std::string> &baselineOptList,
+                    unsigned tierUpThreshold);
+
    CodeBlock *
    getCodeBlock(BinrecCore *core, uint32_t address);
 
 protected:
-   BinrecHandle *createBinrecHandle();
+   struct CompileThread
+   {
+      std::thread thread;
+      BinrecHandle *handle = nullptr;
+      PersistentCodeCache::Hash configHash;
+      BinrecHandle *optimisedHandle = nullptr;
+      PersistentCodeCache::Hash optimisedConfigHash;
+   };
+
+   struct CompileRequest
+   {
+      uint32_t address;
+      CodeBlockTier tier;
+   };
+
+   static BinrecOptimisationFlags
+   parseOptFlags(const std::vector<std::string> &optList);
+
+   const BinrecOptimisationFlags &
+   getBaselineOptFlags();
+
+   CodeBlockTier
+   getBaselineTier();
+
+   void initBinrecSetup(binrec::Setup &setup);
+
+   BinrecHandle *createBinrecHandle(const BinrecOptimisationFlags &optFlags);
+
+   PersistentCodeCache::Hash
+   getBackendHash();
+
+   PersistentCodeCache::Hash
+   getTranslationConfigHash(const BinrecOptimisationFlags &optFlags);
+
+   CodeBlock *
+   translateBlock(BinrecCore *core,
+                  BinrecHandle *handle,
+                  const PersistentCodeCache::Hash &configHash,
+                  uint32_t address,
+                  CodeBlockTier tier);
+
+   void
+   checkTierUp(CodeBlock *block);
+
+   BinrecCore *
+   interpretUntilBranch(BinrecCore *core);
+
+   void
+   queueCompile(uint32_t address,
+                CodeBlockTier tier);
+
+   void
+   startCompileThreads(unsigned numThreads);
+
+   void
+   flushCompileQueue();
+
+   void
+   stopCompileThreads();
+
+   void
+   compileThreadEntry(CompileThread *compileThread);
 
    inline CodeBlock *
    getCodeBlockFast(BinrecCore *core, uint32_t address);
@@ -128,10 +206,26 @@ protected:
 private:
    CodeCache mCodeCache;
    std::array<BinrecHandle *, 3> mHandles;
+   std::array<PersistentCodeCache::Hash, 3> mHandleConfigHashes;
+   PersistentCodeCache mPersistentCache;
    BinrecOptimisationFlags mOptFlags;
+   BinrecOptimisationFlags mBaselineOptFlags;
+   unsigned mTierUpThreshold = 0;
+   std::atomic<uint64_t> mTierUpCompiles { 0 };
    std::vector<std::pair<ppcaddr_t, uint32_t>> mReadOnlyRanges;
+   DataHash mReadOnlyDataHash;
    std::atomic<uint64_t> mTotalProfileTime { 0 };
    uint32_t mProfilingMask = 0;
+
+   // Asynchronous compilation
+   bool mAsyncCompile = false;
+   bool mCompileThreadsRunning = false;
+   unsigned mCompileActiveCount = 0;
+   std::vector<std::unique_ptr<CompileThread>> mCompileThreads;
+   std::deque<CompileRequest> mCompileQueue;
+   std::mutex mCompileMutex;
+   std::condition_variable mCompileCondition;
+   std::condition_variable mCompileIdleCondition;
 };
 
 } // namespace jit
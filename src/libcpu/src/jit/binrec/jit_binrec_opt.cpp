@@ -101,10 +101,13 @@ sOptFlags = {
 void
 BinrecBackend::setOptFlags(const std::vector<std::string> &optList)
 {
-   mOptFlags.common = 0;
-   mOptFlags.guest = 0;
-   mOptFlags.host = 0;
-   mOptFlags.useChaining = false;
+   mOptFlags = parseOptFlags(optList);
+}
+
+BinrecOptimisationFlags
+BinrecBackend::parseOptFlags(const std::vector<std::string> &optList)
+{
+   auto optFlags = BinrecOptimisationFlags { };
 
    for (const auto &i : optList) {
       auto flag = sOptFlags.find(i);
@@ -116,19 +119,21 @@ BinrecBackend::setOptFlags(const std::vector<std::string> &optList)
 
       switch (flag->second.type) {
       case OptFlagInfo::OPTFLAG_CHAIN:
-         mOptFlags.useChaining = true;
+         optFlags.useChaining = true;
          break;
       case OptFlagInfo::OPTFLAG_COMMON:
-         mOptFlags.common |= flag->second.value;
+         optFlags.common |= flag->second.value;
          break;
       case OptFlagInfo::OPTFLAG_GUEST:
-         mOptFlags.guest |= flag->second.value;
+         optFlags.guest |= flag->second.value;
          break;
       case OptFlagInfo::OPTFLAG_HOST:
-         mOptFlags.host |= flag->second.value;
+         optFlags.host |= flag->second.value;
          break;
       }
    }
+
+   return optFlags;
 }
 
 } // namespace jit
@@ -313,7 +313,8 @@ CodeCache::registerCodeBlock(uint32_t address,
                              void *code,
                              size_t size,
                              void *unwindInfo,
-                             size_t unwindSize)
+                             size_t unwindSize,
+                             CodeBlockTier tier)
 {
    auto dataAddress = allocate(mDataAllocator, sizeof(CodeBlock), 1);
    auto codeAddress = allocate(mCodeAllocator, size, 16);
@@ -323,6 +324,8 @@ CodeCache::registerCodeBlock(uint32_t address,
    block->address = address;
    block->code = reinterpret_cast<void *>(codeAddress);
    block->codeSize = static_cast<uint32_t>(size);
+   block->tier = tier;
+   block->tierUpCount = 0;
    std::memcpy(block->code, code, size);
 
    // Initialise profiling data
@@ -132,7 +132,8 @@ public:
                      void *code,
                      size_t size,
                      void *unwindInfo,
-                     size_t unwindSize);
+                     size_t unwindSize,
+                     CodeBlockTier tier = CodeBlockTier::Optimised);
 
 
 private:
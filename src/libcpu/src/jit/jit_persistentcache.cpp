@@ -0,0 +1,348 @@
+#include "jit_persistentcache.h"
+#include "mem.h"
+#include "mmu.h"
+
+#include <common/datahash.h>
+#include <common/log.h>
+#include <common/platform.h>
+
+#include <algorithm>
+
+namespace cpu
+{
+
+namespace jit
+{
+
+static constexpr uint32_t CacheFileMagic = 0x5449434A; // 'JCIT'
+static constexpr uint32_t CacheFileVersion = 2;
+
+#ifdef PLATFORM_WINDOWS
+static constexpr uint32_t CacheFileHost = 0x100 | sizeof(void *);
+#else
+static constexpr uint32_t CacheFileHost = 0x000 | sizeof(void *);
+#endif
+
+struct CacheFileHeader
+{
+   uint32_t magic;
+   uint32_t version;
+   uint32_t host;
+   uint32_t reserved;
+   PersistentCodeCache::Hash backendHash;
+};
+
+struct CacheFileEntryHeader
+{
+   uint32_t address;
+   uint32_t guestSize;
+   uint32_t codeSize;
+   uint32_t unwindSize;
+   PersistentCodeCache::Hash configHash;
+   PersistentCodeCache::Hash guestHash;
+};
+
+PersistentCodeCache::~PersistentCodeCache()
+{
+   close();
+}
+
+
+/**
+ * Open a persistent cache file, loading any valid entries it contains.
+ *
+ * If the file does not exist, or was written by an incompatible version,
+ * host or backend, then it is recreated empty.
+ */
+bool
+PersistentCodeCache::open(const std::string &path,
+                          const Hash &backendHash)
+{
+   close();
+   mPath = path;
+   mBackendHash = backendHash;
+
+   auto rewrite = true;
+   auto in = std::ifstream { path, std::ifstream::binary };
+
+   if (in.is_open()) {
+      rewrite = !load(in);
+      in.close();
+   }
+
+   if (rewrite) {
+      mOutput.open(path, std::ofstream::binary | std::ofstream::trunc);
+
+      if (!mOutput.is_open()) {
+         gLog->warn("Failed to create JIT cache file {}", path);
+         mEntries.clear();
+         return false;
+      }
+
+      auto header = CacheFileHeader { };
+      header.magic = CacheFileMagic;
+      header.version = CacheFileVersion;
+      header.host = CacheFileHost;
+      header.reserved = 0;
+      header.backendHash = mBackendHash;
+      mOutput.write(reinterpret_cast<const char *>(&header), sizeof(header));
+
+      // Write back whatever valid entries we managed to load
+      for (auto &itr : mEntries) {
+         for (auto &entry : itr.second) {
+            writeEntry(itr.first, entry);
+         }
+      }
+   } else {
+      mOutput.open(path, std::ofstream::binary | std::ofstream::app);
+
+      if (!mOutput.is_open()) {
+         gLog->warn("Failed to open JIT cache file {} for writing", path);
+      }
+   }
+
+   gLog->info("Loaded {} blocks from JIT cache {}", mEntries.size(), path);
+   mOpen = true;
+   return true;
+}
+
+
+/**
+ * Close the persistent cache, this discards all loaded entries.
+ */
+void
+PersistentCodeCache::close()
+{
+   std::lock_guard<std::mutex> lock { mMutex };
+
+   if (mOutput.is_open()) {
+      mOutput.close();
+   }
+
+   mEntries.clear();
+   mStored.clear();
+   mOpen = false;
+}
+
+
+/**
+ * Read entries from a cache file.
+ *
+ * Returns false if the file needs to be rewritten.
+ */
+bool
+PersistentCodeCache::load(std::ifstream &in)
+{
+   auto header = CacheFileHeader { };
+   in.read(reinterpret_cast<char *>(&header), sizeof(header));
+
+   if (!in ||
+       header.magic != CacheFileMagic ||
+       header.version != CacheFileVersion ||
+       header.host != CacheFileHost ||
+       header.backendHash != mBackendHash) {
+      gLog->info("Discarding incompatible JIT cache {}", mPath);
+      return false;
+   }
+
+   while (in.peek() != std::ifstream::traits_type::eof()) {
+      auto entryHeader = CacheFileEntryHeader { };
+      in.read(reinterpret_cast<char *>(&entryHeader), sizeof(entryHeader));
+
+      if (!in || entryHeader.guestSize == 0 || entryHeader.codeSize == 0) {
+         gLog->warn("Truncated JIT cache {}, discarding remaining entries", mPath);
+         return false;
+      }
+
+      auto entry = Entry { };
+      entry.configHash = entryHeader.configHash;
+      entry.guestHash = entryHeader.guestHash;
+      entry.guestSize = entryHeader.guestSize;
+      entry.code.resize(entryHeader.codeSize);
+      entry.unwindInfo.resize(entryHeader.unwindSize);
+      in.read(reinterpret_cast<char *>(entry.code.data()), entry.code.size());
+      in.read(reinterpret_cast<char *>(entry.unwindInfo.data()), entry.unwindInfo.size());
+
+      if (!in) {
+         gLog->warn("Truncated JIT cache {}, discarding remaining entries", mPath);
+         return false;
+      }
+
+      auto &entries = mEntries[entryHeader.address];
+      auto itr = std::find_if(entries.begin(), entries.end(),
+                              [&](const Entry &other) {
+                                 return other.configHash == entry.configHash &&
+                                        other.guestHash == entry.guestHash;
+                              });
+
+      if (itr != entries.end()) {
+         *itr = std::move(entry);
+      } else {
+         entries.emplace_back(std::move(entry));
+      }
+   }
+
+   return true;
+}
+
+
+/**
+ * Find a valid entry for a guest address.
+ *
+ * The loaded entries are never modified after open so this does not need
+ * to take a lock.
+ */
+const PersistentCodeCache::Entry *
+PersistentCodeCache::find(uint32_t address,
+                          const Hash &configHash)
+{
+   auto itr = mEntries.find(address);
+
+   if (itr == mEntries.end()) {
+      mStats.misses++;
+      return nullptr;
+   }
+
+   auto guestHash = Hash { };
+   auto guestHashSize = uint32_t { 0 };
+
+   for (auto &entry : itr->second) {
+      if (entry.configHash != configHash) {
+         continue;
+      }
+
+      if (getGuestSize(address, entry.guestSize) != entry.guestSize) {
+         continue;
+      }
+
+      if (guestHashSize != entry.guestSize) {
+         guestHash = hashGuestCode(address, entry.guestSize);
+         guestHashSize = entry.guestSize;
+      }
+
+      if (entry.guestHash == guestHash) {
+         mStats.hits++;
+         return &entry;
+      }
+   }
+
+   mStats.rejects++;
+   return nullptr;
+}
+
+
+/**
+ * Append a newly translated block to the cache file.
+ *
+ * Stored entries only become visible to find after the cache is reopened.
+ */
+void
+PersistentCodeCache::store(uint32_t address,
+                           const Hash &configHash,
+                           uint32_t guestSize,
+                           const void *code,
+                           size_t codeSize,
+                           const void *unwindInfo,
+                           size_t unwindSize)
+{
+   if (!mOpen || !guestSize) {
+      return;
+   }
+
+   auto entry = Entry { };
+   entry.configHash = configHash;
+   entry.guestHash = hashGuestCode(address, guestSize);
+   entry.guestSize = guestSize;
+
+   // Avoid writing the same block again after a cache clear
+   auto key = DataHash { }
+      .write(address)
+      .write(entry.configHash)
+      .write(entry.guestHash)
+      .fastCompareValue();
+
+   std::lock_guard<std::mutex> lock { mMutex };
+   if (!mOutput.is_open() || !mStored.insert(key).second) {
+      return;
+   }
+
+   auto codeBytes = reinterpret_cast<const uint8_t *>(code);
+   auto unwindBytes = reinterpret_cast<const uint8_t *>(unwindInfo);
+   entry.code.assign(codeBytes, codeBytes + codeSize);
+
+   if (unwindSize) {
+      entry.unwindInfo.assign(unwindBytes, unwindBytes + unwindSize);
+   }
+
+   writeEntry(address, entry);
+   mOutput.flush();
+}
+
+
+/**
+ * Reset the hit / miss / reject counters.
+ */
+void
+PersistentCodeCache::resetStats()
+{
+   mStats.hits = 0;
+   mStats.misses = 0;
+   mStats.rejects = 0;
+}
+
+
+/**
+ * Clamp a guest code range to the mapped memory following address.
+ */
+uint32_t
+PersistentCodeCache::getGuestSize(uint32_t address,
+                                  uint32_t limit)
+{
+   auto end = static_cast<uint64_t>(address) + limit;
+
+   for (auto page = static_cast<uint64_t>(address & ~0xFFFu); page < end; page += 0x1000) {
+      if (!isValidAddress(VirtualAddress { static_cast<uint32_t>(page) })) {
+         return page > address ? static_cast<uint32_t>(page - address) : 0u;
+      }
+   }
+
+   return limit;
+}
+
+
+/**
+ * Hash the guest instruction bytes in [address, address + size).
+ */
+PersistentCodeCache::Hash
+PersistentCodeCache::hashGuestCode(uint32_t address,
+                                   uint32_t size)
+{
+   return DataHash { }
+      .write(mem::translate(address), size)
+      .value();
+}
+
+
+/**
+ * Write a single entry to the output file.
+ */
+void
+PersistentCodeCache::writeEntry(uint32_t address,
+                                const Entry &entry)
+{
+   auto entryHeader = CacheFileEntryHeader { };
+   entryHeader.address = address;
+   entryHeader.guestSize = entry.guestSize;
+   entryHeader.codeSize = static_cast<uint32_t>(entry.code.size());
+   entryHeader.unwindSize = static_cast<uint32_t>(entry.unwindInfo.size());
+   entryHeader.configHash = entry.configHash;
+   entryHeader.guestHash = entry.guestHash;
+
+   mOutput.write(reinterpret_cast<const char *>(&entryHeader), sizeof(entryHeader));
+   mOutput.write(reinterpret_cast<const char *>(entry.code.data()), entry.code.size());
+   mOutput.write(reinterpret_cast<const char *>(entry.unwindInfo.data()), entry.unwindInfo.size());
+}
+
+} // namespace jit
+
+} // namespace cpu
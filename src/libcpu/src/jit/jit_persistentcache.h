@@ -0,0 +1,132 @@
+#pragma once
+#include <array>
+#include <atomic>
+#include <cstdint>
+#include <fstream>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+#include <unordered_set>
+#include <vector>
+
+namespace cpu
+{
+
+namespace jit
+{
+
+/**
+ * Persistent Code Cache Responsibilities:
+ *
+ * 1. Load previously translated blocks from disk.
+ * 2. Append newly translated blocks to disk.
+ * 3. Reject entries whose guest code or translation config no longer match.
+ *
+ * Entries are looked up by guest address, then validated against a hash of
+ * the guest instruction bytes and a hash of the translation configuration
+ * (optimisation flags and read-only ranges) they were compiled with. The
+ * whole file is discarded when it was written by a different backend, as
+ * identified by the backend hash given to open.
+ *
+ * Translated code is position independent, every block is already memcpy'd
+ * from the libbinrec output buffer into the CodeCache, so a loaded block is
+ * relocated by simply registering it in the CodeCache again.
+ */
+class PersistentCodeCache
+{
+public:
+   using Hash = std::array<uint64_t, 2>;
+
+   struct Entry
+   {
+      //! Hash of translation configuration used to compile this block.
+      Hash configHash;
+
+      //! Hash of the guest instruction bytes covered by this block.
+      Hash guestHash;
+
+      //! Number of guest bytes covered by guestHash.
+      uint32_t guestSize;
+
+      //! Translated host code.
+      std::vector<uint8_t> code;
+
+      //! Unwind info, only used on Windows.
+      std::vector<uint8_t> unwindInfo;
+   };
+
+   struct Stats
+   {
+      std::atomic<uint64_t> hits { 0 };
+      std::atomic<uint64_t> misses { 0 };
+      std::atomic<uint64_t> rejects { 0 };
+   };
+
+public:
+   ~PersistentCodeCache();
+
+   bool
+   open(const std::string &path,
+        const Hash &backendHash);
+
+   void
+   close();
+
+   bool
+   isOpen() const
+   {
+      return mOpen;
+   }
+
+   const Entry *
+   find(uint32_t address,
+        const Hash &configHash);
+
+   void
+   store(uint32_t address,
+         const Hash &configHash,
+         uint32_t guestSize,
+         const void *code,
+         size_t codeSize,
+         const void *unwindInfo,
+         size_t unwindSize);
+
+   const Stats &
+   stats() const
+   {
+      return mStats;
+   }
+
+   void
+   resetStats();
+
+   static uint32_t
+   getGuestSize(uint32_t address,
+                uint32_t limit);
+
+   static Hash
+   hashGuestCode(uint32_t address,
+                 uint32_t size);
+
+private:
+   bool
+   load(std::ifstream &in);
+
+   void
+   writeEntry(uint32_t address,
+              const Entry &entry);
+
+private:
+   bool mOpen = false;
+   std::string mPath;
+   Hash mBackendHash;
+   std::mutex mMutex;
+   std::ofstream mOutput;
+   std::unordered_map<uint32_t, std::vector<Entry>> mEntries;
+   std::unordered_set<uint64_t> mStored;
+   Stats mStats;
+};
+
+} // namespace jit
+
+} // namespace cpu
@@ -56,6 +56,11 @@ static constexpr size_t TASize = 256 * 1024 * 1024;
 static constexpr PhysicalAddress TABaseAddress = PhysicalAddress { 0xD0000000 };
 static constexpr PhysicalAddress TAEndAddress = TABaseAddress + TASize - 1;
 
+static constexpr auto WriteTrackPageShift = 12u;
+static constexpr auto NumWriteTrackPages = 0x100000000ull >> WriteTrackPageShift;
+static_assert(WriteTrackPageSize == 1u << WriteTrackPageShift,
+              "WriteTrackPageShift does not match WriteTrackPageSize");
+
 
 MemoryMap::~MemoryMap()
 {
@@ -226,6 +231,9 @@ MemoryMap::reserve()
       return false;
    }
 
+   // Write tracking protects individual pages, which only works when the host
+   // page size is not larger than our tracking granularity.
+   mWriteTrackSupported = platform::getSystemPageSize() <= WriteTrackPageSize;
    return true;
 }
 
@@ -290,6 +298,14 @@ MemoryMap::free()
       mTilingAperture = platform::InvalidMapFileHandle;
    }
 
+   // Release write tracking state
+   mWriteTrackSupported = false;
+   mWriteTrackEnabled.store(false, std::memory_order_release);
+   mWriteTrackState.reset();
+   mPageWriteGeneration.reset();
+   mVirtualPageMap.reset();
+   mHostWrites.clear();
+
    // Release virtual memory
    if (mVirtualBase) {
       platform::freeMemory(mVirtualBase, 0x100000000ull);
@@ -629,13 +645,21 @@ MemoryMap::mapMemory(VirtualAddress virtualAddress,
    virtualMemoryMap.size = size;
    virtualMemoryMap.permission = permission;
 
-   mMappedMemory.insert(std::upper_bound(mMappedMemory.begin(),
-                                         mMappedMemory.end(),
-                                         virtualMemoryMap,
-                                         [](const auto &m1, const auto &m2) {
-                                            return m1.virtualAddress < m2.virtualAddress;
-                                         }),
-                        virtualMemoryMap);
+   {
+      std::lock_guard<std::mutex> lock { mWriteTrackMutex };
+      mMappedMemory.insert(std::upper_bound(mMappedMemory.begin(),
+                                            mMappedMemory.end(),
+                                            virtualMemoryMap,
+                                            [](const auto &m1, const auto &m2) {
+                                               return m1.virtualAddress < m2.virtualAddress;
+                                            }),
+                           virtualMemoryMap);
+
+      if (view == virtualPtr) {
+         protectTrackedPages(virtualMemoryMap);
+         setVirtualPageMap(virtualMemoryMap, true);
+      }
+   }
 
    if (view != virtualPtr) {
       gLog->error("Unable to map virtual address 0x{:08X} to physical address 0x{:08X}",
@@ -655,6 +679,7 @@ MemoryMap::unmapMemory(VirtualAddress virtualAddress,
    std::vector<VirtualMemoryMap> remaps;
    auto start = align_up(virtualAddress, cpu::PageSize);
    auto end = start + (align_up(size, cpu::PageSize) - 1);
+   std::unique_lock<std::mutex> lock { mWriteTrackMutex };
 
    for (auto itr = mMappedMemory.begin(); itr != mMappedMemory.end(); ) {
       auto mapStart = itr->virtualAddress;
@@ -683,6 +708,7 @@ MemoryMap::unmapMemory(VirtualAddress virtualAddress,
          continue;
       }
 
+      setVirtualPageMap(*itr, false);
       itr = mMappedMemory.erase(itr);
 
       if (!platform::unmapViewOfFile(getVirtualPointer(mapStart), mapSize)) {
@@ -691,6 +717,8 @@ MemoryMap::unmapMemory(VirtualAddress virtualAddress,
       }
    }
 
+   lock.unlock();
+
    for (auto &remap : remaps) {
       if (!mapMemory(remap.virtualAddress,
                      remap.physicalAddress,
@@ -709,7 +737,11 @@ bool
 MemoryMap::resetVirtualMemory()
 {
    // First unmap all memory
+   std::unique_lock<std::mutex> lock { mWriteTrackMutex };
+
    for (auto &mapping : mMappedMemory) {
+      setVirtualPageMap(mapping, false);
+
       if (!platform::unmapViewOfFile(getVirtualPointer(mapping.virtualAddress),
                                      mapping.size)) {
          gLog->error("Unexpected error whilst unmapping virtual address 0x{:08X}",
@@ -718,6 +750,7 @@ MemoryMap::resetVirtualMemory()
    }
 
    mMappedMemory.clear();
+   lock.unlock();
 
    if (mReservedMemory.size() == 1) {
       // If there is only 1 reservation then we should be good to go.
@@ -759,6 +792,424 @@ MemoryMap::releaseReservation(VirtualReservation reservation)
 }
 
 
+/**
+ * Start tracking CPU writes to a physical address range.
+ *
+ * The physical view and every virtual mapping of the range are write
+ * protected, the first write to a page afterwards faults into
+ * handleWriteFault which marks the page dirty and makes it writable again.
+ * Calling this on a range which is already tracked protects any dirty pages
+ * again, except for pages with a host write in progress.
+ *
+ * To not miss any writes, callers should read getWriteGeneration before
+ * calling this and only read the memory afterwards.
+ *
+ * Returns false if write tracking is not supported on this host, or the
+ * range is not within a single region of physical memory.
+ */
+bool
+MemoryMap::trackWrites(PhysicalAddress physicalAddress,
+                       uint32_t size)
+{
+   if (!mWriteTrackSupported) {
+      return false;
+   }
+
+   if (size == 0) {
+      return true;
+   }
+
+   // The gaps between physical memory regions are not reserved, so we must
+   // never change the protection of anything outside of a region.
+   auto memoryType = queryPhysicalAddress(physicalAddress);
+   if (memoryType == PhysicalMemoryType::Invalid ||
+       static_cast<uint64_t>(physicalAddress.getAddress()) + size > 0x100000000ull ||
+       queryPhysicalAddress(physicalAddress + (size - 1)) != memoryType) {
+      return false;
+   }
+
+   auto firstPage = physicalAddress.getAddress() >> WriteTrackPageShift;
+   auto lastPage = static_cast<uint32_t>(
+      (static_cast<uint64_t>(physicalAddress.getAddress()) + size - 1) >> WriteTrackPageShift);
+   auto runStart = firstPage;
+   auto runLength = 0u;
+   std::lock_guard<std::mutex> lock { mWriteTrackMutex };
+   enableWriteTracking();
+
+   // Protect runs of pages which are not already protected
+   for (auto page = firstPage; page <= lastPage; ++page) {
+      if (mWriteTrackState[page].load(std::memory_order_relaxed) == WriteTrackState::Protected ||
+          isHostWritePage(page)) {
+         if (runLength) {
+            setTrackedPageProtection(runStart, runLength, platform::ProtectFlags::ReadOnly);
+            runLength = 0;
+         }
+
+         continue;
+      }
+
+      mWriteTrackState[page].store(WriteTrackState::Protected, std::memory_order_relaxed);
+
+      if (!runLength) {
+         runStart = page;
+      }
+
+      ++runLength;
+   }
+
+   if (runLength) {
+      setTrackedPageProtection(runStart, runLength, platform::ProtectFlags::ReadOnly);
+   }
+
+   return true;
+}
+
+
+/**
+ * Check if any page in a physical address range was written after the
+ * given write generation.
+ *
+ * Pages which are not tracked are always reported as written.
+ */
+bool
+MemoryMap::hasWriteSince(PhysicalAddress physicalAddress,
+                         uint32_t size,
+                         uint64_t generation)
+{
+   if (!mWriteTrackEnabled.load(std::memory_order_acquire)) {
+      return true;
+   }
+
+   if (size == 0) {
+      return false;
+   }
+
+   auto firstPage = physicalAddress.getAddress() >> WriteTrackPageShift;
+   auto lastPage = static_cast<uint32_t>(
+      (static_cast<uint64_t>(physicalAddress.getAddress()) + size - 1) >> WriteTrackPageShift);
+
+   for (auto page = firstPage; page <= lastPage; ++page) {
+      if (mWriteTrackState[page].load(std::memory_order_acquire) == WriteTrackState::Untracked ||
+          mPageWriteGeneration[page].load(std::memory_order_acquire) > generation) {
+         return true;
+      }
+   }
+
+   return false;
+}
+
+
+/**
+ * Prepare for host code writing to a physical address range in a way which
+ * can not fault, such as a system call reading a file into guest memory,
+ * which would fail on a write protected page instead.
+ *
+ * The tracked pages in the range are marked as written and made writable on
+ * all views, and they stay writable until the matching endHostWrite.
+ */
+void
+MemoryMap::beginHostWrite(PhysicalAddress physicalAddress,
+                          uint32_t size)
+{
+   if (!mWriteTrackSupported || size == 0) {
+      return;
+   }
+
+   auto firstPage = physicalAddress.getAddress() >> WriteTrackPageShift;
+   auto lastPage = static_cast<uint32_t>(
+      (static_cast<uint64_t>(physicalAddress.getAddress()) + size - 1) >> WriteTrackPageShift);
+   auto runStart = firstPage;
+   auto runLength = 0u;
+   std::lock_guard<std::mutex> lock { mWriteTrackMutex };
+   mHostWrites.emplace_back(firstPage, lastPage);
+
+   if (!mWriteTrackEnabled.load(std::memory_order_relaxed)) {
+      return;
+   }
+
+   // Unprotect runs of protected pages
+   for (auto page = firstPage; page <= lastPage; ++page) {
+      if (mWriteTrackState[page].load(std::memory_order_relaxed) != WriteTrackState::Protected) {
+         if (runLength) {
+            setTrackedPageProtection(runStart, runLength, platform::ProtectFlags::ReadWrite);
+            runLength = 0;
+         }
+
+         continue;
+      }
+
+      mWriteTrackState[page].store(WriteTrackState::Dirty, std::memory_order_relaxed);
+
+      if (!runLength) {
+         runStart = page;
+      }
+
+      ++runLength;
+   }
+
+   if (runLength) {
+      setTrackedPageProtection(runStart, runLength, platform::ProtectFlags::ReadWrite);
+   }
+
+   markPagesWritten(firstPage, lastPage);
+}
+
+
+/**
+ * Finish a host write started with beginHostWrite.
+ *
+ * The pages are marked as written again, as the memory may have been read
+ * while the write was still in progress.
+ */
+void
+MemoryMap::endHostWrite(PhysicalAddress physicalAddress,
+                        uint32_t size)
+{
+   if (!mWriteTrackSupported || size == 0) {
+      return;
+   }
+
+   auto firstPage = physicalAddress.getAddress() >> WriteTrackPageShift;
+   auto lastPage = static_cast<uint32_t>(
+      (static_cast<uint64_t>(physicalAddress.getAddress()) + size - 1) >> WriteTrackPageShift);
+   std::lock_guard<std::mutex> lock { mWriteTrackMutex };
+
+   auto itr = std::find(mHostWrites.begin(), mHostWrites.end(),
+                        std::make_pair(firstPage, lastPage));
+   decaf_check(itr != mHostWrites.end());
+   mHostWrites.erase(itr);
+
+   if (mWriteTrackEnabled.load(std::memory_order_relaxed)) {
+      markPagesWritten(firstPage, lastPage);
+   }
+}
+
+
+/**
+ * Handle an access violation caused by a write to a tracked page.
+ *
+ * This runs inside the host exception handler, which may have interrupted a
+ * thread holding mWriteTrackMutex, so it must not take any locks. Faults in
+ * the virtual address space find their physical page through mVirtualPageMap,
+ * faults in the physical view are host code writing through a physical
+ * pointer. Only the faulting page of the faulting view is made writable
+ * again, other views of the page fault on their own next write.
+ *
+ * The page is made writable before it is marked dirty. If a concurrent
+ * trackWrites protects the page again in between then either the retried
+ * write faults again, or the page ends up dirty and read only which at worst
+ * costs one extra fault. A page is never left writable while it is marked
+ * as protected.
+ *
+ * Returns false if the fault was not caused by write tracking.
+ */
+bool
+MemoryMap::handleWriteFault(uintptr_t hostAddress)
+{
+   if (!mWriteTrackEnabled.load(std::memory_order_acquire)) {
+      return false;
+   }
+
+   auto page = uint32_t { 0 };
+
+   if (hostAddress >= mVirtualBase && hostAddress - mVirtualBase < 0x100000000ull) {
+      auto virtualPage = (hostAddress - mVirtualBase) >> WriteTrackPageShift;
+      auto mappedPage = mVirtualPageMap[virtualPage].load(std::memory_order_acquire);
+
+      if (!mappedPage) {
+         return false;
+      }
+
+      page = mappedPage - 1;
+   } else if (hostAddress >= mPhysicalBase && hostAddress - mPhysicalBase < 0x100000000ull) {
+      page = static_cast<uint32_t>((hostAddress - mPhysicalBase) >> WriteTrackPageShift);
+   } else {
+      return false;
+   }
+
+   auto state = mWriteTrackState[page].load(std::memory_order_acquire);
+
+   if (state == WriteTrackState::Untracked) {
+      return false;
+   }
+
+   platform::protectMemory(hostAddress & ~static_cast<uintptr_t>(WriteTrackPageSize - 1),
+                           WriteTrackPageSize,
+                           platform::ProtectFlags::ReadWrite);
+
+   auto expected = WriteTrackState::Protected;
+   mWriteTrackState[page].compare_exchange_strong(expected, WriteTrackState::Dirty,
+                                                  std::memory_order_acq_rel);
+   mPageWriteGeneration[page].store(++mWriteGeneration, std::memory_order_release);
+   return true;
+}
+
+
+/**
+ * Write protect the tracked pages of a newly created virtual mapping.
+ *
+ * Must be called with mWriteTrackMutex held.
+ */
+void
+MemoryMap::protectTrackedPages(const VirtualMemoryMap &mapping)
+{
+   if (!mWriteTrackEnabled.load(std::memory_order_relaxed) ||
+       mapping.permission != MapPermission::ReadWrite) {
+      return;
+   }
+
+   auto firstPage = mapping.physicalAddress.getAddress() >> WriteTrackPageShift;
+   auto numPages = mapping.size >> WriteTrackPageShift;
+
+   for (auto i = 0u; i < numPages; ++i) {
+      auto page = firstPage + i;
+
+      if (mWriteTrackState[page].load(std::memory_order_relaxed) == WriteTrackState::Protected) {
+         auto address = mVirtualBase + mapping.virtualAddress.getAddress() + (i << WriteTrackPageShift);
+         platform::protectMemory(address, WriteTrackPageSize, platform::ProtectFlags::ReadOnly);
+      }
+   }
+}
+
+
+/**
+ * Add or remove a read write virtual mapping from mVirtualPageMap.
+ *
+ * Must be called with mWriteTrackMutex held, before the view is unmapped
+ * when removing a mapping.
+ */
+void
+MemoryMap::setVirtualPageMap(const VirtualMemoryMap &mapping,
+                             bool mapped)
+{
+   if (!mWriteTrackEnabled.load(std::memory_order_relaxed) ||
+       mapping.permission != MapPermission::ReadWrite) {
+      return;
+   }
+
+   auto firstVirtualPage = mapping.virtualAddress.getAddress() >> WriteTrackPageShift;
+   auto firstPage = mapping.physicalAddress.getAddress() >> WriteTrackPageShift;
+   auto numPages = mapping.size >> WriteTrackPageShift;
+
+   for (auto i = 0u; i < numPages; ++i) {
+      mVirtualPageMap[firstVirtualPage + i].store(mapped ? firstPage + i + 1 : 0,
+                                                  std::memory_order_release);
+   }
+}
+
+
+/**
+ * Change the protection of a range of physical pages on the physical view
+ * and on every read write virtual mapping which covers them.
+ *
+ * Must be called with mWriteTrackMutex held.
+ */
+void
+MemoryMap::setTrackedPageProtection(uint32_t firstPage,
+                                    uint32_t numPages,
+                                    platform::ProtectFlags flags)
+{
+   auto start = static_cast<uint64_t>(firstPage) << WriteTrackPageShift;
+   auto end = start + (static_cast<uint64_t>(numPages) << WriteTrackPageShift);
+
+   platform::protectMemory(static_cast<uintptr_t>(mPhysicalBase + start),
+                           static_cast<size_t>(end - start),
+                           flags);
+
+   for (auto &mapping : mMappedMemory) {
+      if (mapping.permission != MapPermission::ReadWrite) {
+         continue;
+      }
+
+      auto mapStart = static_cast<uint64_t>(mapping.physicalAddress.getAddress());
+      auto mapEnd = mapStart + mapping.size;
+      auto protectStart = std::max(start, mapStart);
+      auto protectEnd = std::min(end, mapEnd);
+
+      if (protectStart >= protectEnd) {
+         continue;
+      }
+
+      auto address = mVirtualBase + mapping.virtualAddress.getAddress() + (protectStart - mapStart);
+      platform::protectMemory(static_cast<uintptr_t>(address),
+                              static_cast<size_t>(protectEnd - protectStart),
+                              flags);
+   }
+}
+
+
+/**
+ * Allocate the write tracking tables on first use, so they take no memory
+ * when nothing tracks writes.
+ *
+ * Must be called with mWriteTrackMutex held.
+ */
+void
+MemoryMap::enableWriteTracking()
+{
+   if (mWriteTrackEnabled.load(std::memory_order_relaxed)) {
+      return;
+   }
+
+   mWriteTrackState = std::make_unique<std::atomic<WriteTrackState>[]>(NumWriteTrackPages);
+   mPageWriteGeneration = std::make_unique<std::atomic<uint64_t>[]>(NumWriteTrackPages);
+   mVirtualPageMap = std::make_unique<std::atomic<uint32_t>[]>(NumWriteTrackPages);
+
+   for (auto i = 0u; i < NumWriteTrackPages; ++i) {
+      mWriteTrackState[i].store(WriteTrackState::Untracked, std::memory_order_relaxed);
+      mPageWriteGeneration[i].store(0, std::memory_order_relaxed);
+      mVirtualPageMap[i].store(0, std::memory_order_relaxed);
+   }
+
+   mWriteTrackEnabled.store(true, std::memory_order_release);
+
+   for (auto &mapping : mMappedMemory) {
+      setVirtualPageMap(mapping, true);
+   }
+}
+
+
+/**
+ * Check if a page is part of a host write which is in progress.
+ *
+ * Must be called with mWriteTrackMutex held.
+ */
+bool
+MemoryMap::isHostWritePage(uint32_t page)
+{
+   for (auto &hostWrite : mHostWrites) {
+      if (page >= hostWrite.first && page <= hostWrite.second) {
+         return true;
+      }
+   }
+
+   return false;
+}
+
+
+/**
+ * Give every tracked page in a range a new write generation.
+ */
+void
+MemoryMap::markPagesWritten(uint32_t firstPage,
+                            uint32_t lastPage)
+{
+   auto generation = uint64_t { 0 };
+
+   for (auto page = firstPage; page <= lastPage; ++page) {
+      if (mWriteTrackState[page].load(std::memory_order_acquire) == WriteTrackState::Untracked) {
+         continue;
+      }
+
+      if (!generation) {
+         generation = ++mWriteGeneration;
+      }
+
+      mPageWriteGeneration[page].store(generation, std::memory_order_release);
+   }
+}
+
+
 uintptr_t
 MemoryMap::reserveBaseAddress()
 {
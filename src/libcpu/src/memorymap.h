@@ -3,8 +3,12 @@
 #include "mmu.h"
 #include "pointer.h"
 
+#include <atomic>
 #include <common/platform_memory.h>
 #include <cstdint>
+#include <memory>
+#include <mutex>
+#include <utility>
 #include <vector>
 
 namespace cpu
@@ -29,6 +33,18 @@ class MemoryMap
       MapPermission permission;
    };
 
+   enum class WriteTrackState : uint8_t
+   {
+      //! Writes to this page are not tracked.
+      Untracked,
+
+      //! Page is write protected, the next write will fault.
+      Protected,
+
+      //! Page has been written since it was last protected.
+      Dirty,
+   };
+
 public:
    MemoryMap() = default;
    ~MemoryMap();
@@ -79,9 +95,45 @@ public:
    VirtualMemoryType
    queryVirtualAddress(VirtualAddress virtualAddress);
 
+   bool
+   trackWrites(PhysicalAddress physicalAddress,
+               uint32_t size);
+
+   uint64_t
+   getWriteGeneration() const
+   {
+      return mWriteGeneration.load(std::memory_order_acquire);
+   }
+
+   bool
+   hasWriteSince(PhysicalAddress physicalAddress,
+                 uint32_t size,
+                 uint64_t generation);
+
+   void
+   beginHostWrite(PhysicalAddress physicalAddress,
+                  uint32_t size);
+
+   void
+   endHostWrite(PhysicalAddress physicalAddress,
+                uint32_t size);
+
+   bool
+   handleWriteFault(uintptr_t hostAddress);
+
 private:
    uintptr_t reserveBaseAddress();
 
+   void
+   enableWriteTracking();
+
+   bool
+   isHostWritePage(uint32_t page);
+
+   void
+   markPagesWritten(uint32_t firstPage,
+                    uint32_t lastPage);
+
    bool
    isVirtualAddressFree(VirtualAddress start,
                         uint32_t size);
@@ -92,6 +144,18 @@ private:
    bool
    releaseReservation(VirtualReservation reservation);
 
+   void
+   protectTrackedPages(const VirtualMemoryMap &mapping);
+
+   void
+   setVirtualPageMap(const VirtualMemoryMap &mapping,
+                     bool mapped);
+
+   void
+   setTrackedPageProtection(uint32_t firstPage,
+                            uint32_t numPages,
+                            platform::ProtectFlags flags);
+
    void *getPhysicalPointer(PhysicalAddress physicalAddress);
    void *getVirtualPointer(VirtualAddress virtualAddress);
 
@@ -109,6 +173,27 @@ private:
    uintptr_t mPhysicalBase = 0;
    std::vector<VirtualMemoryMap> mMappedMemory;
    std::vector<VirtualReservation> mReservedMemory;
+
+   //! Serialises changes to mMappedMemory and the write tracking state, it is
+   //! never taken by the write fault handler.
+   std::mutex mWriteTrackMutex;
+   bool mWriteTrackSupported = false;
+
+   //! Set once the write tracking tables below have been allocated, which is
+   //! only done by the first call to trackWrites.
+   std::atomic<bool> mWriteTrackEnabled { false };
+
+   std::atomic<uint64_t> mWriteGeneration { 0 };
+   std::unique_ptr<std::atomic<WriteTrackState>[]> mWriteTrackState;
+   std::unique_ptr<std::atomic<uint64_t>[]> mPageWriteGeneration;
+
+   //! Physical page number + 1 of every read write virtual page, or 0 when
+   //! the virtual page is not mapped read write.
+   std::unique_ptr<std::atomic<uint32_t>[]> mVirtualPageMap;
+
+   //! First and last page of every host write in progress, these pages are
+   //! left writable by trackWrites until the write ends.
+   std::vector<std::pair<uint32_t, uint32_t>> mHostWrites;
 };
 
 } // namespace cpu
@@ -75,6 +75,14 @@ namespace sound
 //! Dump all sounds to file
 extern bool dump_sounds;
 
+//! Check the AX voice decode and mix against the scalar reference, and log
+//! how many voices per millisecond each manages
+extern bool verify_mix;
+
+//! Number of host threads which render AX voices alongside the AX thread
+//! (0 = render every voice on the AX thread)
+extern unsigned int mix_threads;
+
 } // namespace sound
 
 namespace system
@@ -116,6 +124,26 @@ extern std::string resources_path;
 //! Time scale factor for emulated clock
 extern double time_scale;
 
+//! Number of host threads which service IOS file system requests, requests
+//! on different open files may run concurrently (1 = one request at a time)
+extern unsigned int io_threads;
+
+//! Size in KiB of the buffer each open file reads ahead into once the title
+//! reads it sequentially through FSA (0 = no readahead)
+extern unsigned int fs_readahead_kb;
+
+//! Number of host threads which inflate compressed sections while the loader
+//! reads the rest of an RPL (0 = inflate on the loader thread)
+extern unsigned int loader_threads;
+
+//! Directory to cache inflated RPL sections in, so the same libraries are
+//! not inflated again on every boot (empty = no cache)
+extern std::string loader_cache_path;
+
+//! Size in MiB the loader section cache is kept under by removing its oldest
+//! files (0 = no limit)
+extern unsigned int loader_cache_max_mb;
+
 //! List of system modules to load LLE instead of HLE.
 extern std::vector<std::string> lle_modules;
 
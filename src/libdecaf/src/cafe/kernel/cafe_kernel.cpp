@@ -286,6 +286,10 @@ join()
    }
 
    cpu::join();
+
+   // No core is executing anymore, so the title's decoded and compiled code
+   // can be freed
+   cpu::clearInstructionCache();
 }
 
 void
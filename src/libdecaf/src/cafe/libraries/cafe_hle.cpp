@@ -70,6 +70,7 @@
 #include "decaf_config.h"
 
 #include <array>
+#include <map>
 #include <regex>
 
 namespace cafe::hle
@@ -78,6 +79,9 @@ namespace cafe::hle
 static std::array<Library *, static_cast<size_t>(LibraryId::Max)>
 sLibraries;
 
+static std::map<std::string, Library *, std::less<>>
+sLibrariesByName;
+
 static void
 applyTraceFilters();
 
@@ -85,6 +89,7 @@ static void
 registerLibrary(Library *library)
 {
    sLibraries[static_cast<size_t>(library->id())] = library;
+   sLibrariesByName[library->name()] = library;
    library->generate();
 }
 
@@ -92,6 +97,7 @@ void
 initialiseLibraries()
 {
    sLibraries.fill(nullptr);
+   sLibrariesByName.clear();
    registerLibrary(new avm::Library { });
    registerLibrary(new camera::Library { });
    registerLibrary(new coreinit::Library { });
@@ -159,6 +165,15 @@ initialiseLibraries()
    registerLibrary(new vpad::Library { });
    registerLibrary(new zlib125::Library { });
    applyTraceFilters();
+   Library::registerDirectKernelCalls();
+   cpu::setKernelCallTraceEnabled(decaf::config::log::kernel_trace);
+}
+
+void
+setKernelTraceEnabled(bool enabled)
+{
+   decaf::config::log::kernel_trace = enabled;
+   cpu::setKernelCallTraceEnabled(enabled);
 }
 
 Library *
@@ -170,13 +185,12 @@ getLibrary(LibraryId id)
 Library *
 getLibrary(std::string_view name)
 {
-   for (auto library : sLibraries) {
-      if (library && library->name() == name) {
-         return library;
-      }
+   auto itr = sLibrariesByName.find(name);
+   if (itr == sLibrariesByName.end()) {
+      return nullptr;
    }
 
-   return nullptr;
+   return itr->second;
 }
 
 void
@@ -16,6 +16,9 @@ getLibrary(LibraryId id);
 Library *
 getLibrary(std::string_view name);
 
+void
+setKernelTraceEnabled(bool enabled);
+
 void
 relocateLibrary(std::string_view name,
                 virt_addr textBaseAddress,
@@ -112,6 +112,23 @@ Library::registerKernelCalls()
    }
 }
 
+void
+Library::registerDirectKernelCalls()
+{
+   // Called once the trace filters have been applied, functions with tracing
+   // filtered out use their plain thunk in the trace table too.
+   for (auto funcSymbol : sKernelCalls) {
+      auto entry = cpu::KernelCallEntry { funcSymbol->thunk, funcSymbol };
+      auto traceEntry = entry;
+
+      if (funcSymbol->traceEnabled) {
+         traceEntry.func = funcSymbol->traceThunk;
+      }
+
+      cpu::registerKernelCall(funcSymbol->syscallID, entry, traceEntry);
+   }
+}
+
 void
 Library::relocate(virt_addr textBaseAddress,
                   virt_addr dataBaseAddress)
@@ -123,6 +123,9 @@ public:
    handleKernelCall(cpu::Core *state,
                     uint32_t id);
 
+   static void
+   registerDirectKernelCalls();
+
 public:
    Library(LibraryId id, std::string name) :
       mID(id), mName(std::move(name))
@@ -198,19 +201,18 @@ public:
    void
    addUnimplementedFunctionExport(UnimplementedLibraryFunction *unimpl)
    {
-      mUnimplementedFunctionExports.push_back(unimpl);
+      mUnimplementedFunctionExports.emplace(unimpl->name, unimpl);
    }
 
    UnimplementedLibraryFunction *
    findUnimplementedFunctionExport(std::string_view name)
    {
-      for (auto unimpl : mUnimplementedFunctionExports) {
-         if (unimpl->name == name) {
-            return unimpl;
-         }
+      auto itr = mUnimplementedFunctionExports.find(name);
+      if (itr == mUnimplementedFunctionExports.end()) {
+         return nullptr;
       }
 
-      return nullptr;
+      return itr->second;
    }
 
    const auto &
@@ -334,7 +336,7 @@ private:
    std::map<std::string, std::unique_ptr<LibrarySymbol>, std::less<>> mSymbolMap;
    std::vector<LibraryTypeInfo> mTypeInfo;
    std::vector<uint8_t> mGeneratedRpl;
-   std::vector<UnimplementedLibraryFunction *> mUnimplementedFunctionExports;
+   std::map<std::string, UnimplementedLibraryFunction *, std::less<>> mUnimplementedFunctionExports;
 };
 
 virt_addr
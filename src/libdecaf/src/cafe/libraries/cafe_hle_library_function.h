@@ -32,6 +32,12 @@ struct LibraryFunction : public LibrarySymbol
 
    virtual void call(cpu::Core *state) = 0;
 
+   //! Host function a kc of this function is dispatched to directly.
+   cpu::KernelCallFunction thunk = nullptr;
+
+   //! Host function which trace logs the call before making it.
+   cpu::KernelCallFunction traceThunk = nullptr;
+
    //! ID number of syscall.
    uint32_t syscallID;
 
@@ -45,25 +51,68 @@ struct LibraryFunction : public LibrarySymbol
 namespace internal
 {
 
+/**
+ * Thunk for a kc which is dispatched directly to a library function.
+ *
+ * Allocates the callee backchain and lr space on the guest stack around the
+ * call, as the kernel call handler does for the calls it dispatches.
+ */
+template<typename Type, bool Trace>
+inline void
+kernelCallThunk(cpu::Core *core,
+                void *userData)
+{
+   auto function = static_cast<Type *>(userData);
+   auto backchainSp = core->gpr[1];
+   core->gpr[1] -= 2 * 4;
+   *virt_cast<uint32_t *>(virt_addr { core->gpr[1] }) = backchainSp;
+
+   if constexpr (Trace) {
+      function->trace(core);
+   }
+
+   function->invokeHost(core);
+
+   // Grab the most recent core state as it may have changed.
+   core = cpu::this_core::state();
+   core->gpr[1] += 2 * 4;
+}
+
 /**
  * Handles call to both global functions and member functions.
  */
 template<typename FunctionType>
 struct LibraryFunctionCall : LibraryFunction
 {
+   LibraryFunctionCall()
+   {
+      thunk = &kernelCallThunk<LibraryFunctionCall, false>;
+      traceThunk = &kernelCallThunk<LibraryFunctionCall, true>;
+   }
+
    virtual ~LibraryFunctionCall()
    {
    }
 
    FunctionType func;
 
+   void trace(cpu::Core *state)
+   {
+      invoke_trace(state, func, name.c_str());
+   }
+
+   void invokeHost(cpu::Core *state)
+   {
+      invoke(state, func);
+   }
+
    virtual void call(cpu::Core *state) override
    {
       if (decaf::config::log::kernel_trace && traceEnabled) {
-         invoke_trace(state, func, name.c_str());
+         trace(state);
       }
 
-      invoke(state, func);
+      invokeHost(state);
    }
 };
 
@@ -73,6 +122,12 @@ struct LibraryFunctionCall : LibraryFunction
 template<typename ObjectType, typename... ArgTypes>
 struct LibraryConstructorFunction : LibraryFunction
 {
+   LibraryConstructorFunction()
+   {
+      thunk = &kernelCallThunk<LibraryConstructorFunction, false>;
+      traceThunk = &kernelCallThunk<LibraryConstructorFunction, true>;
+   }
+
    virtual ~LibraryConstructorFunction()
    {
    }
@@ -82,13 +137,23 @@ struct LibraryConstructorFunction : LibraryFunction
       ::new(static_cast<void *>(obj.getRawPointer())) ObjectType(args...);
    }
 
+   void trace(cpu::Core *state)
+   {
+      invoke_trace(state, &LibraryConstructorFunction::wrapper, name.c_str());
+   }
+
+   void invokeHost(cpu::Core *state)
+   {
+      invoke(state, &LibraryConstructorFunction::wrapper);
+   }
+
    virtual void call(cpu::Core *state) override
    {
       if (decaf::config::log::kernel_trace && traceEnabled) {
-         invoke_trace(state, &LibraryConstructorFunction::wrapper, name.c_str());
+         trace(state);
       }
 
-      invoke(state, &LibraryConstructorFunction::wrapper);
+      invokeHost(state);
    }
 };
 
@@ -98,6 +163,12 @@ struct LibraryConstructorFunction : LibraryFunction
 template<typename ObjectType>
 struct LibraryDestructorFunction : LibraryFunction
 {
+   LibraryDestructorFunction()
+   {
+      thunk = &kernelCallThunk<LibraryDestructorFunction, false>;
+      traceThunk = &kernelCallThunk<LibraryDestructorFunction, true>;
+   }
+
    virtual ~LibraryDestructorFunction()
    {
    }
@@ -107,13 +178,23 @@ struct LibraryDestructorFunction : LibraryFunction
       (obj.getRawPointer())->~ObjectType();
    }
 
+   void trace(cpu::Core *state)
+   {
+      invoke_trace(state, &LibraryDestructorFunction::wrapper, name.c_str());
+   }
+
+   void invokeHost(cpu::Core *state)
+   {
+      invoke(state, &LibraryDestructorFunction::wrapper);
+   }
+
    virtual void call(cpu::Core *state) override
    {
       if (decaf::config::log::kernel_trace && traceEnabled) {
-         invoke_trace(state, &LibraryDestructorFunction::wrapper, name.c_str());
+         trace(state);
       }
 
-      invoke(state, &LibraryDestructorFunction::wrapper);
+      invokeHost(state);
    }
 };
 
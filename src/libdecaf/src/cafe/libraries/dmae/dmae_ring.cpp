@@ -64,17 +64,13 @@ DMAECopyMem(virt_ptr<void> dst,
                   src.get(),
                   numWords * 4);
    } else if (endian == DMAEEndianSwapMode::Swap8In16) {
-      auto dstWords = reinterpret_cast<uint16_t *>(dst.get());
-      auto srcWords = reinterpret_cast<uint16_t *>(src.get());
-      for (auto i = 0u; i < numWords * 2; ++i) {
-         *dstWords++ = byte_swap(*srcWords++);
-      }
+      byte_swap_to(reinterpret_cast<uint16_t *>(dst.get()),
+                   reinterpret_cast<uint16_t *>(src.get()),
+                   numWords * 2);
    } else if (endian == DMAEEndianSwapMode::Swap8In32) {
-      auto dstDwords = reinterpret_cast<uint32_t *>(dst.get());
-      auto srcDwords = reinterpret_cast<uint32_t *>(src.get());
-      for (auto i = 0u; i < numWords; ++i) {
-         *dstDwords++ = byte_swap(*srcDwords++);
-      }
+      byte_swap_to(reinterpret_cast<uint32_t *>(dst.get()),
+                   reinterpret_cast<uint32_t *>(src.get()),
+                   numWords);
    }
 
    auto timestamp = coreinit::OSGetTime();
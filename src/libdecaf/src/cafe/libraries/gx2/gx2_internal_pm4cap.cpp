@@ -266,10 +266,7 @@ private:
    {
       std::vector<uint32_t> swapped;
       swapped.resize(numWords);
-
-      for (auto i = 0u; i < swapped.size(); ++i) {
-         swapped[i] = words[i];
-      }
+      byte_swap_to(swapped.data(), words.getRawPointer(), numWords);
 
       auto buffer = swapped.data();
       auto bufferSize = swapped.size();
@@ -2,11 +2,16 @@
 #include "sndcore2_config.h"
 #include "sndcore2_constants.h"
 #include "sndcore2_device.h"
+#include "sndcore2_mix.h"
 #include "sndcore2_voice.h"
+#include "decaf_config.h"
 #include "decaf_sound.h"
 
 #include <array>
+#include <chrono>
 #include <common/fixed.h>
+#include <common/log.h>
+#include <cstring>
 #include <libcpu/mmu.h>
 
 namespace cafe::sndcore2
@@ -15,6 +20,21 @@ namespace cafe::sndcore2
 constexpr auto NumOutputSamples = 48000 * 3 / 1000;
 constexpr auto DefaultVolume = ufixed_1_15_t::from_data(0x8000);
 
+/**
+ * Time spent in the block and reference paths, only collected when
+ * sound.verify_mix is enabled.
+ */
+struct MixStats
+{
+   uint64_t numFrames = 0;
+   uint64_t numVoices = 0;
+   std::chrono::steady_clock::duration time { 0 };
+   std::chrono::steady_clock::duration referenceTime { 0 };
+};
+
+static MixStats
+sMixStats;
+
 struct AuxData
 {
    AXAuxCallback callback;
@@ -75,246 +95,43 @@ getDevice(AXDeviceType type,
    }
 }
 
-template<typename Type>
-static Type *
-getMemPageAddress(uint32_t memPageNumber)
-{
-   // We have to do this this way due to the way that mem::translate handles
-   //  nullptr's.  In the case of AX here, our memPageNumber can be 0, causing
-   //  mem::translate to return 0, which is not what we want.
-   return reinterpret_cast<Type *>(cpu::getBaseVirtualAddress() + (static_cast<uint64_t>(memPageNumber) << 29));
-}
-
-struct AudioDecoder
-{
-   // Basic information
-   internal::AXCafeVoiceData offsets;
-   AXVoiceType type;
-   uint32_t loopCount;
-   AXVoiceAdpcm adpcm;
-   AXVoiceAdpcmLoopData adpcmLoop;
-   bool isEof;
-
-   void fromVoice(virt_ptr<AXVoiceExtras> extras)
-   {
-      offsets = extras->data;
-      type = extras->type;
-      loopCount = extras->loopCount;
-      adpcm = extras->adpcm;
-      adpcmLoop = extras->adpcmLoop;
-
-      isEof = false;
-   }
-
-   void toVoice(virt_ptr<AXVoiceExtras> extras)
-   {
-      extras->data = offsets;
-      extras->loopCount = loopCount;
-      extras->adpcm = adpcm;
-   }
-
-   AudioDecoder& advance()
-   {
-      // Update prev sample
-      auto sample = read();
-      adpcm.prevSample[1] = adpcm.prevSample[0];
-      adpcm.prevSample[0] = sample.data();
-
-      if (offsets.currentOffsetAbs == offsets.endOffsetAbs) {
-         // According to Dolphin, the loop back happens regardless
-         //  of whether the voice is in looping mode
-         offsets.currentOffsetAbs = offsets.loopOffsetAbs;
-
-         if (offsets.loopFlag) {
-            adpcm.predScale = adpcmLoop.predScale;
-
-            if (type != AXVoiceType::Streaming) {
-               adpcm.prevSample[0] = adpcmLoop.prevSample[0];
-               adpcm.prevSample[1] = adpcmLoop.prevSample[1];
-            }
-         } else {
-            decaf_check(!isEof);
-            isEof = true;
-         }
-
-         loopCount++;
-      } else {
-         offsets.currentOffsetAbs += 1;
-
-         if (offsets.format == AXVoiceFormat::ADPCM) {
-            // Read next header if were there
-            if ((offsets.currentOffsetAbs & 0xf) < virt_addr { 2 }) {
-               decaf_check((offsets.currentOffsetAbs & 0xf) == virt_addr { 0 });
-
-               auto data = getMemPageAddress<uint8_t>(offsets.memPageNumber);
-
-               adpcm.predScale = data[offsets.currentOffsetAbs / 2];
-               offsets.currentOffsetAbs += 2;
-            }
-         }
-      }
-
-      return *this;
-   }
-
-   bool eof()
-   {
-      return isEof;
-   }
-
-   Pcm16Sample read()
-   {
-      decaf_check(!isEof);
-      auto sampleIndex = static_cast<uint32_t>(offsets.currentOffsetAbs);
-
-      if (offsets.format == AXVoiceFormat::ADPCM) {
-         decaf_check((sampleIndex & 0xf) >= 2);
-
-         auto data = getMemPageAddress<uint8_t>(offsets.memPageNumber);
-
-         auto scale = 1 << (adpcm.predScale.value() & 0xF);
-         auto coeffIndex = (adpcm.predScale.value() >> 4) & 7;
-         auto coeff1 = adpcm.coefficients[coeffIndex * 2 + 0].value();
-         auto coeff2 = adpcm.coefficients[coeffIndex * 2 + 1].value();
-         auto yn1 = adpcm.prevSample[0].value();
-         auto yn2 = adpcm.prevSample[1].value();
-
-         // Extract the 4-bit signed sample from the appropriate byte
-         int sampleData = data[sampleIndex / 2];
-
-         if (sampleIndex % 2 == 0) {
-            sampleData &= 0xF;
-         } else {
-            sampleData >>= 4;
-         }
-
-         if (sampleData >= 8) {
-            sampleData -= 16;
-         }
-
-         // Calculate sample
-         auto adpcmSample = (scale * sampleData) + ((0x400 + (coeff1 * yn1) + (coeff2 * yn2)) >> 11);
-
-         // Clamp the output
-         auto clampedSample = std::min(std::max(adpcmSample, -32767), 32767);
-
-         // Write to the output
-         return Pcm16Sample::from_data(clampedSample);
-      } else if (offsets.format == AXVoiceFormat::LPCM16) {
-         auto data = getMemPageAddress<be2_val<int16_t>>(offsets.memPageNumber);
-         return Pcm16Sample::from_data(data[sampleIndex]);
-      } else if (offsets.format == AXVoiceFormat::LPCM8) {
-         auto data = getMemPageAddress<uint8_t>(offsets.memPageNumber);
-         return Pcm16Sample::from_data(data[sampleIndex] << 8);
-      } else {
-         decaf_abort("Unexpected AXVoice data format");
-      }
-   }
-};
-
-void
-sampleVoice(virt_ptr<AXVoice> voice,
-            Pcm16Sample *samples,
-            int numSamples)
+/**
+ * Run sampleVoiceReference then rewind the voice and run sampleVoice, and
+ * check they both leave the voice in the same state.
+ */
+static void
+sampleVoiceVerified(virt_ptr<AXVoice> voice,
+                    Pcm16Sample *samples,
+                    int numSamples)
 {
-   static const auto FpOne = ufixed1616_t(1);
-   static const auto FpZero = ufixed1616_t(0);
-
-   memset(samples, 0, numSamples * sizeof(Pcm16Sample));
-
    auto extras = getVoiceExtras(voice->index);
-   auto offsetFrac = ufixed1616_t(extras->src.currentOffsetFrac.value());
-
-   AudioDecoder decoder;
-   decoder.fromVoice(extras);
-
-   for (auto i = 0; i < numSamples; ++i) {
-      // Read in the current sample
-      Pcm16Sample sample;
-      if (offsetFrac == FpZero) {
-         sample = decoder.read();
-      } else {
-         AudioDecoder nextDecoder(decoder);
-         nextDecoder.advance();
-         if (!nextDecoder.eof()) {
-            sample = nextDecoder.read();
-         } else {
-            sample = 0;
-         }
-      }
+   AXVoiceExtras initialExtras = *extras;
 
-      if (offsetFrac == FpZero) {
-         samples[i] = sample;
-      } else {
-         auto thisSampleMul = FpOne - offsetFrac;
-         auto lastSampleMul = offsetFrac;
-         auto lastSample = Pcm16Sample::from_data(extras->src.lastSample[0]);
-         samples[i] = sample * thisSampleMul + lastSample * lastSampleMul;
-      }
+   auto referenceStart = std::chrono::steady_clock::now();
+   auto referenceEof = sampleVoiceReference(extras, samples, numSamples);
+   auto referenceEnd = std::chrono::steady_clock::now();
 
-      offsetFrac += extras->src.ratio.value();
+   AXVoiceExtras referenceExtras = *extras;
+   *extras = initialExtras;
 
-      while (offsetFrac >= FpOne) {
-         // Advance the voice by one sample
-         offsetFrac -= FpOne;
-         decoder.advance();
+   auto start = std::chrono::steady_clock::now();
+   auto eof = sampleVoice(extras, samples, numSamples);
+   auto end = std::chrono::steady_clock::now();
 
-         // Update all the last sample listings.  Most of these are used
-         //  for FFT resampling (which we don't currently handle).
-         extras->src.lastSample[3] = extras->src.lastSample[2];
-         extras->src.lastSample[2] = extras->src.lastSample[1];
-         extras->src.lastSample[1] = extras->src.lastSample[0];
-         extras->src.lastSample[0] = sample.data();
-
-         // If we reached the end of the voice data, we should just leave
-         if (decoder.eof()) {
-            break;
-         }
-
-         // If we read through multiple samples due to a high SRC ratio,
-         //  then we need to actually read the upcoming sample in expectation
-         //  of the fact that its about to be stored in lastSample.
-         if (offsetFrac >= FpOne) {
-            sample = decoder.read();
-         }
-      }
-
-      if (decoder.eof()) {
-         break;
-      }
-   }
-
-   if (decoder.eof()) {
+   if (eof) {
       voice->state = AXVoiceState::Stopped;
    }
 
-   decoder.toVoice(extras);
+   sMixStats.numVoices++;
+   sMixStats.referenceTime += referenceEnd - referenceStart;
+   sMixStats.time += end - start;
 
-   extras->src.currentOffsetFrac = ufixed016_t { offsetFrac };
-}
-
-void
-decodeVoiceSamples(int numSamples)
-{
-   const auto voices = getAcquiredVoices();
-
-   for (auto voice : voices) {
-      auto extras = getVoiceExtras(voice->index);
-
-      if (voice->state == AXVoiceState::Stopped) {
-         extras->numSamples = 0;
-         continue;
-      }
-
-      extras->numSamples = numSamples;
-      sampleVoice(voice, extras->samples, numSamples);
+   if (eof != referenceEof ||
+       std::memcmp(&referenceExtras, extras.get(), sizeof(AXVoiceExtras)) != 0) {
+      gLog->error("AX voice {} decode does not match the reference, format {}, ratio 0x{:08X}",
+                  voice->index, static_cast<int>(initialExtras.data.format.value()),
+                  initialExtras.src.ratio.value().data());
    }
-
-   // TODO: Apply Volume Evelope (ADSR)
-
-   // TODO: Apply Biquad Filter
-
-   // TODO: Apply Low Pass Filter
 }
 
 static Pcm16Sample gTvSamples[AXNumTvDevices][AXNumTvChannels][NumOutputSamples];
@@ -392,33 +209,6 @@ invokeFinalMixCallback(DeviceTypeData &device,
    }
 }
 
-AXVoiceExtras::MixVolume &
-getVoiceMixVolume(virt_ptr<AXVoiceExtras> extras,
-                  AXDeviceType type,
-                  uint32_t device,
-                  uint32_t channel,
-                  uint32_t bus)
-{
-   if (type == AXDeviceType::TV) {
-      decaf_check(device < AXNumTvDevices);
-      decaf_check(channel < AXNumTvChannels);
-      decaf_check(bus < AXNumTvBus);
-      return extras->tvVolume[device][channel][bus];
-   } else if (type == AXDeviceType::DRC) {
-      decaf_check(device < AXNumDrcDevices);
-      decaf_check(channel < AXNumDrcChannels);
-      decaf_check(bus < AXNumDrcBus);
-      return extras->drcVolume[device][channel][bus];
-   } else if (type == AXDeviceType::RMT) {
-      decaf_check(device < AXNumRmtDevices);
-      decaf_check(channel < AXNumRmtChannels);
-      decaf_check(bus < AXNumRmtBus);
-      return extras->rmtVolume[device][channel][bus];
-   } else {
-      decaf_abort("Unexpected device type");
-   }
-}
-
 static virt_ptr<DeviceTypeData>
 getDeviceGroup(AXDeviceType type)
 {
@@ -434,37 +224,111 @@ getDeviceGroup(AXDeviceType type)
    }
 }
 
-static uint32_t
-getDeviceNumDevices(AXDeviceType type)
+/**
+ * Decode and mix a single voice.
+ */
+static void
+renderVoice(virt_ptr<AXVoice> voice,
+            uint32_t numSamples,
+            MixSums &sums)
 {
-   decaf_check(type < AXDeviceType::Max);
-   static const uint32_t devices[] = { AXNumTvDevices, AXNumDrcDevices, AXNumRmtDevices };
-   return devices[type];
-}
+   auto extras = getVoiceExtras(voice->index);
 
-static uint32_t
-getDeviceNumBuses(AXDeviceType type)
-{
-   decaf_check(type < AXDeviceType::Max);
-   static const uint32_t busses[] = { AXNumTvBus, AXNumDrcBus, AXNumRmtBus };
-   return busses[type];
+   if (voice->state == AXVoiceState::Stopped) {
+      extras->numSamples = 0;
+      return;
+   }
+
+   extras->numSamples = numSamples;
+
+   if (sampleVoice(extras, extras->samples, numSamples)) {
+      voice->state = AXVoiceState::Stopped;
+   }
+
+   // TODO: Apply Volume Evelope (ADSR)
+
+   // TODO: Apply Biquad Filter
+
+   // TODO: Apply Low Pass Filter
+
+   mixVoice(extras, numSamples, sums);
 }
 
-static uint32_t
-getDeviceNumChannels(AXDeviceType type)
+static VoiceRenderPool
+sVoiceRenderPool;
+
+//! Reference bus samples of each device type, only used by sound.verify_mix.
+static BusSamples
+sReferenceSamples[AXDeviceType::Max];
+
+/**
+ * Decode every voice and mix them into sums.
+ *
+ * When sound.verify_mix is enabled this runs on the AX thread only, checking
+ * sampleVoice as it goes and filling sReferenceSamples from
+ * mixVoiceReference before the voice volumes are advanced.
+ */
+static void
+renderVoices(uint32_t numSamples,
+             MixSums &sums)
 {
-   decaf_check(type < AXDeviceType::Max);
-   static const uint32_t channels[] = { AXNumTvChannels, AXNumDrcChannels, AXNumRmtChannels };
-   return channels[type];
+   const auto voices = getAcquiredVoices();
+
+   if (!decaf::config::sound::verify_mix) {
+      sVoiceRenderPool.render(voices.size(), decaf::config::sound::mix_threads, sums,
+         [&](size_t index, MixSums &voiceSums) {
+            renderVoice(voices[index], numSamples, voiceSums);
+         });
+      return;
+   }
+
+   for (auto voice : voices) {
+      auto extras = getVoiceExtras(voice->index);
+
+      if (voice->state == AXVoiceState::Stopped) {
+         extras->numSamples = 0;
+         continue;
+      }
+
+      extras->numSamples = numSamples;
+      sampleVoiceVerified(voice, extras->samples, numSamples);
+   }
+
+   auto referenceStart = std::chrono::steady_clock::now();
+
+   for (auto type : { AXDeviceType::TV, AXDeviceType::DRC, AXDeviceType::RMT }) {
+      memset(sReferenceSamples[type], 0, sizeof(BusSamples));
+
+      for (auto voice : voices) {
+         auto extras = getVoiceExtras(voice->index);
+
+         if (extras->numSamples) {
+            mixVoiceReference(extras, type, numSamples, sReferenceSamples[type]);
+         }
+      }
+   }
+
+   auto referenceEnd = std::chrono::steady_clock::now();
+   std::memset(sums, 0, sizeof(MixSums));
+
+   for (auto voice : voices) {
+      auto extras = getVoiceExtras(voice->index);
+
+      if (extras->numSamples) {
+         mixVoice(extras, numSamples, sums);
+      }
+   }
+
+   auto end = std::chrono::steady_clock::now();
+   sMixStats.referenceTime += referenceEnd - referenceStart;
+   sMixStats.time += end - referenceEnd;
 }
 
 static void
-mixDevice(AXDeviceType type, uint32_t numSamples)
+mixDevice(AXDeviceType type,
+          uint32_t numSamples,
+          const MixSums &sums)
 {
-   static const auto AXMaxDevices = 4;
-   static const auto AXMaxBuses = 4;
-   static const auto AXMaxChannels = 6;
-
    auto devices = getDeviceGroup(type);
    auto numDevices = getDeviceNumDevices(type);
    auto numBus = getDeviceNumBuses(type);
@@ -475,36 +339,24 @@ mixDevice(AXDeviceType type, uint32_t numSamples)
    decaf_check(numChannels <= AXMaxChannels);
    decaf_check(numSamples == 96 || numSamples == 144);
 
-   Pcm16Sample busSamples[AXMaxBuses][AXMaxDevices][AXMaxChannels][NumOutputSamples];
-   const auto voices = getAcquiredVoices();
-
-   memset(busSamples, 0, sizeof(Pcm16Sample) * AXMaxBuses * AXMaxDevices * AXMaxChannels * NumOutputSamples);
+   BusSamples busSamples;
+   auto row = getDeviceMixRowBase(type);
 
-   for (auto voice : voices) {
-      auto extras = getVoiceExtras(voice->index);
-
-      if (!extras->numSamples) {
-         continue;
-      }
-
-      decaf_check(extras->numSamples == numSamples);
+   memset(busSamples, 0, sizeof(BusSamples));
 
+   for (auto bus = 0u; bus < numBus; ++bus) {
       for (auto deviceId = 0u; deviceId < numDevices; ++deviceId) {
-         for (auto bus = 0u; bus < numBus; ++bus) {
-            for (auto channel = 0u; channel < numChannels; ++channel) {
-               auto &volume = getVoiceMixVolume(extras, type, deviceId, channel, bus);
-               auto &out = busSamples[bus][deviceId][channel];
-
-               for (auto i = 0u; i < numSamples; ++i) {
-                  out[i] += extras->samples[i] * volume.volume;
-               }
-
-               volume.volume += volume.delta;
-            }
+         for (auto channel = 0u; channel < numChannels; ++channel, ++row) {
+            storeBusSamples(busSamples[bus][deviceId][channel], sums[row], numSamples);
          }
       }
    }
 
+   if (decaf::config::sound::verify_mix &&
+       std::memcmp(sReferenceSamples[type], busSamples, sizeof(BusSamples)) != 0) {
+      gLog->error("AX device type {} mix does not match the reference", static_cast<int>(type));
+   }
+
    for (auto deviceId = 0u; deviceId < numDevices; ++deviceId) {
       auto &device = devices->devices[deviceId];
 
@@ -598,6 +450,32 @@ mixDevice(AXDeviceType type, uint32_t numSamples)
    }
 }
 
+/**
+ * Report how many voices per millisecond the block and reference paths
+ * manage, roughly every 3 seconds.
+ */
+static void
+logMixStats()
+{
+   using duration_ms = std::chrono::duration<double, std::milli>;
+
+   if (++sMixStats.numFrames < 1000) {
+      return;
+   }
+
+   auto time = duration_ms { sMixStats.time }.count();
+   auto referenceTime = duration_ms { sMixStats.referenceTime }.count();
+
+   if (sMixStats.numVoices && time > 0.0 && referenceTime > 0.0) {
+      gLog->info("AX mix: {:.0f} voices/ms, reference {:.0f} voices/ms, {:.2f}x",
+                 sMixStats.numVoices / time,
+                 sMixStats.numVoices / referenceTime,
+                 referenceTime / time);
+   }
+
+   sMixStats = MixStats { };
+}
+
 void
 mixOutput(int32_t* buffer,
           int numSamples,
@@ -605,13 +483,19 @@ mixOutput(int32_t* buffer,
 {
    static const int NumOutputSamples = 48000 * 3 / 1000;
 
-   // Decode audio samples from the source voices
-   decodeVoiceSamples(numSamples);
+   static MixSums sums;
+
+   // Decode audio samples from the source voices and mix them into the buses
+   renderVoices(numSamples, sums);
 
    // Mix all the devices
-   mixDevice(AXDeviceType::TV, numSamples);
-   mixDevice(AXDeviceType::DRC, numSamples);
-   mixDevice(AXDeviceType::RMT, numSamples);
+   mixDevice(AXDeviceType::TV, numSamples, sums);
+   mixDevice(AXDeviceType::DRC, numSamples, sums);
+   mixDevice(AXDeviceType::RMT, numSamples, sums);
+
+   if (decaf::config::sound::verify_mix) {
+      logMixStats();
+   }
 
    // Send off the TV device 0 data to be played on host
    for (auto i = 0; i < NumOutputSamples; ++i) {
@@ -0,0 +1,741 @@
+#include "sndcore2_mix.h"
+
+#include <algorithm>
+#include <array>
+#include <common/decaf_assert.h>
+#include <common/platform_thread.h>
+#include <cstring>
+#include <fmt/format.h>
+#include <libcpu/mmu.h>
+
+#if defined(__x86_64__) || defined(_M_X64)
+#define AX_MIX_SSE2
+#include <emmintrin.h>
+#endif
+
+namespace cafe::sndcore2::internal
+{
+
+static_assert(sizeof(Pcm16Sample) == sizeof(int16_t));
+
+//! Most source samples sampleVoice will decode for one frame, anything with a
+//! higher SRC ratio falls back to sampleVoiceReference.
+constexpr auto MaxDecodeSamples = 1024;
+
+template<typename Type>
+static Type *
+getMemPageAddress(uint32_t memPageNumber)
+{
+   // We have to do this this way due to the way that mem::translate handles
+   //  nullptr's.  In the case of AX here, our memPageNumber can be 0, causing
+   //  mem::translate to return 0, which is not what we want.
+   return reinterpret_cast<Type *>(cpu::getBaseVirtualAddress() + (static_cast<uint64_t>(memPageNumber) << 29));
+}
+
+struct AudioDecoder
+{
+   // Basic information
+   internal::AXCafeVoiceData offsets;
+   AXVoiceType type;
+   uint32_t loopCount;
+   AXVoiceAdpcm adpcm;
+   AXVoiceAdpcmLoopData adpcmLoop;
+   bool isEof;
+
+   void fromVoice(virt_ptr<AXVoiceExtras> extras)
+   {
+      offsets = extras->data;
+      type = extras->type;
+      loopCount = extras->loopCount;
+      adpcm = extras->adpcm;
+      adpcmLoop = extras->adpcmLoop;
+
+      isEof = false;
+   }
+
+   void toVoice(virt_ptr<AXVoiceExtras> extras)
+   {
+      extras->data = offsets;
+      extras->loopCount = loopCount;
+      extras->adpcm = adpcm;
+   }
+
+   AudioDecoder& advance()
+   {
+      return advanceFrom(read());
+   }
+
+   // Advance past sample, which must be the result of read() at the current
+   // position.
+   AudioDecoder& advanceFrom(Pcm16Sample sample)
+   {
+      // Update prev sample
+      adpcm.prevSample[1] = adpcm.prevSample[0];
+      adpcm.prevSample[0] = sample.data();
+
+      if (offsets.currentOffsetAbs == offsets.endOffsetAbs) {
+         // According to Dolphin, the loop back happens regardless
+         //  of whether the voice is in looping mode
+         offsets.currentOffsetAbs = offsets.loopOffsetAbs;
+
+         if (offsets.loopFlag) {
+            adpcm.predScale = adpcmLoop.predScale;
+
+            if (type != AXVoiceType::Streaming) {
+               adpcm.prevSample[0] = adpcmLoop.prevSample[0];
+               adpcm.prevSample[1] = adpcmLoop.prevSample[1];
+            }
+         } else {
+            decaf_check(!isEof);
+            isEof = true;
+         }
+
+         loopCount++;
+      } else {
+         offsets.currentOffsetAbs += 1;
+
+         if (offsets.format == AXVoiceFormat::ADPCM) {
+            // Read next header if were there
+            if ((offsets.currentOffsetAbs & 0xf) < virt_addr { 2 }) {
+               decaf_check((offsets.currentOffsetAbs & 0xf) == virt_addr { 0 });
+
+               auto data = getMemPageAddress<uint8_t>(offsets.memPageNumber);
+
+               adpcm.predScale = data[offsets.currentOffsetAbs / 2];
+               offsets.currentOffsetAbs += 2;
+            }
+         }
+      }
+
+      return *this;
+   }
+
+   bool eof()
+   {
+      return isEof;
+   }
+
+   Pcm16Sample read()
+   {
+      decaf_check(!isEof);
+      auto sampleIndex = static_cast<uint32_t>(offsets.currentOffsetAbs);
+
+      if (offsets.format == AXVoiceFormat::ADPCM) {
+         decaf_check((sampleIndex & 0xf) >= 2);
+
+         auto data = getMemPageAddress<uint8_t>(offsets.memPageNumber);
+
+         auto scale = 1 << (adpcm.predScale.value() & 0xF);
+         auto coeffIndex = (adpcm.predScale.value() >> 4) & 7;
+         auto coeff1 = adpcm.coefficients[coeffIndex * 2 + 0].value();
+         auto coeff2 = adpcm.coefficients[coeffIndex * 2 + 1].value();
+         auto yn1 = adpcm.prevSample[0].value();
+         auto yn2 = adpcm.prevSample[1].value();
+
+         // Extract the 4-bit signed sample from the appropriate byte
+         int sampleData = data[sampleIndex / 2];
+
+         if (sampleIndex % 2 == 0) {
+            sampleData &= 0xF;
+         } else {
+            sampleData >>= 4;
+         }
+
+         if (sampleData >= 8) {
+            sampleData -= 16;
+         }
+
+         // Calculate sample
+         auto adpcmSample = (scale * sampleData) + ((0x400 + (coeff1 * yn1) + (coeff2 * yn2)) >> 11);
+
+         // Clamp the output
+         auto clampedSample = std::min(std::max(adpcmSample, -32767), 32767);
+
+         // Write to the output
+         return Pcm16Sample::from_data(clampedSample);
+      } else if (offsets.format == AXVoiceFormat::LPCM16) {
+         auto data = getMemPageAddress<be2_val<int16_t>>(offsets.memPageNumber);
+         return Pcm16Sample::from_data(data[sampleIndex]);
+      } else if (offsets.format == AXVoiceFormat::LPCM8) {
+         auto data = getMemPageAddress<uint8_t>(offsets.memPageNumber);
+         return Pcm16Sample::from_data(data[sampleIndex] << 8);
+      } else {
+         decaf_abort("Unexpected AXVoice data format");
+      }
+   }
+};
+
+/**
+ * Decode and resample a voice one output sample at a time.
+ *
+ * This is the original implementation which sampleVoice must match exactly,
+ * it is still used for voices with a very high SRC ratio and to check
+ * sampleVoice when sound.verify_mix is enabled.
+ *
+ * Returns true if the voice reached the end of its data and should stop.
+ */
+bool
+sampleVoiceReference(virt_ptr<AXVoiceExtras> extras,
+                     Pcm16Sample *samples,
+                     int numSamples)
+{
+   static const auto FpOne = ufixed1616_t(1);
+   static const auto FpZero = ufixed1616_t(0);
+
+   memset(samples, 0, numSamples * sizeof(Pcm16Sample));
+
+   auto offsetFrac = ufixed1616_t(extras->src.currentOffsetFrac.value());
+
+   AudioDecoder decoder;
+   decoder.fromVoice(extras);
+
+   for (auto i = 0; i < numSamples; ++i) {
+      // Read in the current sample
+      Pcm16Sample sample;
+      if (offsetFrac == FpZero) {
+         sample = decoder.read();
+      } else {
+         AudioDecoder nextDecoder(decoder);
+         nextDecoder.advance();
+         if (!nextDecoder.eof()) {
+            sample = nextDecoder.read();
+         } else {
+            sample = 0;
+         }
+      }
+
+      if (offsetFrac == FpZero) {
+         samples[i] = sample;
+      } else {
+         auto thisSampleMul = FpOne - offsetFrac;
+         auto lastSampleMul = offsetFrac;
+         auto lastSample = Pcm16Sample::from_data(extras->src.lastSample[0]);
+         samples[i] = sample * thisSampleMul + lastSample * lastSampleMul;
+      }
+
+      offsetFrac += extras->src.ratio.value();
+
+      while (offsetFrac >= FpOne) {
+         // Advance the voice by one sample
+         offsetFrac -= FpOne;
+         decoder.advance();
+
+         // Update all the last sample listings.  Most of these are used
+         //  for FFT resampling (which we don't currently handle).
+         extras->src.lastSample[3] = extras->src.lastSample[2];
+         extras->src.lastSample[2] = extras->src.lastSample[1];
+         extras->src.lastSample[1] = extras->src.lastSample[0];
+         extras->src.lastSample[0] = sample.data();
+
+         // If we reached the end of the voice data, we should just leave
+         if (decoder.eof()) {
+            break;
+         }
+
+         // If we read through multiple samples due to a high SRC ratio,
+         //  then we need to actually read the upcoming sample in expectation
+         //  of the fact that its about to be stored in lastSample.
+         if (offsetFrac >= FpOne) {
+            sample = decoder.read();
+         }
+      }
+
+      if (decoder.eof()) {
+         break;
+      }
+   }
+
+   decoder.toVoice(extras);
+
+   extras->src.currentOffsetFrac = ufixed016_t { offsetFrac };
+   return decoder.eof();
+}
+
+/**
+ * Decode and resample a voice a block at a time.
+ *
+ * Every source sample the frame steps over is decoded exactly once into a
+ * scratch buffer, instead of copying the decoder to peek at the next sample
+ * for every output sample. The output and the voice state left behind are
+ * identical to sampleVoiceReference, including its quirk of interpolating
+ * the next sample against lastSample[0].
+ */
+bool
+sampleVoice(virt_ptr<AXVoiceExtras> extras,
+            Pcm16Sample *samples,
+            int numSamples)
+{
+   auto ratio = extras->src.ratio.value().data();
+   auto initialFrac = static_cast<uint32_t>(extras->src.currentOffsetFrac.value().data());
+
+   // How far the voice moves only depends on the SRC ratio, not the data
+   auto numAdvances = uint32_t { 0 };
+   auto frac = initialFrac;
+
+   for (auto i = 0; i < numSamples; ++i) {
+      frac += ratio;
+      numAdvances += frac >> 16;
+      frac &= 0xFFFF;
+   }
+
+   if (numAdvances + 2 > MaxDecodeSamples) {
+      return sampleVoiceReference(extras, samples, numSamples);
+   }
+
+   // Decode up to one sample past where the voice stops, as that is the
+   // furthest the interpolation looks ahead. We keep a copy of the decoder at
+   // the position the voice is left at, or where it reached the end of its
+   // data if that comes first.
+   std::array<int16_t, MaxDecodeSamples> source;
+   auto eofPosition = uint32_t { MaxDecodeSamples };
+
+   AudioDecoder decoder;
+   decoder.fromVoice(extras);
+   auto finalDecoder = decoder;
+
+   for (auto pos = 0u; pos <= numAdvances + 1; ++pos) {
+      if (pos == numAdvances) {
+         finalDecoder = decoder;
+      }
+
+      auto sample = decoder.read();
+      source[pos] = sample.data();
+
+      if (pos == numAdvances + 1) {
+         break;
+      }
+
+      decoder.advanceFrom(sample);
+
+      if (decoder.eof()) {
+         // Advancing from pos reached the end, there is no sample after it
+         eofPosition = pos;
+
+         if (pos < numAdvances) {
+            finalDecoder = decoder;
+         }
+
+         break;
+      }
+   }
+
+   std::array<int16_t, 4> lastSample = {
+      extras->src.lastSample[0],
+      extras->src.lastSample[1],
+      extras->src.lastSample[2],
+      extras->src.lastSample[3],
+   };
+
+   auto pushLastSample = [&](int16_t sample) {
+      lastSample[3] = lastSample[2];
+      lastSample[2] = lastSample[1];
+      lastSample[1] = lastSample[0];
+      lastSample[0] = sample;
+   };
+
+   auto pos = 0u;
+   auto numOutput = 0;
+   auto reachedEof = false;
+   frac = initialFrac;
+
+   if (ratio == 0x10000 && frac == 0) {
+      // Playing at the native rate, the output is just the source
+      numOutput = static_cast<int>(std::min<uint32_t>(numSamples, eofPosition + 1));
+      reachedEof = eofPosition < static_cast<uint32_t>(numSamples);
+      std::memcpy(samples, source.data(), numOutput * sizeof(Pcm16Sample));
+
+      for (auto i = std::max(0, numOutput - 4); i < numOutput; ++i) {
+         pushLastSample(source[i]);
+      }
+
+      pos = static_cast<uint32_t>(numOutput);
+   } else {
+      while (numOutput < numSamples && !reachedEof) {
+         auto sample = int16_t { 0 };
+
+         if (frac == 0) {
+            sample = source[pos];
+            samples[numOutput] = Pcm16Sample::from_data(sample);
+         } else {
+            if (eofPosition != pos) {
+               sample = source[pos + 1];
+            }
+
+            // Same arithmetic as sample * (1 - frac) + lastSample * frac
+            // with ufixed1616_t, which is done in uint32_t
+            auto mixed = static_cast<uint32_t>(sample) * (0x10000u - frac)
+                       + static_cast<uint32_t>(lastSample[0]) * frac;
+            samples[numOutput] = Pcm16Sample::from_data(static_cast<int16_t>(mixed >> 16));
+         }
+
+         ++numOutput;
+         frac += ratio;
+
+         while (frac >= 0x10000) {
+            frac -= 0x10000;
+            reachedEof = (eofPosition == pos);
+            pos++;
+            pushLastSample(sample);
+
+            if (reachedEof) {
+               break;
+            }
+
+            if (frac >= 0x10000) {
+               sample = source[pos];
+            }
+         }
+      }
+   }
+
+   std::memset(samples + numOutput, 0, (numSamples - numOutput) * sizeof(Pcm16Sample));
+   finalDecoder.toVoice(extras);
+
+   for (auto i = 0u; i < lastSample.size(); ++i) {
+      extras->src.lastSample[i] = lastSample[i];
+   }
+
+   extras->src.currentOffsetFrac = ufixed016_t::from_data(static_cast<uint16_t>(frac));
+   return reachedEof;
+}
+
+AXVoiceExtras::MixVolume &
+getVoiceMixVolume(virt_ptr<AXVoiceExtras> extras,
+                  AXDeviceType type,
+                  uint32_t device,
+                  uint32_t channel,
+                  uint32_t bus)
+{
+   if (type == AXDeviceType::TV) {
+      decaf_check(device < AXNumTvDevices);
+      decaf_check(channel < AXNumTvChannels);
+      decaf_check(bus < AXNumTvBus);
+      return extras->tvVolume[device][channel][bus];
+   } else if (type == AXDeviceType::DRC) {
+      decaf_check(device < AXNumDrcDevices);
+      decaf_check(channel < AXNumDrcChannels);
+      decaf_check(bus < AXNumDrcBus);
+      return extras->drcVolume[device][channel][bus];
+   } else if (type == AXDeviceType::RMT) {
+      decaf_check(device < AXNumRmtDevices);
+      decaf_check(channel < AXNumRmtChannels);
+      decaf_check(bus < AXNumRmtBus);
+      return extras->rmtVolume[device][channel][bus];
+   } else {
+      decaf_abort("Unexpected device type");
+   }
+}
+
+uint32_t
+getDeviceNumDevices(AXDeviceType type)
+{
+   decaf_check(type < AXDeviceType::Max);
+   static const uint32_t devices[] = { AXNumTvDevices, AXNumDrcDevices, AXNumRmtDevices };
+   return devices[type];
+}
+
+uint32_t
+getDeviceNumBuses(AXDeviceType type)
+{
+   decaf_check(type < AXDeviceType::Max);
+   static const uint32_t busses[] = { AXNumTvBus, AXNumDrcBus, AXNumRmtBus };
+   return busses[type];
+}
+
+uint32_t
+getDeviceNumChannels(AXDeviceType type)
+{
+   decaf_check(type < AXDeviceType::Max);
+   static const uint32_t channels[] = { AXNumTvChannels, AXNumDrcChannels, AXNumRmtChannels };
+   return channels[type];
+}
+
+//! First row of MixSums used by a device type.
+uint32_t
+getDeviceMixRowBase(AXDeviceType type)
+{
+   decaf_check(type < AXDeviceType::Max);
+   static const uint32_t bases[] = { 0, NumTvMixRows, NumTvMixRows + NumDrcMixRows };
+   return bases[type];
+}
+
+/**
+ * out[i] += (samples[i] * volume) >> 15, which is what adding a Pcm16Sample
+ * multiplied by a ufixed_1_15_t to a Pcm16Sample does, except we keep the
+ * sums in 32 bits. Pcm16Sample addition wraps, so truncating the sum to 16
+ * bits at the end gives exactly the same result.
+ */
+static void
+mixVoiceSamples(int32_t *out,
+                const Pcm16Sample *samples,
+                uint16_t volume,
+                uint32_t numSamples)
+{
+   auto in = reinterpret_cast<const int16_t *>(samples);
+   auto i = 0u;
+
+#ifdef AX_MIX_SSE2
+   // There is no unsigned * signed 16 bit multiply, so we multiply by the
+   // volume as a signed value and add the missing samples[i] << 16 back on to
+   // the high half when the top bit of the volume is set.
+   auto vol = _mm_set1_epi16(static_cast<int16_t>(volume));
+   auto volTopBit = _mm_set1_epi16((volume & 0x8000) ? -1 : 0);
+
+   for (; i + 8 <= numSamples; i += 8) {
+      auto value = _mm_loadu_si128(reinterpret_cast<const __m128i *>(in + i));
+      auto lo = _mm_mullo_epi16(value, vol);
+      auto hi = _mm_add_epi16(_mm_mulhi_epi16(value, vol), _mm_and_si128(value, volTopBit));
+      auto product0 = _mm_srai_epi32(_mm_unpacklo_epi16(lo, hi), 15);
+      auto product1 = _mm_srai_epi32(_mm_unpackhi_epi16(lo, hi), 15);
+
+      auto out0 = reinterpret_cast<__m128i *>(out + i);
+      auto out1 = reinterpret_cast<__m128i *>(out + i + 4);
+      _mm_storeu_si128(out0, _mm_add_epi32(_mm_loadu_si128(out0), product0));
+      _mm_storeu_si128(out1, _mm_add_epi32(_mm_loadu_si128(out1), product1));
+   }
+#endif
+
+   for (; i < numSamples; ++i) {
+      out[i] += (in[i] * static_cast<int32_t>(volume)) >> 15;
+   }
+}
+
+//! Truncate the 32 bit bus sums from mixVoiceSamples back to Pcm16Sample.
+void
+storeBusSamples(Pcm16Sample *samples,
+                const int32_t *in,
+                uint32_t numSamples)
+{
+   auto out = reinterpret_cast<int16_t *>(samples);
+   auto i = 0u;
+
+#ifdef AX_MIX_SSE2
+   for (; i + 8 <= numSamples; i += 8) {
+      // Sign extend the low 16 bits so the saturating pack cannot saturate
+      auto value0 = _mm_loadu_si128(reinterpret_cast<const __m128i *>(in + i));
+      auto value1 = _mm_loadu_si128(reinterpret_cast<const __m128i *>(in + i + 4));
+      value0 = _mm_srai_epi32(_mm_slli_epi32(value0, 16), 16);
+      value1 = _mm_srai_epi32(_mm_slli_epi32(value1, 16), 16);
+      _mm_storeu_si128(reinterpret_cast<__m128i *>(out + i), _mm_packs_epi32(value0, value1));
+   }
+#endif
+
+   for (; i < numSamples; ++i) {
+      out[i] = static_cast<int16_t>(in[i]);
+   }
+}
+
+/**
+ * Mix a decoded voice into the bus sums of every device type, advancing its
+ * mix volumes by their delta.
+ *
+ * The rows of each device type are ordered by bus, then device, then channel.
+ */
+void
+mixVoice(virt_ptr<AXVoiceExtras> extras,
+         uint32_t numSamples,
+         MixSums &sums)
+{
+   decaf_check(extras->numSamples == numSamples);
+
+   for (auto type : { AXDeviceType::TV, AXDeviceType::DRC, AXDeviceType::RMT }) {
+      auto numDevices = getDeviceNumDevices(type);
+      auto numBus = getDeviceNumBuses(type);
+      auto numChannels = getDeviceNumChannels(type);
+      auto row = getDeviceMixRowBase(type);
+
+      for (auto bus = 0u; bus < numBus; ++bus) {
+         for (auto deviceId = 0u; deviceId < numDevices; ++deviceId) {
+            for (auto channel = 0u; channel < numChannels; ++channel, ++row) {
+               auto &volume = getVoiceMixVolume(extras, type, deviceId, channel, bus);
+
+               // Most voices are only routed to a few of the channels
+               if (volume.volume.data()) {
+                  mixVoiceSamples(sums[row], extras->samples, volume.volume.data(), numSamples);
+               }
+
+               volume.volume += volume.delta;
+            }
+         }
+      }
+   }
+}
+
+/**
+ * The original scalar mix which mixVoice must match exactly, only used when
+ * sound.verify_mix is enabled.
+ *
+ * This does not advance the voice mix volumes so it can be run before
+ * mixVoice.
+ */
+void
+mixVoiceReference(virt_ptr<AXVoiceExtras> extras,
+                  AXDeviceType type,
+                  uint32_t numSamples,
+                  BusSamples &busSamples)
+{
+   auto numDevices = getDeviceNumDevices(type);
+   auto numBus = getDeviceNumBuses(type);
+   auto numChannels = getDeviceNumChannels(type);
+
+   for (auto deviceId = 0u; deviceId < numDevices; ++deviceId) {
+      for (auto bus = 0u; bus < numBus; ++bus) {
+         for (auto channel = 0u; channel < numChannels; ++channel) {
+            auto volume = getVoiceMixVolume(extras, type, deviceId, channel, bus);
+            auto &out = busSamples[bus][deviceId][channel];
+
+            for (auto i = 0u; i < numSamples; ++i) {
+               out[i] += extras->samples[i] * volume.volume;
+            }
+         }
+      }
+   }
+}
+
+static void
+addMixSums(MixSums &dst,
+           const MixSums &src)
+{
+   auto out = &dst[0][0];
+   auto in = &src[0][0];
+
+   for (auto i = 0u; i < sizeof(MixSums) / sizeof(int32_t); ++i) {
+      out[i] += in[i];
+   }
+}
+
+VoiceRenderPool::~VoiceRenderPool()
+{
+   stop();
+}
+
+/**
+ * Render numVoices voices into sums, on numThreads render threads as well as
+ * the calling thread.
+ *
+ * The threads are restarted whenever numThreads changes. Fewer than
+ * MinParallelVoices voices are rendered on the calling thread alone.
+ */
+void
+VoiceRenderPool::render(size_t numVoices,
+                        unsigned numThreads,
+                        MixSums &sums,
+                        const RenderVoiceFunction &renderVoice)
+{
+   if (mParticipants.empty() || numThreads != mThreads.size()) {
+      start(numThreads);
+   }
+
+   mRenderVoice = &renderVoice;
+   mNumVoices = numVoices;
+   mNextVoice.store(0, std::memory_order_relaxed);
+
+   if (!mThreads.empty() && numVoices >= MinParallelVoices) {
+      {
+         std::unique_lock<std::mutex> lock { mMutex };
+         mNumPending = static_cast<unsigned>(mThreads.size());
+         mGeneration++;
+      }
+
+      mWorkCondition.notify_all();
+      renderVoices(*mParticipants[0]);
+
+      std::unique_lock<std::mutex> lock { mMutex };
+      mDoneCondition.wait(lock, [&]() { return mNumPending == 0; });
+   } else {
+      renderVoices(*mParticipants[0]);
+
+      for (auto i = 1u; i < mParticipants.size(); ++i) {
+         mParticipants[i]->used = false;
+      }
+   }
+
+   mRenderVoice = nullptr;
+   std::memset(sums, 0, sizeof(MixSums));
+
+   for (auto &participant : mParticipants) {
+      if (participant->used) {
+         addMixSums(sums, participant->sums);
+      }
+   }
+}
+
+void
+VoiceRenderPool::start(unsigned numThreads)
+{
+   stop();
+
+   mRunning = true;
+   mParticipants.clear();
+   mParticipants.emplace_back(std::make_unique<Participant>());
+
+   for (auto i = 0u; i < numThreads; ++i) {
+      mParticipants.emplace_back(std::make_unique<Participant>());
+      mThreads.emplace_back(&VoiceRenderPool::threadEntry, this, mParticipants.back().get(), mGeneration);
+      platform::setThreadName(&mThreads.back(), fmt::format("AX Voice Render {}", i));
+   }
+}
+
+void
+VoiceRenderPool::stop()
+{
+   {
+      std::unique_lock<std::mutex> lock { mMutex };
+      mRunning = false;
+   }
+
+   mWorkCondition.notify_all();
+
+   for (auto &thread : mThreads) {
+      thread.join();
+   }
+
+   mThreads.clear();
+}
+
+void
+VoiceRenderPool::threadEntry(Participant *participant,
+                             uint64_t generation)
+{
+   while (true) {
+      {
+         std::unique_lock<std::mutex> lock { mMutex };
+         mWorkCondition.wait(lock, [&]() { return !mRunning || mGeneration != generation; });
+
+         if (!mRunning) {
+            break;
+         }
+
+         generation = mGeneration;
+      }
+
+      renderVoices(*participant);
+
+      std::unique_lock<std::mutex> lock { mMutex };
+      if (--mNumPending == 0) {
+         mDoneCondition.notify_one();
+      }
+   }
+}
+
+void
+VoiceRenderPool::renderVoices(Participant &participant)
+{
+   participant.used = false;
+
+   while (true) {
+      auto index = mNextVoice.fetch_add(1, std::memory_order_relaxed);
+      if (index >= mNumVoices) {
+         break;
+      }
+
+      if (!participant.used) {
+         std::memset(participant.sums, 0, sizeof(MixSums));
+         participant.used = true;
+      }
+
+      (*mRenderVoice)(index, participant.sums);
+   }
+}
+
+} // namespace cafe::sndcore2::internal
@@ -0,0 +1,140 @@
+#pragma once
+#include "sndcore2_constants.h"
+#include "sndcore2_enum.h"
+#include "sndcore2_voice.h"
+
+#include <atomic>
+#include <common/fixed.h>
+#include <condition_variable>
+#include <cstdint>
+#include <functional>
+#include <libcpu/be2_struct.h>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace cafe::sndcore2::internal
+{
+
+constexpr auto AXMaxDevices = 4;
+constexpr auto AXMaxBuses = 4;
+constexpr auto AXMaxChannels = 6;
+constexpr auto AXMaxFrameSamples = 144;
+
+using BusSamples = Pcm16Sample[AXMaxBuses][AXMaxDevices][AXMaxChannels][AXMaxFrameSamples];
+
+constexpr auto NumTvMixRows = AXNumTvBus * AXNumTvDevices * AXNumTvChannels;
+constexpr auto NumDrcMixRows = AXNumDrcBus * AXNumDrcDevices * AXNumDrcChannels;
+constexpr auto NumRmtMixRows = AXNumRmtBus * AXNumRmtDevices * AXNumRmtChannels;
+
+//! 32 bit sums of every voice for each bus, device and channel of every
+//! device type, see mixVoice.
+using MixSums = int32_t[NumTvMixRows + NumDrcMixRows + NumRmtMixRows][AXMaxFrameSamples];
+
+//! Fewest voices worth waking the voice render threads for.
+constexpr auto MinParallelVoices = 8u;
+
+uint32_t
+getDeviceNumDevices(AXDeviceType type);
+
+uint32_t
+getDeviceNumBuses(AXDeviceType type);
+
+uint32_t
+getDeviceNumChannels(AXDeviceType type);
+
+uint32_t
+getDeviceMixRowBase(AXDeviceType type);
+
+AXVoiceExtras::MixVolume &
+getVoiceMixVolume(virt_ptr<AXVoiceExtras> extras,
+                  AXDeviceType type,
+                  uint32_t device,
+                  uint32_t channel,
+                  uint32_t bus);
+
+bool
+sampleVoiceReference(virt_ptr<AXVoiceExtras> extras,
+                     Pcm16Sample *samples,
+                     int numSamples);
+
+bool
+sampleVoice(virt_ptr<AXVoiceExtras> extras,
+            Pcm16Sample *samples,
+            int numSamples);
+
+void
+mixVoiceReference(virt_ptr<AXVoiceExtras> extras,
+                  AXDeviceType type,
+                  uint32_t numSamples,
+                  BusSamples &busSamples);
+
+void
+mixVoice(virt_ptr<AXVoiceExtras> extras,
+         uint32_t numSamples,
+         MixSums &sums);
+
+void
+storeBusSamples(Pcm16Sample *samples,
+                const int32_t *in,
+                uint32_t numSamples);
+
+/**
+ * Host threads which render voices alongside the AX thread.
+ *
+ * Each frame every participant, including the AX thread itself, takes voices
+ * off a shared counter and renders them into its own MixSums. Once all the
+ * voices are done the AX thread adds the sums together. Pcm16Sample addition
+ * wraps, so the order voices are summed in does not change the result.
+ */
+class VoiceRenderPool
+{
+   struct Participant
+   {
+      MixSums sums;
+      bool used = false;
+   };
+
+public:
+   //! Decodes voice index and mixes it into sums.
+   using RenderVoiceFunction = std::function<void(size_t index, MixSums &sums)>;
+
+   ~VoiceRenderPool();
+
+   void
+   render(size_t numVoices,
+          unsigned numThreads,
+          MixSums &sums,
+          const RenderVoiceFunction &renderVoice);
+
+private:
+   void
+   start(unsigned numThreads);
+
+   void
+   stop();
+
+   void
+   threadEntry(Participant *participant,
+               uint64_t generation);
+
+   void
+   renderVoices(Participant &participant);
+
+private:
+   std::vector<std::thread> mThreads;
+   std::vector<std::unique_ptr<Participant>> mParticipants;
+   std::mutex mMutex;
+   std::condition_variable mWorkCondition;
+   std::condition_variable mDoneCondition;
+   bool mRunning = false;
+   uint64_t mGeneration = 0;
+   unsigned mNumPending = 0;
+
+   const RenderVoiceFunction *mRenderVoice = nullptr;
+   size_t mNumVoices = 0;
+   std::atomic<size_t> mNextVoice { 0 };
+};
+
+} // namespace cafe::sndcore2::internal
@@ -13,6 +13,7 @@
 #include <libgpu/latte/latte_pm4_commands.h>
 #include <libgpu/latte/latte_pm4_sizer.h>
 #include <libgpu/latte/latte_pm4_writer.h>
+#include <mutex>
 
 namespace cafe::tcl
 {
@@ -37,6 +38,11 @@ struct StaticRingData
 static virt_ptr<StaticRingData>
 sRingData;
 
+//! Keeps a submission and its timestamp packet together in the ring, so
+//! timestamps retire in the order they were handed out.
+static std::mutex
+sSubmitMutex;
+
 TCLStatus
 TCLReadTimestamp(TCLTimestampID id,
                  virt_ptr<TCLTimestamp> outValue)
@@ -161,6 +167,7 @@ TCLSubmitToRing(virt_ptr<uint32_t> buffer,
       flags = *submitFlags;
    }
 
+   std::unique_lock<std::mutex> lock { sSubmitMutex };
    gpu::ringbuffer::write({ buffer.getRawPointer(), numWords });
 
    if (flags & TCLSubmitFlags::UpdateTimestamp) {
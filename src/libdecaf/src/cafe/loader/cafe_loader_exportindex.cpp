@@ -0,0 +1,78 @@
+#include "cafe_loader_exportindex.h"
+#include "cafe_loader_loaded_rpl.h"
+
+#include <unordered_map>
+
+namespace cafe::loader::internal
+{
+
+/*
+ * Linking looks up every imported symbol in the export table of the module
+ * it is imported from. Rather than binary searching the table with strcmp
+ * each time, the first lookup in a table builds an ExportIndex of it which
+ * is kept until the module is purged.
+ *
+ * Indices are keyed by the address of their export table. Those of shared
+ * libraries are kept for the next process, as it links against the same
+ * shared libraries again.
+ */
+struct ModuleExportIndex
+{
+   ExportIndex index;
+   bool shared = false;
+};
+
+static std::unordered_map<uint32_t, ModuleExportIndex>
+sExportIndices;
+
+virt_ptr<rpl::Export>
+LiFindExport(virt_ptr<LOADED_RPL> rpl,
+             virt_ptr<rpl::Export> exports,
+             uint32_t numExports,
+             virt_ptr<char> name)
+{
+   if (!exports || !numExports || !name || !name[0]) {
+      return nullptr;
+   }
+
+   auto &moduleIndex = sExportIndices[virt_cast<virt_addr>(exports).getAddress()];
+   auto &index = moduleIndex.index;
+   if (index.exports() != exports.get() || index.numExports() != numExports) {
+      auto strTable = virt_cast<char *>(virt_cast<virt_addr>(exports) - 8);
+      index.build(exports.get(), numExports, strTable.get());
+      moduleIndex.shared = rpl && (rpl->loadStateFlags & LoaderStateFlags_Unk0x20000000);
+   }
+
+   auto symbolExport = index.find(name.get());
+   if (!symbolExport) {
+      return nullptr;
+   }
+
+   return exports + static_cast<uint32_t>(symbolExport - exports.get());
+}
+
+void
+LiRemoveExportIndex(virt_ptr<LOADED_RPL> rpl)
+{
+   if (rpl->funcExports) {
+      sExportIndices.erase(virt_cast<virt_addr>(rpl->funcExports).getAddress());
+   }
+
+   if (rpl->dataExports) {
+      sExportIndices.erase(virt_cast<virt_addr>(rpl->dataExports).getAddress());
+   }
+}
+
+void
+LiResetProcessExportIndex()
+{
+   for (auto itr = sExportIndices.begin(); itr != sExportIndices.end(); ) {
+      if (itr->second.shared) {
+         ++itr;
+      } else {
+         itr = sExportIndices.erase(itr);
+      }
+   }
+}
+
+} // namespace cafe::loader::internal
@@ -0,0 +1,95 @@
+#pragma once
+#include "cafe_loader_rpl.h"
+
+#include <cstdint>
+#include <libcpu/be2_struct.h>
+#include <string_view>
+#include <unordered_map>
+
+namespace cafe::loader
+{
+
+struct LOADED_RPL;
+
+namespace internal
+{
+
+/**
+ * Hash index of the names in an RPL export table.
+ *
+ * The names are not copied, they point into the module's export string
+ * table, so the index must be dropped before the module is unloaded.
+ */
+class ExportIndex
+{
+public:
+   void
+   build(const rpl::Export *exports,
+         uint32_t numExports,
+         const char *strTable)
+   {
+      mExports = exports;
+      mNumExports = numExports;
+      mIndices.clear();
+      mIndices.reserve(numExports);
+
+      for (auto i = 0u; i < numExports; ++i) {
+         // The top bit of the name offset marks TLS exports
+         mIndices.emplace(strTable + (exports[i].name & 0x7FFFFFFF), i);
+      }
+   }
+
+   const rpl::Export *
+   find(std::string_view name) const
+   {
+      auto itr = mIndices.find(name);
+      if (itr == mIndices.end()) {
+         return nullptr;
+      }
+
+      return mExports + itr->second;
+   }
+
+   const rpl::Export *
+   exports() const
+   {
+      return mExports;
+   }
+
+   uint32_t
+   numExports() const
+   {
+      return mNumExports;
+   }
+
+private:
+   const rpl::Export *mExports = nullptr;
+   uint32_t mNumExports = 0;
+   std::unordered_map<std::string_view, uint32_t> mIndices;
+};
+
+/**
+ * Find an export by name in an export table of rpl.
+ */
+virt_ptr<rpl::Export>
+LiFindExport(virt_ptr<LOADED_RPL> rpl,
+             virt_ptr<rpl::Export> exports,
+             uint32_t numExports,
+             virt_ptr<char> name);
+
+/**
+ * Drop the indices of an RPL's export tables, before it is unloaded.
+ */
+void
+LiRemoveExportIndex(virt_ptr<LOADED_RPL> rpl);
+
+/**
+ * Drop the indices of every RPL which is not a shared library, when a new
+ * process starts loading.
+ */
+void
+LiResetProcessExportIndex();
+
+} // namespace internal
+
+} // namespace cafe::loader
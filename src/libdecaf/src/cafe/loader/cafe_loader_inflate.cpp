@@ -0,0 +1,396 @@
+#include "cafe_loader_inflate.h"
+
+#include <algorithm>
+#include <common/datahash.h>
+#include <common/platform_dir.h>
+#include <common/platform_thread.h>
+#include <condition_variable>
+#include <cstdio>
+#include <deque>
+#include <fmt/format.h>
+#include <fstream>
+#include <functional>
+#include <mutex>
+#include <queue>
+#include <thread>
+#include <zlib.h>
+
+namespace cafe::loader::internal
+{
+
+//! Same as the chunk size the loader inflated with before, the CRC of each
+//! chunk is calculated while it is still in cache.
+static constexpr auto InflateChunkSize = 0x3000u;
+
+//! Sections smaller than this are quicker to inflate than to hand over to
+//! another thread.
+static constexpr auto MinThreadedDeflatedSize = size_t { 16 * 1024 };
+
+//! Sections smaller than this are quicker to inflate than to look up in the
+//! section cache.
+static constexpr auto MinCachedDeflatedSize = size_t { 16 * 1024 };
+
+/*
+ * The section cache holds the result of every section which inflated without
+ * error, in a file named after the hash of its deflated data. A section which
+ * is inflated again, such as a system library on every boot, is then read
+ * straight out of that file.
+ */
+struct SectionCacheHeader
+{
+   static constexpr auto Magic = 0x44534543u; // DSEC
+   static constexpr auto Version = 1u;
+
+   uint32_t magic;
+   uint32_t version;
+   uint64_t deflatedSize;
+   uint32_t inflatedSize;
+   uint32_t crc;
+};
+
+/*
+ * The files in the section cache, oldest first, so it can be kept under
+ * job.cacheMaxSize by removing the files which were written longest ago.
+ *
+ * The directory is only listed on the first write to it, so when another
+ * emulator shares the cache this only tracks the files we wrote since.
+ */
+class SectionCacheFiles
+{
+   struct File
+   {
+      std::string name;
+      uint64_t size;
+   };
+
+public:
+   void add(const std::string &directory,
+            const std::string &name,
+            uint64_t size,
+            uint64_t maxSize)
+   {
+      std::unique_lock<std::mutex> lock { mMutex };
+
+      if (directory != mDirectory) {
+         list(directory);
+      }
+
+      // The same section may have been written again after failing its CRC
+      auto itr = std::find_if(mFiles.begin(), mFiles.end(),
+                              [&](const File &file) { return file.name == name; });
+      if (itr != mFiles.end()) {
+         mTotalSize -= itr->size;
+         mFiles.erase(itr);
+      }
+
+      mFiles.push_back({ name, size });
+      mTotalSize += size;
+
+      while (maxSize && mTotalSize > maxSize && mFiles.size() > 1) {
+         auto &oldest = mFiles.front();
+         std::remove(fmt::format("{}/{}", mDirectory, oldest.name).c_str());
+         mTotalSize -= oldest.size;
+         mFiles.pop_front();
+      }
+   }
+
+private:
+   void list(const std::string &directory)
+   {
+      auto files = std::vector<std::pair<uint64_t, File>> { };
+      platform::listFiles(directory,
+         [&](const std::string &name, uint64_t size, uint64_t writeTime) {
+            // Sections and any temporary files left by an emulator which
+            // exited part way through writing one
+            if (name.size() > 4 &&
+                (name.compare(name.size() - 4, 4, ".bin") == 0 ||
+                 name.compare(name.size() - 4, 4, ".tmp") == 0)) {
+               files.push_back({ writeTime, File { name, size } });
+            }
+         });
+
+      std::stable_sort(files.begin(), files.end(),
+                       [](const auto &lhs, const auto &rhs) { return lhs.first < rhs.first; });
+
+      mDirectory = directory;
+      mFiles.clear();
+      mTotalSize = 0;
+
+      for (auto &file : files) {
+         mTotalSize += file.second.size;
+         mFiles.push_back(std::move(file.second));
+      }
+   }
+
+private:
+   std::mutex mMutex;
+   std::string mDirectory;
+   std::deque<File> mFiles;
+   uint64_t mTotalSize = 0;
+};
+
+static SectionCacheFiles
+sSectionCacheFiles;
+
+static std::string
+getSectionCacheName(const InflateJob &job)
+{
+   auto hash = DataHash { }.write(job.deflated).value();
+   return fmt::format("{:016X}{:016X}.bin", hash[0], hash[1]);
+}
+
+static bool
+readCachedSection(InflateJob &job,
+                  const std::string &path)
+{
+   auto file = std::ifstream { path, std::ifstream::binary };
+   auto header = SectionCacheHeader { };
+
+   if (!file.read(reinterpret_cast<char *>(&header), sizeof(header)) ||
+       header.magic != SectionCacheHeader::Magic ||
+       header.version != SectionCacheHeader::Version ||
+       header.deflatedSize != job.deflated.size()) {
+      return false;
+   }
+
+   // Inflating to a smaller buffer fails part way, leave that to inflate.
+   if (header.inflatedSize > job.dstSize) {
+      return false;
+   }
+
+   if (!file.read(reinterpret_cast<char *>(job.dst), header.inflatedSize)) {
+      return false;
+   }
+
+   // A damaged file is inflated again, which also replaces it.
+   auto crc = crc32(crc32(0, Z_NULL, 0), job.dst, header.inflatedSize);
+   if (crc != header.crc) {
+      return false;
+   }
+
+   job.initError = 0;
+   job.inflateError = 0;
+   job.inflatedSize = header.inflatedSize;
+   job.crc = header.crc;
+   return true;
+}
+
+static void
+writeCachedSection(const InflateJob &job,
+                   const std::string &name)
+{
+   auto size = sizeof(SectionCacheHeader) + uint64_t { job.inflatedSize };
+   if (job.cacheMaxSize && size > job.cacheMaxSize) {
+      return;
+   }
+
+   // Written under a unique name and then renamed, so another emulator
+   // sharing the cache never reads a partly written file.
+   auto path = fmt::format("{}/{}", job.cachePath, name);
+   auto tmpPath = fmt::format("{}.{:X}.{:X}.tmp", path,
+                              std::hash<std::thread::id> { }(std::this_thread::get_id()),
+                              std::chrono::steady_clock::now().time_since_epoch().count());
+   auto header = SectionCacheHeader { };
+   header.magic = SectionCacheHeader::Magic;
+   header.version = SectionCacheHeader::Version;
+   header.deflatedSize = job.deflated.size();
+   header.inflatedSize = job.inflatedSize;
+   header.crc = job.crc;
+
+   if (!platform::createDirectory(job.cachePath)) {
+      return;
+   }
+
+   {
+      auto file = std::ofstream { tmpPath, std::ofstream::binary };
+      file.write(reinterpret_cast<const char *>(&header), sizeof(header));
+      file.write(reinterpret_cast<const char *>(job.dst), job.inflatedSize);
+
+      if (!file) {
+         file.close();
+         std::remove(tmpPath.c_str());
+         return;
+      }
+   }
+
+   if (std::rename(tmpPath.c_str(), path.c_str()) != 0) {
+      std::remove(tmpPath.c_str());
+      return;
+   }
+
+   sSectionCacheFiles.add(job.cachePath, name, size, job.cacheMaxSize);
+}
+
+void
+inflateSection(InflateJob &job)
+{
+   auto stream = z_stream { };
+   job.initError = inflateInit(&stream);
+   if (job.initError != Z_OK) {
+      return;
+   }
+
+   stream.next_in = job.deflated.data();
+   stream.avail_in = static_cast<uInt>(job.deflated.size());
+   stream.next_out = job.dst;
+   job.crc = crc32(0, Z_NULL, 0);
+
+   while (stream.avail_in) {
+      auto chunk = stream.next_out;
+      stream.avail_out = std::min<uInt>(InflateChunkSize, job.dstSize - stream.total_out);
+
+      auto error = inflate(&stream, 0);
+      job.crc = crc32(job.crc, chunk, static_cast<uInt>(stream.next_out - chunk));
+
+      if (error == Z_STREAM_END) {
+         // Anything after the end of the stream is ignored
+         break;
+      } else if (error != Z_OK) {
+         job.inflateError = error;
+         break;
+      }
+   }
+
+   job.inflatedSize = static_cast<uint32_t>(stream.total_out);
+   inflateEnd(&stream);
+}
+
+void
+inflateSectionCached(InflateJob &job)
+{
+   if (job.cachePath.empty() || job.deflated.size() < MinCachedDeflatedSize) {
+      inflateSection(job);
+      return;
+   }
+
+   auto name = getSectionCacheName(job);
+   if (readCachedSection(job, fmt::format("{}/{}", job.cachePath, name))) {
+      return;
+   }
+
+   inflateSection(job);
+
+   if (!job.failed()) {
+      writeCachedSection(job, name);
+   }
+}
+
+class InflatePool
+{
+public:
+   ~InflatePool()
+   {
+      stop();
+   }
+
+   void submit(std::shared_ptr<InflateJob> job,
+               unsigned numThreads)
+   {
+      std::unique_lock<std::mutex> lock { mMutex };
+
+      if (numThreads != mThreads.size()) {
+         lock.unlock();
+         start(numThreads);
+         lock.lock();
+      }
+
+      if (mThreads.empty() || job->deflated.size() < MinThreadedDeflatedSize) {
+         lock.unlock();
+         inflateSectionCached(*job);
+         lock.lock();
+         job->finished = true;
+         return;
+      }
+
+      mJobs.push(std::move(job));
+      mWorkCondition.notify_one();
+   }
+
+   bool wait(const std::shared_ptr<InflateJob> &job,
+             std::chrono::microseconds timeout)
+   {
+      std::unique_lock<std::mutex> lock { mMutex };
+      return mDoneCondition.wait_for(lock, timeout, [&]() { return job->finished; });
+   }
+
+private:
+   void start(unsigned numThreads)
+   {
+      stop();
+
+      std::unique_lock<std::mutex> lock { mMutex };
+      mRunning = true;
+
+      for (auto i = 0u; i < numThreads; ++i) {
+         mThreads.emplace_back(&InflatePool::threadEntry, this);
+         platform::setThreadName(&mThreads.back(), fmt::format("Loader Inflate {}", i));
+      }
+   }
+
+   void stop()
+   {
+      {
+         std::unique_lock<std::mutex> lock { mMutex };
+         mRunning = false;
+      }
+
+      mWorkCondition.notify_all();
+
+      for (auto &thread : mThreads) {
+         thread.join();
+      }
+
+      mThreads.clear();
+   }
+
+   void threadEntry()
+   {
+      std::unique_lock<std::mutex> lock { mMutex };
+
+      while (true) {
+         // Queued jobs are always finished, the loader is waiting on them
+         mWorkCondition.wait(lock, [&]() { return !mRunning || !mJobs.empty(); });
+
+         if (mJobs.empty()) {
+            break;
+         }
+
+         auto job = std::move(mJobs.front());
+         mJobs.pop();
+
+         lock.unlock();
+         inflateSectionCached(*job);
+         lock.lock();
+
+         job->finished = true;
+         mDoneCondition.notify_all();
+      }
+   }
+
+private:
+   std::vector<std::thread> mThreads;
+   std::queue<std::shared_ptr<InflateJob>> mJobs;
+   std::mutex mMutex;
+   std::condition_variable mWorkCondition;
+   std::condition_variable mDoneCondition;
+   bool mRunning = false;
+};
+
+static InflatePool
+sInflatePool;
+
+void
+submitInflateJob(std::shared_ptr<InflateJob> job,
+                 unsigned numThreads)
+{
+   sInflatePool.submit(std::move(job), numThreads);
+}
+
+bool
+waitInflateJob(const std::shared_ptr<InflateJob> &job,
+               std::chrono::microseconds timeout)
+{
+   return sInflatePool.wait(job, timeout);
+}
+
+} // namespace cafe::loader::internal
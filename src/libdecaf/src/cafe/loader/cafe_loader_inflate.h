@@ -0,0 +1,85 @@
+#pragma once
+#include <chrono>
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <vector>
+
+namespace cafe::loader::internal
+{
+
+/**
+ * A deflated section to be inflated on the host.
+ *
+ * This only touches host memory, the loader copies the deflated data out of
+ * its bounce buffers first, so it can run on any host thread. The results
+ * are the zlib return codes which ZLIB_UncompressFromStream would have seen,
+ * it is up to the loader to turn them into loader errors.
+ */
+struct InflateJob
+{
+   //! Section data following the 4 byte inflated size.
+   std::vector<uint8_t> deflated;
+
+   //! Where to inflate to, at most dstSize bytes are written.
+   uint8_t *dst = nullptr;
+   uint32_t dstSize = 0;
+
+   //! Directory of the inflated section cache, empty to always inflate.
+   std::string cachePath;
+
+   //! Size in bytes the section cache is kept under, 0 for no limit.
+   uint64_t cacheMaxSize = 0;
+
+   //! Result of inflateInit.
+   int initError = 0;
+
+   //! First result of inflate which was not Z_OK or Z_STREAM_END.
+   int inflateError = 0;
+
+   //! Number of bytes inflated to dst.
+   uint32_t inflatedSize = 0;
+
+   //! CRC32 of the inflated data, calculated as it was inflated.
+   uint32_t crc = 0;
+
+   //! Set once the results are valid, guarded by the inflate thread mutex.
+   bool finished = false;
+
+   bool failed() const
+   {
+      return initError || inflateError;
+   }
+};
+
+/**
+ * Inflates a job on the calling thread.
+ */
+void
+inflateSection(InflateJob &job);
+
+/**
+ * Inflates a job on the calling thread, or copies the result of inflating
+ * the same data before out of job.cachePath.
+ */
+void
+inflateSectionCached(InflateJob &job);
+
+/**
+ * Queue a job to be inflated on one of the loader's host threads.
+ *
+ * When there are no host threads, or the job is small enough that waking one
+ * is not worth it, the job is inflated immediately on the calling thread.
+ */
+void
+submitInflateJob(std::shared_ptr<InflateJob> job,
+                 unsigned numThreads);
+
+/**
+ * Wait up to timeout for a submitted job to finish, returns true when it has.
+ */
+bool
+waitInflateJob(const std::shared_ptr<InflateJob> &job,
+               std::chrono::microseconds timeout);
+
+} // namespace cafe::loader::internal
@@ -2,6 +2,7 @@
 #include "cafe_loader_bounce.h"
 #include "cafe_loader_entry.h"
 #include "cafe_loader_error.h"
+#include "cafe_loader_exportindex.h"
 #include "cafe_loader_globals.h"
 #include "cafe_loader_heap.h"
 #include "cafe_loader_iop.h"
@@ -116,6 +117,7 @@ LOADER_Init(kernel::UniqueProcessId upid,
    globals->firstLoadedRpl = nullptr;
    globals->lastLoadedRpl = nullptr;
    globals->loadedRpx = nullptr;
+   LiResetProcessExportIndex();
 
    std::memset(startInfo.get(), 0, sizeof(RPL_STARTINFO));
    startInfo->dataAreaEnd = virt_addr { 0x10000000u } + maxDataSize;
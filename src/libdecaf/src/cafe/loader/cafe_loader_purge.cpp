@@ -1,3 +1,4 @@
+#include "cafe_loader_exportindex.h"
 #include "cafe_loader_globals.h"
 #include "cafe_loader_heap.h"
 #include "cafe_loader_log.h"
@@ -17,6 +18,8 @@ LiPurgeOneUnlinkedModule(virt_ptr<LOADED_RPL> rpl)
    }
 
    if (!(rpl->loadStateFlags & LoaderStateFlags_Unk0x20000000)) {
+      LiRemoveExportIndex(rpl);
+
       if (rpl->textBuffer) {
          LiCacheLineCorrectFreeEx(globals->processCodeHeap,
                                   rpl->textBuffer,
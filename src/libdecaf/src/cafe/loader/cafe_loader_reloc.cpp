@@ -1,5 +1,6 @@
 #include "cafe_loader_basics.h"
 #include "cafe_loader_error.h"
+#include "cafe_loader_exportindex.h"
 #include "cafe_loader_flush.h"
 #include "cafe_loader_iop.h"
 #include "cafe_loader_loaded_rpl.h"
@@ -21,35 +22,6 @@ namespace cafe::loader::internal
 constexpr auto TrampSize = uint32_t { 16 };
 static std::array<uint8_t, 0x1FF8> sRelocBuffer;
 
-static virt_ptr<rpl::Export>
-LiBinSearchExport(virt_ptr<rpl::Export> exports,
-                  uint32_t numExports,
-                  virt_ptr<char> name)
-{
-   if (!exports || !numExports || !name || !name[0]) {
-      return nullptr;
-   }
-
-   auto strTable = virt_cast<char *>(virt_cast<virt_addr>(exports) - 8);
-   auto left = 0u;
-   auto right = numExports;
-
-   while (left < right) {
-      auto index = left + (right - left) / 2;
-      auto exportName = strTable + (exports[index].name & 0x7FFFFFFF);
-      auto cmpValue = strcmp(name.get(), exportName.get());
-      if (cmpValue == 0) {
-         return exports + index;
-      } else if (cmpValue < 0) {
-         right = index;
-      } else {
-         left = index + 1;
-      }
-   }
-
-   return nullptr;
-}
-
 static int32_t
 sFixupOneSymbolTable(virt_ptr<LOADED_RPL> rpl,
                      uint32_t sectionIndex,
@@ -114,9 +86,10 @@ sFixupOneSymbolTable(virt_ptr<LOADED_RPL> rpl,
       }
 
       auto &import = imports[symbol->shndx];
-      auto symbolExport = LiBinSearchExport(import.exports,
-                                            import.numExports,
-                                            symbolName);
+      auto symbolExport = LiFindExport(import.rpl,
+                                       import.exports,
+                                       import.numExports,
+                                       symbolName);
       if (symbolExport) {
          symbol->value = symbolExport->value;
       } else {
@@ -3,6 +3,7 @@
 #include "cafe_loader_error.h"
 #include "cafe_loader_globals.h"
 #include "cafe_loader_heap.h"
+#include "cafe_loader_inflate.h"
 #include "cafe_loader_iop.h"
 #include "cafe_loader_purge.h"
 #include "cafe_loader_setup.h"
@@ -10,8 +11,12 @@
 #include "cafe_loader_log.h"
 #include "cafe_loader_minfileinfo.h"
 #include "cafe/cafe_stackobject.h"
+#include "decaf_config.h"
 
+#include <chrono>
 #include <common/align.h>
+#include <memory>
+#include <vector>
 #include <zlib.h>
 
 namespace cafe::loader::internal
@@ -192,16 +197,187 @@ sLiRefillBounceBufferForReading(virt_ptr<LOADED_RPL> rpl,
    return result;
 }
 
-int32_t
+/**
+ * Deflated sections which are being inflated on the loader's host threads.
+ *
+ * The loader carries on reading the rest of the file while they inflate, so
+ * their errors are only reported once they are waited on in finish. The first
+ * section which failed is reported as though nothing after it had been read
+ * yet, so the loader ends up with the same fatal error and result as when it
+ * inflated each section before moving on to the next.
+ */
+class PendingInflates
+{
+   struct Pending
+   {
+      std::shared_ptr<InflateJob> job;
+      int32_t sectionIndex;
+      std::string_view boundsName;
+      uint32_t expectedSize;
+   };
+
+public:
+   PendingInflates(virt_ptr<LOADED_RPL> rpl) :
+      mRpl(rpl),
+      mHadFatalError(LiGetFatalError() != 0)
+   {
+   }
+
+   ~PendingInflates()
+   {
+      decaf_check(mPending.empty());
+   }
+
+   void add(std::shared_ptr<InflateJob> job,
+            int32_t sectionIndex,
+            std::string_view boundsName,
+            uint32_t expectedSize)
+   {
+      submitInflateJob(job, decaf::config::system::loader_threads);
+      mPending.push_back({ std::move(job), sectionIndex, boundsName, expectedSize });
+   }
+
+   /**
+    * Wait for every pending section to finish inflating.
+    *
+    * Returns the error of the first section which failed, or result if none
+    * of them did.
+    */
+   int32_t finish(int32_t result = 0)
+   {
+      auto failed = false;
+
+      for (auto &pending : mPending) {
+         // Every job is waited for, even after one has failed, as they are
+         // writing to memory which the caller is about to free.
+         while (!waitInflateJob(pending.job, std::chrono::milliseconds { 1 })) {
+            LiCheckAndHandleInterrupts();
+         }
+
+         if (failed) {
+            continue;
+         }
+
+         auto error = checkResult(pending);
+         if (error) {
+            failed = true;
+            result = error;
+         } else {
+            mRpl->lastSectionCrc = pending.job->crc;
+         }
+      }
+
+      mPending.clear();
+      return result;
+   }
+
+   /**
+    * Report a zlib error in the same way ZLIB_UncompressFromStream would have.
+    */
+   int32_t reportZlibError(const InflateJob &job)
+   {
+      // This failure happened before whatever else may have since set a
+      // fatal error while it was being inflated.
+      if (!mHadFatalError) {
+         LiResetFatalError();
+      }
+
+      if (job.initError != Z_OK) {
+         switch (job.initError) {
+         case Z_STREAM_ERROR:
+            LiSetFatalError(0x18729Bu, mRpl->fileType, 1, "ZLIB_UncompressFromStream", 332);
+            return Error::ZlibStreamError;
+         case Z_MEM_ERROR:
+            LiSetFatalError(0x187298u, mRpl->fileType, 0, "ZLIB_UncompressFromStream", 319);
+            return Error::ZlibMemError;
+         case Z_VERSION_ERROR:
+            LiSetFatalError(0x18729Bu, mRpl->fileType, 1, "ZLIB_UncompressFromStream", 332);
+            return Error::ZlibVersionError;
+         default:
+            Loader_ReportError("***Unknown ZLIB error {} (0x{}).", job.initError, job.initError);
+            LiSetFatalError(0x18729Bu, mRpl->fileType, 1, "ZLIB_UncompressFromStream", 332);
+            return Error::ZlibUnknownError;
+         }
+      }
+
+      switch (job.inflateError) {
+      case Z_STREAM_ERROR:
+         LiSetFatalError(0x18729Bu, mRpl->fileType, 1, "ZLIB_UncompressFromStream", 405);
+         return -470086;
+      case Z_MEM_ERROR:
+         LiSetFatalError(0x187298u, mRpl->fileType, 0, "ZLIB_UncompressFromStream", 415);
+         return -470084;
+      case Z_DATA_ERROR:
+         LiSetFatalError(0x18729Bu, mRpl->fileType, 1, "ZLIB_UncompressFromStream", 419);
+         return -470087;
+      default:
+         Loader_ReportError("***Unknown ZLIB error {} (0x{}).", job.inflateError, job.inflateError);
+         LiSetFatalError(0x18729Bu, mRpl->fileType, 1, "ZLIB_UncompressFromStream", 424);
+         return -470100;
+      }
+   }
+
+private:
+   int32_t checkResult(const Pending &pending)
+   {
+      auto &job = *pending.job;
+
+      if (job.failed()) {
+         auto error = reportZlibError(job);
+         Loader_ReportError(
+            "***{} {} {} Decompression ({}->{}) failure.",
+            mRpl->moduleNameBuffer,
+            pending.boundsName,
+            pending.sectionIndex,
+            job.deflated.size(),
+            pending.expectedSize);
+         return error;
+      }
+
+      if (job.inflatedSize != pending.expectedSize) {
+         if (!mHadFatalError) {
+            LiResetFatalError();
+         }
+
+         Loader_ReportError(
+            "***{} {} {} Decompression ({}->{}) failure. Anticipated uncompressed size would be {}; got {}",
+            mRpl->moduleNameBuffer,
+            pending.boundsName,
+            pending.sectionIndex,
+            job.deflated.size(),
+            pending.expectedSize,
+            pending.expectedSize,
+            job.inflatedSize);
+         LiSetFatalError(0x18729Bu, mRpl->fileType, 1, "sLiSetupOneAllocSection", 1604);
+         return -470090;
+      }
+
+      return 0;
+   }
+
+private:
+   virt_ptr<LOADED_RPL> mRpl;
+   bool mHadFatalError;
+   std::vector<Pending> mPending;
+};
+
+/**
+ * Copy a deflated section out of the bounce buffers and queue it to be
+ * inflated to inflatedBuffer.
+ *
+ * Errors from inflating are reported later by PendingInflates::finish, only
+ * errors from reading the file are returned here.
+ */
+static int32_t
 ZLIB_UncompressFromStream(virt_ptr<LOADED_RPL> rpl,
-                          uint32_t sectionIndex,
+                          int32_t sectionIndex,
                           std::string_view boundsName,
                           uint32_t fileOffset,
                           uint32_t deflatedSize,
                           virt_ptr<void> inflatedBuffer,
-                          uint32_t *inflatedSize)
+                          uint32_t inflatedSize,
+                          PendingInflates &inflates)
 {
-   auto inflatedBytesMax = *inflatedSize;
    auto deflatedBytesRemaining = deflatedSize;
    auto bounceBuffer = virt_ptr<void> { nullptr };
    auto bounceBufferSize = uint32_t { 0 };
@@ -216,69 +392,18 @@ ZLIB_UncompressFromStream(virt_ptr<LOADED_RPL> rpl,
       return error;
    }
 
-   auto stream = z_stream { };
-   std::memset(&stream, 0, sizeof(stream));
-
-   auto zlibError = inflateInit(&stream);
-   if (zlibError != Z_OK) {
-      switch (zlibError) {
-      case Z_STREAM_ERROR:
-         LiSetFatalError(0x18729Bu, rpl->fileType, 1, "ZLIB_UncompressFromStream", 332);
-         return Error::ZlibStreamError;
-      case Z_MEM_ERROR:
-         LiSetFatalError(0x187298u, rpl->fileType, 0, "ZLIB_UncompressFromStream", 319);
-         return Error::ZlibMemError;
-      case Z_VERSION_ERROR:
-         LiSetFatalError(0x18729Bu, rpl->fileType, 1, "ZLIB_UncompressFromStream", 332);
-         return Error::ZlibVersionError;
-      default:
-         Loader_ReportError("***Unknown ZLIB error {} (0x{}).", zlibError, zlibError);
-         LiSetFatalError(0x18729Bu, rpl->fileType, 1, "ZLIB_UncompressFromStream", 332);
-         return Error::ZlibUnknownError;
-      }
-   }
-
-   constexpr auto InflateChunkSize = 0x3000u;
-   rpl->lastSectionCrc = 0u;
-
-   stream.next_out = reinterpret_cast<Bytef *>(inflatedBuffer.get());
+   auto job = std::make_shared<InflateJob>();
+   job->dst = reinterpret_cast<uint8_t *>(inflatedBuffer.get());
+   job->dstSize = inflatedSize;
+   job->cachePath = decaf::config::system::loader_cache_path;
+   job->cacheMaxSize = uint64_t { decaf::config::system::loader_cache_max_mb } * 1024 * 1024;
+   job->deflated.reserve(deflatedSize);
 
    while (true) {
       // TODO: Loader_UpdateHeartBeat();
       LiCheckAndHandleInterrupts();
-      stream.avail_in = bounceBufferSize;
-      stream.next_in = reinterpret_cast<Bytef *>(bounceBuffer.get());
-
-      while (stream.avail_in) {
-         LiCheckAndHandleInterrupts();
-         stream.avail_out = std::min<uInt>(InflateChunkSize, inflatedBytesMax - stream.total_out);
-
-         zlibError = inflate(&stream, 0);
-         if (zlibError != Z_OK && zlibError != Z_STREAM_END) {
-            switch (zlibError) {
-            case Z_STREAM_ERROR:
-               LiSetFatalError(0x18729Bu, rpl->fileType, 1, "ZLIB_UncompressFromStream", 405);
-               return -470086;
-            case Z_MEM_ERROR:
-               LiSetFatalError(0x187298u, rpl->fileType, 0, "ZLIB_UncompressFromStream", 415);
-               error = -470084;
-               break;
-            case Z_DATA_ERROR:
-               LiSetFatalError(0x18729Bu, rpl->fileType, 1, "ZLIB_UncompressFromStream", 419);
-               error = -470087;
-               break;
-            default:
-               Loader_ReportError("***Unknown ZLIB error {} (0x{}).", zlibError, zlibError);
-               LiSetFatalError(0x18729Bu, rpl->fileType, 1, "ZLIB_UncompressFromStream", 424);
-               error = -470100;
-            }
-
-            inflateEnd(&stream);
-            return error;
-         }
-
-         decaf_check(stream.total_out <= inflatedBytesMax);
-      }
+      auto data = reinterpret_cast<uint8_t *>(bounceBuffer.get());
+      job->deflated.insert(job->deflated.end(), data, data + bounceBufferSize);
 
       deflatedBytesRemaining -= bounceBufferSize;
       if (!deflatedBytesRemaining) {
@@ -287,15 +412,24 @@ ZLIB_UncompressFromStream(virt_ptr<LOADED_RPL> rpl,
 
       error = sLiRefillBounceBufferForReading(rpl, &bounceBufferSize, deflatedBytesRemaining, &bounceBuffer);
       if (error) {
+         // Sections before this one, and then the data read so far, would
+         // have failed to inflate before the read did.
+         error = inflates.finish();
+         if (error) {
+            return error;
+         }
+
+         inflateSection(*job);
+         if (job->failed()) {
+            return inflates.reportZlibError(*job);
+         }
+
          LiSetFatalError(0x18729Bu, rpl->fileType, 1, "ZLIB_UncompressFromStream", 520);
-         inflateEnd(&stream);
-         *inflatedSize = stream.total_out;
          return -470087;
       }
    }
 
-   inflateEnd(&stream);
-   *inflatedSize = stream.total_out;
+   inflates.add(std::move(job), sectionIndex, boundsName, inflatedSize);
    return 0;
 }
 
@@ -308,7 +442,8 @@ LiSetupOneAllocSection(kernel::UniqueProcessId upid,
                        SegmentBounds *bounds,
                        virt_ptr<void> base,
                        uint32_t baseAlign,
-                       uint32_t unk_a9)
+                       uint32_t unk_a9,
+                       PendingInflates &inflates)
 {
    auto globals = getGlobalStorage();
    LiCheckAndHandleInterrupts();
@@ -375,14 +510,14 @@ LiSetupOneAllocSection(kernel::UniqueProcessId upid,
             *reinterpret_cast<be2_val<uint32_t> *>(
                inflatedExpectedSizeBuffer.data());
          if (inflatedExpectedSize) {
-            auto inflatedBytes = static_cast<uint32_t>(inflatedExpectedSize);
             error = ZLIB_UncompressFromStream(rpl,
                                               sectionIndex,
                                               bounds->name,
                                               sectionHeader->offset + 4,
                                               sectionHeader->size - 4,
                                               virt_cast<void *>(sectionAddress),
-                                              &inflatedBytes);
+                                              inflatedExpectedSize,
+                                              inflates);
             if (error) {
                Loader_ReportError(
                   "***{} {} {} Decompression ({}->{}) failure.",
@@ -394,21 +529,9 @@ LiSetupOneAllocSection(kernel::UniqueProcessId upid,
                return error;
             }
 
-            if (inflatedBytes != inflatedExpectedSize) {
-               Loader_ReportError(
-                  "***{} {} {} Decompression ({}->{}) failure. Anticipated uncompressed size would be {}; got {}",
-                  rpl->moduleNameBuffer,
-                  bounds->name,
-                  sectionIndex,
-                  sectionHeader->size - 4,
-                  inflatedExpectedSize,
-                  inflatedExpectedSize,
-                  inflatedBytes);
-               LiSetFatalError(0x18729Bu, rpl->fileType, 1, "sLiSetupOneAllocSection", 1604);
-               return -470090;
-            }
-
-            sectionHeader->size = inflatedBytes;
+            // The size is checked against what was inflated once it is
+            // finished, if it differs the load fails.
+            sectionHeader->size = inflatedExpectedSize;
          }
       } else {
          auto bytesRead = 0u;
@@ -459,6 +582,7 @@ LiSetupOneRPL(kernel::UniqueProcessId upid,
               virt_ptr<TinyHeap> dataHeapTracking)
 {
    int32_t result = 0;
+   PendingInflates inflates { rpl };
 
    // Calculate segment bounds
    RplSegmentBounds bounds;
@@ -557,7 +681,8 @@ LiSetupOneRPL(kernel::UniqueProcessId upid,
                                             &bounds.data,
                                             rpl->dataBuffer,
                                             fileInfo->dataAlign,
-                                            0);
+                                            0,
+                                            inflates);
             if (result) {
                goto error;
             }
@@ -584,12 +709,19 @@ LiSetupOneRPL(kernel::UniqueProcessId upid,
                                                &bounds.load,
                                                rpl->loadBuffer,
                                                fileInfo->loadAlign,
-                                               (sectionHeader->type == rpl::SHT_RPL_IMPORTS) ? 1 : 0);
+                                               (sectionHeader->type == rpl::SHT_RPL_IMPORTS) ? 1 : 0,
+                                               inflates);
                if (result) {
                   goto error;
                }
 
                if (sectionHeader->type == rpl::SHT_RPL_EXPORTS) {
+                  // The export counts are read straight away
+                  result = inflates.finish();
+                  if (result) {
+                     goto error;
+                  }
+
                   if (sectionHeader->flags & rpl::SHF_EXECINSTR) {
                      rpl->numFuncExports = *virt_cast<uint32_t *>(rpl->sectionAddressBuffer[i]);
                      rpl->funcExports = virt_cast<void *>(rpl->sectionAddressBuffer[i] + 8);
@@ -628,7 +760,8 @@ LiSetupOneRPL(kernel::UniqueProcessId upid,
                                             &bounds.text,
                                             virt_cast<void *>(virt_cast<virt_addr>(rpl->textBuffer) + fileInfo->trampAdjust),
                                             fileInfo->textAlign,
-                                            0);
+                                            0,
+                                            inflates);
             if (result) {
                goto error;
             }
@@ -716,6 +849,11 @@ LiSetupOneRPL(kernel::UniqueProcessId upid,
       }
    }
 
+   result = inflates.finish();
+   if (result) {
+      goto error;
+   }
+
    for (auto i = 0u; i < 4; ++i) {
       if (bounds[i].allocMax > bounds[i].max) {
          Loader_ReportError(
@@ -753,6 +891,8 @@ LiSetupOneRPL(kernel::UniqueProcessId upid,
    return 0;
 
 error:
+   result = inflates.finish(result);
+
    if (rpl->compressedRelocationsBuffer) {
       LiCacheLineCorrectFreeEx(codeHeapTracking,
                                  rpl->compressedRelocationsBuffer,
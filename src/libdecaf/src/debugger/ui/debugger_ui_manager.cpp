@@ -15,6 +15,7 @@
 #include "debugger_ui_window_voices.h"
 #include "debugger_ui_window_performance.h"
 
+#include "cafe/libraries/cafe_hle.h"
 #include "cafe/loader/cafe_loader_entry.h"
 #include "cafe/loader/cafe_loader_loaded_rpl.h"
 #include "cafe/libraries/coreinit/coreinit_thread.h"
@@ -390,7 +391,7 @@ void Manager::drawMenu()
       ImGui::Separator();
 
       if (ImGui::MenuItem("Kernel Trace Enabled", nullptr, decaf::config::log::kernel_trace, true)) {
-         decaf::config::log::kernel_trace = !decaf::config::log::kernel_trace;
+         cafe::hle::setKernelTraceEnabled(!decaf::config::log::kernel_trace);
       }
 
       auto pm4Enable = false;
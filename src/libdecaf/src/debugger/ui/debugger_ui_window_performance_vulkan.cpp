@@ -42,6 +42,18 @@ void PerformanceWindowVulkan::drawBackendInfo()
    drawTextAndValue("Pipelines:", mInfo->numPipelines);
    drawTextAndValue("Samplers:", mInfo->numSamplers);
    drawTextAndValue("Surfaces:", mInfo->numSurfaces);
+
+   ImGui::Columns(1);
+   ImGui::Separator();
+   ImGui::Columns(2);
+
+   drawTextAndValue("Pipelines Pending:", mInfo->numPipelinesPending);
+   drawTextAndValue("Pipelines Failed:", mInfo->numPipelinesFailed);
+
+   ImGui::NextColumn();
+
+   drawTextAndValue("Draws Skipped:", mInfo->numDrawsSkipped);
+   drawTextAndValue("Draws w/ Fallback:", mInfo->numDrawsFallback);
 }
 
 } // namespace ui
@@ -74,6 +74,19 @@ StatsWindow::draw()
    ImGui::NextColumn();
    ImGui::Text("%.2f MB", stats.usedDataCacheSize / 1.0e6);
    ImGui::NextColumn();
+
+   ImGui::Text("Persistent Cache Hit / Miss / Reject");
+   ImGui::NextColumn();
+   ImGui::Text("%" PRIu64 " / %" PRIu64 " / %" PRIu64,
+               stats.persistentCacheHits,
+               stats.persistentCacheMisses,
+               stats.persistentCacheRejects);
+   ImGui::NextColumn();
+
+   ImGui::Text("Tier Up Compiles");
+   ImGui::NextColumn();
+   ImGui::Text("%" PRIu64, stats.tierUpCompiles);
+   ImGui::NextColumn();
    ImGui::Columns(1);
 
    if (sampled) {
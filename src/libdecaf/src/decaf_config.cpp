@@ -55,6 +55,8 @@ namespace sound
 {
 
 bool dump_sounds = false;
+bool verify_mix = false;
+unsigned int mix_threads = 0;
 
 } // namespace sound
 
@@ -69,6 +71,11 @@ std::string hfio_path = "";
 std::string content_path = {};
 std::string resources_path = "resources";
 double time_scale = 1.0;
+unsigned int io_threads = 4;
+unsigned int fs_readahead_kb = 2048;
+unsigned int loader_threads = 4;
+std::string loader_cache_path = {};
+unsigned int loader_cache_max_mb = 1024;
 std::vector<std::string> lle_modules;
 bool dump_hle_rpl = false;
 
@@ -11,7 +11,11 @@
 #include "filesystem_virtual_folder.h"
 
 #include <common/log.h>
+#include <cstdint>
 #include <memory>
+#include <mutex>
+#include <string>
+#include <unordered_map>
 
 namespace fs
 {
@@ -47,7 +51,9 @@ public:
       }
 
       auto folder = reinterpret_cast<Folder *>(parent);
-      return folder->remove(path.filename());
+      auto result = folder->remove(path.filename());
+      invalidatePathCache();
+      return result;
    }
 
    Result<Error>
@@ -81,7 +87,9 @@ public:
       auto srcFolder = reinterpret_cast<HostFolder *>(srcParent);
       auto dstFolder = reinterpret_cast<HostFolder *>(dstParent);
 
-      return HostFolder::move(srcFolder, src.filename(), dstFolder, dst.filename());
+      auto moveResult = HostFolder::move(srcFolder, src.filename(), dstFolder, dst.filename());
+      invalidatePathCache();
+      return moveResult;
    }
 
    Result<Node *>
@@ -131,6 +139,7 @@ public:
 
       if (dstNode) {
          dstNode = folder->addChild(dstNode);
+         invalidatePathCache();
       }
 
       return dstNode;
@@ -156,7 +165,9 @@ public:
       gLog->debug("Mount {} to {}", src.path(), dst.path());
       auto folder = reinterpret_cast<VirtualFolder *>(parent);
       auto name = dst.filename();
-      return folder->addChild(new HostFolder { src, name, permissions });
+      auto node = folder->addChild(new HostFolder { src, name, permissions });
+      invalidatePathCache();
+      return node;
    }
 
    Result<Node *>
@@ -177,7 +188,9 @@ public:
       }
 
       auto folder = reinterpret_cast<VirtualFolder *>(parent);
-      return folder->addChild(new HostFile { src, dst.filename(), permissions });
+      auto node = folder->addChild(new HostFile { src, dst.filename(), permissions });
+      invalidatePathCache();
+      return node;
    }
 
    Result<FileHandle>
@@ -191,7 +204,14 @@ public:
       }
 
       auto folder = reinterpret_cast<Folder *>(parent);
-      return folder->openFile(path.filename(), mode);
+      auto result = folder->openFile(path.filename(), mode);
+
+      // Opening for write may have created the file
+      if ((mode & File::Write) || (mode & File::Append)) {
+         invalidatePathCache();
+      }
+
+      return result;
    }
 
    Result<FolderHandle>
@@ -275,10 +295,23 @@ protected:
       return node;
    }
 
+   /**
+    * Find the node at path, following a link at the end of it.
+    *
+    * Every folder and every missing path found along the way is kept in
+    * mPathCache, so repeat lookups skip walking through the folders, which
+    * for host folders means a stat per path component. Files are not cached
+    * so that their size is refreshed from the host on each lookup.
+    *
+    * This is called from the guest core threads and the FSA threads at the
+    * same time, so the cache is only touched with mPathCacheMutex held.
+    */
    Node *
    findNode(const Path &path)
    {
       auto node = reinterpret_cast<Node *>(&mRoot);
+      auto key = std::string { };
+      auto generation = getPathCacheGeneration();
 
       for (auto dir : path) {
          if (!node || node->type() != Node::FolderNode) {
@@ -290,8 +323,19 @@ protected:
             continue;
          }
 
+         key += Path::PathSeparator;
+         key += dir;
+
+         if (findCachedPath(key, node)) {
+            continue;
+         }
+
          auto folder = reinterpret_cast<Folder *>(node);
          node = folder->findChild(dir);
+
+         if (!node || node->type() == Node::FolderNode) {
+            cachePath(key, node, generation);
+         }
       }
 
       return followLink(node);
@@ -316,6 +360,10 @@ protected:
          auto folder = reinterpret_cast<Folder *>(node);
          auto result = folder->addFolder(dir);
 
+         if (result == Error::OK) {
+            invalidatePathCache();
+         }
+
          if (result != Error::OK && result != Error::AlreadyExists) {
             return { result.error() };
          }
@@ -326,8 +374,96 @@ protected:
       return node;
    }
 
+   uint64_t
+   getPathCacheGeneration()
+   {
+      std::lock_guard<std::mutex> lock { mPathCacheMutex };
+      return mPathCacheGeneration;
+   }
+
+   bool
+   findCachedPath(const std::string &key,
+                  Node *&node)
+   {
+      std::lock_guard<std::mutex> lock { mPathCacheMutex };
+
+      // Drop everything if any node has been freed since we last looked
+      if (mPathCacheDestroyedCount != Node::destroyedCount()) {
+         clearPathCache();
+         return false;
+      }
+
+      auto itr = mPathCache.find(key);
+
+      if (itr == mPathCache.end()) {
+         return false;
+      }
+
+      node = itr->second;
+      return true;
+   }
+
+   void
+   cachePath(const std::string &key,
+             Node *node,
+             uint64_t generation)
+   {
+      std::lock_guard<std::mutex> lock { mPathCacheMutex };
+
+      // The cache was invalidated while we were looking the path up on
+      // another thread, so what we found may already be wrong
+      if (generation != mPathCacheGeneration) {
+         return;
+      }
+
+      if (mPathCacheDestroyedCount != Node::destroyedCount()) {
+         clearPathCache();
+         return;
+      }
+
+      if (mPathCache.size() >= MaxPathCacheEntries) {
+         clearPathCache();
+      }
+
+      mPathCache.emplace(key, node);
+   }
+
+   /**
+    * Called after anything which may have created, deleted or moved a node,
+    * as cached paths and missing paths may no longer be right. A lookup on
+    * another thread which started before the change took the old generation,
+    * so cachePath will not add what it found.
+    */
+   void
+   invalidatePathCache()
+   {
+      std::lock_guard<std::mutex> lock { mPathCacheMutex };
+      clearPathCache();
+   }
+
+   void
+   clearPathCache()
+   {
+      mPathCache.clear();
+      mPathCacheDestroyedCount = Node::destroyedCount();
+      ++mPathCacheGeneration;
+   }
+
 private:
+   static constexpr auto MaxPathCacheEntries = size_t { 0x10000 };
+
    VirtualFolder mRoot;
+
+   std::mutex mPathCacheMutex;
+
+   //! Maps a normalised absolute path to its node, or nullptr if missing.
+   std::unordered_map<std::string, Node *> mPathCache;
+
+   //! Node::destroyedCount() when mPathCache was last known to be valid.
+   uint64_t mPathCacheDestroyedCount = Node::destroyedCount();
+
+   //! Incremented each time mPathCache is cleared.
+   uint64_t mPathCacheGeneration = 0;
 };
 
 } // namespace fs
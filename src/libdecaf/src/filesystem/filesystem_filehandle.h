@@ -44,6 +44,17 @@ public:
    write(const void *data,
          size_t size,
          size_t count) = 0;
+
+   /**
+    * Ask the host to start reading [position, position + size) in the
+    * background, returns false if this handle has no way to do that.
+    */
+   virtual bool
+   readAhead(size_t position,
+             size_t size)
+   {
+      return false;
+   }
 };
 
 using FileHandle = std::shared_ptr<IFileHandle>;
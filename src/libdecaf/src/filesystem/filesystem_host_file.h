@@ -1,10 +1,12 @@
 #pragma once
 #include "filesystem_file.h"
 #include "filesystem_host_filehandle.h"
+#include "filesystem_host_mapped_filehandle.h"
 #include "filesystem_host_path.h"
 
 #include <string>
 #include <memory>
+#include <mutex>
 
 namespace fs
 {
@@ -30,6 +32,14 @@ public:
          return nullptr;
       }
 
+      // Nothing can write to a file on a read only mount, so we can read
+      // it straight from a mapping shared with the other handles
+      if (mode == File::Read && !checkPermission(Permissions::Write) && mSize) {
+         if (auto mapping = getMapping()) {
+            return std::make_shared<HostMappedFileHandle>(std::move(mapping));
+         }
+      }
+
       auto handle = new HostFileHandle { mPath.path(), mode };
 
       if (!handle->open()) {
@@ -40,8 +50,27 @@ public:
       return FileHandle { handle };
    }
 
+private:
+   std::shared_ptr<HostFileMapping>
+   getMapping()
+   {
+      std::unique_lock<std::mutex> lock { mMappingMutex };
+      auto mapping = mMapping.lock();
+
+      if (!mapping) {
+         mapping = HostFileMapping::open(mPath.path());
+         mMapping = mapping;
+      }
+
+      return mapping;
+   }
+
 private:
    HostPath mPath;
+
+   //! Mapping used by the open HostMappedFileHandles, if there are any.
+   std::mutex mMappingMutex;
+   std::weak_ptr<HostFileMapping> mMapping;
 };
 
 } // namespace fs
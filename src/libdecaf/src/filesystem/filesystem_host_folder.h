@@ -5,6 +5,8 @@
 #include "filesystem_host_path.h"
 #include "filesystem_virtual_folder.h"
 
+#include <mutex>
+
 namespace fs
 {
 
@@ -69,6 +71,7 @@ public:
    setPermissions(Permissions permissions,
                   PermissionFlags flags) override
    {
+      std::lock_guard<std::mutex> lock { mVirtualMutex };
       mPermissions = permissions;
       mVirtual.setPermissions(permissions, flags);
    }
@@ -131,7 +134,7 @@ public:
       }
 
       // Unregister the child from srcFolder as it no longer exists once moved
-      srcFolder->mVirtual.deleteChild(srcChild);
+      srcFolder->unregisterChild(srcChild);
       return Error::OK;
    }
 
@@ -140,6 +143,7 @@ private:
    registerFile(const HostPath &path,
                 const std::string &name)
    {
+      std::lock_guard<std::mutex> lock { mVirtualMutex };
       auto child = mVirtual.findChild(name);
 
       if (child && child->type() != NodeType::FileNode) {
@@ -159,6 +163,7 @@ private:
    registerFolder(const HostPath &path,
                   const std::string &name)
    {
+      std::lock_guard<std::mutex> lock { mVirtualMutex };
       auto child = mVirtual.findChild(name);
 
       if (child && child->type() != NodeType::FolderNode) {
@@ -174,12 +179,42 @@ private:
       return child;
    }
 
+   void
+   unregisterChild(Node *child)
+   {
+      std::lock_guard<std::mutex> lock { mVirtualMutex };
+      mVirtual.deleteChild(child);
+   }
+
+   /**
+    * Unregister the child for a host path which was not found. A thread can
+    * create it between our lookup and taking the lock, so this checks again.
+    */
+   void
+   unregisterMissingChild(const HostPath &path,
+                          const std::string &name)
+   {
+      std::lock_guard<std::mutex> lock { mVirtualMutex };
+      auto child = mVirtual.findChild(name);
+
+      if (child && !hostExists(path)) {
+         mVirtual.deleteChild(child);
+      }
+   }
+
+   static bool
+   hostExists(const HostPath &path);
+
    static Result<Error>
    hostMove(const HostPath &src,
             const HostPath &dst);
 
 private:
    HostPath mPath;
+
+   //! Guards mVirtual, which findChild fills in from the guest core threads
+   //! and the FSA threads at the same time.
+   std::mutex mVirtualMutex;
    VirtualFolder mVirtual;
 };
 
@@ -0,0 +1,174 @@
+#include "filesystem_host_mapped_filehandle.h"
+
+#include <algorithm>
+#include <common/decaf_assert.h>
+#include <cstring>
+
+namespace fs
+{
+
+//! Reads at least this large ask the host to start reading in the whole
+//! range up front, rather than faulting it in a page at a time.
+static constexpr auto PrefetchReadSize = size_t { 64 * 1024 };
+
+HostFileMapping::~HostFileMapping()
+{
+   if (view) {
+      platform::unmapViewOfFile(const_cast<uint8_t *>(view), size);
+   }
+
+   if (handle != platform::InvalidMapFileHandle) {
+      platform::closeMemoryMappedFile(handle);
+   }
+}
+
+
+std::shared_ptr<HostFileMapping>
+HostFileMapping::open(const std::string &path)
+{
+   auto mapping = std::make_shared<HostFileMapping>();
+   mapping->handle = platform::openMemoryMappedFile(path,
+                                                    platform::ProtectFlags::ReadOnly,
+                                                    &mapping->size);
+   if (mapping->handle == platform::InvalidMapFileHandle || !mapping->size) {
+      return nullptr;
+   }
+
+   mapping->view = reinterpret_cast<const uint8_t *>(
+      platform::mapViewOfFile(mapping->handle,
+                              platform::ProtectFlags::ReadOnly,
+                              0, mapping->size));
+   if (!mapping->view) {
+      return nullptr;
+   }
+
+   return mapping;
+}
+
+
+HostMappedFileHandle::HostMappedFileHandle(std::shared_ptr<HostFileMapping> mapping) :
+   mMapping(std::move(mapping))
+{
+}
+
+
+bool
+HostMappedFileHandle::open()
+{
+   return !!mMapping;
+}
+
+
+void
+HostMappedFileHandle::close()
+{
+   mMapping = nullptr;
+}
+
+
+bool
+HostMappedFileHandle::eof()
+{
+   decaf_check(mMapping);
+   return mEof;
+}
+
+
+bool
+HostMappedFileHandle::flush()
+{
+   // Same result as HostFileHandle gives for a read only file
+   decaf_check(mMapping);
+   return false;
+}
+
+
+bool
+HostMappedFileHandle::seek(size_t position)
+{
+   decaf_check(mMapping);
+   mPosition = position;
+   mEof = false;
+   return true;
+}
+
+
+size_t
+HostMappedFileHandle::size()
+{
+   decaf_check(mMapping);
+   return mMapping->size;
+}
+
+
+size_t
+HostMappedFileHandle::tell()
+{
+   decaf_check(mMapping);
+   return mPosition;
+}
+
+
+size_t
+HostMappedFileHandle::truncate()
+{
+   // A guest can ask for this on any handle, fail like a failed ftruncate
+   decaf_check(mMapping);
+   return 0;
+}
+
+
+size_t
+HostMappedFileHandle::read(void *data,
+                           size_t size,
+                           size_t count)
+{
+   decaf_check(mMapping);
+
+   if (!size || !count) {
+      return 0;
+   }
+
+   auto available = mPosition < mMapping->size ? mMapping->size - mPosition : 0;
+   auto bytes = std::min(size * count, available);
+
+   if (bytes < size * count) {
+      mEof = true;
+   }
+
+   if (bytes >= PrefetchReadSize) {
+      platform::prefetchViewOfFile(mMapping->view + mPosition, bytes);
+   }
+
+   std::memcpy(data, mMapping->view + mPosition, bytes);
+   mPosition += bytes;
+   return bytes / size;
+}
+
+
+size_t
+HostMappedFileHandle::write(const void *data,
+                            size_t size,
+                            size_t count)
+{
+   // A guest can ask for this on any handle, fail like a failed fwrite
+   decaf_check(mMapping);
+   return 0;
+}
+
+
+bool
+HostMappedFileHandle::readAhead(size_t position,
+                                size_t size)
+{
+   decaf_check(mMapping);
+
+   if (position < mMapping->size) {
+      size = std::min(size, mMapping->size - position);
+      platform::prefetchViewOfFile(mMapping->view + position, size);
+   }
+
+   return true;
+}
+
+} // namespace fs
@@ -0,0 +1,94 @@
+#pragma once
+#include "filesystem_file.h"
+#include "filesystem_filehandle.h"
+
+#include <common/platform_memory.h>
+#include <cstdint>
+#include <memory>
+#include <string>
+
+namespace fs
+{
+
+/**
+ * A read only view of a whole host file.
+ *
+ * One mapping is shared by every handle open on the same file, so they all
+ * read from the same page cache pages.
+ */
+struct HostFileMapping
+{
+   ~HostFileMapping();
+
+   static std::shared_ptr<HostFileMapping>
+   open(const std::string &path);
+
+   platform::MapFileHandle handle = platform::InvalidMapFileHandle;
+   const uint8_t *view = nullptr;
+   size_t size = 0;
+};
+
+/**
+ * A file handle which reads straight out of a HostFileMapping, rather than
+ * going through the stdio buffer first like HostFileHandle.
+ *
+ * This is only used for files opened read only on a read only mount, such
+ * as title content, so it never has to handle writes or the file changing
+ * size.
+ */
+struct HostMappedFileHandle : public IFileHandle
+{
+   HostMappedFileHandle(std::shared_ptr<HostFileMapping> mapping);
+
+   virtual ~HostMappedFileHandle() override
+   {
+      close();
+   }
+
+   virtual bool
+   open() override;
+
+   virtual void
+   close() override;
+
+   virtual bool
+   eof() override;
+
+   virtual bool
+   flush() override;
+
+   virtual bool
+   seek(size_t position) override;
+
+   virtual size_t
+   size() override;
+
+   virtual size_t
+   tell() override;
+
+   virtual size_t
+   truncate() override;
+
+   virtual size_t
+   read(void *data,
+        size_t size,
+        size_t count) override;
+
+   virtual size_t
+   write(const void *data,
+         size_t size,
+         size_t count) override;
+
+   virtual bool
+   readAhead(size_t position,
+             size_t size) override;
+
+private:
+   std::shared_ptr<HostFileMapping> mMapping;
+   size_t mPosition = 0;
+
+   //! Set like the stdio end of file flag, by a read which hit the end.
+   bool mEof = false;
+};
+
+} // namespace fs
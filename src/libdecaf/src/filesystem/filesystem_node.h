@@ -1,4 +1,6 @@
 #pragma once
+#include <atomic>
+#include <cstdint>
 #include <string>
 #include "filesystem_permissions.h"
 
@@ -34,7 +36,10 @@ public:
    {
    }
 
-   virtual ~Node() = default;
+   virtual ~Node()
+   {
+      sDestroyedCount.fetch_add(1, std::memory_order_relaxed);
+   }
 
    NodeType
    type() const
@@ -73,6 +78,18 @@ public:
       mPermissions = permissions;
    }
 
+   /**
+    * Number of nodes destroyed so far.
+    *
+    * Anything which holds on to Node pointers can check this to know when
+    * one of them may have been freed.
+    */
+   static uint64_t
+   destroyedCount()
+   {
+      return sDestroyedCount.load(std::memory_order_relaxed);
+   }
+
 protected:
    bool
    checkPermission(Permissions requested) const
@@ -86,6 +103,9 @@ protected:
    size_t mSize = 0;
    Permissions mPermissions = Permissions::None;
    std::string mName;
+
+private:
+   static inline std::atomic<uint64_t> sDestroyedCount { 0 };
 };
 
 } // namespace fs
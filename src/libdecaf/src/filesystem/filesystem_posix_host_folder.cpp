@@ -2,6 +2,7 @@
 #include <common/platform.h>
 
 #ifdef PLATFORM_POSIX
+#include <cstdio>
 #include <sys/types.h>
 #include <sys/stat.h>
 
@@ -49,11 +50,11 @@ HostFolder::remove(const std::string &name)
       return Error::InvalidPermission;
    }
 
-   if (remove(hostPath.path().c_str())) {
+   if (::remove(hostPath.path().c_str())) {
       return Error::GenericError;
    }
 
-   mVirtual.deleteChild(child);
+   unregisterChild(child);
    return Error::OK;
 }
 
@@ -65,11 +66,9 @@ HostFolder::findChild(const std::string &name)
    auto hostPath = mPath.join(name);
 
    if (stat(hostPath.path().c_str(), &data)) {
-      // File was not found
-      if (auto child = mVirtual.findChild(name)) {
-         // Delete the virtual child because file does not exist anymore
-         mVirtual.deleteChild(child);
-      }
+      // File was not found, delete the virtual child as it does not exist
+      // anymore
+      unregisterMissingChild(hostPath, name);
 
       return nullptr;
    }
@@ -88,6 +87,14 @@ HostFolder::findChild(const std::string &name)
 }
 
 
+bool
+HostFolder::hostExists(const HostPath &path)
+{
+   struct stat data;
+   return stat(path.path().c_str(), &data) == 0;
+}
+
+
 Result<Error>
 HostFolder::hostMove(const HostPath &src,
                      const HostPath &dst)
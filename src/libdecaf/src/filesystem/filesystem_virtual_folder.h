@@ -3,6 +3,8 @@
 #include "filesystem_node.h"
 #include "filesystem_virtual_folderhandle.h"
 #include <algorithm>
+#include <string>
+#include <unordered_map>
 #include <vector>
 
 namespace fs
@@ -28,6 +30,9 @@ public:
    addChild(Node *node)
    {
       mChildren.push_back(node);
+
+      // If there is already a child with this name it stays the one found
+      mChildIndex.emplace(node->name(), node);
       return node;
    }
 
@@ -41,6 +46,7 @@ public:
       }
 
       mChildren.erase(itr, mChildren.end());
+      unindexChild(node);
       delete node;
       return true;
    }
@@ -84,6 +90,7 @@ public:
       }
 
       mChildren.erase(std::remove(mChildren.begin(), mChildren.end(), node), mChildren.end());
+      unindexChild(node);
       delete node;
       return Error::OK;
    }
@@ -91,13 +98,13 @@ public:
    virtual Node *
    findChild(const std::string &name) override
    {
-      for (auto node : mChildren) {
-         if (node->name().compare(name) == 0) {
-            return node;
-         }
+      auto itr = mChildIndex.find(name);
+
+      if (itr == mChildIndex.end()) {
+         return nullptr;
       }
 
-      return nullptr;
+      return itr->second;
    }
 
    virtual Result<FolderHandle>
@@ -131,7 +138,33 @@ public:
    }
 
 private:
+   // Remove node from mChildIndex, after it has been removed from mChildren.
+   void
+   unindexChild(Node *node)
+   {
+      auto itr = mChildIndex.find(node->name());
+
+      if (itr == mChildIndex.end() || itr->second != node) {
+         return;
+      }
+
+      mChildIndex.erase(itr);
+
+      // Fall back to the next child with the same name, if any
+      for (auto child : mChildren) {
+         if (child->name() == node->name()) {
+            mChildIndex.emplace(child->name(), child);
+            break;
+         }
+      }
+   }
+
+private:
+   //! Children in the order they were added, used when listing the folder.
    std::vector<Node *> mChildren;
+
+   //! First child with each name, used by findChild.
+   std::unordered_map<std::string, Node *> mChildIndex;
 };
 
 } // namespace fs
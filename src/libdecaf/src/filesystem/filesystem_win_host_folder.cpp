@@ -61,7 +61,7 @@ HostFolder::remove(const std::string &name)
    }
 
    if (removed) {
-      mVirtual.deleteChild(child);
+      unregisterChild(child);
    }
 
    return removed ? Error::OK : Error::GenericError;
@@ -79,11 +79,9 @@ HostFolder::findChild(const std::string &name)
    auto handle = FindFirstFileW(winPath.c_str(), &data);
 
    if (handle == INVALID_HANDLE_VALUE) {
-      // File was not found
-      if (auto child = mVirtual.findChild(name)) {
-         // Delete the virtual child because file does not exist anymore
-         mVirtual.deleteChild(child);
-      }
+      // File was not found, delete the virtual child as it does not exist
+      // anymore
+      unregisterMissingChild(hostPath, name);
 
       return nullptr;
    }
@@ -106,6 +104,14 @@ HostFolder::findChild(const std::string &name)
 }
 
 
+bool
+HostFolder::hostExists(const HostPath &path)
+{
+   auto winPath = platform::toWinApiString(path.path());
+   return GetFileAttributesW(winPath.c_str()) != INVALID_FILE_ATTRIBUTES;
+}
+
+
 Result<Error>
 HostFolder::hostMove(const HostPath &src,
                      const HostPath &dst)
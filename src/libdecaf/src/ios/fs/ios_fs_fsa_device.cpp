@@ -1,7 +1,13 @@
 #include "ios_fs_fsa_device.h"
+#include "decaf_config.h"
 #include "ios/ios.h"
 
+#include <algorithm>
+#include <common/log.h>
 #include <common/strutils.h>
+#include <cstring>
+#include <libcpu/mmu.h>
+#include <map>
 
 namespace ios::fs::internal
 {
@@ -14,8 +20,44 @@ using FileHandle = ::fs::FileHandle;
 using FolderEntry = ::fs::FolderEntry;
 using FolderHandle = ::fs::FolderHandle;
 
+//! Number of reads in a row which must follow on from each other before we
+//! start reading ahead of a file.
+constexpr auto ReadAheadMinSequentialReads = 2u;
+
+//! Version of each path which is open with readahead, shared by all of the
+//! FSA devices as any of them may write to a file another one is reading.
+static std::mutex sFileVersionsMutex;
+static std::map<std::string, std::weak_ptr<std::atomic<uint64_t>>> sFileVersions;
+
+static std::shared_ptr<std::atomic<uint64_t>>
+getFileVersion(const std::string &path)
+{
+   auto lock = std::unique_lock { sFileVersionsMutex };
+   auto &entry = sFileVersions[path];
+   auto version = entry.lock();
+
+   if (!version) {
+      version = std::make_shared<std::atomic<uint64_t>>(0);
+      entry = version;
+   }
+
+   return version;
+}
+
+static void
+releaseFileVersion(const std::string &path)
+{
+   auto lock = std::unique_lock { sFileVersionsMutex };
+   auto itr = sFileVersions.find(path);
+
+   if (itr != sFileVersions.end() && itr->second.expired()) {
+      sFileVersions.erase(itr);
+   }
+}
+
 FSADevice::FSADevice() :
-   mFS(ios::getFileSystem())
+   mFS(ios::getFileSystem()),
+   mReadAheadSize(decaf::config::system::fs_readahead_kb * size_t { 1024 })
 {
 }
 
@@ -102,20 +144,23 @@ FSADevice::translateStat(const FolderEntry &entry,
 
 
 int32_t
-FSADevice::mapHandle(FileHandle file)
+FSADevice::mapHandle(FileHandle file,
+                     std::shared_ptr<ReadAhead> readAhead)
 {
+   auto lock = std::unique_lock { mHandlesMutex };
    auto index = 0;
 
    for (index = 0; index < mHandles.size(); ++index) {
       if (mHandles[index].type == Handle::Unused) {
          mHandles[index].type = Handle::File;
          mHandles[index].file = file;
+         mHandles[index].readAhead = readAhead;
          break;
       }
    }
 
    if (index == mHandles.size()) {
-      mHandles.push_back({ Handle::File, file, nullptr });
+      mHandles.push_back({ Handle::File, file, nullptr, readAhead });
    }
 
    return index + 1;
@@ -125,6 +170,7 @@ FSADevice::mapHandle(FileHandle file)
 int32_t
 FSADevice::mapHandle(FolderHandle folder)
 {
+   auto lock = std::unique_lock { mHandlesMutex };
    auto index = 0;
 
    for (index = 0; index < mHandles.size(); ++index) {
@@ -147,6 +193,18 @@ FSAStatus
 FSADevice::mapHandle(int32_t index,
                      FileHandle &file)
 {
+   auto readAhead = std::shared_ptr<ReadAhead> { };
+   return mapHandle(index, file, readAhead);
+}
+
+
+FSAStatus
+FSADevice::mapHandle(int32_t index,
+                     FileHandle &file,
+                     std::shared_ptr<ReadAhead> &readAhead)
+{
+   auto lock = std::unique_lock { mHandlesMutex };
+
    if (index <= 0 || index > mHandles.size()) {
       return FSAStatus::InvalidFileHandle;
    }
@@ -158,6 +216,7 @@ FSADevice::mapHandle(int32_t index,
    }
 
    file = handle.file;
+   readAhead = handle.readAhead;
    return FSAStatus::OK;
 }
 
@@ -166,6 +225,8 @@ FSAStatus
 FSADevice::mapHandle(int32_t index,
                      FolderHandle &folder)
 {
+   auto lock = std::unique_lock { mHandlesMutex };
+
    if (index <= 0 || index > mHandles.size()) {
       return FSAStatus::InvalidDirHandle;
    }
@@ -185,6 +246,8 @@ FSAStatus
 FSADevice::removeHandle(int32_t index,
                         Handle::Type type)
 {
+   auto lock = std::unique_lock { mHandlesMutex };
+
    if (index <= 0 || index > mHandles.size()) {
       if (type == Handle::File) {
          return FSAStatus::InvalidFileHandle;
@@ -206,10 +269,68 @@ FSADevice::removeHandle(int32_t index,
    handle.type = Handle::Unused;
    handle.file = nullptr;
    handle.folder = nullptr;
+   handle.readAhead = nullptr;
    return FSAStatus::OK;
 }
 
 
+/**
+ * Read from a file, using whatever part of the request is already in its
+ * readahead buffer.
+ */
+size_t
+FSADevice::readBuffered(const FileHandle &file,
+                        ReadAhead &readAhead,
+                        uint8_t *data,
+                        size_t size,
+                        size_t count)
+{
+   auto position = file->tell();
+   auto bytes = size * count;
+   auto copied = size_t { 0 };
+
+   if (!bytes) {
+      return 0;
+   }
+
+   if (position == readAhead.nextReadPos) {
+      readAhead.sequentialReads++;
+   } else {
+      readAhead.sequentialReads = 0;
+   }
+
+   // The file has been written to since the buffer was filled
+   if (readAhead.bufferVersion != readAhead.version->load()) {
+      readAhead.bufferSize = 0;
+   }
+
+   if (position >= readAhead.bufferStart &&
+       position < readAhead.bufferStart + readAhead.bufferSize) {
+      copied = std::min(bytes, readAhead.bufferStart + readAhead.bufferSize - position);
+      std::memcpy(data,
+                  readAhead.buffer.data() + (position - readAhead.bufferStart),
+                  copied);
+      file->seek(position + copied);
+   }
+
+   auto bytesRead = copied;
+
+   if (copied < bytes) {
+      bytesRead += file->read(data + copied, 1, bytes - copied);
+   } else {
+      readAhead.bufferedReads++;
+   }
+
+   readAhead.reads++;
+   readAhead.bytesRead += bytesRead;
+   readAhead.bufferedBytes += copied;
+   readAhead.nextReadPos = position + bytesRead;
+
+   // Like fread, only whole elements count as read
+   return (bytesRead / size) * size;
+}
+
+
 FSAStatus
 FSADevice::changeDir(phys_ptr<FSARequestChangeDir> request)
 {
@@ -237,14 +358,30 @@ FSAStatus
 FSADevice::closeFile(phys_ptr<FSARequestCloseFile> request)
 {
    auto file = FileHandle {};
-   auto error = mapHandle(request->handle, file);
+   auto readAhead = std::shared_ptr<ReadAhead> { };
+   auto error = mapHandle(request->handle, file, readAhead);
 
    if (error < 0) {
       return error;
    }
 
+   if (readAhead && !readAhead->buffer.empty()) {
+      gLog->debug("FSA readahead of {}: {} of {} reads and {} of {} bytes came from the buffer",
+                  readAhead->path,
+                  readAhead->bufferedReads, readAhead->reads,
+                  readAhead->bufferedBytes, readAhead->bytesRead);
+   }
+
    file->close();
-   return removeHandle(request->handle, Handle::File);
+   error = removeHandle(request->handle, Handle::File);
+
+   if (readAhead) {
+      auto path = std::move(readAhead->path);
+      readAhead = nullptr;
+      releaseFileVersion(path);
+   }
+
+   return error;
 }
 
 
@@ -410,12 +547,26 @@ FSADevice::openFile(phys_ptr<FSARequestOpenFile> request,
    auto path = translatePath(phys_addrof(request->path));
    auto mode = translateMode(phys_addrof(request->mode));
    auto result = mFS->openFile(path, mode);
+   auto readAhead = std::shared_ptr<ReadAhead> { };
 
    if (!result) {
       return translateError(result);
    }
 
-   response->handle = mapHandle(result);
+   // Every handle gets a version, so that writing through one of them drops
+   // the readahead of the others which are open on the same file
+   if (mReadAheadSize) {
+      readAhead = std::make_shared<ReadAhead>();
+      readAhead->path = path.path();
+      readAhead->version = getFileVersion(readAhead->path);
+
+      // Opening with w truncates the file
+      if (mode & File::Write) {
+         readAhead->version->fetch_add(1);
+      }
+   }
+
+   response->handle = mapHandle(result, readAhead);
    return FSAStatus::OK;
 }
 
@@ -451,7 +602,9 @@ FSADevice::readFile(phys_ptr<FSARequestReadFile> request,
                     uint32_t bufferLen)
 {
    auto file = FileHandle {};
-   auto error = mapHandle(request->handle, file);
+   auto readAhead = std::shared_ptr<ReadAhead> { };
+   auto error = mapHandle(request->handle, file, readAhead);
+   auto bytesRead = size_t { 0 };
 
    if (error < 0) {
       return error;
@@ -461,8 +614,18 @@ FSADevice::readFile(phys_ptr<FSARequestReadFile> request,
       file->seek(request->pos);
    }
 
-   auto elemsRead = file->read(buffer.get(), request->size, request->count);
-   auto bytesRead = elemsRead * request->size;
+   // The host file read can not fault on write tracked pages
+   cpu::beginHostWrite(phys_cast<phys_addr>(buffer), bufferLen);
+
+   if (readAhead) {
+      bytesRead = readBuffered(file, *readAhead, buffer.get(),
+                               request->size, request->count);
+   } else {
+      auto elemsRead = file->read(buffer.get(), request->size, request->count);
+      bytesRead = elemsRead * request->size;
+   }
+
+   cpu::endHostWrite(phys_cast<phys_addr>(buffer), bufferLen);
    return static_cast<FSAStatus>(bytesRead);
 }
 
@@ -548,13 +711,19 @@ FSAStatus
 FSADevice::truncateFile(phys_ptr<FSARequestTruncateFile> request)
 {
    auto file = FileHandle {};
-   auto error = mapHandle(request->handle, file);
+   auto readAhead = std::shared_ptr<ReadAhead> { };
+   auto error = mapHandle(request->handle, file, readAhead);
 
    if (error < 0) {
       return error;
    }
 
    file->truncate();
+
+   if (readAhead) {
+      readAhead->version->fetch_add(1);
+   }
+
    return FSAStatus::OK;
 }
 
@@ -574,7 +743,8 @@ FSADevice::writeFile(phys_ptr<FSARequestWriteFile> request,
                      uint32_t bufferLen)
 {
    auto file = FileHandle {};
-   auto error = mapHandle(request->handle, file);
+   auto readAhead = std::shared_ptr<ReadAhead> { };
+   auto error = mapHandle(request->handle, file, readAhead);
 
    if (error < 0) {
       return error;
@@ -586,7 +756,78 @@ FSADevice::writeFile(phys_ptr<FSARequestWriteFile> request,
 
    auto elemsWritten = file->write(buffer.get(), request->size, request->count);
    auto bytesWritten = elemsWritten * request->size;
+
+   // Only bump the version once the data is in the file, a readahead which
+   // started before then is dropped and one which starts after sees it
+   if (readAhead) {
+      readAhead->version->fetch_add(1);
+   }
+
    return static_cast<FSAStatus>(bytesWritten);
 }
 
+
+/**
+ * Called by the worker after each read has been replied to, so the next
+ * part of a file which is being read sequentially is ready by the time the
+ * title asks for it.
+ */
+void
+FSADevice::readAheadFile(int32_t handle)
+{
+   auto file = FileHandle {};
+   auto readAhead = std::shared_ptr<ReadAhead> { };
+
+   if (mapHandle(handle, file, readAhead) < 0 || !readAhead) {
+      return;
+   }
+
+   // Do not read ahead after hitting the end, seeking back would clear eof
+   auto position = file->tell();
+
+   if (readAhead->sequentialReads < ReadAheadMinSequentialReads ||
+       position != readAhead->nextReadPos || file->eof()) {
+      return;
+   }
+
+   if (file->readAhead(position, mReadAheadSize)) {
+      return;
+   }
+
+   // Read the version first, so a write which lands while we fill the buffer
+   // leaves it out of date rather than silently stale
+   auto version = readAhead->version->load();
+
+   if (readAhead->bufferVersion != version) {
+      readAhead->bufferSize = 0;
+   }
+
+   // Wait until half of the buffer has been used before filling it up again
+   auto bufferEnd = readAhead->bufferStart + readAhead->bufferSize;
+   auto buffered = size_t { 0 };
+
+   if (position >= readAhead->bufferStart && position < bufferEnd) {
+      buffered = bufferEnd - position;
+   }
+
+   if (buffered >= mReadAheadSize / 2) {
+      return;
+   }
+
+   readAhead->buffer.resize(mReadAheadSize);
+
+   if (buffered) {
+      std::memmove(readAhead->buffer.data(),
+                   readAhead->buffer.data() + (position - readAhead->bufferStart),
+                   buffered);
+   }
+
+   file->seek(position + buffered);
+   readAhead->bufferStart = position;
+   readAhead->bufferSize = buffered +
+      file->read(readAhead->buffer.data() + buffered, 1, mReadAheadSize - buffered);
+   readAhead->bufferVersion = version;
+   file->seek(position);
+}
+
 } // namespace ios::fs::internal
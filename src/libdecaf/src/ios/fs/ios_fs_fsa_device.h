@@ -8,6 +8,12 @@
 
 #include <common/structsize.h>
 #include <libcpu/be2_struct.h>
+#include <atomic>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
 
 namespace ios::fs::internal
 {
@@ -26,6 +32,42 @@ class FSADevice
    using FolderEntry = ::fs::FolderEntry;
    using FolderHandle = ::fs::FolderHandle;
 
+   /**
+    * Readahead state of an open file.
+    *
+    * Once the title reads a file sequentially, the worker reads ahead of it
+    * into buffer after each request, so following requests can be copied
+    * straight from memory. It is only used by requests on its own handle,
+    * which never run concurrently.
+    *
+    * Every handle open on the same path shares one version, which writes and
+    * truncates through any of them bump. A buffer filled at an older version
+    * is dropped before it is used.
+    */
+   struct ReadAhead
+   {
+      std::string path;
+      std::shared_ptr<std::atomic<uint64_t>> version;
+
+      //! File data starting at offset bufferStart, bufferSize bytes of it
+      //! are valid as long as version still matches bufferVersion.
+      std::vector<uint8_t> buffer;
+      size_t bufferStart = 0;
+      size_t bufferSize = 0;
+      uint64_t bufferVersion = 0;
+
+      //! File offset just after the last read.
+      size_t nextReadPos = 0;
+
+      //! Number of reads in a row which started where the last one ended.
+      unsigned sequentialReads = 0;
+
+      uint64_t reads = 0;
+      uint64_t bufferedReads = 0;
+      uint64_t bytesRead = 0;
+      uint64_t bufferedBytes = 0;
+   };
+
    struct Handle
    {
       enum Type
@@ -38,6 +80,7 @@ class FSADevice
       Type type;
       FileHandle file;
       FolderHandle folder;
+      std::shared_ptr<ReadAhead> readAhead;
    };
 
 public:
@@ -68,6 +111,8 @@ public:
    FSAStatus unmount(phys_ptr<FSARequestUnmount> request);
    FSAStatus writeFile(phys_ptr<FSARequestWriteFile> request, phys_ptr<const uint8_t> buffer, uint32_t bufferLen);
 
+   void readAheadFile(int32_t handle);
+
 private:
    FSAStatus
    translateError(FSError error) const;
@@ -83,7 +128,8 @@ private:
                  phys_ptr<FSAStat> stat) const;
 
    int32_t
-   mapHandle(FileHandle file);
+   mapHandle(FileHandle file,
+             std::shared_ptr<ReadAhead> readAhead);
 
    int32_t
    mapHandle(FolderHandle folder);
@@ -92,6 +138,11 @@ private:
    mapHandle(int32_t handle,
              FileHandle &file);
 
+   FSAStatus
+   mapHandle(int32_t handle,
+             FileHandle &file,
+             std::shared_ptr<ReadAhead> &readAhead);
+
    FSAStatus
    mapHandle(int32_t handle,
              FolderHandle &folder);
@@ -100,9 +151,21 @@ private:
    removeHandle(int32_t index,
                 Handle::Type type);
 
+   size_t
+   readBuffered(const FileHandle &file,
+                ReadAhead &readAhead,
+                uint8_t *data,
+                size_t size,
+                size_t count);
+
 private:
    FileSystem *mFS = nullptr;
    Path mWorkingPath = "/";
+   size_t mReadAheadSize = 0;
+
+   //! Requests on different open files run concurrently, so mHandles is
+   //! only accessed with mHandlesMutex held.
+   std::mutex mHandlesMutex;
    std::vector<Handle> mHandles;
 };
 
@@ -16,6 +16,7 @@
 
 using namespace ios::kernel;
 using ios::internal::submitWorkerTask;
+using ios::internal::WorkerTaskKey;
 
 namespace ios::fs::internal
 {
@@ -57,6 +58,24 @@ getDevice(FSADeviceHandle handle,
    return FSAStatus::OK;
 }
 
+/**
+ * Worker queue for requests on an open file.
+ *
+ * These only touch the file handle itself, so each open file gets its own
+ * queue and a long read on one file does not hold up requests on another,
+ * while requests on the same file still run in order. Everything else may
+ * walk the filesystem tree, which is not thread safe, so it all goes through
+ * the serial worker queue.
+ */
+static WorkerTaskKey
+getFileTaskKey(phys_ptr<ResourceRequest> resourceRequest,
+               int32_t fileHandle)
+{
+   auto deviceHandle = static_cast<uint32_t>(resourceRequest->requestData.handle);
+   return ((static_cast<WorkerTaskKey>(deviceHandle) + 1) << 32) |
+          static_cast<uint32_t>(fileHandle);
+}
+
 static FSAStatus
 fsaDeviceOpen(phys_ptr<RequestOrigin> origin,
               FSADeviceHandle *outHandle,
@@ -137,14 +156,18 @@ fsaDeviceIoctl(phys_ptr<ResourceRequest> resourceRequest,
          });
       break;
    case FSACommand::CloseFile:
-      submitWorkerTask([=]() {
+      submitWorkerTask(
+         getFileTaskKey(resourceRequest, request->closeFile.handle),
+         [=]() {
             fsaAsyncTaskComplete(
                resourceRequest,
                device->closeFile(phys_addrof(request->closeFile)));
          });
       break;
    case FSACommand::FlushFile:
-      submitWorkerTask([=]() {
+      submitWorkerTask(
+         getFileTaskKey(resourceRequest, request->flushFile.handle),
+         [=]() {
             fsaAsyncTaskComplete(
                resourceRequest,
                device->flushFile(phys_addrof(request->flushFile)));
@@ -173,7 +196,9 @@ fsaDeviceIoctl(phys_ptr<ResourceRequest> resourceRequest,
          });
       break;
    case FSACommand::GetPosFile:
-      submitWorkerTask([=]() {
+      submitWorkerTask(
+         getFileTaskKey(resourceRequest, request->getPosFile.handle),
+         [=]() {
             fsaAsyncTaskComplete(
                resourceRequest,
                device->getPosFile(phys_addrof(request->getPosFile),
@@ -181,7 +206,9 @@ fsaDeviceIoctl(phys_ptr<ResourceRequest> resourceRequest,
          });
       break;
    case FSACommand::IsEof:
-      submitWorkerTask([=]() {
+      submitWorkerTask(
+         getFileTaskKey(resourceRequest, request->isEof.handle),
+         [=]() {
             fsaAsyncTaskComplete(
                resourceRequest,
                device->isEof(phys_addrof(request->isEof)));
@@ -247,14 +274,18 @@ fsaDeviceIoctl(phys_ptr<ResourceRequest> resourceRequest,
          });
       break;
    case FSACommand::SetPosFile:
-      submitWorkerTask([=]() {
+      submitWorkerTask(
+         getFileTaskKey(resourceRequest, request->setPosFile.handle),
+         [=]() {
             fsaAsyncTaskComplete(
                resourceRequest,
                device->setPosFile(phys_addrof(request->setPosFile)));
          });
       break;
    case FSACommand::StatFile:
-      submitWorkerTask([=]() {
+      submitWorkerTask(
+         getFileTaskKey(resourceRequest, request->statFile.handle),
+         [=]() {
             fsaAsyncTaskComplete(
                resourceRequest,
                device->statFile(phys_addrof(request->statFile),
@@ -262,7 +293,9 @@ fsaDeviceIoctl(phys_ptr<ResourceRequest> resourceRequest,
          });
       break;
    case FSACommand::TruncateFile:
-      submitWorkerTask([=]() {
+      submitWorkerTask(
+         getFileTaskKey(resourceRequest, request->truncateFile.handle),
+         [=]() {
             fsaAsyncTaskComplete(
                resourceRequest,
                device->truncateFile(phys_addrof(request->truncateFile)));
@@ -298,20 +331,27 @@ fsaDeviceIoctlv(phys_ptr<ResourceRequest> resourceRequest,
    case FSACommand::ReadFile:
    {
       submitWorkerTask(
+         getFileTaskKey(resourceRequest, request->readFile.handle),
          [=]() {
             auto buffer = phys_cast<uint8_t *>(vecs[1].paddr);
             auto length = vecs[1].len;
+            int32_t fileHandle = request->readFile.handle;
 
             fsaAsyncTaskComplete(
                resourceRequest,
                device->readFile(phys_addrof(request->readFile),
                                 buffer, length));
+
+            // The request belongs to the title again once it is completed,
+            // but the next request on this file waits for the readahead
+            device->readAheadFile(fileHandle);
          });
       break;
    }
    case FSACommand::WriteFile:
    {
       submitWorkerTask(
+         getFileTaskKey(resourceRequest, request->writeFile.handle),
          [=]()
          {
             auto buffer = phys_cast<uint8_t *>(vecs[1].paddr);
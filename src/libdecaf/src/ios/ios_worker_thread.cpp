@@ -1,19 +1,32 @@
 #include "ios_worker_thread.h"
+#include "decaf_config.h"
 
+#include <algorithm>
 #include <atomic>
 #include <condition_variable>
+#include <deque>
 #include <functional>
 #include <mutex>
 #include <queue>
 #include <thread>
+#include <unordered_map>
+#include <vector>
+
+/*
+ * The IOS worker threads run host work, such as file system requests, off
+ * the IOS threads.
+ *
+ * Each key has its own queue of tasks. A key is on sReadyKeys while it has
+ * queued tasks and none of its tasks are running, so a worker which takes a
+ * key from there owns it until that task is finished and there is never more
+ * than one task of a key running at once.
+ */
 
 namespace ios::internal
 {
 
-using WorkerTask = std::function<void()>;
-
-static std::thread
-sWorkerThread;
+static std::vector<std::thread>
+sWorkerThreads;
 
 static std::atomic<bool>
 sWorkerThreadRunning { false };
@@ -24,52 +37,97 @@ sWorkerThreadConditionVariable;
 static std::mutex
 sWorkerThreadMutex;
 
-static std::queue<WorkerTask>
+static std::unordered_map<WorkerTaskKey, std::queue<WorkerTask>>
 sWorkerThreadTasks;
 
+static std::deque<WorkerTaskKey>
+sReadyKeys;
+
 static void
 iosWorkerThread()
 {
-   while (sWorkerThreadRunning) {
-      auto lock = std::unique_lock { sWorkerThreadMutex };
+   auto lock = std::unique_lock { sWorkerThreadMutex };
 
-      if (sWorkerThreadTasks.empty()) {
+   while (sWorkerThreadRunning) {
+      if (sReadyKeys.empty()) {
          sWorkerThreadConditionVariable.wait(lock);
-         if (!sWorkerThreadRunning) {
-            break;
-         }
+         continue;
       }
 
-      auto task = std::move(sWorkerThreadTasks.front());
-      sWorkerThreadTasks.pop();
+      auto key = sReadyKeys.front();
+      sReadyKeys.pop_front();
+
+      // The task stays at the front of its queue until it has finished, so
+      // the key is not made ready again while it is running
+      auto task = std::move(sWorkerThreadTasks[key].front());
       lock.unlock();
 
       task();
+
+      lock.lock();
+      auto itr = sWorkerThreadTasks.find(key);
+      itr->second.pop();
+
+      if (itr->second.empty()) {
+         sWorkerThreadTasks.erase(itr);
+      } else {
+         // Go to the back so one busy key does not starve the others
+         sReadyKeys.push_back(key);
+         sWorkerThreadConditionVariable.notify_one();
+      }
    }
 }
 
 void
 startWorkerThread()
 {
+   auto numThreads = std::max(1u, decaf::config::system::io_threads);
    sWorkerThreadRunning = true;
-   sWorkerThread = std::thread { iosWorkerThread };
+
+   for (auto i = 0u; i < numThreads; ++i) {
+      sWorkerThreads.emplace_back(iosWorkerThread);
+   }
 }
 
 void
 joinWorkerThread()
 {
-   sWorkerThreadRunning = false;
-   sWorkerThreadConditionVariable.notify_all();
-   sWorkerThread.join();
-   sWorkerThreadTasks = {};
+   {
+      auto lock = std::unique_lock { sWorkerThreadMutex };
+      sWorkerThreadRunning = false;
+      sWorkerThreadConditionVariable.notify_all();
+   }
+
+   for (auto &thread : sWorkerThreads) {
+      thread.join();
+   }
+
+   sWorkerThreads.clear();
+   sWorkerThreadTasks.clear();
+   sReadyKeys.clear();
 }
 
 void
 submitWorkerTask(WorkerTask task)
+{
+   submitWorkerTask(SerialWorkerTaskKey, std::move(task));
+}
+
+void
+submitWorkerTask(WorkerTaskKey key,
+                 WorkerTask task)
 {
    auto lock = std::unique_lock { sWorkerThreadMutex };
-   sWorkerThreadTasks.push(std::move(task));
-   sWorkerThreadConditionVariable.notify_all();
+   auto &tasks = sWorkerThreadTasks[key];
+
+   // A key which already has tasks is either ready or running, in both cases
+   // this task will be picked up after them.
+   if (tasks.empty()) {
+      sReadyKeys.push_back(key);
+      sWorkerThreadConditionVariable.notify_one();
+   }
+
+   tasks.push(std::move(task));
 }
 
 } // namespace ios::internal
@@ -1,3 +1,4 @@
+#include <cstdint>
 #include <functional>
 
 namespace ios::internal
@@ -5,6 +6,15 @@ namespace ios::internal
 
 using WorkerTask = std::function<void()>;
 
+/**
+ * Tasks submitted with the same key run one at a time in the order they were
+ * submitted, tasks with different keys may run concurrently.
+ */
+using WorkerTaskKey = uint64_t;
+
+//! Key used by submitWorkerTask when none is given.
+constexpr auto SerialWorkerTaskKey = WorkerTaskKey { 0 };
+
 void
 startWorkerThread();
 
@@ -14,4 +24,8 @@ joinWorkerThread();
 void
 submitWorkerTask(WorkerTask task);
 
+void
+submitWorkerTask(WorkerTaskKey key,
+                 WorkerTask task);
+
 } // namespace ios::internal
@@ -127,6 +127,24 @@ untileMipMapsForSlice(const SurfaceInfo &surface,
                       int slice,
                       int sample = 0);
 
+void
+untileSlices(const SurfaceInfo &surface,
+             int pitch,
+             const void *src,
+             void *dst,
+             int dstPitch,
+             int firstSlice,
+             int lastSlice);
+
+void
+tileSlices(const SurfaceInfo &surface,
+           int pitch,
+           const void *src,
+           int srcPitch,
+           void *dst,
+           int firstSlice,
+           int lastSlice);
+
 void
 unpitchImage(const SurfaceInfo &surface,
              void *src,
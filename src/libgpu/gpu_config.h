@@ -1,5 +1,6 @@
 #pragma once
 #include <cstdint>
+#include <string>
 #include <vector>
 
 namespace gpu
@@ -20,6 +21,25 @@ extern bool dump_shaders;
 //! Debuggable shaders
 extern bool debuggable_shaders;
 
+//! Number of host threads which untile large surfaces
+extern unsigned tiling_threads;
+
+//! Directory to keep translated shaders in, so they are not translated again
+//! on every boot (empty = no cache)
+extern std::string shader_cache_path;
+
+//! Number of host threads which compile pipelines in the background
+//! (0 = compile on the GPU thread when first drawn with)
+extern unsigned pipeline_compile_threads;
+
+//! While a pipeline compiles in the background, draw with a ready pipeline
+//! which differs only in blend, depth or raster state (false = skip the draw)
+extern bool pipeline_fallback;
+
+//! Detect CPU writes to GPU memory by write protecting it, instead of hashing
+//! the memory every time it is used
+extern bool cpu_write_tracking;
+
 } // namespace config
 
 } // namespace gpu
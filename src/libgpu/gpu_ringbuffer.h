@@ -7,12 +7,31 @@ namespace gpu::ringbuffer
 
 using Buffer = gsl::span<uint32_t>;
 
+/**
+ * Copy PM4 packets into the ring buffer.
+ *
+ * Safe to call from several threads, concurrent writes are serialised so
+ * each buffer lands in the ring whole. A buffer larger than the ring is
+ * copied in runs of whole packets as the GPU thread releases space, otherwise
+ * this blocks if the ring is full until there is room for all of it.
+ */
 void
 write(const Buffer &buffer);
 
+/**
+ * Read the next contiguous run of packets from the ring buffer.
+ *
+ * The returned span points directly into the ring and is valid until the
+ * next call to read() or wait(), which release it back to the producer.
+ */
 Buffer
 read();
 
+/**
+ * Wait until there is data to read or wake() is called.
+ *
+ * Returns true if there is data to read.
+ */
 bool
 wait();
 
@@ -46,6 +46,7 @@ convertFromTiled(uint8_t *output,
                  uint32_t beginSlice = 0,
                  uint32_t endSlice = 0);
 
+// input holds only the slices in [beginSlice, endSlice), packed from its start
 bool
 convertToTiled(uint8_t *output,
                uint8_t *input,
@@ -62,4 +63,17 @@ convertToTiled(uint8_t *output,
                uint32_t beginSlice = 0,
                uint32_t endSlice = 0);
 
+void
+calculateTiledSliceRange(latte::SQ_TILE_MODE tileMode,
+                         uint32_t pitch,
+                         uint32_t height,
+                         uint32_t depth,
+                         uint32_t aa,
+                         bool isDepth,
+                         uint32_t bpp,
+                         uint32_t beginSlice,
+                         uint32_t endSlice,
+                         uint32_t &offset,
+                         uint32_t &size);
+
 } // namespace gpu
@@ -19,6 +19,15 @@ public:
       uint64_t numSamplers = 0;
       uint64_t numSurfaces = 0;
       uint64_t numDataBuffers = 0;
+
+      // Pipelines still compiling in the background, and pipelines which
+      // failed to compile since boot
+      uint64_t numPipelinesPending = 0;
+      uint64_t numPipelinesFailed = 0;
+
+      // Draws since the last flip whose pipeline was not compiled yet
+      uint64_t numDrawsSkipped = 0;
+      uint64_t numDrawsFallback = 0;
    };
 
    virtual ~VulkanDriver() = default;
@@ -65,9 +65,7 @@ public:
       std::memcpy(mBuffer + mCurSize, values.data(), dataSize * sizeof(uint32_t));
 
       // We do the byte_swap here separately as Type may not be uint32_t sized
-      for (auto i = 0u; i < dataSize; ++i) {
-         mBuffer[mCurSize + i] = byte_swap(mBuffer[mCurSize + i]);
-      }
+      byte_swap_to(mBuffer + mCurSize, mBuffer + mCurSize, dataSize);
 
       mCurSize += dataSize;
       return *this;
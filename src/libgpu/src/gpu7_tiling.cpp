@@ -1,16 +1,28 @@
 #include "gpu7_tiling.h"
+#include "gpu_config.h"
 
 #include <algorithm>
+#include <array>
+#include <condition_variable>
 #include <cstdint>
 #include <cstring>
 #include <common/align.h>
 #include <common/decaf_assert.h>
+#include <common/platform_thread.h>
+#include <fmt/format.h>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+#if defined(__x86_64__) || defined(_M_X64)
+#define GPU7_TILING_SSE2
+#include <emmintrin.h>
+#endif
 
 namespace gpu7::tiling
 {
 
-static bool LogMicroShit = false;
-
 static constexpr auto MicroTileWidth = 8;
 static constexpr auto MicroTileHeight = 8;
 static constexpr auto NumPipes = 2;
@@ -102,597 +114,889 @@ getMicroTileThickness(TileMode tileMode)
    return MicroTileThickness[static_cast<size_t>(tileMode)];
 }
 
-struct MicroTiler8
-{
-   /*
-      8 bits per element:
-       0:   0,  1,  2,  3,  4,  5,  6,  7,
-       8:  16, 17, 18, 19, 20, 21, 22, 23,
-      16:   8,  9, 10, 11, 12, 13, 14, 15,
-      24:  24, 25, 26, 27, 28, 29, 30, 31,
-
-      32:  32, 33, 34, 35, 36, 37, 38, 39,
-      40:  48, 49, 50, 51, 52, 53, 54, 55,
-      48:  40, 41, 42, 43, 44, 45, 46, 47,
-      56:  56, 57, 58, 59, 60, 61, 62, 63,
-   */
-
-   static inline void
-   apply(const SurfaceInfo &surface,
-         uint8_t *src,
-         int srcOffset,
-         int srcStrideBytes,
-         uint8_t *dst,
-         int dstOffset,
-         int dstStrideBytes)
-   {
-      static constexpr auto rowSize = MicroTileWidth * sizeof(uint8_t);
-      src += srcOffset;
-      dst += dstOffset;
+static constexpr auto MicroTileElements = MicroTileWidth * MicroTileHeight;
+
+// Tiling calls smaller than this are not split across threads
+static constexpr auto MinParallelBytes = 256 * 1024;
+
+// Pixel rows per parallel job, a multiple of every macro tile height
+static constexpr auto RowsPerJob = 64;
+
+static constexpr int BankSwapOrder[] = { 0, 1, 3, 2 };
+
+static constexpr int TileModeRotation[] = {
+   /* LinearGeneral = */   0,
+   /* LinearAligned = */   0,
+   /* Tiled1DThin1 = */    0,
+   /* Tiled1DThick = */    0,
+   /* Tiled2DThin1 = */    NumPipes * ((NumBanks >> 1) - 1),
+   /* Tiled2DThin2 = */    NumPipes * ((NumBanks >> 1) - 1),
+   /* Tiled2DThin4 = */    NumPipes * ((NumBanks >> 1) - 1),
+   /* Tiled2DThick = */    NumPipes * ((NumBanks >> 1) - 1),
+   /* Tiled2BThin1 = */    NumPipes * ((NumBanks >> 1) - 1),
+   /* Tiled2BThin2 = */    NumPipes * ((NumBanks >> 1) - 1),
+   /* Tiled2BThin4 = */    NumPipes * ((NumBanks >> 1) - 1),
+   /* Tiled2BThick = */    NumPipes * ((NumBanks >> 1) - 1),
+   /* Tiled3DThin1 = */    1,
+   /* Tiled3DThick = */    1,
+   /* Tiled3BThin1 = */    1,
+   /* Tiled3BThick = */    1,
+};
 
-      for (int y = 0; y < MicroTileHeight; y += 4) {
-         std::memcpy(dst, src + 0 * srcStrideBytes, rowSize);
-         dst += dstStrideBytes;
+static constexpr int
+getTileModeRotation(TileMode tileMode)
+{
+   return TileModeRotation[static_cast<size_t>(tileMode)];
+}
 
-         std::memcpy(dst, src + 2 * srcStrideBytes, rowSize);
-         dst += dstStrideBytes;
+static constexpr bool
+isMacroTiled(TileMode tileMode)
+{
+   return tileMode >= TileMode::Tiled2DThin1;
+}
 
-         std::memcpy(dst, src + 1 * srcStrideBytes, rowSize);
-         dst += dstStrideBytes;
+static constexpr bool
+isBankSwapped(TileMode tileMode)
+{
+   switch (tileMode) {
+   case TileMode::Tiled2BThin1:
+   case TileMode::Tiled2BThin2:
+   case TileMode::Tiled2BThin4:
+   case TileMode::Tiled2BThick:
+   case TileMode::Tiled3BThin1:
+   case TileMode::Tiled3BThick:
+      return true;
+   default:
+      return false;
+   }
+}
 
-         std::memcpy(dst, src + 3 * srcStrideBytes, rowSize);
-         dst += dstStrideBytes;
 
-         src += 4 * srcStrideBytes;
-      }
+/**
+ * Index of element x, y within a micro tile.
+ *
+ * Depth surfaces use non-displayable micro tiles, everything else uses
+ * displayable micro tiles, whose layout depends on the element size.
+ */
+static int
+getMicroTilePixelIndex(int bpp,
+                       bool isDepth,
+                       int x,
+                       int y)
+{
+   const auto x0 = (x >> 0) & 1, x1 = (x >> 1) & 1, x2 = (x >> 2) & 1;
+   const auto y0 = (y >> 0) & 1, y1 = (y >> 1) & 1, y2 = (y >> 2) & 1;
+   auto bits = std::array<int, 6> { };
+
+   if (isDepth) {
+      bits = { x0, y0, x1, y1, x2, y2 };
+   } else if (bpp == 8) {
+      bits = { x0, x1, x2, y1, y0, y2 };
+   } else if (bpp == 16) {
+      bits = { x0, x1, x2, y0, y1, y2 };
+   } else if (bpp == 64) {
+      bits = { x0, y0, x1, x2, y1, y2 };
+   } else if (bpp == 128) {
+      bits = { y0, x0, x1, x2, y1, y2 };
+   } else {
+      bits = { x0, x1, y0, x2, y1, y2 };
    }
-};
 
-struct MicroTiler16
-{
-   /*
-      16 bits per element:
-       0:   0,  1,  2,  3,  4,  5,  6,  7,
-       8:   8,  9, 10, 11, 12, 13, 14, 15,
-      16:  16, 17, 18, 19, 20, 21, 22, 23,
-      24:  24, 25, 26, 27, 28, 29, 30, 31,
-      32:  32, 33, 34, 35, 36, 37, 38, 39,
-      40:  40, 41, 42, 43, 44, 45, 46, 47,
-      48:  48, 49, 50, 51, 52, 53, 54, 55,
-      56:  56, 57, 58, 59, 60, 61, 62, 63,
-   */
-
-   static inline void
-   apply(const SurfaceInfo &surface,
-         uint8_t *src,
-         int srcOffset,
-         int srcStrideBytes,
-         uint8_t *dst,
-         int dstOffset,
-         int dstStrideBytes)
-   {
-      static constexpr auto rowSize = MicroTileWidth * sizeof(uint16_t);
-      src += srcOffset;
-      dst += dstOffset;
-
-      for (int y = 0; y < MicroTileHeight; ++y) {
-         std::memcpy(dst, src, rowSize);
-         src += srcStrideBytes;
-         dst += dstStrideBytes;
-      }
-   }
-};
+   auto index = 0;
 
-struct MicroTiler32
-{
-   /*
-      32 bits per element:
-       0:   0,  1,  2,  3,    8,  9, 10, 11,
-       8:   4,  5,  6,  7,   12, 13, 14, 15,
+   for (auto i = 0u; i < bits.size(); ++i) {
+      index |= bits[i] << i;
+   }
 
-      16:  16, 17, 18, 19,   24, 25, 26, 27,
-      24:  20, 21, 22, 23,   28, 29, 30, 31,
+   return index;
+}
 
-      32:  32, 33, 34, 35,   40, 41, 42, 43,
-      40:  36, 37, 38, 39,   44, 45, 46, 47,
 
-      48:  48, 49, 50, 51,   56, 57, 58, 59,
-      56:  52, 53, 54, 55,   60, 61, 62, 63,
-   */
+/**
+ * Where the elements of one slice of a micro tile go in an 8x8 block of the
+ * image, as runs of elements which are adjacent in both.
+ */
+struct MicroTileLayout
+{
+   //! Length of every run, at most 16 bytes.
+   int runBytes = 0;
+   int numRuns = 0;
 
-   static inline void
-   apply(const SurfaceInfo &surface,
-         uint8_t *src,
-         int srcOffset,
-         int srcStrideBytes,
-         uint8_t *dst,
-         int dstOffset,
-         int dstStrideBytes)
-   {
-      static constexpr auto groupSize = 4 * sizeof(uint32_t);
-      src += srcOffset;
-      dst += dstOffset;
+   //! Byte offset of each run in the micro tile.
+   std::array<uint16_t, MicroTileElements> tileOffset { };
 
-      for (int y = 0; y < MicroTileHeight; y += 2) {
-         auto dstRow1 = reinterpret_cast<uint32_t *>(dst);
-         auto dstRow2 = reinterpret_cast<uint32_t *>(dst + dstStrideBytes);
+   //! Byte offset of each run within its row of the block.
+   std::array<uint16_t, MicroTileElements> rowOffset { };
 
-         auto srcRow1 = reinterpret_cast<uint32_t *>(src);
-         auto srcRow2 = reinterpret_cast<uint32_t *>(src + srcStrideBytes);
+   //! Row of the block of each run.
+   std::array<uint8_t, MicroTileElements> row { };
+};
 
-         std::memcpy(dstRow1 + 0, srcRow1 + 0, groupSize);
-         std::memcpy(dstRow1 + 4, srcRow2 + 0, groupSize);
+static MicroTileLayout
+buildMicroTileLayout(int bpp,
+                     bool isDepth)
+{
+   const auto bytesPerElement = bpp / 8;
+   auto runElements = std::min(MicroTileWidth, std::max(1, 16 / bytesPerElement));
+
+   // Every layout is made of power of two runs which start at x % run == 0
+   for (auto y = 0; y < MicroTileHeight; ++y) {
+      for (auto x = 1; x < MicroTileWidth; ++x) {
+         if (getMicroTilePixelIndex(bpp, isDepth, x, y) !=
+             getMicroTilePixelIndex(bpp, isDepth, x - 1, y) + 1) {
+            while (x % runElements) {
+               runElements /= 2;
+            }
+         }
+      }
+   }
 
-         std::memcpy(dstRow2 + 0, srcRow1 + 4, groupSize);
-         std::memcpy(dstRow2 + 4, srcRow2 + 4, groupSize);
+   auto layout = MicroTileLayout { };
+   layout.runBytes = runElements * bytesPerElement;
 
-         src += srcStrideBytes * 2;
-         dst += dstStrideBytes * 2;
+   for (auto y = 0; y < MicroTileHeight; ++y) {
+      for (auto x = 0; x < MicroTileWidth; x += runElements) {
+         auto index = getMicroTilePixelIndex(bpp, isDepth, x, y);
+         layout.tileOffset[layout.numRuns] = static_cast<uint16_t>(index * bytesPerElement);
+         layout.rowOffset[layout.numRuns] = static_cast<uint16_t>(x * bytesPerElement);
+         layout.row[layout.numRuns] = static_cast<uint8_t>(y);
+         layout.numRuns++;
       }
    }
-};
 
-template<bool MacroTiling>
-struct MicroTiler64
+   return layout;
+}
+
+static int
+getLayoutIndex(int bpp,
+               bool isDepth)
 {
-   /*
-      64 bits per element:
-       0:   0,  1,    4,  5,    8,  9,   12, 13,
-       8:   2,  3,    6,  7,   10, 11,   14, 15,
+   switch (bpp) {
+   case 8:
+      return 0 + isDepth;
+   case 16:
+      return 2 + isDepth;
+   case 32:
+      return 4 + isDepth;
+   case 64:
+      return 6 + isDepth;
+   case 128:
+      return 8 + isDepth;
+   default:
+      decaf_abort("Unsupported tiled surface bpp");
+   }
+}
 
-      16:  16, 17,   20, 21,   24, 25,   28, 29,
-      24:  18, 19,   22, 23,   26, 27,   30, 31,
+static const MicroTileLayout &
+getMicroTileLayout(int bpp,
+                   bool isDepth)
+{
+   static const auto layouts = []() {
+      auto layouts = std::array<MicroTileLayout, 10> { };
 
-      32:  32, 33,   36, 37,   40, 41,   44, 45,
-      40:  34, 35,   38, 39,   42, 43,   46, 47,
+      for (auto bpp : { 8, 16, 32, 64, 128 }) {
+         layouts[getLayoutIndex(bpp, false)] = buildMicroTileLayout(bpp, false);
+         layouts[getLayoutIndex(bpp, true)] = buildMicroTileLayout(bpp, true);
+      }
 
-      48:  48, 49,   52, 53,   56, 57,   60, 61,
-      56:  50, 51,   54, 55,   58, 59,   62, 63,
-   */
+      return layouts;
+   }();
 
-   static inline void
-   apply(const SurfaceInfo &surface,
-         uint8_t *src,
-         int srcOffset,
-         int srcStrideBytes,
-         uint8_t *dst,
-         int dstOffset,
-         int dstStrideBytes)
-   {
-      static constexpr auto groupBytes = 2 * sizeof(uint64_t);
-      const auto nextGroupOffset =
-         srcOffset + (0x100 << (NumBankBits + NumPipeBits));
-
-      for (int y = 0; y < MicroTileHeight; y += 2) {
-         if (MacroTiling && y == 4) {
-            // At y == 4 we hit the next group (at element offset 256)
-            srcOffset = nextGroupOffset;
-         }
+   return layouts[getLayoutIndex(bpp, isDepth)];
+}
 
-         auto dstRow1 = reinterpret_cast<uint64_t *>(dst + dstOffset);
-         auto dstRow2 = reinterpret_cast<uint64_t *>(dst + dstOffset + dstStrideBytes);
+using UntileKernel = void (*)(const MicroTileLayout &layout,
+                              const uint8_t *tile,
+                              uint8_t *dst,
+                              int dstStride);
 
-         auto srcRow1 = reinterpret_cast<uint64_t *>(src + srcOffset);
-         auto srcRow2 = reinterpret_cast<uint64_t *>(src + srcOffset + srcStrideBytes);
+using TileKernel = void (*)(const MicroTileLayout &layout,
+                            const uint8_t *src,
+                            int srcStride,
+                            uint8_t *tile);
 
-         std::memcpy(dstRow1 + 0, srcRow1 + 0, groupBytes);
-         std::memcpy(dstRow2 + 0, srcRow1 + 2, groupBytes);
+template<int RunBytes>
+static void
+untileMicroTileRuns(const MicroTileLayout &layout,
+                    const uint8_t *tile,
+                    uint8_t *dst,
+                    int dstStride)
+{
+   for (auto i = 0; i < layout.numRuns; ++i) {
+      std::memcpy(dst + layout.row[i] * dstStride + layout.rowOffset[i],
+                  tile + layout.tileOffset[i],
+                  RunBytes);
+   }
+}
 
-         std::memcpy(dstRow1 + 2, srcRow1 + 4, groupBytes);
-         std::memcpy(dstRow2 + 2, srcRow1 + 6, groupBytes);
+template<int RunBytes>
+static void
+tileMicroTileRuns(const MicroTileLayout &layout,
+                  const uint8_t *src,
+                  int srcStride,
+                  uint8_t *tile)
+{
+   for (auto i = 0; i < layout.numRuns; ++i) {
+      std::memcpy(tile + layout.tileOffset[i],
+                  src + layout.row[i] * srcStride + layout.rowOffset[i],
+                  RunBytes);
+   }
+}
 
-         std::memcpy(dstRow1 + 4, srcRow2 + 0, groupBytes);
-         std::memcpy(dstRow2 + 4, srcRow2 + 2, groupBytes);
+#ifdef GPU7_TILING_SSE2
+/*
+ * Depth micro tiles are made of 2x2 quads, which leaves runs of only two
+ * elements. For 16 and 32 bit depth it is quicker to load two rows of quads
+ * at once and shuffle them into rows.
+ */
+static constexpr int
+getDepthQuadRowOffset(int y,
+                      int bytesPerElement)
+{
+   // Elements y1 y2 select a run of 8, x2 selects the second half of a row
+   return ((((y >> 1) & 1) << 3) | (((y >> 2) & 1) << 5)) * bytesPerElement;
+}
 
-         std::memcpy(dstRow1 + 6, srcRow2 + 4, groupBytes);
-         std::memcpy(dstRow2 + 6, srcRow2 + 6, groupBytes);
+static void
+untileMicroTileDepth16(const MicroTileLayout &,
+                       const uint8_t *tile,
+                       uint8_t *dst,
+                       int dstStride)
+{
+   for (auto y = 0; y < MicroTileHeight; y += 2) {
+      auto src = tile + getDepthQuadRowOffset(y, 2);
+      auto lo = _mm_loadu_si128(reinterpret_cast<const __m128i *>(src));
+      auto hi = _mm_loadu_si128(reinterpret_cast<const __m128i *>(src + 32));
+
+      // Each 32 bit lane holds two elements of one row, gather the rows
+      lo = _mm_shuffle_epi32(lo, _MM_SHUFFLE(3, 1, 2, 0));
+      hi = _mm_shuffle_epi32(hi, _MM_SHUFFLE(3, 1, 2, 0));
+
+      _mm_storeu_si128(reinterpret_cast<__m128i *>(dst + y * dstStride),
+                       _mm_unpacklo_epi64(lo, hi));
+      _mm_storeu_si128(reinterpret_cast<__m128i *>(dst + (y + 1) * dstStride),
+                       _mm_unpackhi_epi64(lo, hi));
+   }
+}
 
-         srcOffset += 2 * srcStrideBytes;
-         dstOffset += 2 * dstStrideBytes;
-      }
+static void
+tileMicroTileDepth16(const MicroTileLayout &,
+                     const uint8_t *src,
+                     int srcStride,
+                     uint8_t *tile)
+{
+   for (auto y = 0; y < MicroTileHeight; y += 2) {
+      auto row0 = _mm_loadu_si128(reinterpret_cast<const __m128i *>(src + y * srcStride));
+      auto row1 = _mm_loadu_si128(reinterpret_cast<const __m128i *>(src + (y + 1) * srcStride));
+
+      // The shuffle swaps the middle lanes, so it is its own inverse
+      auto lo = _mm_shuffle_epi32(_mm_unpacklo_epi64(row0, row1), _MM_SHUFFLE(3, 1, 2, 0));
+      auto hi = _mm_shuffle_epi32(_mm_unpackhi_epi64(row0, row1), _MM_SHUFFLE(3, 1, 2, 0));
+
+      auto dst = tile + getDepthQuadRowOffset(y, 2);
+      _mm_storeu_si128(reinterpret_cast<__m128i *>(dst), lo);
+      _mm_storeu_si128(reinterpret_cast<__m128i *>(dst + 32), hi);
    }
-};
+}
+
+static void
+untileMicroTileDepth32(const MicroTileLayout &,
+                       const uint8_t *tile,
+                       uint8_t *dst,
+                       int dstStride)
+{
+   for (auto y = 0; y < MicroTileHeight; y += 2) {
+      auto src = tile + getDepthQuadRowOffset(y, 4);
+      auto q0 = _mm_loadu_si128(reinterpret_cast<const __m128i *>(src + 0));
+      auto q1 = _mm_loadu_si128(reinterpret_cast<const __m128i *>(src + 16));
+      auto q2 = _mm_loadu_si128(reinterpret_cast<const __m128i *>(src + 64));
+      auto q3 = _mm_loadu_si128(reinterpret_cast<const __m128i *>(src + 80));
+
+      // Each quad holds two elements of both rows
+      auto row0 = dst + y * dstStride;
+      auto row1 = row0 + dstStride;
+      _mm_storeu_si128(reinterpret_cast<__m128i *>(row0 + 0), _mm_unpacklo_epi64(q0, q1));
+      _mm_storeu_si128(reinterpret_cast<__m128i *>(row0 + 16), _mm_unpacklo_epi64(q2, q3));
+      _mm_storeu_si128(reinterpret_cast<__m128i *>(row1 + 0), _mm_unpackhi_epi64(q0, q1));
+      _mm_storeu_si128(reinterpret_cast<__m128i *>(row1 + 16), _mm_unpackhi_epi64(q2, q3));
+   }
+}
+
+static void
+tileMicroTileDepth32(const MicroTileLayout &,
+                     const uint8_t *src,
+                     int srcStride,
+                     uint8_t *tile)
+{
+   for (auto y = 0; y < MicroTileHeight; y += 2) {
+      auto row0 = src + y * srcStride;
+      auto row1 = row0 + srcStride;
+      auto r00 = _mm_loadu_si128(reinterpret_cast<const __m128i *>(row0 + 0));
+      auto r01 = _mm_loadu_si128(reinterpret_cast<const __m128i *>(row0 + 16));
+      auto r10 = _mm_loadu_si128(reinterpret_cast<const __m128i *>(row1 + 0));
+      auto r11 = _mm_loadu_si128(reinterpret_cast<const __m128i *>(row1 + 16));
+
+      auto dst = tile + getDepthQuadRowOffset(y, 4);
+      _mm_storeu_si128(reinterpret_cast<__m128i *>(dst + 0), _mm_unpacklo_epi64(r00, r10));
+      _mm_storeu_si128(reinterpret_cast<__m128i *>(dst + 16), _mm_unpackhi_epi64(r00, r10));
+      _mm_storeu_si128(reinterpret_cast<__m128i *>(dst + 64), _mm_unpacklo_epi64(r01, r11));
+      _mm_storeu_si128(reinterpret_cast<__m128i *>(dst + 80), _mm_unpackhi_epi64(r01, r11));
+   }
+}
+#endif
+
+static UntileKernel
+getUntileKernel(int bpp,
+                bool isDepth)
+{
+#ifdef GPU7_TILING_SSE2
+   if (isDepth && bpp == 16) {
+      return &untileMicroTileDepth16;
+   } else if (isDepth && bpp == 32) {
+      return &untileMicroTileDepth32;
+   }
+#endif
+
+   switch (getMicroTileLayout(bpp, isDepth).runBytes) {
+   case 1:
+      return &untileMicroTileRuns<1>;
+   case 2:
+      return &untileMicroTileRuns<2>;
+   case 4:
+      return &untileMicroTileRuns<4>;
+   case 8:
+      return &untileMicroTileRuns<8>;
+   case 16:
+      return &untileMicroTileRuns<16>;
+   default:
+      decaf_abort("Unexpected micro tile run length");
+   }
+}
 
-template<bool MacroTiling>
-struct MicroTiler128
+static TileKernel
+getTileKernel(int bpp,
+              bool isDepth)
 {
-   /*
-      128 bits per element:
-         0:   0,  2,    4,  6,    8, 10,   12, 14,
-         8:   1,  3,    5,  7,    9, 11,   13, 15,
+#ifdef GPU7_TILING_SSE2
+   if (isDepth && bpp == 16) {
+      return &tileMicroTileDepth16;
+   } else if (isDepth && bpp == 32) {
+      return &tileMicroTileDepth32;
+   }
+#endif
+
+   switch (getMicroTileLayout(bpp, isDepth).runBytes) {
+   case 1:
+      return &tileMicroTileRuns<1>;
+   case 2:
+      return &tileMicroTileRuns<2>;
+   case 4:
+      return &tileMicroTileRuns<4>;
+   case 8:
+      return &tileMicroTileRuns<8>;
+   case 16:
+      return &tileMicroTileRuns<16>;
+   default:
+      decaf_abort("Unexpected micro tile run length");
+   }
+}
 
-        16:  16, 18,   20, 22,   24, 26,   28, 30,
-        24:  17, 19,   21, 23,   25, 27,   29, 31,
 
-        32:  32, 34,   36, 38,   40, 42,   44, 46,
-        40:  33, 35,   37, 39,   41, 43,   45, 47,
+/**
+ * Width in pixels after which the banks of a bank swapped tile mode rotate.
+ */
+static int
+calculateBankSwapWidth(const SurfaceInfo &surface,
+                       int pitch)
+{
+   const auto bpp = surface.bpp;
+   const auto bytesPerSample = 8 * bpp;
+   const auto samplesPerTile = SplitSize / bytesPerSample;
+   const auto numSamples = getMicroTileThickness(surface.tileMode) > 1 ? 4 : 1;
+   const auto slicesPerTile = samplesPerTile ? std::max(1, 1 / samplesPerTile) : 1;
+   const auto bytesPerTileSlice = numSamples * bytesPerSample / slicesPerTile;
+
+   const auto factor = getMacroTileHeight(surface.tileMode) / NumPipes;
+   const auto swapTiles = std::max(1, (SwapSize >> 1) / bpp);
+   const auto swapWidth = swapTiles * MicroTileWidth * NumBanks;
+   const auto heightBytes = factor * NumPipes * bpp / slicesPerTile;
+   const auto swapMax = NumPipes * NumBanks * RowSize / heightBytes;
+   const auto swapMin = PipeInterleaveBytes * MicroTileWidth * NumBanks / bytesPerTileSlice;
+
+   auto bankSwapWidth = std::min(swapMax, std::max(swapMin, swapWidth));
+
+   while (bankSwapWidth >= 2 * pitch) {
+      bankSwapWidth >>= 1;
+   }
+
+   return bankSwapWidth;
+}
 
-        48:  48, 50,   52, 54,   56, 58,   60, 62,
-        56:  49, 51,   53, 55,   57, 59,   61, 63,
-   */
 
-   static inline void
-   apply(const SurfaceInfo &surface,
-         uint8_t *src,
-         int srcOffset,
-         int srcStrideBytes,
-         uint8_t *dst,
-         int dstOffset,
-         int dstStrideBytes)
+/**
+ * The tiled layout of a single sampled surface, everything which is the same
+ * for all of its micro tiles.
+ */
+struct TiledSurface
+{
+   TiledSurface(const SurfaceInfo &surface,
+                int pitch) :
+      tileMode(surface.tileMode),
+      bytesPerElement(surface.bpp / 8),
+      thickness(getMicroTileThickness(surface.tileMode)),
+      pitch(pitch),
+      height(surface.height),
+      planeBytes(MicroTileElements * bytesPerElement),
+      layout(getMicroTileLayout(surface.bpp, surface.isDepth)),
+      untileKernel(getUntileKernel(surface.bpp, surface.isDepth)),
+      tileKernel(getTileKernel(surface.bpp, surface.isDepth))
    {
-      static constexpr auto elemBytes = 8;
-
-      for (int y = 0; y < MicroTileHeight; y += 2) {
-         auto dstRow1 = reinterpret_cast<uint8_t *>(dst + dstOffset);
-         auto dstRow2 = reinterpret_cast<uint8_t *>(dst + dstOffset + dstStrideBytes);
-
-         auto srcRow1 = reinterpret_cast<uint8_t *>(src + srcOffset);
-         auto srcRow2 = reinterpret_cast<uint8_t *>(src + srcOffset + srcStrideBytes);
-
-         std::memcpy(dstRow1 + 0 * elemBytes, srcRow1 + 0 * elemBytes, elemBytes);
-         std::memcpy(dstRow1 + 1 * elemBytes, srcRow1 + 2 * elemBytes, elemBytes);
-         std::memcpy(dstRow2 + 0 * elemBytes, srcRow1 + 1 * elemBytes, elemBytes);
-         std::memcpy(dstRow2 + 1 * elemBytes, srcRow1 + 3 * elemBytes, elemBytes);
-
-         std::memcpy(dstRow1 + 2 * elemBytes, srcRow1 + 4 * elemBytes, elemBytes);
-         std::memcpy(dstRow1 + 3 * elemBytes, srcRow1 + 6 * elemBytes, elemBytes);
-         std::memcpy(dstRow2 + 2 * elemBytes, srcRow1 + 5 * elemBytes, elemBytes);
-         std::memcpy(dstRow2 + 3 * elemBytes, srcRow1 + 7 * elemBytes, elemBytes);
-
-         std::memcpy(dstRow1 + 4 * elemBytes, srcRow2 + 0 * elemBytes, elemBytes);
-         std::memcpy(dstRow1 + 5 * elemBytes, srcRow2 + 2 * elemBytes, elemBytes);
-         std::memcpy(dstRow2 + 4 * elemBytes, srcRow2 + 1 * elemBytes, elemBytes);
-         std::memcpy(dstRow2 + 5 * elemBytes, srcRow2 + 3 * elemBytes, elemBytes);
-
-         std::memcpy(dstRow1 + 6 * elemBytes, srcRow2 + 4 * elemBytes, elemBytes);
-         std::memcpy(dstRow1 + 7 * elemBytes, srcRow2 + 6 * elemBytes, elemBytes);
-         std::memcpy(dstRow2 + 6 * elemBytes, srcRow2 + 5 * elemBytes, elemBytes);
-         std::memcpy(dstRow2 + 7 * elemBytes, srcRow2 + 7 * elemBytes, elemBytes);
-
-         if (MacroTiling) {
-            srcOffset += 0x100 << (NumBankBits + NumPipeBits);
-         } else {
-            srcOffset += 2 * srcStrideBytes;
+      decaf_check(surface.numSamples == 1);
+      sliceBytes = static_cast<uint64_t>(pitch) * surface.height * thickness * bytesPerElement;
+
+      if (isMacroTiled(tileMode)) {
+         macroTilePitch = getMacroTileWidth(tileMode) * MicroTileWidth;
+         macroTileHeight = getMacroTileHeight(tileMode) * MicroTileHeight;
+         macroTilesPerRow = pitch / macroTilePitch;
+         macroTileBytes = static_cast<uint64_t>(macroTilePitch) * macroTileHeight
+                        * thickness * bytesPerElement;
+         swizzle = surface.pipeSwizzle + NumPipes * surface.bankSwizzle;
+         rotation = getTileModeRotation(tileMode);
+
+         if (isBankSwapped(tileMode)) {
+            bankSwapWidth = calculateBankSwapWidth(surface, pitch);
          }
-
-         dstOffset += 2 * dstStrideBytes;
       }
    }
+
+   TileMode tileMode;
+   int bytesPerElement;
+   int thickness;
+   int pitch;
+   int height;
+   int planeBytes;
+   uint64_t sliceBytes;
+
+   int macroTilePitch = 0;
+   int macroTileHeight = 0;
+   int macroTilesPerRow = 0;
+   uint64_t macroTileBytes = 0;
+   int swizzle = 0;
+   int rotation = 0;
+   int bankSwapWidth = 0;
+
+   const MicroTileLayout &layout;
+   UntileKernel untileKernel;
+   TileKernel tileKernel;
 };
 
-struct MicroTilerDepth
-{
-   /*
-      depth elements:
-          0:   0,  1,  4,  5,   16, 17, 20, 21,
-          8:   2,  3,  6,  7,   18, 19, 22, 23,
-         16:   8,  9, 12, 13,   24, 25, 28, 29,
-         24:  10, 11, 14, 15,   26, 27, 30, 31,
-
-         32:  32, 33, 36, 37,   48, 49, 52, 53,
-         40:  34, 35, 38, 39,   50, 51, 54, 55,
-         48:  40, 41, 44, 45,   56, 57, 60, 61,
-         56:  42, 43, 46, 47,   58, 59, 62, 63,
-   */
-
-   static inline void
-   apply(const SurfaceInfo &surface,
-         uint8_t *src,
-         int srcOffset,
-         int srcStrideBytes,
-         uint8_t *dst,
-         int dstOffset,
-         int dstStrideBytes)
+
+/**
+ * Where the elements of one slice of a micro tile are in tiled memory.
+ *
+ * The slice of a micro tile is contiguous in memory unless it crosses a pipe
+ * interleave boundary of a macro tiled surface.
+ */
+struct MicroTilePlane
+{
+   //! Offset of the slice, without the bank and pipe bits of macro tiling.
+   uint64_t offset = 0;
+   uint64_t bankPipeBits = 0;
+   bool macroTiled = false;
+   bool contiguous = true;
+
+   uint64_t
+   getAddress(int planeOffset) const
    {
-      decaf_abort("MicroTilerDepth not implemented");
+      const auto address = offset + planeOffset;
+
+      if (!macroTiled) {
+         return address;
+      }
+
+      return ((address & ~static_cast<uint64_t>(GroupMask)) << (NumBankBits + NumPipeBits))
+         | bankPipeBits | (address & GroupMask);
    }
 };
 
-template<typename MicroTiler>
+static MicroTilePlane
+getMicroTilePlane(const TiledSurface &tiled,
+                  int x,
+                  int y,
+                  int slice)
+{
+   const auto planeOffset = (slice % tiled.thickness) * tiled.planeBytes;
+   const auto sliceOffset = tiled.sliceBytes * (slice / tiled.thickness);
+   auto plane = MicroTilePlane { };
+
+   if (!isMacroTiled(tiled.tileMode)) {
+      const auto microTilesPerRow = tiled.pitch / MicroTileWidth;
+      const auto microTileIndex = (x / MicroTileWidth) + (y / MicroTileHeight) * microTilesPerRow;
+      plane.offset = sliceOffset
+         + static_cast<uint64_t>(microTileIndex) * tiled.planeBytes * tiled.thickness
+         + planeOffset;
+      return plane;
+   }
+
+   auto pipe = ((x >> 3) ^ (y >> 3)) & 1;
+   auto bank = (((y >> 5) ^ (x >> 3)) & 1) | ((((y >> 4) ^ (x >> 4)) & 1) << 1);
+   auto bankPipe = pipe + NumPipes * bank;
+   bankPipe ^= tiled.swizzle + (slice / tiled.thickness) * tiled.rotation;
+   bankPipe %= NumPipes * NumBanks;
+   pipe = bankPipe % NumPipes;
+   bank = bankPipe / NumPipes;
+
+   const auto macroTileX = x / tiled.macroTilePitch;
+   const auto macroTileY = y / tiled.macroTileHeight;
+   const auto macroTileOffset =
+      tiled.macroTileBytes * (macroTileX + tiled.macroTilesPerRow * macroTileY);
+
+   if (tiled.bankSwapWidth) {
+      const auto swapIndex = tiled.macroTilePitch * macroTileX / tiled.bankSwapWidth;
+      bank ^= BankSwapOrder[swapIndex & (NumBanks - 1)];
+   }
+
+   plane.macroTiled = true;
+   plane.bankPipeBits =
+      static_cast<uint64_t>((bank << (NumPipeBits + NumGroupBits)) | (pipe << NumGroupBits));
+   plane.offset =
+      ((macroTileOffset + sliceOffset) >> (NumBankBits + NumPipeBits)) + planeOffset;
+   plane.contiguous = (plane.offset & GroupMask) + tiled.planeBytes <= PipeInterleaveBytes;
+   return plane;
+}
+
+/**
+ * Calls func(address, planeOffset, size) for each contiguous part of a micro
+ * tile slice which crosses pipe interleave boundaries.
+ */
+template<typename Function>
 static void
-applyMicroTiler(const SurfaceInfo &surface,
-                void *src,
-                void *dst,
-                int dstStrideBytes,
-                int sliceOffset,
-                int microTilesPerRow,
-                int microTilesNumRows,
-                int microTileBytes)
+forEachPlaneSegment(const TiledSurface &tiled,
+                    const MicroTilePlane &plane,
+                    Function func)
 {
-   const auto bytesPerElement = surface.bpp / 8;
-   auto microTileOffset = sliceOffset;
-
-   for (auto microTileY = 0; microTileY < microTilesNumRows; ++microTileY) {
-      for (auto microTileX = 0; microTileX < microTilesPerRow; ++microTileX) {
-         const auto pixelX = microTileX * MicroTileWidth;
-         const auto pixelY = microTileY * MicroTileHeight;
-         const auto dstOffset =
-            pixelX * bytesPerElement + pixelY * dstStrideBytes;
-
-         MicroTiler::apply(surface,
-                           static_cast<uint8_t *>(src),
-                           microTileOffset,
-                           MicroTileWidth * bytesPerElement,
-                           static_cast<uint8_t *>(dst),
-                           dstOffset,
-                           dstStrideBytes);
-         microTileOffset += microTileBytes;
-      }
+   for (auto planeOffset = 0; planeOffset < tiled.planeBytes; ) {
+      const auto groupOffset = static_cast<int>((plane.offset + planeOffset) & GroupMask);
+      const auto size = std::min(PipeInterleaveBytes - groupOffset,
+                                 tiled.planeBytes - planeOffset);
+      func(plane.getAddress(planeOffset), planeOffset, size);
+      planeOffset += size;
+   }
+}
+
+/**
+ * Returns the elements of a micro tile slice, which are gathered into
+ * scratch when they are not contiguous.
+ */
+static const uint8_t *
+readMicroTilePlane(const TiledSurface &tiled,
+                   const MicroTilePlane &plane,
+                   const uint8_t *src,
+                   uint8_t *scratch)
+{
+   if (plane.contiguous) {
+      return src + plane.getAddress(0);
    }
+
+   forEachPlaneSegment(tiled, plane, [&](uint64_t address, int planeOffset, int size) {
+      std::memcpy(scratch + planeOffset, src + address, size);
+   });
+
+   return scratch;
 }
 
+/**
+ * Scatters the elements of a micro tile slice which is not contiguous.
+ */
 static void
-untileMicroSurface(const SurfaceInfo &surface,
-                   void *src,
-                   void *dst,
-                   int slice,
-                   int sample)
+writeMicroTilePlane(const TiledSurface &tiled,
+                    const MicroTilePlane &plane,
+                    const uint8_t *data,
+                    uint8_t *dst)
 {
-   const auto bytesPerElement = surface.bpp / 8;
+   forEachPlaneSegment(tiled, plane, [&](uint64_t address, int planeOffset, int size) {
+      std::memcpy(dst + address, data + planeOffset, size);
+   });
+}
 
-   const auto microTileThickness = getMicroTileThickness(surface.tileMode);
-   const auto microTileBytes =
-      MicroTileWidth * MicroTileHeight * microTileThickness
-      * bytesPerElement * surface.numSamples;
+static bool
+isLinear(TileMode tileMode)
+{
+   return tileMode == TileMode::LinearGeneral
+       || tileMode == TileMode::LinearAligned;
+}
+
+
+/**
+ * Untile rows [beginY, endY) of one slice, beginY must be a multiple of the
+ * micro tile height.
+ */
+static void
+untileSliceRows(const SurfaceInfo &surface,
+                const TiledSurface &tiled,
+                const uint8_t *src,
+                uint8_t *dst,
+                int dstPitch,
+                int slice,
+                int beginY,
+                int endY)
+{
+   const auto bytesPerElement = tiled.bytesPerElement;
+   const auto dstStride = dstPitch * bytesPerElement;
+
+   if (isLinear(tiled.tileMode)) {
+      const auto srcStride = static_cast<uint64_t>(tiled.pitch) * bytesPerElement;
+      const auto srcSlice = src + srcStride * tiled.height * slice;
+
+      for (auto y = beginY; y < endY; ++y) {
+         std::memcpy(dst + y * dstStride, srcSlice + y * srcStride,
+                     surface.width * bytesPerElement);
+      }
 
-   const auto pitch = calculateAlignedPitch(surface);
-   const auto height = calculateAlignedHeight(surface);
-   const auto microTilesPerRow = pitch / MicroTileWidth;
-   const auto microTilesNumRows = height / MicroTileHeight;
-
-   const auto microTileIndexZ = slice / microTileThickness;
-   const  auto sliceBytes =
-      pitch * height * microTileThickness * bytesPerElement;
-   const auto sliceOffset = microTileIndexZ * sliceBytes;
-
-   const auto dstStrideBytes = pitch * bytesPerElement;
-
-   if (surface.isDepth) {
-      // TODO: Implement depth tiling for sample > 0
-      decaf_check(sample == 0);
-      applyMicroTiler<MicroTilerDepth>(surface, src, dst, dstStrideBytes,
-                                       sliceOffset,
-                                       microTilesPerRow, microTilesNumRows,
-                                       microTileBytes);
       return;
    }
 
-   const auto sampleOffset = sample * (microTileBytes / surface.numSamples);
-   const auto sampleSliceOffset = sliceOffset + sampleOffset;
+   alignas(16) uint8_t scratch[MicroTileElements * 16];
+   alignas(16) uint8_t block[MicroTileElements * 16];
+   const auto blockStride = MicroTileWidth * bytesPerElement;
 
-   switch (surface.bpp) {
-   case 8:
-      applyMicroTiler<MicroTiler8>(surface, src, dst, dstStrideBytes,
-                                   sampleSliceOffset,
-                                   microTilesPerRow, microTilesNumRows,
-                                   microTileBytes);
-      break;
-   case 16:
-      applyMicroTiler<MicroTiler16>(surface, src, dst, dstStrideBytes,
-                                    sampleSliceOffset,
-                                    microTilesPerRow, microTilesNumRows,
-                                    microTileBytes);
-      break;
-   case 32:
-      applyMicroTiler<MicroTiler32>(surface, src, dst, dstStrideBytes,
-                                    sampleSliceOffset,
-                                    microTilesPerRow, microTilesNumRows,
-                                    microTileBytes);
-      break;
-   case 64:
-      applyMicroTiler<MicroTiler64<false>>(surface, src, dst, dstStrideBytes,
-                                           sampleSliceOffset,
-                                           microTilesPerRow, microTilesNumRows,
-                                           microTileBytes);
-      break;
-   case 128:
-      applyMicroTiler<MicroTiler128<false>>(surface, src, dst, dstStrideBytes,
-                                            sampleSliceOffset,
-                                            microTilesPerRow, microTilesNumRows,
-                                            microTileBytes);
-      break;
-   default:
-      decaf_abort("Invalid bpp");
+   for (auto y = beginY; y < endY; y += MicroTileHeight) {
+      const auto rows = std::min(MicroTileHeight, endY - y);
+
+      for (auto x = 0; x < surface.width; x += MicroTileWidth) {
+         const auto columns = std::min(MicroTileWidth, surface.width - x);
+         const auto plane = getMicroTilePlane(tiled, x, y, slice);
+         const auto tile = readMicroTilePlane(tiled, plane, src, scratch);
+         const auto dstTile = dst + y * dstStride + x * bytesPerElement;
+
+         if (rows == MicroTileHeight && columns == MicroTileWidth) {
+            tiled.untileKernel(tiled.layout, tile, dstTile, dstStride);
+            continue;
+         }
+
+         // Partial micro tiles at the edge of the image go through a block
+         tiled.untileKernel(tiled.layout, tile, block, blockStride);
+
+         for (auto row = 0; row < rows; ++row) {
+            std::memcpy(dstTile + row * dstStride, block + row * blockStride,
+                        columns * bytesPerElement);
+         }
+      }
    }
 }
 
-template<typename MicroTiler>
+
+/**
+ * Tile rows [beginY, endY) of one slice, beginY must be a multiple of the
+ * micro tile height.
+ *
+ * Elements of a partial micro tile which are outside of the image keep the
+ * value they had in tiled memory.
+ */
 static void
-applyMacroTiling(const SurfaceInfo &surface,
-                 void *src,
-                 void *dst,
-                 int dstStrideBytes,
-                 int sampleOffset,
-                 int sliceOffset,
-                 int bankSliceRotation,
-                 int sampleSliceRotation,
-                 int pipeSliceRotation,
-                 int bankSwapInterval,
-                 int macroTileWidth,
-                 int macroTileHeight,
-                 int macroTilesPerRow,
-                 int macroTilesNumRows,
-                 int macroTileBytes,
-                 int microTileBytes)
+tileSliceRows(const SurfaceInfo &surface,
+              const TiledSurface &tiled,
+              const uint8_t *src,
+              int srcPitch,
+              uint8_t *dst,
+              int slice,
+              int beginY,
+              int endY)
 {
-   const auto bytesPerElement = surface.bpp / 8;
-   auto macroTileOffset = 0;
-   auto macroTileIndex = 0;
-
-   for (auto macroTileY = 0; macroTileY < macroTilesNumRows; ++macroTileY) {
-      for (auto macroTileX = 0; macroTileX < macroTilesPerRow; ++macroTileX) {
-         const auto totalOffset =
-            ((sliceOffset + macroTileOffset) >> (NumBankBits + NumPipeBits))
-            + sampleOffset;
-         const auto offsetHigh =
-            (totalOffset & ~GroupMask) << (NumBankBits + NumPipeBits);
-
-         // Our code assumes offsetLow is 0 at this point
-         decaf_check((totalOffset & GroupMask) == 0);
-
-         for (auto microTileY = 0; microTileY < macroTileHeight; ++microTileY) {
-            for (auto microTileX = 0; microTileX < macroTileWidth; ++microTileX) {
-               const  auto pixelX =
-                  (macroTileX * macroTileWidth + microTileX) * MicroTileWidth;
-               const auto pixelY =
-                  (macroTileY * macroTileHeight + microTileY) * MicroTileHeight;
-               const auto dstOffset =
-                  pixelX * bytesPerElement + pixelY * dstStrideBytes;
-
-               // Calculate bank & pipe
-               auto bank = ((pixelX >> 3) & 1) ^ ((pixelY >> 5) & 1);
-               bank |= (((pixelX >> 4) & 1) ^ ((pixelY >> 4) & 1)) << 1;
-               bank ^= (surface.bankSwizzle + bankSliceRotation) & (NumBanks - 1);
-               bank ^= sampleSliceRotation;
-
-               if (bankSwapInterval) {
-                  auto bankSwapRotation = (macroTileIndex / bankSwapInterval) % NumBanks;
-                  bank ^= bankSwapRotation;
-               }
-
-               auto pipe = ((pixelX >> 3) & 1) ^ ((pixelY >> 3) & 1);
-               pipe ^= (surface.pipeSwizzle + pipeSliceRotation) & (NumPipes - 1);
-
-               auto microTileOffset =
-                  (bank << (NumGroupBits + NumPipeBits))
-                  + (pipe << NumGroupBits) + offsetHigh;
-
-               MicroTiler::apply(surface,
-                                 static_cast<uint8_t *>(src),
-                                 microTileOffset,
-                                 MicroTileWidth * bytesPerElement,
-                                 static_cast<uint8_t *>(dst),
-                                 dstOffset,
-                                 dstStrideBytes);
+   const auto bytesPerElement = tiled.bytesPerElement;
+   const auto srcStride = srcPitch * bytesPerElement;
+
+   if (isLinear(tiled.tileMode)) {
+      const auto dstStride = static_cast<uint64_t>(tiled.pitch) * bytesPerElement;
+      const auto dstSlice = dst + dstStride * tiled.height * slice;
+
+      for (auto y = beginY; y < endY; ++y) {
+         std::memcpy(dstSlice + y * dstStride, src + y * srcStride,
+                     surface.width * bytesPerElement);
+      }
+
+      return;
+   }
+
+   alignas(16) uint8_t scratch[MicroTileElements * 16];
+   alignas(16) uint8_t block[MicroTileElements * 16];
+   const auto blockStride = MicroTileWidth * bytesPerElement;
+
+   for (auto y = beginY; y < endY; y += MicroTileHeight) {
+      const auto rows = std::min(MicroTileHeight, endY - y);
+
+      for (auto x = 0; x < surface.width; x += MicroTileWidth) {
+         const auto columns = std::min(MicroTileWidth, surface.width - x);
+         const auto plane = getMicroTilePlane(tiled, x, y, slice);
+         const auto tile = plane.contiguous ? dst + plane.getAddress(0) : scratch;
+         auto srcTile = src + y * srcStride + x * bytesPerElement;
+         auto srcTileStride = srcStride;
+
+         if (rows != MicroTileHeight || columns != MicroTileWidth) {
+            // Merge partial micro tiles with what is already in memory
+            tiled.untileKernel(tiled.layout,
+                               readMicroTilePlane(tiled, plane, dst, scratch),
+                               block, blockStride);
+
+            for (auto row = 0; row < rows; ++row) {
+               std::memcpy(block + row * blockStride, srcTile + row * srcStride,
+                           columns * bytesPerElement);
             }
+
+            srcTile = block;
+            srcTileStride = blockStride;
          }
 
-         macroTileOffset += macroTileBytes;
-         macroTileIndex++;
+         tiled.tileKernel(tiled.layout, srcTile, srcTileStride, tile);
+
+         if (!plane.contiguous) {
+            writeMicroTilePlane(tiled, plane, scratch, dst);
+         }
       }
    }
 }
 
-static void
-untileMacroSurface(const SurfaceInfo &surface,
-                   void *src,
-                   void *dst,
-                   int slice,
-                   int sample)
+
+/**
+ * Runs the jobs of a tiling call on a few host threads, with the calling
+ * thread helping. Calls from different threads take turns.
+ */
+class TilingPool
 {
-   const auto bytesPerElement = surface.bpp / 8;
+public:
+   ~TilingPool()
+   {
+      stop();
+   }
 
-   const auto microTileThickness = getMicroTileThickness(surface.tileMode);
-   const auto microTileBytes =
-      MicroTileWidth * MicroTileHeight * microTileThickness
-      * bytesPerElement * surface.numSamples;
+   void run(unsigned numThreads,
+            int numJobs,
+            const std::function<void(int)> &job)
+   {
+      std::unique_lock<std::mutex> runLock { mRunMutex };
 
-   const auto macroTileWidth = getMacroTileWidth(surface.tileMode);
-   const auto macroTileHeight = getMacroTileHeight(surface.tileMode);
-   const auto macroTileBytes =
-      macroTileWidth * macroTileHeight * microTileBytes;
+      if (numThreads != mThreads.size()) {
+         start(numThreads);
+      }
 
-   const auto pitch = calculateAlignedPitch(surface);
-   const auto height = calculateAlignedHeight(surface);
-   const auto macroTilesPerRow = pitch / (macroTileWidth * MicroTileWidth);
-   const auto macroTilesNumRows = height / (macroTileHeight * MicroTileHeight);
-   const auto dstStrideBytes = pitch * bytesPerElement;
+      if (mThreads.empty() || numJobs <= 1) {
+         for (auto i = 0; i < numJobs; ++i) {
+            job(i);
+         }
 
-   const auto macroTilesPerSlice = macroTilesPerRow * macroTilesNumRows;
-   const auto sliceOffset =
-      (slice / microTileThickness) * macroTilesPerSlice * macroTileBytes;
+         return;
+      }
 
-   // Depth tiling is different for samples, not yet implemented
-   decaf_check(!surface.isDepth || sample == 0);
-   const auto sampleOffset = sample * (microTileBytes / surface.numSamples);
+      {
+         std::unique_lock<std::mutex> lock { mMutex };
+         mJob = &job;
+         mNumJobs = numJobs;
+         mNextJob = 0;
+         mJobsRemaining = numJobs;
+      }
 
-   // Calculate bank / pipe rotation
-   auto bankSliceRotation = 0;
-   auto sampleSliceRotation = 0;
-   auto pipeSliceRotation = 0;
-   auto bankSwapInterval = 0;
+      mWorkCondition.notify_all();
+      runJobs();
 
-   switch (surface.tileMode) {
-   case TileMode::Tiled2DThin1:
-   case TileMode::Tiled2DThin2:
-   case TileMode::Tiled2DThin4:
-   case TileMode::Tiled2DThick:
-   case TileMode::Tiled2BThin1:
-   case TileMode::Tiled2BThin2:
-   case TileMode::Tiled2BThin4:
-   case TileMode::Tiled2BThick:
-      bankSliceRotation = ((NumBanks >> 1) - 1) * (slice / microTileThickness);
-      sampleSliceRotation = ((NumBanks >> 1) + 1) * sample;
-      break;
-   case TileMode::Tiled3DThin1:
-   case TileMode::Tiled3DThick:
-   case TileMode::Tiled3BThin1:
-   case TileMode::Tiled3BThick:
-      bankSliceRotation = (slice / microTileThickness) / NumPipes;
-      pipeSliceRotation = (slice / microTileThickness);
-      break;
+      std::unique_lock<std::mutex> lock { mMutex };
+      mDoneCondition.wait(lock, [&]() { return mJobsRemaining == 0; });
+      mJob = nullptr;
    }
 
-   switch (surface.tileMode) {
-   case TileMode::Tiled2BThin1:
-   case TileMode::Tiled2BThin2:
-   case TileMode::Tiled2BThin4:
-   case TileMode::Tiled2BThick:
-   case TileMode::Tiled3BThin1:
-   case TileMode::Tiled3BThick:
-      bankSwapInterval = (bytesPerElement * 8 * 2 / BankSwapBytes);
-      break;
+private:
+   void start(unsigned numThreads)
+   {
+      stop();
+
+      std::unique_lock<std::mutex> lock { mMutex };
+      mRunning = true;
+
+      for (auto i = 0u; i < numThreads; ++i) {
+         mThreads.emplace_back(&TilingPool::threadEntry, this);
+         platform::setThreadName(&mThreads.back(), fmt::format("GPU Tiling {}", i));
+      }
    }
 
-   // Do the tiling
-   switch (surface.bpp) {
-   case 8:
-      applyMacroTiling<MicroTiler8>(surface, src, dst, dstStrideBytes,
-                                    sampleOffset, sliceOffset,
-                                    bankSliceRotation, sampleSliceRotation,
-                                    pipeSliceRotation, bankSwapInterval,
-                                    macroTileWidth, macroTileHeight,
-                                    macroTilesPerRow, macroTilesNumRows,
-                                    macroTileBytes, microTileBytes);
-      break;
-   case 16:
-      applyMacroTiling<MicroTiler16>(surface, src, dst, dstStrideBytes,
-                                     sampleOffset, sliceOffset,
-                                     bankSliceRotation, sampleSliceRotation,
-                                     pipeSliceRotation, bankSwapInterval,
-                                     macroTileWidth, macroTileHeight,
-                                     macroTilesPerRow, macroTilesNumRows,
-                                     macroTileBytes, microTileBytes);
-      break;
-   case 32:
-      applyMacroTiling<MicroTiler32>(surface, src, dst, dstStrideBytes,
-                                     sampleOffset, sliceOffset,
-                                     bankSliceRotation, sampleSliceRotation,
-                                     pipeSliceRotation, bankSwapInterval,
-                                     macroTileWidth, macroTileHeight,
-                                     macroTilesPerRow, macroTilesNumRows,
-                                     macroTileBytes, microTileBytes);
-      break;
-   case 64:
-      applyMacroTiling<MicroTiler64<true>>(surface, src, dst, dstStrideBytes,
-                                           sampleOffset, sliceOffset,
-                                           bankSliceRotation, sampleSliceRotation,
-                                           pipeSliceRotation, bankSwapInterval,
-                                           macroTileWidth, macroTileHeight,
-                                           macroTilesPerRow, macroTilesNumRows,
-                                           macroTileBytes, microTileBytes);
-      break;
-   case 128:
-      applyMacroTiling<MicroTiler128<true>>(surface, src, dst, dstStrideBytes,
-                                            sampleOffset, sliceOffset,
-                                            bankSliceRotation, sampleSliceRotation,
-                                            pipeSliceRotation, bankSwapInterval,
-                                            macroTileWidth, macroTileHeight,
-                                            macroTilesPerRow, macroTilesNumRows,
-                                            macroTileBytes, microTileBytes);
-      break;
-   default:
-      decaf_abort("Invalid surface bpp");
+   void stop()
+   {
+      {
+         std::unique_lock<std::mutex> lock { mMutex };
+         mRunning = false;
+      }
+
+      mWorkCondition.notify_all();
+
+      for (auto &thread : mThreads) {
+         thread.join();
+      }
+
+      mThreads.clear();
+   }
+
+   void runJobs()
+   {
+      std::unique_lock<std::mutex> lock { mMutex };
+
+      while (mJob && mNextJob < mNumJobs) {
+         auto job = mJob;
+         auto index = mNextJob++;
+
+         lock.unlock();
+         (*job)(index);
+         lock.lock();
+
+         if (--mJobsRemaining == 0) {
+            mDoneCondition.notify_all();
+         }
+      }
+   }
+
+   void threadEntry()
+   {
+      std::unique_lock<std::mutex> lock { mMutex };
+
+      while (true) {
+         mWorkCondition.wait(lock, [&]() {
+            return !mRunning || (mJob && mNextJob < mNumJobs);
+         });
+
+         if (!mRunning) {
+            break;
+         }
+
+         lock.unlock();
+         runJobs();
+         lock.lock();
+      }
+   }
+
+private:
+   std::vector<std::thread> mThreads;
+   std::mutex mRunMutex;
+   std::mutex mMutex;
+   std::condition_variable mWorkCondition;
+   std::condition_variable mDoneCondition;
+   const std::function<void(int)> *mJob = nullptr;
+   int mNumJobs = 0;
+   int mNextJob = 0;
+   int mJobsRemaining = 0;
+   bool mRunning = false;
+};
+
+static TilingPool
+sTilingPool;
+
+static void
+runTilingJobs(int numJobs,
+              uint64_t totalBytes,
+              const std::function<void(int)> &job)
+{
+   if (totalBytes < MinParallelBytes) {
+      for (auto i = 0; i < numJobs; ++i) {
+         job(i);
+      }
+   } else {
+      sTilingPool.run(gpu::config::tiling_threads, numJobs, job);
    }
 }
 
@@ -1096,21 +1400,110 @@ calculateMipMapSliceInfo(const SurfaceInfo &surface,
    calculateMipMapInfo(mipMapSurface, numLevels, info);
 }
 
+/**
+ * Untile slices [firstSlice, lastSlice) of a surface whose tiled memory has
+ * the given pitch.
+ *
+ * The untiled slices are written one after another to dst, each one
+ * dstPitch * surface.height elements. Only surface.width columns of each
+ * row are written.
+ */
+void
+untileSlices(const SurfaceInfo &surface,
+             int pitch,
+             const void *src,
+             void *dst,
+             int dstPitch,
+             int firstSlice,
+             int lastSlice)
+{
+   const auto tiled = TiledSurface { surface, pitch };
+   const auto dstSliceSize = static_cast<uint64_t>(dstPitch) * surface.height * tiled.bytesPerElement;
+   const auto numBands = (surface.height + RowsPerJob - 1) / RowsPerJob;
+   const auto numSlices = lastSlice - firstSlice;
+
+   if (numSlices <= 0 || surface.width <= 0 || surface.height <= 0) {
+      return;
+   }
+
+   runTilingJobs(numSlices * numBands, dstSliceSize * numSlices, [&](int job) {
+      const auto slice = firstSlice + job / numBands;
+      const auto beginY = (job % numBands) * RowsPerJob;
+      const auto endY = std::min(surface.height, beginY + RowsPerJob);
+      untileSliceRows(surface, tiled,
+                      reinterpret_cast<const uint8_t *>(src),
+                      reinterpret_cast<uint8_t *>(dst) + dstSliceSize * (slice - firstSlice),
+                      dstPitch, slice, beginY, endY);
+   });
+}
+
+/**
+ * Tile slices [firstSlice, lastSlice) of a surface whose tiled memory has the
+ * given pitch.
+ *
+ * The linear slices are read one after another from src, each one
+ * srcPitch * surface.height elements. Only surface.width columns of each row
+ * are written to tiled memory.
+ */
+void
+tileSlices(const SurfaceInfo &surface,
+           int pitch,
+           const void *src,
+           int srcPitch,
+           void *dst,
+           int firstSlice,
+           int lastSlice)
+{
+   const auto tiled = TiledSurface { surface, pitch };
+   const auto srcSliceSize = static_cast<uint64_t>(srcPitch) * surface.height * tiled.bytesPerElement;
+   const auto numBands = (surface.height + RowsPerJob - 1) / RowsPerJob;
+   const auto numSlices = lastSlice - firstSlice;
+
+   if (numSlices <= 0 || surface.width <= 0 || surface.height <= 0) {
+      return;
+   }
+
+   runTilingJobs(numSlices * numBands, srcSliceSize * numSlices, [&](int job) {
+      const auto slice = firstSlice + job / numBands;
+      const auto beginY = (job % numBands) * RowsPerJob;
+      const auto endY = std::min(surface.height, beginY + RowsPerJob);
+      tileSliceRows(surface, tiled,
+                    reinterpret_cast<const uint8_t *>(src) + srcSliceSize * (slice - firstSlice),
+                    srcPitch,
+                    reinterpret_cast<uint8_t *>(dst),
+                    slice, beginY, endY);
+   });
+}
+
+/**
+ * The surface as laid out in tiled memory, the whole aligned pitch and height
+ * are untiled.
+ */
+static SurfaceInfo
+getAlignedSurfaceInfo(const SurfaceInfo &surface)
+{
+   auto alignedSurface = surface;
+   alignedSurface.width = calculateAlignedPitch(surface);
+   alignedSurface.height = calculateAlignedHeight(surface);
+   return alignedSurface;
+}
+
 void
 untileImage(const SurfaceInfo &surface,
             void *src,
             void *dst)
 {
-   const auto sliceSize = calculateSliceSize(surface);
-
    // Multi-sample untile is not supported yet
    decaf_check(surface.numSamples == 1);
 
-   for (auto slice = 0; slice < surface.depth; ++slice) {
-      untileSlice(surface, src,
-                  reinterpret_cast<uint8_t *>(dst) + sliceSize * slice,
-                  slice, 0);
+   if (isLinear(surface.tileMode)) {
+      // Already "untiled"
+      return;
    }
+
+   const auto alignedSurface = getAlignedSurfaceInfo(surface);
+   untileSlices(alignedSurface, alignedSurface.width, src, dst,
+                alignedSurface.width, 0, surface.depth);
 }
 
 void
@@ -1123,31 +1516,14 @@ untileSlice(const SurfaceInfo &surface,
    // Sample decoding is not supported yet.
    decaf_check(sample == 0);
 
-   switch (static_cast<TileMode>(surface.tileMode)) {
-   case TileMode::LinearGeneral:
-   case TileMode::LinearAligned:
+   if (isLinear(surface.tileMode)) {
       // Already "untiled"
       return;
-   case TileMode::Tiled1DThin1:
-      return untileMicroSurface(surface, src, dst, slice, sample);
-   case TileMode::Tiled1DThick:
-      return untileMicroSurface(surface, src, dst, slice, sample);
-   case TileMode::Tiled2DThin1:
-   case TileMode::Tiled2DThin2:
-   case TileMode::Tiled2DThin4:
-   case TileMode::Tiled2DThick:
-   case TileMode::Tiled2BThin1:
-   case TileMode::Tiled2BThin2:
-   case TileMode::Tiled2BThin4:
-   case TileMode::Tiled2BThick:
-   case TileMode::Tiled3DThin1:
-   case TileMode::Tiled3DThick:
-   case TileMode::Tiled3BThin1:
-   case TileMode::Tiled3BThick:
-      return untileMacroSurface(surface, src, dst, slice, sample);
-   default:
-      decaf_abort("Invalid tile mode");
    }
+
+   const auto alignedSurface = getAlignedSurfaceInfo(surface);
+   untileSlices(alignedSurface, alignedSurface.width, src, dst,
+                alignedSurface.width, slice, slice + 1);
 }
 
 void
@@ -1156,20 +1532,45 @@ untileMipMaps(const SurfaceInfo &surface,
               void *src,
               void *dst)
 {
+   struct MipSlice
+   {
+      SurfaceInfo surface;
+      uint8_t *src;
+      uint8_t *dst;
+      int slice;
+   };
+
+   // Every slice of every level is a job, the small levels are not worth
+   // splitting into bands.
+   auto jobs = std::vector<MipSlice> { };
+   auto totalSize = uint64_t { 0 };
+
    for (auto level = 1; level < mipMapInfo.numLevels; ++level) {
       const auto mipSurface = getMipSurfaceInfo(surface, level);
       const auto offset = getMipLevelOffset(mipMapInfo, level);
       const auto sliceSize = calculateSliceSize(mipSurface);
 
-      const auto mipSrc = reinterpret_cast<uint8_t *>(src) + offset;
-      const auto mipDst = reinterpret_cast<uint8_t *>(dst) + offset;
+      if (isLinear(mipSurface.tileMode)) {
+         continue;
+      }
 
       for (auto slice = 0; slice < mipSurface.depth; ++slice) {
-         untileSlice(mipSurface,
-                     mipSrc,
-                     mipDst + sliceSize * slice, slice, 0);
+         jobs.push_back({
+            getAlignedSurfaceInfo(mipSurface),
+            reinterpret_cast<uint8_t *>(src) + offset,
+            reinterpret_cast<uint8_t *>(dst) + offset + sliceSize * slice,
+            slice
+         });
+         totalSize += sliceSize;
       }
    }
+
+   runTilingJobs(static_cast<int>(jobs.size()), totalSize, [&](int index) {
+      const auto &job = jobs[index];
+      const auto tiled = TiledSurface { job.surface, job.surface.width };
+      untileSliceRows(job.surface, tiled, job.src, job.dst,
+                      job.surface.width, job.slice, 0, job.surface.height);
+   });
 }
 
 void
@@ -1190,7 +1591,7 @@ untileMipMapsForSlice(const SurfaceInfo &surface,
                   reinterpret_cast<uint8_t *>(src) + srcOffset,
                   reinterpret_cast<uint8_t *>(dst) + dstOffset,
                   slice,
-                  0);
+                  sample);
    }
 }
 
@@ -10,6 +10,11 @@ bool debug = false;
 std::vector<int64_t> debug_filters = { };
 bool dump_shaders = false;
 bool debuggable_shaders = false;
+unsigned tiling_threads = 2;
+std::string shader_cache_path = {};
+unsigned pipeline_compile_threads = 0;
+bool pipeline_fallback = true;
+bool cpu_write_tracking = false;
 
 } // namespace config
 
@@ -1,63 +1,226 @@
 #include "gpu_ringbuffer.h"
+#include "latte/latte_pm4.h"
 
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <common/byte_swap.h>
+#include <common/decaf_assert.h>
 #include <condition_variable>
+#include <cstring>
 #include <mutex>
-#include <vector>
+#include <thread>
+
+/*
+ * The ring buffer is a single consumer queue of PM4 words, much like the CP
+ * ring buffer on real hardware. Only producers take a lock, the consumer
+ * side is lock-free.
+ *
+ * The producer copies packets directly into the ring and publishes them by
+ * advancing writePosition. The consumer is handed spans which point straight
+ * into the ring, so there is no further copy, and only releases that space
+ * back to the producer on its next call to read() or wait().
+ *
+ * A packet is never split across the end of the ring, instead the end is
+ * padded with type 2 filler packets so every span returned by read() holds
+ * only whole packets. Writes larger than half the ring are split on packet
+ * boundaries and copied in as the consumer releases space.
+ *
+ * Producers are serialised by producerMutex, so each write() lands in the
+ * ring as one contiguous run of packets.
+ *
+ * The mutex and condition variable are only touched when the consumer has
+ * parked itself in wait() because the ring is empty.
+ */
 
 namespace gpu::ringbuffer
 {
 
-static std::vector<uint32_t>
-mWriteVector;
+//! Size of the ring in words, must be a power of two.
+static constexpr auto RingSize = size_t { 0x10000 };
+
+//! Largest run of packets copied into the ring at once, so there is always
+//! room for it plus the filler packets after a wrap around.
+static constexpr auto MaxWriteSize = RingSize / 2;
+
+//! A type 3 packet can be up to 0x4000 words of data plus its header.
+static_assert(MaxWriteSize >= 0x4001, "ring must fit the largest packet");
+
+//! PM4 type 2 filler packet, in guest byte order.
+static const auto FillerPacket = byte_swap(0x80000000u);
+
+struct RingBuffer
+{
+   std::array<uint32_t, RingSize> words;
+
+   //! Total number of words written by the producer.
+   alignas(64) std::atomic<size_t> writePosition { 0 };
 
-static std::vector<uint32_t>
-mReadVector;
+   //! Total number of words released by the consumer.
+   alignas(64) std::atomic<size_t> readPosition { 0 };
 
-static std::mutex
-sMutex;
+   //! End of the last span returned by read(), only used by the consumer.
+   size_t readEnd = 0;
 
-static std::condition_variable
-sConditionVariable;
+   //! Held for the duration of a write().
+   std::mutex producerMutex;
+
+   //! Set while the consumer is parked in wait().
+   alignas(64) std::atomic<bool> consumerWaiting { false };
+   std::atomic<bool> pendingWake { false };
+   std::mutex mutex;
+   std::condition_variable conditionVariable;
+};
+
+static RingBuffer
+sRingBuffer;
+
+static void
+notifyConsumer()
+{
+   std::unique_lock<std::mutex> lock { sRingBuffer.mutex };
+   sRingBuffer.conditionVariable.notify_all();
+}
 
 static bool
-sPendingWake = false;
+hasPendingData()
+{
+   return sRingBuffer.writePosition.load() != sRingBuffer.readEnd;
+}
+
+static void
+releaseReadBuffer()
+{
+   sRingBuffer.readPosition.store(sRingBuffer.readEnd, std::memory_order_release);
+}
+
+/**
+ * Returns the number of words of whole packets at the start of words which
+ * fit in MaxWriteSize.
+ */
+static size_t
+getChunkSize(const uint32_t *words,
+             size_t numWords)
+{
+   auto pos = size_t { 0 };
+
+   while (pos < numWords) {
+      auto header = latte::pm4::Header::get(byte_swap(words[pos]));
+      auto size = size_t { 1 };
+
+      if (header.type() == latte::pm4::PacketType::Type0) {
+         size += latte::pm4::HeaderType0::get(header.value).count() + 1;
+      } else if (header.type() == latte::pm4::PacketType::Type3) {
+         size += latte::pm4::HeaderType3::get(header.value).size() + 1;
+      }
+
+      if (pos + size > MaxWriteSize) {
+         break;
+      }
+
+      pos += size;
+   }
+
+   return std::min(pos, numWords);
+}
+
+static void
+writeChunk(const uint32_t *words,
+           size_t size)
+{
+   auto writePos = sRingBuffer.writePosition.load(std::memory_order_relaxed);
+   auto offset = writePos & (RingSize - 1);
+   auto padding = size_t { 0 };
+
+   if (offset + size > RingSize) {
+      padding = RingSize - offset;
+   }
+
+   // Wait for the consumer to release enough space
+   while (writePos + padding + size - sRingBuffer.readPosition.load(std::memory_order_acquire) > RingSize) {
+      std::this_thread::yield();
+   }
+
+   if (padding) {
+      std::fill_n(sRingBuffer.words.data() + offset, padding, FillerPacket);
+      offset = 0;
+   }
+
+   std::memcpy(sRingBuffer.words.data() + offset, words, size * sizeof(uint32_t));
+
+   // This store and the exchange of consumerWaiting must be sequentially
+   // consistent to pair with the opposite order in wait(). Clearing the flag
+   // means we only notify once per time the consumer parks.
+   sRingBuffer.writePosition.store(writePos + padding + size);
+
+   if (sRingBuffer.consumerWaiting.exchange(false)) {
+      notifyConsumer();
+   }
+}
 
 void
 write(const Buffer &items)
 {
-   std::unique_lock<std::mutex> lock { sMutex };
-   mWriteVector.insert(mWriteVector.end(), items.begin(), items.end());
-   sConditionVariable.notify_all();
+   std::unique_lock<std::mutex> lock { sRingBuffer.producerMutex };
+   auto words = items.data();
+   auto remaining = static_cast<size_t>(items.size());
+
+   while (remaining > 0) {
+      auto size = remaining;
+
+      if (size > MaxWriteSize) {
+         size = getChunkSize(words, remaining);
+      }
+
+      writeChunk(words, size);
+      words += size;
+      remaining -= size;
+   }
 }
 
 Buffer
 read()
 {
-   std::unique_lock<std::mutex> lock { sMutex };
-   mReadVector.clear();
-   mReadVector.swap(mWriteVector);
-   return mReadVector;
+   releaseReadBuffer();
+
+   auto readPos = sRingBuffer.readEnd;
+   auto writePos = sRingBuffer.writePosition.load(std::memory_order_acquire);
+
+   if (readPos == writePos) {
+      return { };
+   }
+
+   auto offset = readPos & (RingSize - 1);
+   auto size = static_cast<uint32_t>(std::min(writePos - readPos, RingSize - offset));
+   sRingBuffer.readEnd = readPos + size;
+   return { sRingBuffer.words.data() + offset, size };
 }
 
 bool
 wait()
 {
-   std::unique_lock<std::mutex> lock { sMutex };
-   if (mWriteVector.empty() && !sPendingWake) {
-      sConditionVariable.wait(lock);
-   }
+   releaseReadBuffer();
 
-   sPendingWake = false;
+   if (!hasPendingData() && !sRingBuffer.pendingWake.load()) {
+      std::unique_lock<std::mutex> lock { sRingBuffer.mutex };
+      sRingBuffer.consumerWaiting.store(true);
+
+      if (!hasPendingData() && !sRingBuffer.pendingWake.load()) {
+         sRingBuffer.conditionVariable.wait(lock);
+      }
+
+      sRingBuffer.consumerWaiting.store(false);
+   }
 
-   return !mWriteVector.empty();
+   sRingBuffer.pendingWake.store(false);
+   return hasPendingData();
 }
 
 void
 wake()
 {
-   std::unique_lock<std::mutex> lock { sMutex };
-   sPendingWake = true;
-   sConditionVariable.notify_all();
+   sRingBuffer.pendingWake.store(true);
+   notifyConsumer();
 }
 
 } // namespace gpu::ringbuffer
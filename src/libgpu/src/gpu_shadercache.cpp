@@ -0,0 +1,232 @@
+#include "gpu_shadercache.h"
+
+#include <common/log.h>
+
+namespace gpu
+{
+
+static constexpr uint32_t CacheFileMagic = 0x43444853; // 'SHDC'
+static constexpr uint32_t CacheFileVersion = 1;
+
+//! Far larger than any translated shader, an entry claiming to be bigger
+//! than this is corrupt.
+static constexpr uint32_t MaxEntrySize = 16 * 1024 * 1024;
+
+struct CacheFileHeader
+{
+   uint32_t magic;
+   uint32_t version;
+   ShaderCache::Hash translatorHash;
+};
+
+struct CacheFileEntryHeader
+{
+   ShaderCache::Hash hash;
+   uint32_t dataSize;
+   uint32_t reserved;
+};
+
+ShaderCache::~ShaderCache()
+{
+   close();
+}
+
+
+/**
+ * Open a shader cache file, loading all the entries it contains.
+ *
+ * If the file does not exist, or was written by an incompatible version or
+ * by a different build of the translator, then it is recreated empty.
+ */
+bool
+ShaderCache::open(const std::string &path,
+                  const Hash &translatorHash)
+{
+   close();
+   mPath = path;
+   mTranslatorHash = translatorHash;
+
+   auto rewrite = true;
+   auto in = std::ifstream { path, std::ifstream::binary };
+
+   if (in.is_open()) {
+      rewrite = !load(in);
+      in.close();
+   }
+
+   if (rewrite) {
+      mOutput.open(path, std::ofstream::binary | std::ofstream::trunc);
+
+      if (!mOutput.is_open()) {
+         gLog->warn("Failed to create shader cache file {}", path);
+         mEntries.clear();
+         return false;
+      }
+
+      auto header = CacheFileHeader { };
+      header.magic = CacheFileMagic;
+      header.version = CacheFileVersion;
+      header.translatorHash = mTranslatorHash;
+      mOutput.write(reinterpret_cast<const char *>(&header), sizeof(header));
+
+      // Write back whatever valid entries we managed to load
+      for (auto &itr : mEntries) {
+         writeEntry(itr.first, itr.second);
+      }
+
+      mOutput.flush();
+   } else {
+      mOutput.open(path, std::ofstream::binary | std::ofstream::app);
+
+      if (!mOutput.is_open()) {
+         gLog->warn("Failed to open shader cache file {} for writing", path);
+      }
+   }
+
+   gLog->info("Loaded {} shaders from shader cache {}", mEntries.size(), path);
+   mOpen = true;
+   return true;
+}
+
+
+/**
+ * Close the shader cache, this discards all loaded entries.
+ */
+void
+ShaderCache::close()
+{
+   std::lock_guard<std::mutex> lock { mMutex };
+
+   if (mOutput.is_open()) {
+      mOutput.close();
+   }
+
+   mEntries.clear();
+   mStored.clear();
+   mOpen = false;
+}
+
+
+/**
+ * Read entries from a cache file.
+ *
+ * Returns false if the file needs to be rewritten.
+ */
+bool
+ShaderCache::load(std::ifstream &in)
+{
+   auto header = CacheFileHeader { };
+   in.read(reinterpret_cast<char *>(&header), sizeof(header));
+
+   if (!in ||
+       header.magic != CacheFileMagic ||
+       header.version != CacheFileVersion) {
+      gLog->info("Discarding incompatible shader cache {}", mPath);
+      return false;
+   }
+
+   if (header.translatorHash != mTranslatorHash) {
+      gLog->info("Discarding shader cache {} from a different shader translator", mPath);
+      return false;
+   }
+
+   in.seekg(0, std::ifstream::end);
+   auto fileSize = static_cast<uint64_t>(in.tellg());
+   in.seekg(sizeof(header), std::ifstream::beg);
+
+   while (in.peek() != std::ifstream::traits_type::eof()) {
+      auto entryHeader = CacheFileEntryHeader { };
+      in.read(reinterpret_cast<char *>(&entryHeader), sizeof(entryHeader));
+
+      if (!in || entryHeader.dataSize == 0) {
+         gLog->warn("Truncated shader cache {}, discarding remaining entries", mPath);
+         return false;
+      }
+
+      // Check the size before allocating for it, so a corrupt entry can not
+      // make us allocate up to 4GB
+      auto remaining = fileSize - static_cast<uint64_t>(in.tellg());
+
+      if (entryHeader.dataSize > MaxEntrySize || entryHeader.dataSize > remaining) {
+         gLog->warn("Corrupt shader cache {}, discarding remaining entries", mPath);
+         return false;
+      }
+
+      auto data = std::vector<uint8_t>(entryHeader.dataSize);
+      in.read(reinterpret_cast<char *>(data.data()), data.size());
+
+      if (!in) {
+         gLog->warn("Truncated shader cache {}, discarding remaining entries", mPath);
+         return false;
+      }
+
+      mEntries[entryHeader.hash] = std::move(data);
+   }
+
+   return true;
+}
+
+
+/**
+ * Find the entry for a shader description hash.
+ *
+ * The loaded entries are never modified after open so this does not need
+ * to take a lock.
+ */
+const std::vector<uint8_t> *
+ShaderCache::find(const Hash &hash)
+{
+   auto itr = mEntries.find(hash);
+
+   if (itr == mEntries.end()) {
+      mStats.misses++;
+      return nullptr;
+   }
+
+   mStats.hits++;
+   return &itr->second;
+}
+
+
+/**
+ * Append a newly translated shader to the cache file.
+ *
+ * Stored entries only become visible to find after the cache is reopened,
+ * when they replace any earlier entry loaded for the same hash.
+ */
+void
+ShaderCache::store(const Hash &hash,
+                   const std::vector<uint8_t> &data)
+{
+   if (!mOpen || data.empty()) {
+      return;
+   }
+
+   std::lock_guard<std::mutex> lock { mMutex };
+   if (!mOutput.is_open() || !mStored.insert(hash).second) {
+      return;
+   }
+
+   writeEntry(hash, data);
+   mOutput.flush();
+   mStats.stores++;
+}
+
+
+/**
+ * Write a single entry to the output file.
+ */
+void
+ShaderCache::writeEntry(const Hash &hash,
+                        const std::vector<uint8_t> &data)
+{
+   auto entryHeader = CacheFileEntryHeader { };
+   entryHeader.hash = hash;
+   entryHeader.dataSize = static_cast<uint32_t>(data.size());
+   entryHeader.reserved = 0;
+
+   mOutput.write(reinterpret_cast<const char *>(&entryHeader), sizeof(entryHeader));
+   mOutput.write(reinterpret_cast<const char *>(data.data()), data.size());
+}
+
+} // namespace gpu
@@ -0,0 +1,105 @@
+#pragma once
+#include <array>
+#include <atomic>
+#include <cstdint>
+#include <fstream>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+#include <unordered_set>
+#include <vector>
+
+namespace gpu
+{
+
+/**
+ * Persistent Shader Cache Responsibilities:
+ *
+ * 1. Load previously translated shaders from disk.
+ * 2. Append newly translated shaders to disk.
+ * 3. Reject files written by a different build of the shader translator.
+ *
+ * Entries are looked up by the hash of the shader description they were
+ * translated from, which covers the shader binaries and every register that
+ * affects the translation. What an entry holds is up to the translator, the
+ * cache only stores it as an opaque blob, so the same file format serves
+ * both the SPIR-V and GLSL translators.
+ *
+ * A cache file may also be written offline and loaded at startup, so every
+ * shader a title uses is already translated before it is first drawn.
+ */
+class ShaderCache
+{
+public:
+   using Hash = std::array<uint64_t, 2>;
+
+   struct HashHasher
+   {
+      size_t operator()(const Hash &hash) const
+      {
+         return static_cast<size_t>(hash[0] ^ hash[1]);
+      }
+   };
+
+   struct Stats
+   {
+      std::atomic<uint64_t> hits { 0 };
+      std::atomic<uint64_t> misses { 0 };
+      std::atomic<uint64_t> stores { 0 };
+   };
+
+public:
+   ~ShaderCache();
+
+   bool
+   open(const std::string &path,
+        const Hash &translatorHash);
+
+   void
+   close();
+
+   bool
+   isOpen() const
+   {
+      return mOpen;
+   }
+
+   size_t
+   size() const
+   {
+      return mEntries.size();
+   }
+
+   const std::vector<uint8_t> *
+   find(const Hash &hash);
+
+   void
+   store(const Hash &hash,
+         const std::vector<uint8_t> &data);
+
+   const Stats &
+   stats() const
+   {
+      return mStats;
+   }
+
+private:
+   bool
+   load(std::ifstream &in);
+
+   void
+   writeEntry(const Hash &hash,
+              const std::vector<uint8_t> &data);
+
+private:
+   bool mOpen = false;
+   std::string mPath;
+   Hash mTranslatorHash;
+   std::mutex mMutex;
+   std::ofstream mOutput;
+   std::unordered_map<Hash, std::vector<uint8_t>, HashHasher> mEntries;
+   std::unordered_set<Hash, HashHasher> mStored;
+   Stats mStats;
+};
+
+} // namespace gpu
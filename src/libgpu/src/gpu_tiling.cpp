@@ -1,6 +1,8 @@
 #include "gpu_addrlibopt.h"
 #include "gpu_tiling.h"
+#include "gpu7_tiling.h"
 
+#include <common/align.h>
 #include <common/decaf_assert.h>
 #include <cstdlib>
 #include <cstring>
@@ -184,6 +186,37 @@ copySurfacePixels(uint8_t *dstBasePtr,
    }
 }
 
+static bool
+isTilingSupported(uint32_t bpp)
+{
+   return bpp == 8 || bpp == 16 || bpp == 32 || bpp == 64 || bpp == 128;
+}
+
+static gpu7::tiling::SurfaceInfo
+getTiledSurfaceInfo(latte::SQ_TILE_MODE tileMode,
+                    uint32_t swizzle,
+                    uint32_t width,
+                    uint32_t height,
+                    uint32_t depth,
+                    bool isDepth,
+                    uint32_t bpp)
+{
+   auto surface = gpu7::tiling::SurfaceInfo { };
+   auto bankSwizzle = uint32_t { 0 };
+   auto pipeSwizzle = uint32_t { 0 };
+   calcSurfaceBankPipeSwizzle(swizzle, &bankSwizzle, &pipeSwizzle);
+
+   surface.bpp = static_cast<int>(bpp);
+   surface.tileMode = static_cast<gpu7::tiling::TileMode>(tileMode);
+   surface.width = static_cast<int>(width);
+   surface.height = static_cast<int>(height);
+   surface.depth = static_cast<int>(depth);
+   surface.isDepth = isDepth;
+   surface.bankSwizzle = static_cast<int>(bankSwizzle);
+   surface.pipeSwizzle = static_cast<int>(pipeSwizzle);
+   return surface;
+}
+
 bool
 convertFromTiled(
    uint8_t *output,
@@ -209,6 +242,20 @@ convertFromTiled(
    decaf_check(endSlice > 0);
    decaf_check(endSlice <= depth);
 
+   // Single sampled surfaces are untiled a micro tile at a time by gpu7
+   if (aa == 0 && isTilingSupported(bpp)) {
+      auto surface = getTiledSurfaceInfo(tileMode, swizzle, width, height, depth, isDepth, bpp);
+      auto outputSliceSize = static_cast<size_t>(outputPitch) * height * (bpp / 8);
+      gpu7::tiling::untileSlices(surface,
+                                 static_cast<int>(pitch),
+                                 input,
+                                 output + outputSliceSize * beginSlice,
+                                 static_cast<int>(outputPitch),
+                                 static_cast<int>(beginSlice),
+                                 static_cast<int>(endSlice));
+      return true;
+   }
+
    ADDR_COMPUTE_SURFACE_ADDRFROMCOORD_INPUT srcAddrInput;
    std::memset(&srcAddrInput, 0, sizeof(ADDR_COMPUTE_SURFACE_ADDRFROMCOORD_INPUT));
    srcAddrInput.size = sizeof(ADDR_COMPUTE_SURFACE_ADDRFROMCOORD_INPUT);
@@ -285,13 +332,26 @@ convertToTiled(
    decaf_check(endSlice > 0);
    decaf_check(endSlice <= depth);
 
+   // Single sampled surfaces are tiled a micro tile at a time by gpu7
+   if (aa == 0 && isTilingSupported(bpp)) {
+      auto surface = getTiledSurfaceInfo(tileMode, swizzle, width, height, depth, isDepth, bpp);
+      gpu7::tiling::tileSlices(surface,
+                               static_cast<int>(pitch),
+                               input,
+                               static_cast<int>(inputPitch),
+                               output,
+                               static_cast<int>(beginSlice),
+                               static_cast<int>(endSlice));
+      return true;
+   }
+
    ADDR_COMPUTE_SURFACE_ADDRFROMCOORD_INPUT srcAddrInput;
    std::memset(&srcAddrInput, 0, sizeof(ADDR_COMPUTE_SURFACE_ADDRFROMCOORD_INPUT));
    srcAddrInput.size = sizeof(ADDR_COMPUTE_SURFACE_ADDRFROMCOORD_INPUT);
    srcAddrInput.bpp = bpp;
    srcAddrInput.pitch = inputPitch;
    srcAddrInput.height = height;
-   srcAddrInput.numSlices = depth;
+   srcAddrInput.numSlices = endSlice - beginSlice;
    srcAddrInput.numSamples = 1;
    srcAddrInput.tileMode = AddrTileMode::ADDR_TM_LINEAR_GENERAL;
    srcAddrInput.isDepth = isDepth;
@@ -316,8 +376,8 @@ convertToTiled(
    dstAddrInput.compBits = 0;
    dstAddrInput.numFrags = 0;
    calcSurfaceBankPipeSwizzle(swizzle,
-                              &srcAddrInput.bankSwizzle,
-                              &srcAddrInput.pipeSwizzle);
+                              &dstAddrInput.bankSwizzle,
+                              &dstAddrInput.pipeSwizzle);
 
    // Untiling always takes sample 0
    srcAddrInput.sample = 0;
@@ -325,7 +385,7 @@ convertToTiled(
 
    // Untile all of the slices of this surface
    for (uint32_t slice = beginSlice; slice < endSlice; ++slice) {
-      srcAddrInput.slice = slice;
+      srcAddrInput.slice = slice - beginSlice;
       dstAddrInput.slice = slice;
 
       copySurfacePixels(
@@ -336,4 +396,40 @@ convertToTiled(
    return true;
 }
 
+
+/**
+ * Calculates the range of tiled memory which holds [beginSlice, endSlice).
+ *
+ * Thick tile modes interleave their slices in groups, so the range is widened
+ * to cover every group it touches.
+ */
+void
+calculateTiledSliceRange(latte::SQ_TILE_MODE tileMode,
+                         uint32_t pitch,
+                         uint32_t height,
+                         uint32_t depth,
+                         uint32_t aa,
+                         bool isDepth,
+                         uint32_t bpp,
+                         uint32_t beginSlice,
+                         uint32_t endSlice,
+                         uint32_t &offset,
+                         uint32_t &size)
+{
+   if (endSlice == 0) {
+      endSlice = depth;
+   }
+
+   decaf_check(beginSlice < endSlice);
+   decaf_check(endSlice <= depth);
+
+   // A single slice is padded out to a whole group of slices
+   auto surface = getTiledSurfaceInfo(tileMode, 0, pitch, height, 1, isDepth, bpp);
+   auto sliceGroup = static_cast<uint32_t>(gpu7::tiling::calculateAlignedDepth(surface));
+   auto sliceSize = static_cast<uint32_t>(gpu7::tiling::calculateSliceSize(surface)) << aa;
+
+   offset = align_down(beginSlice, sliceGroup) * sliceSize;
+   size = align_up(endSlice, sliceGroup) * sliceSize - offset;
+}
+
 } // namespace gpu
@@ -1,7 +1,20 @@
 #include "null_driver.h"
+#include "gpu_clock.h"
 #include "gpu_event.h"
+#include "gpu_ih.h"
+#include "gpu_memory.h"
 #include "gpu_ringbuffer.h"
 
+#include "latte/latte_endian.h"
+#include "latte/latte_enum_as_string.h"
+
+#include <algorithm>
+#include <common/decaf_assert.h>
+#include <common/log.h>
+#include <fmt/format.h>
+#include <utility>
+#include <vector>
+
 namespace null
 {
 
@@ -12,8 +25,11 @@ Driver::run()
 
    while (mRunning) {
       if (gpu::ringbuffer::wait()) {
-         auto items = gpu::ringbuffer::read();
-         // TODO: We need to actually process pm4 to do EVENT_WRITE_EOP for retired timestamps
+         auto buffer = gpu::ringbuffer::read();
+
+         if (!buffer.empty()) {
+            executeBuffer(buffer);
+         }
       }
    }
 }
@@ -28,8 +44,18 @@ Driver::stop()
 void
 Driver::runUntilFlip()
 {
-   // The null driver does not support "force sync"
-   decaf_check(0);
+   auto startingSwap = mSwapCount;
+
+   while (mSwapCount == startingSwap) {
+      gpu::ringbuffer::wait();
+
+      auto buffer = gpu::ringbuffer::read();
+      if (buffer.empty()) {
+         break;
+      }
+
+      executeBuffer(buffer);
+   }
 }
 
 gpu::GraphicsDriverType
@@ -41,13 +67,20 @@ Driver::type()
 float
 Driver::getAverageFPS()
 {
-   return 0.0f;
+   static const auto second = std::chrono::duration_cast<duration_system_clock>(std::chrono::seconds { 1 }).count();
+   auto avgFrameTime = mAverageFrameTime.count();
+
+   if (avgFrameTime == 0.0) {
+      return 0.0f;
+   } else {
+      return static_cast<float>(second / avgFrameTime);
+   }
 }
 
 float
 Driver::getAverageFrametimeMS()
 {
-   return 0.0f;
+   return static_cast<float>(std::chrono::duration_cast<duration_ms>(mAverageFrameTime).count());
 }
 
 void
@@ -62,4 +95,253 @@ Driver::notifyGpuFlush(phys_addr address,
 {
 }
 
+void
+Driver::executeBuffer(const gpu::ringbuffer::Buffer &buffer)
+{
+   runCommandBuffer(buffer);
+}
+
+void
+Driver::handlePacketType3(latte::pm4::HeaderType3 header,
+                          const gsl::span<uint32_t> &data)
+{
+   mFramePacketCounts[static_cast<uint32_t>(header.opcode()) & 0xFF]++;
+   Pm4Processor::handlePacketType3(header, data);
+}
+
+
+/**
+ * Called for every flip, updates the frame time and reports the packets
+ * processed during the frame.
+ */
+void
+Driver::onSwap()
+{
+   static const auto weight = 0.9;
+   auto now = std::chrono::system_clock::now();
+
+   if (mLastSwap.time_since_epoch().count()) {
+      mAverageFrameTime = weight * mAverageFrameTime + (1.0 - weight) * (now - mLastSwap);
+   }
+
+   mLastSwap = now;
+   mSwapCount++;
+
+   if (gLog->should_log(spdlog::level::debug)) {
+      auto packets = std::vector<std::pair<uint32_t, uint32_t>> { };
+      auto total = 0u;
+
+      for (auto i = 0u; i < mFramePacketCounts.size(); ++i) {
+         if (mFramePacketCounts[i]) {
+            packets.emplace_back(mFramePacketCounts[i], i);
+            total += mFramePacketCounts[i];
+         }
+      }
+
+      std::sort(packets.begin(), packets.end(), std::greater<> { });
+
+      fmt::memory_buffer out;
+      fmt::format_to(out, "Null driver frame {}, {} packets:", mSwapCount, total);
+
+      for (auto &packet : packets) {
+         fmt::format_to(out, " {}={}",
+                        latte::pm4::to_string(static_cast<latte::pm4::IT_OPCODE>(packet.second)),
+                        packet.first);
+      }
+
+      gLog->debug("{}", std::string { out.data(), out.size() });
+   }
+
+   mFramePacketCounts.fill(0);
+   gpu::onFlip();
+}
+
+void
+Driver::decafSetBuffer(const latte::pm4::DecafSetBuffer &data)
+{
+}
+
+void
+Driver::decafCopyColorToScan(const latte::pm4::DecafCopyColorToScan &data)
+{
+}
+
+void
+Driver::decafSwapBuffers(const latte::pm4::DecafSwapBuffers &data)
+{
+   onSwap();
+}
+
+void
+Driver::decafCapSyncRegisters(const latte::pm4::DecafCapSyncRegisters &data)
+{
+   gpu::onSyncRegisters(mRegisters.data(), static_cast<uint32_t>(mRegisters.size()));
+}
+
+void
+Driver::decafClearColor(const latte::pm4::DecafClearColor &data)
+{
+}
+
+void
+Driver::decafClearDepthStencil(const latte::pm4::DecafClearDepthStencil &data)
+{
+}
+
+void
+Driver::decafOSScreenFlip(const latte::pm4::DecafOSScreenFlip &data)
+{
+   onSwap();
+}
+
+void
+Driver::decafCopySurface(const latte::pm4::DecafCopySurface &data)
+{
+}
+
+void
+Driver::decafExpandColorBuffer(const latte::pm4::DecafExpandColorBuffer &data)
+{
+}
+
+void
+Driver::drawIndexAuto(const latte::pm4::DrawIndexAuto &data)
+{
+}
+
+void
+Driver::drawIndex2(const latte::pm4::DrawIndex2 &data)
+{
+}
+
+void
+Driver::drawIndexImmd(const latte::pm4::DrawIndexImmd &data)
+{
+}
+
+void
+Driver::memWrite(const latte::pm4::MemWrite &data)
+{
+   auto addr = phys_addr { data.addrLo.ADDR_LO() << 2 };
+   auto ptr = gpu::internal::translateAddress(addr);
+   auto value = uint64_t { 0 };
+
+   // Read value
+   if (data.addrHi.CNTR_SEL() == latte::pm4::MW_WRITE_CLOCK) {
+      value = gpu::clock::now();
+   } else if (data.addrHi.DATA32()) {
+      value = static_cast<uint64_t>(data.dataLo);
+   } else {
+      value = static_cast<uint64_t>(data.dataLo) |
+              (static_cast<uint64_t>(data.dataHi) << 32);
+   }
+
+   // Swap value
+   value = latte::applyEndianSwap(value, data.addrLo.ENDIAN_SWAP());
+
+   // Write value
+   if (data.addrHi.DATA32()) {
+      *reinterpret_cast<uint32_t *>(ptr) = static_cast<uint32_t>(value);
+   } else {
+      *reinterpret_cast<uint64_t *>(ptr) = value;
+   }
+}
+
+void
+Driver::eventWrite(const latte::pm4::EventWrite &data)
+{
+   auto addr = phys_addr { data.addrLo.ADDR_LO() << 2 };
+   decaf_assert(data.addrHi.ADDR_HI() == 0, "Invalid event write address (high word not zero)");
+
+   // We do not draw anything, so occlusion queries always report zero
+   // samples passed.
+   if (data.eventInitiator.EVENT_TYPE() == latte::VGT_EVENT_TYPE::ZPASS_DONE) {
+      auto ptr = gpu::internal::translateAddress(addr);
+      *reinterpret_cast<uint64_t *>(ptr) = 0;
+   }
+}
+
+void
+Driver::eventWriteEOP(const latte::pm4::EventWriteEOP &data)
+{
+   // Write event data to memory if required
+   if (data.addrHi.DATA_SEL() != latte::pm4::EWP_DATA_DISCARD) {
+      auto addr = phys_addr { data.addrLo.ADDR_LO() << 2 };
+      auto ptr = gpu::internal::translateAddress(addr);
+      decaf_assert(data.addrHi.ADDR_HI() == 0, "Invalid event write address (high word not zero)");
+
+      // Read value
+      auto value = uint64_t { 0u };
+      switch (data.addrHi.DATA_SEL()) {
+      case latte::pm4::EWP_DATA_32:
+         value = data.dataLo;
+         break;
+      case latte::pm4::EWP_DATA_64:
+         value = static_cast<uint64_t>(data.dataLo) |
+                 (static_cast<uint64_t>(data.dataHi) << 32);
+         break;
+      case latte::pm4::EWP_DATA_CLOCK:
+         value = gpu::clock::now();
+         break;
+      }
+
+      // Swap value
+      value = latte::applyEndianSwap(value, data.addrLo.ENDIAN_SWAP());
+
+      // Write value
+      switch (data.addrHi.DATA_SEL()) {
+      case latte::pm4::EWP_DATA_32:
+         *reinterpret_cast<uint32_t *>(ptr) = static_cast<uint32_t>(value);
+         break;
+      case latte::pm4::EWP_DATA_64:
+      case latte::pm4::EWP_DATA_CLOCK:
+         *reinterpret_cast<uint64_t *>(ptr) = value;
+         break;
+      }
+   }
+
+   // Generate interrupt if required, this is what retires timestamps
+   if (data.addrHi.INT_SEL() != latte::pm4::EWP_INT_NONE) {
+      auto interrupt = gpu::ih::Entry { };
+      interrupt.word0 = latte::CP_INT_SRC_ID::CP_EOP_EVENT;
+      gpu::ih::write(interrupt);
+   }
+}
+
+void
+Driver::pfpSyncMe(const latte::pm4::PfpSyncMe &data)
+{
+}
+
+void
+Driver::setPredication(const latte::pm4::SetPredication &data)
+{
+}
+
+void
+Driver::streamOutBaseUpdate(const latte::pm4::StreamOutBaseUpdate &data)
+{
+}
+
+void
+Driver::streamOutBufferUpdate(const latte::pm4::StreamOutBufferUpdate &data)
+{
+   // Nothing is ever streamed out, so the filled size is always zero
+   if (data.control.STORE_BUFFER_FILLED_SIZE() && data.dstLo) {
+      decaf_assert(data.dstHi == 0, "Store target out of 32-bit range for feedback buffer");
+      *gpu::internal::translateAddress<uint32_t>(data.dstLo) = 0;
+   }
+}
+
+void
+Driver::surfaceSync(const latte::pm4::SurfaceSync &data)
+{
+   // There are no host copies of guest memory to synchronise
+}
+
+void
+Driver::applyRegister(latte::Register reg)
+{
+}
+
 } // namespace null
@@ -1,10 +1,22 @@
 #pragma once
 #include "gpu_graphicsdriver.h"
+#include "pm4_processor.h"
+
+#include <array>
+#include <atomic>
+#include <chrono>
 
 namespace null
 {
 
-class Driver : public gpu::GraphicsDriver
+/**
+ * A graphics driver which does no rendering.
+ *
+ * Every PM4 packet is still parsed so that memory writes, end of pipe events
+ * and flips happen as the guest expects, which lets titles which wait on GPU
+ * timestamps or flips run headless.
+ */
+class Driver : public gpu::GraphicsDriver, public Pm4Processor
 {
 public:
    virtual ~Driver() = default;
@@ -22,7 +34,45 @@ public:
    virtual void notifyGpuFlush(phys_addr address, uint32_t size) override;
 
 private:
-   bool mRunning = false;
+   void executeBuffer(const gpu::ringbuffer::Buffer &buffer);
+   void onSwap();
+
+   virtual void decafSetBuffer(const latte::pm4::DecafSetBuffer &data) override;
+   virtual void decafCopyColorToScan(const latte::pm4::DecafCopyColorToScan &data) override;
+   virtual void decafSwapBuffers(const latte::pm4::DecafSwapBuffers &data) override;
+   virtual void decafCapSyncRegisters(const latte::pm4::DecafCapSyncRegisters &data) override;
+   virtual void decafClearColor(const latte::pm4::DecafClearColor &data) override;
+   virtual void decafClearDepthStencil(const latte::pm4::DecafClearDepthStencil &data) override;
+   virtual void decafOSScreenFlip(const latte::pm4::DecafOSScreenFlip &data) override;
+   virtual void decafCopySurface(const latte::pm4::DecafCopySurface &data) override;
+   virtual void decafExpandColorBuffer(const latte::pm4::DecafExpandColorBuffer &data) override;
+   virtual void drawIndexAuto(const latte::pm4::DrawIndexAuto &data) override;
+   virtual void drawIndex2(const latte::pm4::DrawIndex2 &data) override;
+   virtual void drawIndexImmd(const latte::pm4::DrawIndexImmd &data) override;
+   virtual void memWrite(const latte::pm4::MemWrite &data) override;
+   virtual void eventWrite(const latte::pm4::EventWrite &data) override;
+   virtual void eventWriteEOP(const latte::pm4::EventWriteEOP &data) override;
+   virtual void pfpSyncMe(const latte::pm4::PfpSyncMe &data) override;
+   virtual void setPredication(const latte::pm4::SetPredication &data) override;
+   virtual void streamOutBaseUpdate(const latte::pm4::StreamOutBaseUpdate &data) override;
+   virtual void streamOutBufferUpdate(const latte::pm4::StreamOutBufferUpdate &data) override;
+   virtual void surfaceSync(const latte::pm4::SurfaceSync &data) override;
+   virtual void applyRegister(latte::Register reg) override;
+   virtual void handlePacketType3(latte::pm4::HeaderType3 header, const gsl::span<uint32_t> &data) override;
+
+private:
+   using duration_system_clock = std::chrono::duration<double, std::chrono::system_clock::period>;
+   using duration_ms = std::chrono::duration<double, std::chrono::milliseconds::period>;
+
+   std::atomic_bool mRunning { false };
+
+   //! Number of flips seen, used by runUntilFlip.
+   uint64_t mSwapCount = 0;
+   std::chrono::time_point<std::chrono::system_clock> mLastSwap;
+   duration_system_clock mAverageFrameTime { 0.0 };
+
+   //! Number of type 3 packets seen this frame, indexed by opcode.
+   std::array<uint32_t, 256> mFramePacketCounts = { 0 };
 };
 
 } // namespace null
@@ -282,9 +282,7 @@ GLDriver::drawPrimitivesIndexed(const void *buffer,
          decaf_abort(fmt::format("Unexpected INDEX_TYPE {} for VGT_DMA_SWAP_16_BIT", vgt_dma_index_type.INDEX_TYPE()));
       }
 
-      for (auto i = 0u; i < count; ++i) {
-         indices[i] = byte_swap(src[i]);
-      }
+      byte_swap_to(indices.data(), src, count);
 
       drawPrimitives(count,
                      indices.data(),
@@ -297,9 +295,7 @@ GLDriver::drawPrimitivesIndexed(const void *buffer,
          decaf_abort(fmt::format("Unexpected INDEX_TYPE {} for VGT_DMA_SWAP_32_BIT", vgt_dma_index_type.INDEX_TYPE()));
       }
 
-      for (auto i = 0u; i < count; ++i) {
-         indices[i] = byte_swap(src[i]);
-      }
+      byte_swap_to(indices.data(), src, count);
 
       drawPrimitives(count,
                      indices.data(),
@@ -2,6 +2,8 @@
 #include "gpu_memory.h"
 #include "pm4_processor.h"
 
+#include <algorithm>
+#include <common/byte_swap.h>
 #include <common/log.h>
 #include <libcpu/mmu.h>
 
@@ -22,16 +24,41 @@ Pm4Processor::indirectBufferCallPriv(const IndirectBufferCallPriv &data)
 void
 Pm4Processor::runCommandBuffer(const gpu::ringbuffer::Buffer &buffer)
 {
-   std::vector<uint32_t> swapped;
-   swapped.resize(buffer.size());
+   // INDIRECT_BUFFER packets call back into runCommandBuffer while the outer
+   // buffer is still being processed, so each level of nesting gets its own
+   // scratch buffer. These are reused so there is no allocation per buffer.
+   auto depth = mCommandBufferDepth++;
+   if (mSwapScratch.size() <= depth) {
+      mSwapScratch.resize(depth + 1);
+   }
 
-   for (auto i = 0u; i < buffer.size(); ++i) {
-      swapped[i] = byte_swap(buffer[i]);
+   auto &scratch = mSwapScratch[depth];
+   if (scratch.size() < static_cast<size_t>(buffer.size())) {
+      scratch.resize(buffer.size());
    }
 
-   for (auto pos = 0u; pos < swapped.size(); ) {
+   // The resize of mSwapScratch by a nested call moves the scratch vectors
+   // but not their storage, so this pointer remains valid.
+   auto swapped = scratch.data();
+   auto bufferSize = static_cast<size_t>(buffer.size());
+   auto swappedSize = size_t { 0 };
+
+   // Swap the buffer lazily in chunks ahead of the packet being processed,
+   // large enough that the bulk swap stays efficient but we do not swap what
+   // follows a terminating zero word.
+   auto swapUpTo = [&](size_t end) {
+      if (end > swappedSize) {
+         auto chunkEnd = std::min(bufferSize, std::max(end, swappedSize + SwapChunkWords));
+         byte_swap_to(swapped + swappedSize, buffer.data() + swappedSize, chunkEnd - swappedSize);
+         swappedSize = chunkEnd;
+      }
+   };
+
+   for (auto pos = size_t { 0u }; pos < bufferSize; ) {
+      swapUpTo(pos + 1);
+
       auto header = *reinterpret_cast<Header *>(&swapped[pos]);
-      auto size = 0u;
+      auto size = size_t { 0u };
 
       if (swapped[pos] == 0) {
          break;
@@ -43,7 +70,8 @@ Pm4Processor::runCommandBuffer(const gpu::ringbuffer::Buffer &buffer)
          auto header3 = HeaderType3::get(header.value);
          size = header3.size() + 1;
 
-         decaf_check(pos + size <= swapped.size());
+         decaf_check(pos + size < bufferSize);
+         swapUpTo(pos + size + 1);
          handlePacketType3(header3, gsl::make_span(&swapped[pos + 1], size));
          break;
       }
@@ -52,7 +80,8 @@ Pm4Processor::runCommandBuffer(const gpu::ringbuffer::Buffer &buffer)
          auto header0 = HeaderType0::get(header.value);
          size = header0.count() + 1;
 
-         decaf_check(pos + size <= swapped.size());
+         decaf_check(pos + size < bufferSize);
+         swapUpTo(pos + size + 1);
          handlePacketType0(header0, gsl::make_span(&swapped[pos + 1], size));
          break;
       }
@@ -65,12 +94,14 @@ Pm4Processor::runCommandBuffer(const gpu::ringbuffer::Buffer &buffer)
       default:
          gLog->error("Invalid packet header type {}, header = 0x{:08X}",
                      header.type(), header.value);
-         pos = static_cast<uint32_t>(swapped.size());
+         pos = bufferSize;
          break;
       }
 
       pos += size + 1;
    }
+
+   mCommandBufferDepth--;
 }
 
 void
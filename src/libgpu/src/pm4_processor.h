@@ -33,7 +33,7 @@ protected:
    virtual void surfaceSync(const SurfaceSync &data) = 0;
 
    void handlePacketType0(HeaderType0 header, const gsl::span<uint32_t> &data);
-   void handlePacketType3(HeaderType3 header, const gsl::span<uint32_t> &data);
+   virtual void handlePacketType3(HeaderType3 header, const gsl::span<uint32_t> &data);
    void nopPacket(const Nop &data);
    void indirectBufferCall(const IndirectBufferCall &data);
    void indirectBufferCallPriv(const IndirectBufferCallPriv &data);
@@ -85,6 +85,13 @@ protected:
       decaf_abort("Unsupported register address fetch");
    }
 
+   //! Number of words byte swapped at a time by runCommandBuffer.
+   static constexpr auto SwapChunkWords = size_t { 1024 };
+
+   //! Byte swapped packets for each level of indirect buffer nesting.
+   std::vector<std::vector<uint32_t>> mSwapScratch;
+   uint32_t mCommandBufferDepth = 0;
+
    latte::ShadowState mShadowState;
    std::array<uint32_t, 0x10000> mRegisters = { 0 };
    phys_addr mRegAddr_VGT_STRMOUT_DRAW_OPAQUE_BUFFER_FILLED_SIZE = phys_addr { 0 };
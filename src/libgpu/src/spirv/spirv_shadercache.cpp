@@ -0,0 +1,242 @@
+#ifdef DECAF_VULKAN
+#include "spirv_translate.h"
+#include "gpu_shadercache.h"
+
+#include <common/log.h>
+#include <cstring>
+#include <type_traits>
+
+// Set by the build from a hash of the translator source
+#ifndef SPIRV_TRANSLATOR_HASH0
+#define SPIRV_TRANSLATOR_HASH0 0
+#endif
+
+#ifndef SPIRV_TRANSLATOR_HASH1
+#define SPIRV_TRANSLATOR_HASH1 0
+#endif
+
+namespace spirv
+{
+
+class ShaderWriter
+{
+public:
+   ShaderWriter(std::vector<uint8_t> &data) :
+      mData(data)
+   {
+   }
+
+   template<typename Type>
+   void write(const Type &value)
+   {
+      static_assert(std::is_trivially_copyable<Type>::value, "Cached types must be trivial");
+      auto bytes = reinterpret_cast<const uint8_t *>(&value);
+      mData.insert(mData.end(), bytes, bytes + sizeof(Type));
+   }
+
+   template<typename Type>
+   void write(const std::vector<Type> &values)
+   {
+      static_assert(std::is_trivially_copyable<Type>::value, "Cached types must be trivial");
+      auto bytes = reinterpret_cast<const uint8_t *>(values.data());
+      write(static_cast<uint32_t>(values.size()));
+      mData.insert(mData.end(), bytes, bytes + values.size() * sizeof(Type));
+   }
+
+private:
+   std::vector<uint8_t> &mData;
+};
+
+class ShaderReader
+{
+public:
+   ShaderReader(const std::vector<uint8_t> &data) :
+      mPos(data.data()),
+      mEnd(data.data() + data.size())
+   {
+   }
+
+   template<typename Type>
+   bool read(Type &value)
+   {
+      static_assert(std::is_trivially_copyable<Type>::value, "Cached types must be trivial");
+      if (static_cast<size_t>(mEnd - mPos) < sizeof(Type)) {
+         return false;
+      }
+
+      std::memcpy(&value, mPos, sizeof(Type));
+      mPos += sizeof(Type);
+      return true;
+   }
+
+   template<typename Type>
+   bool read(std::vector<Type> &values)
+   {
+      static_assert(std::is_trivially_copyable<Type>::value, "Cached types must be trivial");
+      auto size = uint32_t { 0 };
+      if (!read(size) || static_cast<size_t>(mEnd - mPos) / sizeof(Type) < size) {
+         return false;
+      }
+
+      values.resize(size);
+      std::memcpy(values.data(), mPos, size * sizeof(Type));
+      mPos += size * sizeof(Type);
+      return true;
+   }
+
+   bool atEnd() const
+   {
+      return mPos == mEnd;
+   }
+
+private:
+   const uint8_t *mPos;
+   const uint8_t *mEnd;
+};
+
+std::array<uint64_t, 2>
+getTranslatorHash()
+{
+   return { SPIRV_TRANSLATOR_HASH0, SPIRV_TRANSLATOR_HASH1 };
+}
+
+static void
+writeShader(ShaderWriter &writer, const Shader &shader)
+{
+   writer.write(shader.binary);
+   writer.write(shader.samplerUsed);
+   writer.write(shader.textureUsed);
+   writer.write(shader.cbufferUsed);
+}
+
+static void
+writeShader(ShaderWriter &writer, const VertexShader &shader)
+{
+   writeShader(writer, static_cast<const Shader &>(shader));
+   writer.write(shader.inputBuffers);
+   writer.write(shader.inputAttribs);
+   writer.write(shader.outputSemantics);
+   writer.write(shader.rectStubBinary);
+}
+
+static void
+writeShader(ShaderWriter &writer, const GeometryShader &shader)
+{
+   writeShader(writer, static_cast<const Shader &>(shader));
+   writer.write(shader.outputSemantics);
+}
+
+static bool
+readShader(ShaderReader &reader, Shader &shader)
+{
+   return reader.read(shader.binary)
+       && reader.read(shader.samplerUsed)
+       && reader.read(shader.textureUsed)
+       && reader.read(shader.cbufferUsed);
+}
+
+static bool
+readShader(ShaderReader &reader, VertexShader &shader)
+{
+   return readShader(reader, static_cast<Shader &>(shader))
+       && reader.read(shader.inputBuffers)
+       && reader.read(shader.inputAttribs)
+       && reader.read(shader.outputSemantics)
+       && reader.read(shader.rectStubBinary);
+}
+
+static bool
+readShader(ShaderReader &reader, GeometryShader &shader)
+{
+   return readShader(reader, static_cast<Shader &>(shader))
+       && reader.read(shader.outputSemantics);
+}
+
+template<typename Type>
+static bool
+readShaderData(ShaderType expectedType, const std::vector<uint8_t> &data, Shader *shader)
+{
+   // Read into a new shader, so a bad entry leaves nothing behind for
+   // translate to append to.
+   auto reader = ShaderReader { data };
+   auto type = ShaderType::Unknown;
+   auto loaded = Type { };
+
+   if (!reader.read(type) || type != expectedType ||
+       !readShader(reader, loaded) || !reader.atEnd() ||
+       loaded.binary.empty()) {
+      return false;
+   }
+
+   *static_cast<Type *>(shader) = std::move(loaded);
+   return true;
+}
+
+bool
+saveShader(ShaderType type, const Shader *shader, std::vector<uint8_t> &data)
+{
+   auto writer = ShaderWriter { data };
+   writer.write(type);
+
+   switch (type) {
+   case ShaderType::Vertex:
+      writeShader(writer, *static_cast<const VertexShader *>(shader));
+      break;
+   case ShaderType::Geometry:
+      writeShader(writer, *static_cast<const GeometryShader *>(shader));
+      break;
+   case ShaderType::Pixel:
+      writeShader(writer, *static_cast<const PixelShader *>(shader));
+      break;
+   default:
+      return false;
+   }
+
+   return true;
+}
+
+bool
+loadShader(ShaderType type, const std::vector<uint8_t> &data, Shader *shader)
+{
+   switch (type) {
+   case ShaderType::Vertex:
+      return readShaderData<VertexShader>(type, data, shader);
+   case ShaderType::Geometry:
+      return readShaderData<GeometryShader>(type, data, shader);
+   case ShaderType::Pixel:
+      return readShaderData<PixelShader>(type, data, shader);
+   default:
+      return false;
+   }
+}
+
+bool
+translate(gpu::ShaderCache &cache, const ShaderDesc &shaderDesc, const DataHash &hash, Shader *shader)
+{
+   auto key = hash.value();
+
+   if (auto data = cache.find(key)) {
+      if (loadShader(shaderDesc.type, *data, shader)) {
+         return true;
+      }
+
+      gLog->warn("Discarding bad shader cache entry {:016X}{:016X}", key[0], key[1]);
+   }
+
+   if (!translate(shaderDesc, shader)) {
+      return false;
+   }
+
+   if (cache.isOpen()) {
+      auto data = std::vector<uint8_t> { };
+      if (saveShader(shaderDesc.type, shader, data)) {
+         cache.store(key, data);
+      }
+   }
+
+   return true;
+}
+
+} // namespace spirv
+
+#endif // ifdef DECAF_VULKAN
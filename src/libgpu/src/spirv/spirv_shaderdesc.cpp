@@ -0,0 +1,239 @@
+#ifdef DECAF_VULKAN
+#include "spirv_translate.h"
+#include "latte/latte_registers.h"
+
+#include <common/decaf_assert.h>
+#include <libcpu/pointer.h>
+
+namespace spirv
+{
+
+template<typename Type>
+static Type
+getRegister(const RegisterFile &registers,
+            uint32_t id)
+{
+   static_assert(sizeof(Type) == 4, "Register storage must be a uint32_t");
+   return *reinterpret_cast<const Type *>(&registers[id / 4]);
+}
+
+VertexShaderDesc
+getVertexShaderDesc(const RegisterFile &registers,
+                    bool isRectDraw)
+{
+   gsl::span<uint8_t> fsShaderBinary;
+   gsl::span<uint8_t> vsShaderBinary;
+
+   auto pgm_start_fs = getRegister<latte::SQ_PGM_START_FS>(registers, latte::Register::SQ_PGM_START_FS);
+   auto pgm_offset_fs = getRegister<latte::SQ_PGM_CF_OFFSET_FS>(registers, latte::Register::SQ_PGM_CF_OFFSET_FS);
+   auto pgm_size_fs = getRegister<latte::SQ_PGM_SIZE_FS>(registers, latte::Register::SQ_PGM_SIZE_FS);
+   fsShaderBinary = gsl::make_span(
+      phys_cast<uint8_t*>(phys_addr(pgm_start_fs.PGM_START() << 8)).getRawPointer(),
+      pgm_size_fs.PGM_SIZE() << 3);
+   decaf_check(pgm_offset_fs.PGM_OFFSET() == 0);
+
+   auto vgt_gs_mode = getRegister<latte::VGT_GS_MODE>(registers, latte::Register::VGT_GS_MODE);
+   if (vgt_gs_mode.MODE() == latte::VGT_GS_ENABLE_MODE::OFF) {
+      // When GS is disabled, vertex shader comes from vertex shader register
+      auto pgm_start_vs = getRegister<latte::SQ_PGM_START_VS>(registers, latte::Register::SQ_PGM_START_VS);
+      auto pgm_offset_vs = getRegister<latte::SQ_PGM_CF_OFFSET_VS>(registers, latte::Register::SQ_PGM_CF_OFFSET_VS);
+      auto pgm_size_vs = getRegister<latte::SQ_PGM_SIZE_VS>(registers, latte::Register::SQ_PGM_SIZE_VS);
+      vsShaderBinary = gsl::make_span(
+         phys_cast<uint8_t*>(phys_addr(pgm_start_vs.PGM_START() << 8)).getRawPointer(),
+         pgm_size_vs.PGM_SIZE() << 3);
+      decaf_check(pgm_offset_vs.PGM_OFFSET() == 0);
+   } else {
+      // When GS is enabled, vertex shader comes from export shader register
+      auto pgm_start_es = getRegister<latte::SQ_PGM_START_ES>(registers, latte::Register::SQ_PGM_START_ES);
+      auto pgm_offset_es = getRegister<latte::SQ_PGM_CF_OFFSET_ES>(registers, latte::Register::SQ_PGM_CF_OFFSET_ES);
+      auto pgm_size_es = getRegister<latte::SQ_PGM_SIZE_ES>(registers, latte::Register::SQ_PGM_SIZE_ES);
+
+      vsShaderBinary = gsl::make_span(
+         phys_cast<uint8_t*>(phys_addr(pgm_start_es.PGM_START() << 8)).getRawPointer(),
+         pgm_size_es.PGM_SIZE() << 3);
+      decaf_check(pgm_offset_es.PGM_OFFSET() == 0);
+   }
+
+   VertexShaderDesc shaderDesc;
+
+   shaderDesc.type = ShaderType::Vertex;
+   shaderDesc.binary = vsShaderBinary;
+   shaderDesc.fsBinary = fsShaderBinary;
+
+   auto sq_config = getRegister<latte::SQ_CONFIG>(registers, latte::Register::SQ_CONFIG);
+   shaderDesc.aluInstPreferVector = sq_config.ALU_INST_PREFER_VECTOR();
+
+   for (auto i = 0; i < latte::MaxTextures; ++i) {
+      auto resourceOffset = (latte::SQ_RES_OFFSET::VS_TEX_RESOURCE_0 + i) * 7;
+      auto sq_tex_resource_word0 = getRegister<latte::SQ_TEX_RESOURCE_WORD0_N>(registers, latte::Register::SQ_RESOURCE_WORD0_0 + 4 * resourceOffset);
+      auto sq_tex_resource_word4 = getRegister<latte::SQ_TEX_RESOURCE_WORD4_N>(registers, latte::Register::SQ_RESOURCE_WORD4_0 + 4 * resourceOffset);
+      shaderDesc.texDims[i] = sq_tex_resource_word0.DIM();
+      shaderDesc.texIsUint[i] = (sq_tex_resource_word4.NUM_FORMAT_ALL() == latte::SQ_NUM_FORMAT::INT);
+   }
+
+   shaderDesc.generateRectStub = isRectDraw;
+
+   shaderDesc.regs.sq_pgm_resources_vs = getRegister<latte::SQ_PGM_RESOURCES_VS>(registers, latte::Register::SQ_PGM_RESOURCES_VS);
+   shaderDesc.regs.pa_cl_vs_out_cntl = getRegister<latte::PA_CL_VS_OUT_CNTL>(registers, latte::Register::PA_CL_VS_OUT_CNTL);
+   shaderDesc.regs.spi_vs_out_config = getRegister<latte::SPI_VS_OUT_CONFIG>(registers, latte::Register::SPI_VS_OUT_CONFIG);
+
+   for (auto i = 0u; i < 32; ++i) {
+      shaderDesc.regs.sq_vtx_semantics[i] = getRegister<latte::SQ_VTX_SEMANTIC_N>(registers, latte::Register::SQ_VTX_SEMANTIC_0 + i * 4);
+   }
+
+   for (auto i = 0; i < 10; ++i) {
+      shaderDesc.regs.spi_vs_out_ids[i] = getRegister<latte::SPI_VS_OUT_ID_N>(registers, latte::Register::SPI_VS_OUT_ID_0 + i * 4);
+   }
+
+   shaderDesc.instanceStepRates[0] = getRegister<uint32_t>(registers, latte::Register::VGT_INSTANCE_STEP_RATE_0);
+   shaderDesc.instanceStepRates[1] = getRegister<uint32_t>(registers, latte::Register::VGT_INSTANCE_STEP_RATE_1);
+
+   return shaderDesc;
+}
+
+GeometryShaderDesc
+getGeometryShaderDesc(const RegisterFile &registers)
+{
+   // Do not generate geometry shaders if they are disabled
+   auto vgt_gs_mode = getRegister<latte::VGT_GS_MODE>(registers, latte::Register::VGT_GS_MODE);
+   if (vgt_gs_mode.MODE() == latte::VGT_GS_ENABLE_MODE::OFF) {
+      return GeometryShaderDesc();
+   }
+
+   gsl::span<uint8_t> gsShaderBinary;
+   gsl::span<uint8_t> dcShaderBinary;
+
+   // Geometry shader comes from geometry shader register
+   auto pgm_start_gs = getRegister<latte::SQ_PGM_START_VS>(registers, latte::Register::SQ_PGM_START_GS);
+   auto pgm_offset_gs = getRegister<latte::SQ_PGM_CF_OFFSET_GS>(registers, latte::Register::SQ_PGM_CF_OFFSET_GS);
+   auto pgm_size_gs = getRegister<latte::SQ_PGM_SIZE_GS>(registers, latte::Register::SQ_PGM_SIZE_GS);
+   gsShaderBinary = gsl::make_span(
+      phys_cast<uint8_t*>(phys_addr(pgm_start_gs.PGM_START() << 8)).getRawPointer(),
+      pgm_size_gs.PGM_SIZE() << 3);
+   decaf_check(pgm_offset_gs.PGM_OFFSET() == 0);
+
+   // Data cache shader comes from vertex shader register
+   auto pgm_start_vs = getRegister<latte::SQ_PGM_START_VS>(registers, latte::Register::SQ_PGM_START_VS);
+   auto pgm_offset_vs = getRegister<latte::SQ_PGM_CF_OFFSET_VS>(registers, latte::Register::SQ_PGM_CF_OFFSET_VS);
+   auto pgm_size_vs = getRegister<latte::SQ_PGM_SIZE_VS>(registers, latte::Register::SQ_PGM_SIZE_VS);
+   dcShaderBinary = gsl::make_span(
+      phys_cast<uint8_t*>(phys_addr(pgm_start_vs.PGM_START() << 8)).getRawPointer(),
+      pgm_size_vs.PGM_SIZE() << 3);
+   decaf_check(pgm_offset_vs.PGM_OFFSET() == 0);
+
+   // If Geometry shading is enabled, we need to have a geometry shader, and data-cache
+   //  shaders must always be set if a geometry shader is used.
+   decaf_check(!gsShaderBinary.empty());
+   decaf_check(!dcShaderBinary.empty());
+
+   // Need to generate the shader here...
+   GeometryShaderDesc shaderDesc;
+
+   shaderDesc.type = ShaderType::Geometry;
+   shaderDesc.binary = gsShaderBinary;
+   shaderDesc.dcBinary = dcShaderBinary;
+
+   auto sq_config = getRegister<latte::SQ_CONFIG>(registers, latte::Register::SQ_CONFIG);
+   shaderDesc.aluInstPreferVector = sq_config.ALU_INST_PREFER_VECTOR();
+
+   for (auto i = 0; i < latte::MaxTextures; ++i) {
+      auto resourceOffset = (latte::SQ_RES_OFFSET::GS_TEX_RESOURCE_0 + i) * 7;
+      auto sq_tex_resource_word0 = getRegister<latte::SQ_TEX_RESOURCE_WORD0_N>(registers, latte::Register::SQ_RESOURCE_WORD0_0 + 4 * resourceOffset);
+      auto sq_tex_resource_word4 = getRegister<latte::SQ_TEX_RESOURCE_WORD4_N>(registers, latte::Register::SQ_RESOURCE_WORD4_0 + 4 * resourceOffset);
+      shaderDesc.texDims[i] = sq_tex_resource_word0.DIM();
+      shaderDesc.texIsUint[i] = (sq_tex_resource_word4.NUM_FORMAT_ALL() == latte::SQ_NUM_FORMAT::INT);
+   }
+
+   shaderDesc.regs.sq_gs_vert_itemsize = getRegister<latte::SQ_GS_VERT_ITEMSIZE>(registers, latte::Register::SQ_GS_VERT_ITEMSIZE);
+   shaderDesc.regs.vgt_gs_out_prim_type = getRegister<latte::VGT_GS_OUT_PRIMITIVE_TYPE>(registers, latte::Register::VGT_GS_OUT_PRIM_TYPE);
+   shaderDesc.regs.vgt_gs_mode = getRegister<latte::VGT_GS_MODE>(registers, latte::Register::VGT_GS_MODE);
+   shaderDesc.regs.sq_gsvs_ring_itemsize = getRegister<uint32_t>(registers, latte::Register::SQ_GSVS_RING_ITEMSIZE);
+   shaderDesc.regs.spi_vs_out_config = getRegister<latte::SPI_VS_OUT_CONFIG>(registers, latte::Register::SPI_VS_OUT_CONFIG);
+   shaderDesc.regs.pa_cl_vs_out_cntl = getRegister<latte::PA_CL_VS_OUT_CNTL>(registers, latte::Register::PA_CL_VS_OUT_CNTL);
+
+   for (auto i = 0; i < 10; ++i) {
+      shaderDesc.regs.spi_vs_out_ids[i] = getRegister<latte::SPI_VS_OUT_ID_N>(registers, latte::Register::SPI_VS_OUT_ID_0 + i * 4);
+   }
+
+   return shaderDesc;
+}
+
+PixelShaderDesc
+getPixelShaderDesc(const RegisterFile &registers,
+                   const std::vector<uint32_t> &vsOutputSemantics)
+{
+   // Do not generate pixel shaders if rasterization is disabled
+   auto pa_cl_clip_cntl = getRegister<latte::PA_CL_CLIP_CNTL>(registers, latte::Register::PA_CL_CLIP_CNTL);
+   if (pa_cl_clip_cntl.RASTERISER_DISABLE()) {
+      return PixelShaderDesc();
+   }
+
+   gsl::span<uint8_t> psShaderBinary;
+
+   auto pgm_start_ps = getRegister<latte::SQ_PGM_START_PS>(registers, latte::Register::SQ_PGM_START_PS);
+   auto pgm_offset_ps = getRegister<latte::SQ_PGM_CF_OFFSET_PS>(registers, latte::Register::SQ_PGM_CF_OFFSET_PS);
+   auto pgm_size_ps = getRegister<latte::SQ_PGM_SIZE_PS>(registers, latte::Register::SQ_PGM_SIZE_PS);
+   psShaderBinary = gsl::make_span(
+      phys_cast<uint8_t*>(phys_addr(pgm_start_ps.PGM_START() << 8)).getRawPointer(),
+      pgm_size_ps.PGM_SIZE() << 3);
+   decaf_check(pgm_offset_ps.PGM_OFFSET() == 0);
+
+   PixelShaderDesc shaderDesc;
+
+   shaderDesc.type = ShaderType::Pixel;
+   shaderDesc.binary = psShaderBinary;
+
+   auto sq_config = getRegister<latte::SQ_CONFIG>(registers, latte::Register::SQ_CONFIG);
+   shaderDesc.aluInstPreferVector = sq_config.ALU_INST_PREFER_VECTOR();
+
+   for (auto i = 0; i < latte::MaxRenderTargets; ++i) {
+      auto cb_color_info = getRegister<latte::CB_COLORN_INFO>(registers, latte::Register::CB_COLOR0_INFO + i * 4);
+
+      ColorOutputType pixelOutType;
+      switch (cb_color_info.NUMBER_TYPE()) {
+      case latte::CB_NUMBER_TYPE::SINT:
+         pixelOutType = ColorOutputType::SINT;
+         break;
+      case latte::CB_NUMBER_TYPE::UINT:
+         pixelOutType = ColorOutputType::UINT;
+         break;
+      default:
+         pixelOutType = ColorOutputType::FLOAT;
+         break;
+      }
+
+      shaderDesc.pixelOutType[i] = pixelOutType;
+   }
+
+   for (auto i = 0; i < latte::MaxTextures; ++i) {
+      auto resourceOffset = (latte::SQ_RES_OFFSET::PS_TEX_RESOURCE_0 + i) * 7;
+      auto sq_tex_resource_word0 = getRegister<latte::SQ_TEX_RESOURCE_WORD0_N>(registers, latte::Register::SQ_RESOURCE_WORD0_0 + 4 * resourceOffset);
+      auto sq_tex_resource_word4 = getRegister<latte::SQ_TEX_RESOURCE_WORD4_N>(registers, latte::Register::SQ_RESOURCE_WORD4_0 + 4 * resourceOffset);
+      shaderDesc.texDims[i] = sq_tex_resource_word0.DIM();
+      shaderDesc.texIsUint[i] = (sq_tex_resource_word4.NUM_FORMAT_ALL() == latte::SQ_NUM_FORMAT::INT);
+   }
+
+   auto sx_alpha_test_control = getRegister<latte::SX_ALPHA_TEST_CONTROL>(registers, latte::Register::SX_ALPHA_TEST_CONTROL);
+   shaderDesc.alphaRefFunc = sx_alpha_test_control.ALPHA_FUNC();
+   if (!sx_alpha_test_control.ALPHA_TEST_ENABLE() || sx_alpha_test_control.ALPHA_TEST_BYPASS()) {
+      shaderDesc.alphaRefFunc = latte::REF_FUNC::ALWAYS;
+   }
+
+   shaderDesc.regs.sq_pgm_resources_ps = getRegister<latte::SQ_PGM_RESOURCES_PS>(registers, latte::Register::SQ_PGM_RESOURCES_PS);
+   shaderDesc.regs.sq_pgm_exports_ps = getRegister<latte::SQ_PGM_EXPORTS_PS>(registers, latte::Register::SQ_PGM_EXPORTS_PS);
+
+   shaderDesc.regs.spi_ps_in_control_0 = getRegister<latte::SPI_PS_IN_CONTROL_0>(registers, latte::Register::SPI_PS_IN_CONTROL_0);
+   shaderDesc.regs.spi_ps_in_control_1 = getRegister<latte::SPI_PS_IN_CONTROL_1>(registers, latte::Register::SPI_PS_IN_CONTROL_1);
+
+   for (auto i = 0; i < 32; ++i) {
+      shaderDesc.regs.spi_ps_input_cntls[i] = getRegister<latte::SPI_PS_INPUT_CNTL_N>(registers, latte::Register::SPI_PS_INPUT_CNTL_0 + i * 4);
+   }
+
+   shaderDesc.vsOutputSemantics = vsOutputSemantics;
+
+   return shaderDesc;
+}
+
+} // namespace spirv
+
+#endif // ifdef DECAF_VULKAN
@@ -10,6 +10,11 @@
 #include <common/datahash.h>
 #include <gsl/gsl>
 
+namespace gpu
+{
+class ShaderCache;
+} // namespace gpu
+
 namespace spirv
 {
 
@@ -203,12 +208,42 @@ struct PixelShader : public Shader
 {
 };
 
+//! Register values, indexed by register address / 4.
+using RegisterFile = std::array<uint32_t, 0x10000>;
+
+VertexShaderDesc
+getVertexShaderDesc(const RegisterFile &registers,
+                    bool isRectDraw);
+
+GeometryShaderDesc
+getGeometryShaderDesc(const RegisterFile &registers);
+
+PixelShaderDesc
+getPixelShaderDesc(const RegisterFile &registers,
+                   const std::vector<uint32_t> &vsOutputSemantics);
+
 bool
 translate(const ShaderDesc& shaderDesc, Shader *shader);
 
+//! Translate a shader, unless it is already in the shader cache. Shaders
+//! which do have to be translated are stored in the cache.
+bool
+translate(gpu::ShaderCache &cache, const ShaderDesc &shaderDesc, const DataHash &hash, Shader *shader);
+
 std::string
 shaderToString(const Shader *shader);
 
+//! Hash of the translator source, shaders translated by any other build of
+//! the translator are not loaded from a shader cache.
+std::array<uint64_t, 2>
+getTranslatorHash();
+
+bool
+saveShader(ShaderType type, const Shader *shader, std::vector<uint8_t> &data);
+
+bool
+loadShader(ShaderType type, const std::vector<uint8_t> &data, Shader *shader);
+
 } // namespace spirv
 
 #endif // ifdef DECAF_VULKAN
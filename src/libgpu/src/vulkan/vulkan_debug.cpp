@@ -41,6 +41,12 @@ Driver::updateDebuggerInfo()
    mDebuggerInfo.numSamplers = mSamplers.size();
    mDebuggerInfo.numSurfaces = mSurfaceGroups.size();
    mDebuggerInfo.numDataBuffers = 0;
+   mDebuggerInfo.numPipelinesPending = mPipelinesPending;
+   mDebuggerInfo.numPipelinesFailed = mPipelinesFailed;
+   mDebuggerInfo.numDrawsSkipped = mFrameDrawsSkipped;
+   mDebuggerInfo.numDrawsFallback = mFrameDrawsFallback;
+   mFrameDrawsSkipped = 0;
+   mFrameDrawsFallback = 0;
 }
 
 template <typename ObjType>
@@ -311,7 +311,7 @@ Driver::drawGenericIndexed(latte::VGT_DRAW_INITIATOR drawInit, uint32_t numIndic
       return;
    }
    if (!checkCurrentPipeline()) {
-      gLog->debug("Skipped draw due to a pipeline error");
+      gLog->debug("Skipped draw due to a pipeline error or a pipeline still compiling");
       return;
    }
    if (!checkCurrentSamplers()) {
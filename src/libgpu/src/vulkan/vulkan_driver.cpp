@@ -1,5 +1,6 @@
 #ifdef DECAF_VULKAN
 #include "vulkan_driver.h"
+#include "gpu_config.h"
 #include "gpu_event.h"
 #include "gpu_graphicsdriver.h"
 #include "gpu_ringbuffer.h"
@@ -154,6 +155,11 @@ Driver::initialise(vk::PhysicalDevice physDevice, vk::Device device, vk::Queue q
    pipelineLayoutDesc.pushConstantRangeCount = static_cast<uint32_t>(pushConstants.size());
    pipelineLayoutDesc.pPushConstantRanges = pushConstants.data();
    mPipelineLayout = mDevice.createPipelineLayout(pipelineLayoutDesc);
+
+   // Load the shaders and pipelines compiled on previous runs
+   openShaderCache();
+   openPipelineCache();
+   startPipelineThreads(gpu::config::pipeline_compile_threads);
 }
 
 vk::DescriptorPool
@@ -268,6 +274,9 @@ Driver::shutdown()
 {
    mFenceSignal.notify_all();
    mFenceThread.join();
+   stopPipelineThreads();
+   closePipelineCache();
+   mShaderCache.close();
 }
 
 void
@@ -2,6 +2,7 @@
 #ifdef DECAF_VULKAN
 #include "gpu_graphicsdriver.h"
 #include "gpu_ringbuffer.h"
+#include "gpu_shadercache.h"
 #include "gpu_vulkandriver.h"
 #include "latte/latte_formats.h"
 #include "latte/latte_constants.h"
@@ -11,6 +12,7 @@
 
 #include <atomic>
 #include <condition_variable>
+#include <deque>
 #include <functional>
 #include <gsl/gsl>
 #include <map>
@@ -114,6 +116,16 @@ struct MemCacheSegment
    // Stores the last computed hash for this data (from the CPU).
    DataHash dataHash;
 
+   // Records if CPU writes to this segment are being tracked by libcpu, and
+   // the write generation at which this segment was last checked.
+   bool cpuWriteTracked;
+   uint64_t cpuWriteGeneration;
+
+   // Counts the consecutive checks which found CPU writes to this segment.
+   // Segments written between nearly every check are cheaper to hash than
+   // to track, so tracking is given up on them once this gets too high.
+   uint32_t cpuWriteDirtyChecks;
+
    // Tracks the last CPU check of this segment, to avoid checking the
    // memory multiple times in a single batch.
    uint64_t lastCheckIndex;
@@ -666,9 +678,23 @@ struct PipelineDesc
    }
 };
 
+enum class PipelineStatus : uint32_t
+{
+   Compiling,
+   Ready,
+   Failed,
+};
+
 struct PipelineObject
 {
    HashedDesc<PipelineDesc> desc;
+
+   //! Hash of the state which a fallback pipeline must share with this one
+   DataHash compatibleHash;
+
+   //! Set by the thread which compiled the pipeline, after all other fields
+   std::atomic<PipelineStatus> status { PipelineStatus::Compiling };
+
    vk::Pipeline pipeline;
    bool needsPremultipliedTargets;
    std::array<bool, latte::MaxRenderTargets> targetIsPremultiplied;
@@ -857,6 +883,7 @@ protected:
    spirv::VertexShaderDesc getVertexShaderDesc();
    spirv::GeometryShaderDesc getGeometryShaderDesc();
    spirv::PixelShaderDesc getPixelShaderDesc();
+   void openShaderCache();
    bool checkCurrentVertexShader();
    bool checkCurrentGeometryShader();
    bool checkCurrentPixelShader();
@@ -867,6 +894,12 @@ protected:
 
    // Pipelines
    PipelineDesc getPipelineDesc();
+   void openPipelineCache();
+   void closePipelineCache();
+   void startPipelineThreads(unsigned numThreads);
+   void stopPipelineThreads();
+   void pipelineThreadEntry();
+   bool compilePipeline(PipelineObject *pipelineObject);
    bool checkCurrentPipeline();
 
    // Debug
@@ -982,8 +1015,22 @@ private:
    std::unordered_map<DataHash, PixelShaderObject*> mPixelShaders;
    std::unordered_map<DataHash, RenderPassObject*> mRenderPasses;
    std::unordered_map<DataHash, PipelineObject*> mPipelines;
+   std::unordered_map<DataHash, PipelineObject*> mFallbackPipelines;
    std::unordered_map<DataHash, SamplerObject*> mSamplers;
    std::unordered_map<DataHash, MemCacheObject *> mMemCaches;
+   gpu::ShaderCache mShaderCache;
+
+   // Background pipeline compilation
+   vk::PipelineCache mPipelineCache;
+   bool mPipelineThreadsRunning = false;
+   std::vector<std::thread> mPipelineThreads;
+   std::deque<PipelineObject *> mPipelineQueue;
+   std::mutex mPipelineMutex;
+   std::condition_variable mPipelineCondition;
+   std::atomic<uint64_t> mPipelinesPending { 0 };
+   std::atomic<uint64_t> mPipelinesFailed { 0 };
+   uint64_t mFrameDrawsSkipped = 0;
+   uint64_t mFrameDrawsFallback = 0;
 };
 
 } // namespace vulkan
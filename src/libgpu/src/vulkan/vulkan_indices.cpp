@@ -70,9 +70,7 @@ Driver::maybeSwapIndices()
 
          auto swapSrc = reinterpret_cast<uint16_t *>(drawDesc.indices);
          auto swapDest = reinterpret_cast<uint16_t *>(mScratchIdxSwap.data());
-         for (auto i = 0; i < indexBytes / sizeof(uint16_t); ++i) {
-            swapDest[i] = byte_swap(swapSrc[i]);
-         }
+         byte_swap_to(swapDest, swapSrc, indexBytes / sizeof(uint16_t));
 
          drawDesc.indices = mScratchIdxSwap.data();
       } else if (drawDesc.indexSwapMode == latte::VGT_DMA_SWAP::SWAP_32_BIT) {
@@ -81,9 +79,7 @@ Driver::maybeSwapIndices()
 
          auto swapSrc = reinterpret_cast<uint32_t *>(drawDesc.indices);
          auto swapDest = reinterpret_cast<uint32_t *>(mScratchIdxSwap.data());
-         for (auto i = 0; i < indexBytes / sizeof(uint32_t); ++i) {
-            swapDest[i] = byte_swap(swapSrc[i]);
-         }
+         byte_swap_to(swapDest, swapSrc, indexBytes / sizeof(uint32_t));
 
          drawDesc.indices = mScratchIdxSwap.data();
       } else if (drawDesc.indexSwapMode == latte::VGT_DMA_SWAP::NONE) {
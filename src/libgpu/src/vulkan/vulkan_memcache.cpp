@@ -3,6 +3,8 @@
 #include "vulkan_rangecombiner.h"
 #include "gpu_tiling.h"
 
+#include <libcpu/mmu.h>
+
 namespace vulkan
 {
 
@@ -251,7 +253,9 @@ Driver::_downloadMemCacheRaw(MemCacheObject *cache, SectionRange range)
          // Map our staging buffer so we can copy out of it.
          void *mappedPtr = mapStagingBuffer(stagingBuffer, true);
          auto stagedData = reinterpret_cast<uint8_t*>(mappedPtr) + stagingOffset;
+         cpu::beginHostWrite(cache->address + section.offset, section.size);
          memcpy(data, stagedData, section.size);
+         cpu::endHostWrite(cache->address + section.offset, section.size);
          unmapStagingBuffer(stagingBuffer, false);
 
          // We need to calculate new data hashes for the relevant segments that
@@ -276,30 +280,94 @@ Driver::_downloadMemCacheRaw(MemCacheObject *cache, SectionRange range)
 void
 Driver::_downloadMemCacheRetile(MemCacheObject *cache, SectionRange range)
 {
-   // We do not currently implement retiled downloads
+   auto& retile = cache->mutator.retile;
+   auto sliceSize = retile.pitch * retile.height * retile.bpp / 8;
 
-   /*
-   Note that in the upload code, we set width to pitch, so that we untile the whole
-   pitch in all cases.  This ensures that if we copy memory from this block, we also
-   copy the data from the pitch.  When we write back to the CPU, we only write the
-   exact width that is being used by this particular buffer.
+   auto& firstSection = cache->sections[range.start];
+   auto& lastSection = cache->sections[range.start + range.count - 1];
+   auto startOffset = firstSection.offset;
+   auto endOffset = lastSection.offset + lastSection.size;
 
-   gpu::convertFromTiled(
-      untiledImage.data(),
-      retile.pitch,
-      dataBytesPtr,
-      retile.tileMode,
-      retile.swizzle,
-      retile.pitch,
-      retile.width,
-      retile.height,
-      retile.depth,
-      retile.aa,
-      retile.isDepth,
-      retile.bpp,
-      startSlice,
-      endSlice);
-   */
+   decaf_check(startOffset % sliceSize == 0);
+   decaf_check(endOffset % sliceSize == 0);
+   auto startSlice = startOffset / sliceSize;
+   auto endSlice = endOffset / sliceSize;
+
+   // The staging buffer only holds the slices we are writing back
+   auto stagingBuffer = getStagingBuffer(endOffset - startOffset);
+
+   vk::BufferCopy copyDesc;
+   copyDesc.srcOffset = startOffset;
+   copyDesc.dstOffset = 0;
+   copyDesc.size = endOffset - startOffset;
+   mActiveCommandBuffer.copyBuffer(cache->buffer, stagingBuffer->buffer, { copyDesc });
+
+   auto sections = std::vector<MemCacheSection> {
+      cache->sections.begin() + range.start,
+      cache->sections.begin() + range.start + range.count
+   };
+
+   addRetireTask([=](){
+      void *data = phys_cast<void*>(cache->address).getRawPointer();
+      auto dataBytesPtr = reinterpret_cast<uint8_t*>(data);
+
+      void *mappedPtr = mapStagingBuffer(stagingBuffer, true);
+      auto untiledImage = reinterpret_cast<uint8_t*>(mappedPtr);
+
+      // Avoid taking a write tracking fault for every page we write, these are
+      // the tiled bytes of our slices which need not match the untiled offsets.
+      auto tiledOffset = uint32_t { 0 };
+      auto tiledSize = uint32_t { 0 };
+      gpu::calculateTiledSliceRange(retile.tileMode,
+                                    retile.pitch,
+                                    retile.height,
+                                    retile.depth,
+                                    retile.aa,
+                                    retile.isDepth,
+                                    retile.bpp,
+                                    startSlice,
+                                    endSlice,
+                                    tiledOffset,
+                                    tiledSize);
+      cpu::beginHostWrite(cache->address + tiledOffset, tiledSize);
+
+      // Note that in the upload code, we set width to pitch, so that we untile
+      // the whole pitch in all cases.  When we write back to the CPU, we only
+      // write the exact width that is being used by this particular buffer.
+      gpu::convertToTiled(
+         dataBytesPtr,
+         untiledImage,
+         retile.pitch,
+         retile.tileMode,
+         retile.swizzle,
+         retile.pitch,
+         retile.width,
+         retile.height,
+         retile.depth,
+         retile.aa,
+         retile.isDepth,
+         retile.bpp,
+         startSlice,
+         endSlice);
+
+      cpu::endHostWrite(cache->address + tiledOffset, tiledSize);
+      unmapStagingBuffer(stagingBuffer, false);
+
+      // We need to calculate new data hashes for the relevant segments that
+      // are affected by this image and are not still being GPU written.
+      for (auto& section : sections) {
+         forEachMemSegment(section.firstSegment, section.size, [&](MemCacheSegment* segment){
+            decaf_check(segment->lastChangeIndex >= section.lastChangeIndex);
+
+            if (segment->lastChangeIndex == section.lastChangeIndex) {
+               auto dataPtr = phys_cast<void*>(segment->address).getRawPointer();
+               auto dataSize = segment->size;
+               segment->dataHash = DataHash {}.write(dataPtr, dataSize);
+               segment->gpuWritten = false;
+            }
+         });
+      }
+   });
 }
 
 void
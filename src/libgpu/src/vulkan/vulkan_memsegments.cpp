@@ -1,10 +1,15 @@
 #ifdef DECAF_VULKAN
 #include "vulkan_driver.h"
+#include "gpu_config.h"
 #include "gpu_tiling.h"
 
+#include <libcpu/mmu.h>
+
 namespace vulkan
 {
 
+static const uint32_t maxCpuWriteDirtyChecks = 8;
+
 MemCacheSegment *
 Driver::_allocateMemSegment(phys_addr address, uint32_t size)
 {
@@ -12,6 +17,9 @@ Driver::_allocateMemSegment(phys_addr address, uint32_t size)
    segment->address = address;
    segment->size = size;
    segment->dataHash = DataHash {};
+   segment->cpuWriteTracked = false;
+   segment->cpuWriteGeneration = 0;
+   segment->cpuWriteDirtyChecks = 0;
    segment->lastCheckIndex = 0;
    segment->gpuWritten = false;
    segment->lastChangeIndex = 0;
@@ -40,6 +48,9 @@ Driver::_splitMemSegment(MemSegmentMap::iterator iter, uint32_t newSize)
    newSegment->gpuWritten = oldSegment->gpuWritten;
    newSegment->lastChangeIndex = oldSegment->lastChangeIndex;
    newSegment->lastChangeOwner = oldSegment->lastChangeOwner;
+   newSegment->cpuWriteTracked = oldSegment->cpuWriteTracked;
+   newSegment->cpuWriteGeneration = oldSegment->cpuWriteGeneration;
+   newSegment->cpuWriteDirtyChecks = oldSegment->cpuWriteDirtyChecks;
 
    // If the old segment was written by the GPU, there is no need to
    // do any of the hashing work, it will be done during readback.
@@ -48,6 +59,37 @@ Driver::_splitMemSegment(MemSegmentMap::iterator iter, uint32_t newSize)
       return newIter;
    }
 
+   // If CPU writes are being tracked we can check for changes without
+   // hashing.  The segments are left without a hash, so the next change
+   // detected by _refreshMemSegment will always be treated as a change.
+   if (oldSegment->cpuWriteTracked) {
+      oldSegment->dataHash = DataHash {};
+      newSegment->dataHash = DataHash {};
+
+      if (oldSegment->lastCheckIndex >= mActiveBatchIndex) {
+         return newIter;
+      }
+
+      if (cpu::hasPhysicalWriteSince(oldSegment->address, oldSize,
+                                     oldSegment->cpuWriteGeneration)) {
+         auto changeIndex = ++mMemChangeCounter;
+         auto writeGeneration = cpu::getPhysicalWriteGeneration();
+         cpu::trackPhysicalWrites(oldSegment->address, oldSize);
+
+         oldSegment->lastCheckIndex = mActiveBatchIndex;
+         oldSegment->lastChangeIndex = changeIndex;
+         oldSegment->lastChangeOwner = nullptr;
+         oldSegment->cpuWriteGeneration = writeGeneration;
+
+         newSegment->lastCheckIndex = mActiveBatchIndex;
+         newSegment->lastChangeIndex = changeIndex;
+         newSegment->lastChangeOwner = nullptr;
+         newSegment->cpuWriteGeneration = writeGeneration;
+      }
+
+      return newIter;
+   }
+
    // Lets calculate the new hashes for the segments after they have been
    // split to ensure we don't do unneeded uploading after a split.  We check
    // that the new hashes reflect the same data that previous existed in the
@@ -179,6 +221,31 @@ Driver::_refreshMemSegment(MemCacheSegment *segment)
       return;
    }
 
+   // If CPU writes to this segment are tracked, and there have been none
+   // since we last checked, there is no need to look at the data at all.
+   if (segment->cpuWriteTracked) {
+      if (!cpu::hasPhysicalWriteSince(segment->address, segment->size,
+                                      segment->cpuWriteGeneration)) {
+         segment->cpuWriteDirtyChecks = 0;
+         segment->lastCheckIndex = mActiveBatchIndex;
+         return;
+      }
+
+      segment->cpuWriteDirtyChecks++;
+   }
+
+   // Start (or restart) tracking writes before reading the data, so any
+   // write which happens after this point will be seen by the next check.
+   // Segments which keep getting written go back to only being hashed, so
+   // they stop paying for a write fault on every check.
+   if (gpu::config::cpu_write_tracking &&
+       segment->cpuWriteDirtyChecks < maxCpuWriteDirtyChecks) {
+      segment->cpuWriteGeneration = cpu::getPhysicalWriteGeneration();
+      segment->cpuWriteTracked = cpu::trackPhysicalWrites(segment->address, segment->size);
+   } else {
+      segment->cpuWriteTracked = false;
+   }
+
    // Rehash all our data
    auto dataPtr = phys_cast<void*>(segment->address).getRawPointer();
    auto dataSize = segment->size;
@@ -1,6 +1,12 @@
 #ifdef DECAF_VULKAN
 #include "vulkan_driver.h"
 #include "vulkan_utils.h"
+#include "gpu_config.h"
+
+#include <common/log.h>
+#include <common/platform_thread.h>
+#include <fstream>
+#include <iterator>
 
 namespace vulkan
 {
@@ -296,64 +302,189 @@ Driver::getPipelineDesc()
    return desc;
 }
 
-bool
-Driver::checkCurrentPipeline()
+/**
+ * Hash the parts of a pipeline description which a pipeline must match to be
+ * drawn with in place of it.
+ *
+ * Pipelines with the same render pass, shaders, vertex layout and topology
+ * accept the same draw commands and resources, they only differ in how the
+ * result is blended, depth tested or rasterised.
+ */
+static DataHash
+getCompatiblePipelineHash(const PipelineDesc &desc)
 {
-   decaf_check(mCurrentVertexShader);
-   decaf_check(mCurrentRenderPass);
+   return DataHash {}
+      .write(desc.renderPass)
+      .write(desc.vertexShader)
+      .write(desc.geometryShader)
+      .write(desc.pixelShader)
+      .write(desc.attribBufferStride)
+      .write(desc.primitiveType)
+      .write(desc.primitiveResetEnabled);
+}
 
-   HashedDesc<PipelineDesc> currentDesc = getPipelineDesc();
+void
+Driver::openPipelineCache()
+{
+   auto &path = gpu::config::shader_cache_path;
+   auto initialData = std::vector<char> { };
 
-   if (mCurrentPipeline && mCurrentPipeline->desc == currentDesc) {
-      // Already active, nothing to do.
-      return true;
+   if (!path.empty()) {
+      auto file = std::ifstream { fmt::format("{}/pipelines.bin", path), std::ifstream::binary };
+      if (file.is_open()) {
+         initialData.assign(std::istreambuf_iterator<char> { file }, std::istreambuf_iterator<char> { });
+      }
    }
 
-   auto& foundPipeline = mPipelines[currentDesc.hash()];
-   if (foundPipeline) {
-      mCurrentPipeline = foundPipeline;
-      return true;
+   // The driver validates the header of the cache data itself, and ignores
+   // data written by a different driver or device.
+   vk::PipelineCacheCreateInfo pipelineCacheDesc;
+   pipelineCacheDesc.initialDataSize = initialData.size();
+   pipelineCacheDesc.pInitialData = initialData.data();
+   mPipelineCache = mDevice.createPipelineCache(pipelineCacheDesc);
+}
+
+void
+Driver::closePipelineCache()
+{
+   auto &path = gpu::config::shader_cache_path;
+
+   if (!mPipelineCache) {
+      return;
+   }
+
+   if (!path.empty()) {
+      auto data = mDevice.getPipelineCacheData(mPipelineCache);
+      auto file = std::ofstream { fmt::format("{}/pipelines.bin", path), std::ofstream::binary | std::ofstream::trunc };
+
+      if (file.is_open()) {
+         file.write(reinterpret_cast<const char *>(data.data()), data.size());
+      } else {
+         gLog->warn("Failed to write pipeline cache to {}", path);
+      }
+   }
+
+   mDevice.destroyPipelineCache(mPipelineCache);
+   mPipelineCache = vk::PipelineCache();
+}
+
+void
+Driver::startPipelineThreads(unsigned numThreads)
+{
+   stopPipelineThreads();
+
+   if (!numThreads) {
+      return;
+   }
+
+   mPipelineThreadsRunning = true;
+
+   for (auto i = 0u; i < numThreads; ++i) {
+      mPipelineThreads.emplace_back(&Driver::pipelineThreadEntry, this);
+      platform::setThreadName(&mPipelineThreads.back(), fmt::format("GPU Pipeline {}", i));
    }
+}
+
+/**
+ * Stop and join all pipeline compile threads, pipelines which are still
+ * queued are never compiled.
+ */
+void
+Driver::stopPipelineThreads()
+{
+   {
+      std::unique_lock<std::mutex> lock { mPipelineMutex };
+      mPipelineThreadsRunning = false;
+      mPipelinesPending -= mPipelineQueue.size();
+      mPipelineQueue.clear();
+   }
+
+   mPipelineCondition.notify_all();
+
+   for (auto &thread : mPipelineThreads) {
+      if (thread.joinable()) {
+         thread.join();
+      }
+   }
+
+   mPipelineThreads.clear();
+}
+
+void
+Driver::pipelineThreadEntry()
+{
+   std::unique_lock<std::mutex> lock { mPipelineMutex };
 
-   foundPipeline = new PipelineObject();
-   foundPipeline->desc = currentDesc;
+   while (true) {
+      mPipelineCondition.wait(lock, [&]() {
+         return !mPipelineThreadsRunning || !mPipelineQueue.empty();
+      });
+
+      if (!mPipelineThreadsRunning) {
+         break;
+      }
+
+      auto pipeline = mPipelineQueue.front();
+      mPipelineQueue.pop_front();
+      lock.unlock();
+
+      compilePipeline(pipeline);
+      mPipelinesPending--;
+
+      lock.lock();
+   }
+}
+
+/**
+ * Compile the vk::Pipeline for a pipeline object.
+ *
+ * This only reads state from the pipeline description, so it may run on
+ * any thread.
+ */
+bool
+Driver::compilePipeline(PipelineObject *pipelineObject)
+{
+   auto &currentDesc = pipelineObject->desc;
+   auto vertexShader = currentDesc->vertexShader;
+   auto geometryShader = currentDesc->geometryShader;
+   auto pixelShader = currentDesc->pixelShader;
 
    // ------------------------------------------------------------
    // Shader Stages
    // ------------------------------------------------------------
 
    std::vector<vk::PipelineShaderStageCreateInfo> shaderStages;
-   if (mCurrentVertexShader) {
+   if (vertexShader) {
       vk::PipelineShaderStageCreateInfo shaderStageDesc;
       shaderStageDesc.stage = vk::ShaderStageFlagBits::eVertex;
-      shaderStageDesc.module = mCurrentVertexShader->module;
+      shaderStageDesc.module = vertexShader->module;
       shaderStageDesc.pName = "main";
       shaderStageDesc.pSpecializationInfo = nullptr;
       shaderStages.push_back(shaderStageDesc);
 
-      if (mCurrentVertexShader->rectStubModule) {
-         decaf_check(!mCurrentGeometryShader);
+      if (vertexShader->rectStubModule) {
+         decaf_check(!geometryShader);
 
          vk::PipelineShaderStageCreateInfo rectStageDesc;
          rectStageDesc.stage = vk::ShaderStageFlagBits::eGeometry;
-         rectStageDesc.module = mCurrentVertexShader->rectStubModule;
+         rectStageDesc.module = vertexShader->rectStubModule;
          rectStageDesc.pName = "main";
          rectStageDesc.pSpecializationInfo = nullptr;
          shaderStages.push_back(rectStageDesc);
       }
    }
-   if (mCurrentGeometryShader) {
+   if (geometryShader) {
       vk::PipelineShaderStageCreateInfo shaderStageDesc;
       shaderStageDesc.stage = vk::ShaderStageFlagBits::eGeometry;
-      shaderStageDesc.module = mCurrentGeometryShader->module;
+      shaderStageDesc.module = geometryShader->module;
       shaderStageDesc.pName = "main";
       shaderStageDesc.pSpecializationInfo = nullptr;
       shaderStages.push_back(shaderStageDesc);
    }
-   if (mCurrentPixelShader) {
+   if (pixelShader) {
       vk::PipelineShaderStageCreateInfo shaderStageDesc;
       shaderStageDesc.stage = vk::ShaderStageFlagBits::eFragment;
-      shaderStageDesc.module = mCurrentPixelShader->module;
+      shaderStageDesc.module = pixelShader->module;
       shaderStageDesc.pName = "main";
       shaderStageDesc.pSpecializationInfo = nullptr;
       shaderStages.push_back(shaderStageDesc);
@@ -367,7 +498,7 @@ Driver::checkCurrentPipeline()
    std::vector<vk::VertexInputBindingDescription> bindingDescs;
    std::vector<vk::VertexInputBindingDivisorDescriptionEXT> divisorDescs;
 
-   const auto& inputBuffers = mCurrentVertexShader->shader.inputBuffers;
+   const auto& inputBuffers = vertexShader->shader.inputBuffers;
    for (auto i = 0u; i < latte::MaxAttribBuffers; ++i) {
       const auto &inputBuffer = inputBuffers[i];
 
@@ -400,7 +531,7 @@ Driver::checkCurrentPipeline()
 
    std::vector<vk::VertexInputAttributeDescription> attribDescs;
 
-   const auto& inputAttribs = mCurrentVertexShader->shader.inputAttribs;
+   const auto& inputAttribs = vertexShader->shader.inputAttribs;
    for (auto i = 0u; i < inputAttribs.size(); ++i) {
       const auto &inputAttrib = inputAttribs[i];
 
@@ -775,19 +906,85 @@ Driver::checkCurrentPipeline()
    pipelineInfo.pColorBlendState = &colorBlendState;
    pipelineInfo.pDynamicState = &dynamicDesc;
    pipelineInfo.layout = mPipelineLayout;
-   pipelineInfo.renderPass = mCurrentRenderPass->renderPass;
+   pipelineInfo.renderPass = currentDesc->renderPass->renderPass;
    pipelineInfo.subpass = 0;
    pipelineInfo.basePipelineHandle = vk::Pipeline();
    pipelineInfo.basePipelineIndex = -1;
-   auto pipeline = mDevice.createGraphicsPipeline(vk::PipelineCache(), pipelineInfo);
-   foundPipeline->pipeline = pipeline;
-   foundPipeline->needsPremultipliedTargets = needsPremultipliedTargets;
-   foundPipeline->targetIsPremultiplied = targetIsPremultiplied;
 
-   mCurrentPipeline = foundPipeline;
+   try {
+      pipelineObject->pipeline = mDevice.createGraphicsPipeline(mPipelineCache, pipelineInfo);
+   } catch (vk::SystemError &err) {
+      gLog->error("Failed to create pipeline: {}", err.what());
+      mPipelinesFailed++;
+      pipelineObject->status.store(PipelineStatus::Failed, std::memory_order_release);
+      return false;
+   }
+
+   pipelineObject->needsPremultipliedTargets = needsPremultipliedTargets;
+   pipelineObject->targetIsPremultiplied = targetIsPremultiplied;
+   pipelineObject->status.store(PipelineStatus::Ready, std::memory_order_release);
    return true;
 }
 
+bool
+Driver::checkCurrentPipeline()
+{
+   decaf_check(mCurrentVertexShader);
+   decaf_check(mCurrentRenderPass);
+
+   HashedDesc<PipelineDesc> currentDesc = getPipelineDesc();
+
+   if (mCurrentPipeline && mCurrentPipeline->desc == currentDesc) {
+      // Already active, nothing to do.
+      return true;
+   }
+
+   auto& foundPipeline = mPipelines[currentDesc.hash()];
+   if (!foundPipeline) {
+      foundPipeline = new PipelineObject();
+      foundPipeline->desc = currentDesc;
+      foundPipeline->compatibleHash = getCompatiblePipelineHash(*currentDesc);
+
+      if (mPipelineThreads.empty()) {
+         compilePipeline(foundPipeline);
+      } else {
+         mPipelinesPending++;
+
+         {
+            std::unique_lock<std::mutex> lock { mPipelineMutex };
+            mPipelineQueue.push_back(foundPipeline);
+         }
+
+         mPipelineCondition.notify_one();
+      }
+   }
+
+   switch (foundPipeline->status.load(std::memory_order_acquire)) {
+   case PipelineStatus::Ready:
+      mFallbackPipelines[foundPipeline->compatibleHash] = foundPipeline;
+      mCurrentPipeline = foundPipeline;
+      return true;
+   case PipelineStatus::Failed:
+      return false;
+   case PipelineStatus::Compiling:
+      break;
+   }
+
+   // The pipeline is still compiling in the background, rather than wait
+   // for it we either draw with a compatible pipeline or skip the draw.
+   if (gpu::config::pipeline_fallback) {
+      auto itr = mFallbackPipelines.find(foundPipeline->compatibleHash);
+      if (itr != mFallbackPipelines.end()) {
+         mFrameDrawsFallback++;
+         mCurrentPipeline = itr->second;
+         return true;
+      }
+   }
+
+   mFrameDrawsSkipped++;
+   return false;
+}
+
 } // namespace vulkan
 
 #endif // ifdef DECAF_VULKAN
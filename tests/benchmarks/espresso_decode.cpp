@@ -0,0 +1,34 @@
+#include <catch.hpp>
+#include "../cpu/libcpu/espresso_decoders.h"
+
+#include <libcpu/espresso/espresso_instructionset.h>
+
+#include <chrono>
+#include <cstdint>
+
+TEST_CASE("espresso decode", "[libcpu]")
+{
+   initialiseInstructionSet();
+
+   // Cross-check and time both decoders over the whole 32-bit instruction space.
+   auto treeSum = uint64_t { 0 };
+   auto flatSum = uint64_t { 0 };
+
+   auto treeStart = std::chrono::steady_clock::now();
+   for (auto i = uint64_t { 0 }; i <= 0xFFFFFFFFull; ++i) {
+      treeSum += static_cast<uint64_t>(treeDecodeID(static_cast<uint32_t>(i)));
+   }
+   auto treeTime = std::chrono::steady_clock::now() - treeStart;
+
+   auto flatStart = std::chrono::steady_clock::now();
+   for (auto i = uint64_t { 0 }; i <= 0xFFFFFFFFull; ++i) {
+      flatSum += static_cast<uint64_t>(espresso::decodeInstructionID(static_cast<uint32_t>(i)));
+   }
+   auto flatTime = std::chrono::steady_clock::now() - flatStart;
+
+   auto treeNs = std::chrono::duration<double, std::nano> { treeTime }.count() / 4294967296.0;
+   auto flatNs = std::chrono::duration<double, std::nano> { flatTime }.count() / 4294967296.0;
+   WARN("tree decoder: " << treeNs << " ns/instruction");
+   WARN("flat decoder: " << flatNs << " ns/instruction");
+   REQUIRE(treeSum == flatSum);
+}
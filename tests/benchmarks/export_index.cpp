@@ -0,0 +1,80 @@
+#include <catch.hpp>
+#include "../loader/export_table.h"
+
+#include <cafe/loader/cafe_loader_exportindex.h>
+
+#include <algorithm>
+#include <chrono>
+#include <fmt/format.h>
+#include <random>
+#include <string>
+#include <utility>
+#include <vector>
+
+using namespace cafe::loader::internal;
+
+TEST_CASE("Link time for a title importing 5000 symbols", "[loader]")
+{
+   const auto numModules = 30;
+   const auto numImports = 5000;
+
+   auto tables = std::vector<ExportTable> { };
+   auto imports = std::vector<std::pair<size_t, std::string>> { };
+   auto random = std::mt19937 { 0x19 };
+
+   // A few large system libraries and many small ones
+   for (auto i = 0; i < numModules; ++i) {
+      auto names = makeSymbolNames(fmt::format("lib{}", i).c_str(), i < 4 ? 2000 : 150);
+      tables.emplace_back(names);
+
+      for (auto j = 0; j < numImports / numModules; ++j) {
+         imports.emplace_back(i, names[random() % names.size()]);
+      }
+   }
+
+   std::shuffle(imports.begin(), imports.end(), random);
+
+   auto start = std::chrono::steady_clock::now();
+   auto found = size_t { 0 };
+
+   for (auto &[module, name] : imports) {
+      found += !!tables[module].binarySearch(name.c_str());
+   }
+
+   auto binarySearch = std::chrono::steady_clock::now() - start;
+   REQUIRE(found == imports.size());
+
+   // The indices are built as part of linking
+   start = std::chrono::steady_clock::now();
+   auto indices = std::vector<ExportIndex>(tables.size());
+   found = 0;
+
+   for (auto &[module, name] : imports) {
+      auto &index = indices[module];
+      if (!index.exports()) {
+         index.build(tables[module].data(), tables[module].size(), tables[module].strings.data());
+      }
+
+      found += !!index.find(name);
+   }
+
+   auto indexed = std::chrono::steady_clock::now() - start;
+   REQUIRE(found == imports.size());
+
+   // A second link against the same libraries reuses their indices
+   start = std::chrono::steady_clock::now();
+   found = 0;
+
+   for (auto &[module, name] : imports) {
+      found += !!indices[module].find(name);
+   }
+
+   auto reused = std::chrono::steady_clock::now() - start;
+   REQUIRE(found == imports.size());
+
+   WARN(fmt::format("{} imports: binary search {} us, index {} us, reused index {} us",
+                    imports.size(),
+                    std::chrono::duration_cast<std::chrono::microseconds>(binarySearch).count(),
+                    std::chrono::duration_cast<std::chrono::microseconds>(indexed).count(),
+                    std::chrono::duration_cast<std::chrono::microseconds>(reused).count()));
+}
@@ -0,0 +1,61 @@
+#include <catch.hpp>
+#include "../common/fiber_pingpong.h"
+
+#include <common/platform.h>
+
+#include <chrono>
+#include <cstdint>
+
+#ifdef PLATFORM_POSIX
+#include <ucontext.h>
+#include <vector>
+
+static ucontext_t sUcontextMain;
+static ucontext_t sUcontextFiber;
+static uint64_t sUcontextCount = 0;
+
+static void
+ucontextEntry()
+{
+   while (true) {
+      ++sUcontextCount;
+      swapcontext(&sUcontextFiber, &sUcontextMain);
+   }
+}
+
+static double
+runUcontextPingPong(uint64_t iterations)
+{
+   auto stack = std::vector<char>(1024 * 1024);
+   getcontext(&sUcontextFiber);
+   sUcontextFiber.uc_stack.ss_sp = stack.data();
+   sUcontextFiber.uc_stack.ss_size = stack.size();
+   sUcontextFiber.uc_link = nullptr;
+   makecontext(&sUcontextFiber, &ucontextEntry, 0);
+   sUcontextCount = 0;
+
+   auto start = std::chrono::steady_clock::now();
+   for (auto i = 0u; i < iterations; ++i) {
+      swapcontext(&sUcontextMain, &sUcontextFiber);
+   }
+   auto time = std::chrono::steady_clock::now() - start;
+
+   REQUIRE(sUcontextCount == iterations);
+   return std::chrono::duration<double> { time }.count();
+}
+
+#endif
+
+TEST_CASE("fiber switching", "[common]")
+{
+   const auto iterations = uint64_t { 10000000 };
+
+   // Each iteration is two switches, there and back again
+   auto fiberTime = runPingPong(iterations);
+   WARN("platform fiber: " << (2 * iterations / fiberTime) << " switches/s");
+
+#ifdef PLATFORM_POSIX
+   auto ucontextTime = runUcontextPingPong(iterations);
+   WARN("ucontext: " << (2 * iterations / ucontextTime) << " switches/s");
+#endif
+}
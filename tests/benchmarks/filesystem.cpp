@@ -0,0 +1,69 @@
+#include <catch.hpp>
+#include <filesystem/filesystem.h>
+
+#include <chrono>
+#include <common/platform_dir.h>
+#include <fmt/format.h>
+#include <fstream>
+#include <random>
+#include <string>
+#include <vector>
+
+TEST_CASE("FSA open latency over a 100k file content tree", "[fs]")
+{
+   const auto numTopFolders = 10;
+   const auto numFolders = 100;
+   const auto numFiles = 100;
+   const auto numOpens = 200000;
+
+   auto hostFilePath = [](int top, int folder, int file) {
+      return fmt::format("fs-bench-content/{:02}/{:03}/{:03}.bin", top, folder, file);
+   };
+
+   // The tree is left behind so later runs do not have to create it again
+   if (!platform::fileExists(hostFilePath(numTopFolders - 1, numFolders - 1, numFiles - 1))) {
+      for (auto top = 0; top < numTopFolders; ++top) {
+         for (auto folder = 0; folder < numFolders; ++folder) {
+            REQUIRE(platform::createDirectory(fmt::format("fs-bench-content/{:02}/{:03}", top, folder)));
+
+            for (auto file = 0; file < numFiles; ++file) {
+               REQUIRE(std::ofstream { hostFilePath(top, folder, file) }.is_open());
+            }
+         }
+      }
+   }
+
+   fs::FileSystem fs;
+   REQUIRE(fs.mountHostFolder("/vol/content", "fs-bench-content", fs::Permissions::Read));
+
+   auto paths = std::vector<std::string> { };
+   auto random = std::mt19937 { 0x13 };
+
+   for (auto i = 0; i < numOpens; ++i) {
+      paths.push_back(fmt::format("/vol/content/{:02}/{:03}/{:03}.bin",
+                                  random() % numTopFolders,
+                                  random() % numFolders,
+                                  random() % numFiles));
+   }
+
+   auto start = std::chrono::steady_clock::now();
+
+   for (auto &path : paths) {
+      auto result = fs.openFile(path, fs::File::Read);
+      REQUIRE(result);
+      result.value()->close();
+   }
+
+   auto openTime = std::chrono::steady_clock::now() - start;
+   start = std::chrono::steady_clock::now();
+
+   for (auto &path : paths) {
+      REQUIRE(!fs.fileExists(path + ".missing"));
+   }
+
+   auto missingTime = std::chrono::steady_clock::now() - start;
+
+   auto usPerOpen = std::chrono::duration<double, std::micro> { openTime }.count() / numOpens;
+   auto usPerMissing = std::chrono::duration<double, std::micro> { missingTime }.count() / numOpens;
+   WARN("open: " << usPerOpen << " us, missing file lookup: " << usPerMissing << " us");
+}
@@ -0,0 +1,164 @@
+#include <catch.hpp>
+#include "../loader/section_data.h"
+
+#include <cafe/loader/cafe_loader_inflate.h>
+
+#include <chrono>
+#include <common/byte_swap.h>
+#include <common/strutils.h>
+#include <cstdlib>
+#include <fmt/format.h>
+#include <fstream>
+#include <iterator>
+#include <memory>
+#include <string>
+#include <vector>
+
+using namespace cafe::loader::internal;
+
+/**
+ * The deflated sections of every RPL listed in $DECAF_BENCH_RPLS, separated by
+ * ';', or of a set of made up RPLs when that is not set.
+ */
+static std::vector<std::vector<uint8_t>>
+loadDeflatedSections(size_t &totalInflatedSize)
+{
+   constexpr auto SHF_DEFLATED = 0x08000000u;
+   auto sections = std::vector<std::vector<uint8_t>> { };
+   auto paths = std::getenv("DECAF_BENCH_RPLS");
+   totalInflatedSize = 0;
+
+   if (!paths || !paths[0]) {
+      WARN("DECAF_BENCH_RPLS is not set, using generated sections");
+
+      for (auto i = 0u; i < 64; ++i) {
+         auto data = makeSectionData(64 * 1024 + i * 32 * 1024, i);
+         totalInflatedSize += data.size();
+         sections.push_back(deflate(data));
+      }
+
+      return sections;
+   }
+
+   auto read32 = [](const std::vector<uint8_t> &file, size_t offset) {
+      return byte_swap(*reinterpret_cast<const uint32_t *>(file.data() + offset));
+   };
+
+   auto read16 = [](const std::vector<uint8_t> &file, size_t offset) {
+      return byte_swap(*reinterpret_cast<const uint16_t *>(file.data() + offset));
+   };
+
+   auto files = std::vector<std::string> { };
+   split_string(paths, ';', files);
+
+   for (auto &path : files) {
+      auto stream = std::ifstream { path, std::ios::binary };
+      auto file = std::vector<uint8_t>(std::istreambuf_iterator<char> { stream }, { });
+      REQUIRE(file.size() >= 0x34);
+
+      auto shoff = read32(file, 0x20);
+      auto shentsize = read16(file, 0x2E);
+      auto shnum = read16(file, 0x30);
+
+      for (auto i = 0u; i < shnum; ++i) {
+         auto header = shoff + i * shentsize;
+         if (header + 40 > file.size()) {
+            break;
+         }
+
+         auto flags = read32(file, header + 8);
+         auto offset = read32(file, header + 16);
+         auto size = read32(file, header + 20);
+         if (!(flags & SHF_DEFLATED) || size <= 4 || offset + size > file.size()) {
+            continue;
+         }
+
+         totalInflatedSize += read32(file, offset);
+         sections.emplace_back(file.begin() + offset + 4, file.begin() + offset + size);
+      }
+   }
+
+   return sections;
+}
+
+TEST_CASE("Loader inflate time over a set of RPLs", "[loader]")
+{
+   auto totalInflatedSize = size_t { 0 };
+   auto sections = loadDeflatedSections(totalInflatedSize);
+   REQUIRE(!sections.empty());
+
+   auto inflated = std::vector<uint8_t>(totalInflatedSize);
+
+   for (auto numThreads : { 0u, 1u, 2u, 4u, 8u }) {
+      auto jobs = std::vector<std::shared_ptr<InflateJob>> { };
+      auto dst = inflated.data();
+
+      for (auto &section : sections) {
+         auto job = std::make_shared<InflateJob>();
+         job->deflated = section;
+         jobs.push_back(job);
+      }
+
+      // The section data is copied before timing, as the loader copies it as
+      // it reads the file anyway.
+      auto start = std::chrono::steady_clock::now();
+
+      for (auto &job : jobs) {
+         job->dst = dst;
+         job->dstSize = static_cast<uint32_t>(inflated.data() + inflated.size() - dst);
+         submitInflateJob(job, numThreads);
+         waitInflateJob(job);
+         dst += job->inflatedSize;
+      }
+
+      auto serial = std::chrono::steady_clock::now() - start;
+
+      // Same again, but only waiting once everything is queued like the
+      // loader does between reading sections
+      for (auto &job : jobs) {
+         job->finished = false;
+      }
+
+      dst = inflated.data();
+      start = std::chrono::steady_clock::now();
+
+      for (auto &job : jobs) {
+         job->dst = dst;
+         job->dstSize = static_cast<uint32_t>(job->inflatedSize);
+         dst += job->inflatedSize;
+         submitInflateJob(job, numThreads);
+      }
+
+      for (auto &job : jobs) {
+         waitInflateJob(job);
+         REQUIRE(!job->failed());
+      }
+
+      auto queued = std::chrono::steady_clock::now() - start;
+      WARN(fmt::format("{} threads: {} sections, {} MiB, {} ms waiting on each, {} ms queued",
+                       numThreads, sections.size(), totalInflatedSize / (1024 * 1024),
+                       std::chrono::duration_cast<std::chrono::milliseconds>(serial).count(),
+                       std::chrono::duration_cast<std::chrono::milliseconds>(queued).count()));
+   }
+
+   // A second boot with the section cache filled in by the first
+   for (auto pass : { "cold", "warm" }) {
+      auto dst = inflated.data();
+      auto start = std::chrono::steady_clock::now();
+
+      for (auto &section : sections) {
+         auto job = InflateJob { };
+         job.deflated = section;
+         job.dst = dst;
+         job.dstSize = static_cast<uint32_t>(inflated.data() + inflated.size() - dst);
+         job.cachePath = "loader-bench-cache";
+         inflateSectionCached(job);
+         REQUIRE(!job.failed());
+         dst += job.inflatedSize;
+      }
+
+      auto elapsed = std::chrono::steady_clock::now() - start;
+      WARN(fmt::format("section cache {}: {} ms", pass,
+                       std::chrono::duration_cast<std::chrono::milliseconds>(elapsed).count()));
+   }
+}
@@ -0,0 +1,82 @@
+#include <catch.hpp>
+#include "../cpu/libcpu/kernel_calls.h"
+
+#include <libcpu/cpu.h>
+
+#include <chrono>
+#include <memory>
+#include <vector>
+
+/**
+ * The HLE function a kc used to reach: a virtual call behind a per call trace
+ * check, found through the kernel call handler.
+ */
+struct VirtualKernelCall
+{
+   virtual ~VirtualKernelCall() = default;
+   virtual void call(cpu::Core *core) = 0;
+   bool traceEnabled = true;
+};
+
+template<cpu::KernelCallFunction Func>
+struct VirtualKernelCallImpl : VirtualKernelCall
+{
+   void call(cpu::Core *core) override
+   {
+      if (sTraceVirtualCalls && traceEnabled) {
+         ++sTraceCalls;
+      }
+
+      Func(core, nullptr);
+   }
+
+   static inline bool sTraceVirtualCalls = false;
+};
+
+static std::vector<VirtualKernelCall *> sVirtualKernelCalls;
+
+static void
+virtualKernelCallHandler(cpu::Core *core,
+                         uint32_t id)
+{
+   sVirtualKernelCalls[id & 0x7FFFFF]->call(core);
+}
+
+TEST_CASE("kernel call dispatch", "[libcpu]")
+{
+   constexpr auto NumCalls = 50000000u;
+   registerTestKernelCalls();
+
+   auto getTime = VirtualKernelCallImpl<&osGetTime> { };
+   auto fastMutexLock = VirtualKernelCallImpl<&osFastMutexLock> { };
+   sVirtualKernelCalls.resize(OSFastMutexLockId + 1);
+   sVirtualKernelCalls[OSGetTimeId] = &getTime;
+   sVirtualKernelCalls[OSFastMutexLockId] = &fastMutexLock;
+
+   auto core = std::make_unique<cpu::Core>();
+
+   for (auto id : { OSGetTimeId, OSFastMutexLockId }) {
+      auto name = id == OSGetTimeId ? "OSGetTime" : "OSFastMutex_Lock";
+
+      // With the top bit set the id has no registered function, so it goes
+      // through the kernel call handler like every kc did before.
+      cpu::setKernelCallHandler(&virtualKernelCallHandler);
+      auto start = std::chrono::steady_clock::now();
+      for (auto i = 0u; i < NumCalls; ++i) {
+         cpu::onKernelCall(core.get(), 0x800000 | id);
+      }
+      auto handlerTime = std::chrono::steady_clock::now() - start;
+
+      start = std::chrono::steady_clock::now();
+      for (auto i = 0u; i < NumCalls; ++i) {
+         cpu::onKernelCall(core.get(), id);
+      }
+      auto directTime = std::chrono::steady_clock::now() - start;
+      cpu::setKernelCallHandler(&kernelCallHandler);
+
+      auto handlerNs = std::chrono::duration<double, std::nano> { handlerTime }.count() / NumCalls;
+      auto directNs = std::chrono::duration<double, std::nano> { directTime }.count() / NumCalls;
+      WARN(name << " through handler and virtual call: " << handlerNs << " ns/call");
+      WARN(name << " direct dispatch: " << directNs << " ns/call");
+   }
+}
@@ -0,0 +1,22 @@
+#include <catch.hpp>
+#include "../gpu/command_buffers.h"
+#include "../gpu/counting_processor.h"
+
+#include <chrono>
+#include <cstdint>
+
+TEST_CASE("pm4 processor", "[gpu]")
+{
+   auto processor = CountingProcessor { };
+   auto buffer = buildRegisterWrites(0x10000);
+   const auto iterations = 1000;
+
+   auto start = std::chrono::steady_clock::now();
+   for (auto i = 0; i < iterations; ++i) {
+      processor.run(buffer);
+   }
+   auto time = std::chrono::steady_clock::now() - start;
+
+   auto seconds = std::chrono::duration<double> { time }.count();
+   WARN("pm4 processor: " << (iterations * buffer.size() / seconds) << " words/s");
+}
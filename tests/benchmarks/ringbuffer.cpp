@@ -0,0 +1,32 @@
+#include <catch.hpp>
+#include "../gpu/command_buffers.h"
+#include "../gpu/counting_processor.h"
+
+#include <chrono>
+#include <cstdint>
+#include <thread>
+
+TEST_CASE("ringbuffer throughput", "[gpu]")
+{
+   auto processor = CountingProcessor { };
+   const auto submissions = uint64_t { 2000000 };
+
+   auto start = std::chrono::steady_clock::now();
+   auto producer = std::thread {
+      [&]() {
+         for (auto i = 1u; i <= submissions; ++i) {
+            submitCommandBuffer(i);
+         }
+      } };
+
+   consumeUntil(processor, submissions);
+   auto time = std::chrono::steady_clock::now() - start;
+   producer.join();
+
+   // Each submission is three packets, NOP, MEM_WRITE and EVENT_WRITE_EOP
+   auto seconds = std::chrono::duration<double> { time }.count();
+   WARN("ringbuffer: " << (3 * submissions / seconds) << " packets/s, "
+        << (submissions / seconds) << " submissions/s");
+   REQUIRE(processor.inOrder);
+   REQUIRE(processor.eventWrites == submissions);
+}
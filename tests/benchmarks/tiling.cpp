@@ -0,0 +1,142 @@
+#include <catch.hpp>
+#include "../gpu/tiling_reference.h"
+
+#include <gpu_config.h>
+#include <gpu7_tiling.h>
+
+#include <algorithm>
+#include <chrono>
+#include <fmt/format.h>
+#include <vector>
+
+using namespace gpu7::tiling;
+
+TEST_CASE("gpu7 untiling", "[gpu]")
+{
+   constexpr auto NumIterations = 20;
+
+   for (auto tileMode : { TileMode::Tiled1DThin1, TileMode::Tiled2DThin1, TileMode::Tiled2BThick }) {
+      for (auto isDepth : { false, true }) {
+         auto surface = SurfaceInfo { };
+         surface.bpp = 32;
+         surface.tileMode = tileMode;
+         surface.width = 1920;
+         surface.height = 1080;
+         surface.depth = 4;
+         surface.isDepth = isDepth;
+         surface.bankSwizzle = 1;
+
+         const auto pitch = calculateAlignedPitch(surface);
+         surface.height = calculateAlignedHeight(surface);
+
+         const auto imageSize = static_cast<size_t>(pitch) * surface.height * surface.depth * 4;
+         auto tiled = getRandomBytes(imageSize, 0);
+         auto untiled = std::vector<uint8_t>(imageSize);
+
+         auto getMBps = [&](auto duration) {
+            auto seconds = std::chrono::duration<double> { duration }.count();
+            return (imageSize * NumIterations) / seconds / (1024 * 1024);
+         };
+
+         // The per element copy which the drivers used before
+         auto start = std::chrono::steady_clock::now();
+         for (auto i = 0; i < NumIterations; ++i) {
+            copySlicesPerElement(surface, pitch, tiled.data(), untiled.data(), surface.width,
+                                 0, surface.depth, false);
+         }
+         auto perElement = std::chrono::steady_clock::now() - start;
+
+         auto expected = untiled;
+         auto threads = gpu::config::tiling_threads;
+         gpu::config::tiling_threads = 0;
+
+         start = std::chrono::steady_clock::now();
+         for (auto i = 0; i < NumIterations; ++i) {
+            untileSlices(surface, pitch, tiled.data(), untiled.data(), surface.width, 0, surface.depth);
+         }
+         auto microTiles = std::chrono::steady_clock::now() - start;
+         REQUIRE(untiled == expected);
+
+         gpu::config::tiling_threads = std::max(threads, 1u);
+
+         start = std::chrono::steady_clock::now();
+         for (auto i = 0; i < NumIterations; ++i) {
+            untileSlices(surface, pitch, tiled.data(), untiled.data(), surface.width, 0, surface.depth);
+         }
+         auto parallel = std::chrono::steady_clock::now() - start;
+         REQUIRE(untiled == expected);
+         gpu::config::tiling_threads = threads;
+
+         WARN(fmt::format("tileMode {} isDepth {}: per element {:.0f} MB/s, micro tiles {:.0f} MB/s, "
+                          "micro tiles on {} threads {:.0f} MB/s",
+                          static_cast<int>(tileMode), isDepth,
+                          getMBps(perElement), getMBps(microTiles),
+                          gpu::config::tiling_threads + 1, getMBps(parallel)));
+      }
+   }
+}
+
+TEST_CASE("gpu7 tiling", "[gpu]")
+{
+   constexpr auto NumIterations = 20;
+
+   for (auto tileMode : { TileMode::Tiled1DThin1, TileMode::Tiled2DThin1, TileMode::Tiled2BThick }) {
+      for (auto isDepth : { false, true }) {
+         auto surface = SurfaceInfo { };
+         surface.bpp = 32;
+         surface.tileMode = tileMode;
+         surface.width = 1920;
+         surface.height = 1080;
+         surface.depth = 4;
+         surface.isDepth = isDepth;
+         surface.bankSwizzle = 1;
+
+         const auto pitch = calculateAlignedPitch(surface);
+         surface.height = calculateAlignedHeight(surface);
+
+         const auto imageSize = static_cast<size_t>(pitch) * surface.height * surface.depth * 4;
+         auto untiled = getRandomBytes(imageSize, 0);
+         auto tiled = std::vector<uint8_t>(imageSize);
+
+         auto getMBps = [&](auto duration) {
+            auto seconds = std::chrono::duration<double> { duration }.count();
+            return (imageSize * NumIterations) / seconds / (1024 * 1024);
+         };
+
+         // The per element copy which the drivers used before
+         auto start = std::chrono::steady_clock::now();
+         for (auto i = 0; i < NumIterations; ++i) {
+            copySlicesPerElement(surface, pitch, tiled.data(), untiled.data(), surface.width,
+                                 0, surface.depth, true);
+         }
+         auto perElement = std::chrono::steady_clock::now() - start;
+
+         auto expected = tiled;
+         auto threads = gpu::config::tiling_threads;
+         gpu::config::tiling_threads = 0;
+
+         start = std::chrono::steady_clock::now();
+         for (auto i = 0; i < NumIterations; ++i) {
+            tileSlices(surface, pitch, untiled.data(), surface.width, tiled.data(), 0, surface.depth);
+         }
+         auto microTiles = std::chrono::steady_clock::now() - start;
+         REQUIRE(tiled == expected);
+
+         gpu::config::tiling_threads = std::max(threads, 1u);
+
+         start = std::chrono::steady_clock::now();
+         for (auto i = 0; i < NumIterations; ++i) {
+            tileSlices(surface, pitch, untiled.data(), surface.width, tiled.data(), 0, surface.depth);
+         }
+         auto parallel = std::chrono::steady_clock::now() - start;
+         REQUIRE(tiled == expected);
+         gpu::config::tiling_threads = threads;
+
+         WARN(fmt::format("tileMode {} isDepth {}: per element {:.0f} MB/s, micro tiles {:.0f} MB/s, "
+                          "micro tiles on {} threads {:.0f} MB/s",
+                          static_cast<int>(tileMode), isDepth,
+                          getMBps(perElement), getMBps(microTiles),
+                          gpu::config::tiling_threads + 1, getMBps(parallel)));
+      }
+   }
+}
@@ -0,0 +1,57 @@
+#include <catch.hpp>
+#include "../cpu/libcpu/test_memory.h"
+
+#include <common/datahash.h>
+#include <libcpu/mmu.h>
+
+#include <chrono>
+#include <cstdint>
+#include <cstring>
+
+TEST_CASE("physical write tracking", "[libcpu]")
+{
+   auto memory = getTestMemory();
+   auto generation = cpu::getPhysicalWriteGeneration();
+   std::memset(memory, 0xCD, TestSize);
+
+   if (!cpu::trackPhysicalWrites(TestPhysicalAddress, TestSize)) {
+      WARN("Physical write tracking is not supported on this host");
+      return;
+   }
+
+   // Compare checking a large vertex buffer for changes by hashing it with
+   // checking its pages with write tracking.
+   const auto iterations = 20;
+   auto hashSum = uint64_t { 0 };
+   auto dirtyCount = 0;
+
+   auto hashStart = std::chrono::steady_clock::now();
+   for (auto i = 0; i < iterations; ++i) {
+      hashSum += DataHash { }.write(memory, TestSize).value()[0];
+   }
+   auto hashTime = std::chrono::steady_clock::now() - hashStart;
+
+   auto trackStart = std::chrono::steady_clock::now();
+   for (auto i = 0; i < iterations; ++i) {
+      if (cpu::hasPhysicalWriteSince(TestPhysicalAddress, TestSize, generation)) {
+         ++dirtyCount;
+      }
+   }
+   auto trackTime = std::chrono::steady_clock::now() - trackStart;
+
+   // Cost of the first write to a tracked page
+   auto faultStart = std::chrono::steady_clock::now();
+   for (auto i = 0; i < iterations; ++i) {
+      memory[i * cpu::WriteTrackPageSize] = static_cast<uint8_t>(i);
+   }
+   auto faultTime = std::chrono::steady_clock::now() - faultStart;
+
+   auto hashUs = std::chrono::duration<double, std::micro> { hashTime }.count() / iterations;
+   auto trackUs = std::chrono::duration<double, std::micro> { trackTime }.count() / iterations;
+   auto faultUs = std::chrono::duration<double, std::micro> { faultTime }.count() / iterations;
+   WARN("hash " << (TestSize >> 20) << " MiB: " << hashUs << " us/check (sum " << hashSum << ")");
+   WARN("write tracking " << (TestSize >> 20) << " MiB: " << trackUs << " us/check");
+   WARN("write fault: " << faultUs << " us/write");
+   REQUIRE(dirtyCount == 0);
+   REQUIRE(cpu::hasPhysicalWriteSince(TestPhysicalAddress, TestSize, generation));
+}
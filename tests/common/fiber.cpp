@@ -0,0 +1,43 @@
+#include <catch.hpp>
+#include "fiber_pingpong.h"
+
+#include <common/platform_fiber.h>
+
+TEST_CASE("fiber switching")
+{
+   runPingPong(1000);
+}
+
+TEST_CASE("fiber preserves callee saved floating point state")
+{
+   struct State
+   {
+      platform::Fiber *main;
+      platform::Fiber *fiber;
+      double value;
+   } state;
+
+   state.main = platform::getThreadFiber();
+   state.fiber = platform::createFiber(
+      [](void *param) {
+         auto state = reinterpret_cast<State *>(param);
+
+         while (true) {
+            state->value *= 2.0;
+            platform::swapToFiber(state->fiber, state->main);
+         }
+      }, &state);
+
+   auto local = 1.5;
+   state.value = 1.0;
+
+   for (auto i = 0; i < 10; ++i) {
+      platform::swapToFiber(state.main, state.fiber);
+      local += 1.0;
+   }
+
+   REQUIRE(local == 11.5);
+   REQUIRE(state.value == 1024.0);
+   platform::destroyFiber(state.fiber);
+   platform::destroyFiber(state.main);
+}
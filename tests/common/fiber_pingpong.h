@@ -0,0 +1,49 @@
+#pragma once
+#include <catch.hpp>
+
+#include <common/platform_fiber.h>
+
+#include <chrono>
+#include <cstdint>
+
+struct PingPong
+{
+   platform::Fiber *main = nullptr;
+   platform::Fiber *fiber = nullptr;
+   uint64_t count = 0;
+};
+
+inline void
+pingPongEntry(void *param)
+{
+   auto state = reinterpret_cast<PingPong *>(param);
+
+   while (true) {
+      ++state->count;
+      platform::swapToFiber(state->fiber, state->main);
+   }
+}
+
+/**
+ * Switch to a fiber and back iterations times, returns how many seconds
+ * that took.
+ */
+inline double
+runPingPong(uint64_t iterations)
+{
+   auto state = PingPong { };
+   state.main = platform::getThreadFiber();
+   state.fiber = platform::createFiber(pingPongEntry, &state);
+   REQUIRE(state.fiber);
+
+   auto start = std::chrono::steady_clock::now();
+   for (auto i = 0u; i < iterations; ++i) {
+      platform::swapToFiber(state.main, state.fiber);
+   }
+   auto time = std::chrono::steady_clock::now() - start;
+
+   REQUIRE(state.count == iterations);
+   platform::destroyFiber(state.fiber);
+   platform::destroyFiber(state.main);
+   return std::chrono::duration<double> { time }.count();
+}
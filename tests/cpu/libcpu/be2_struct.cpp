@@ -1,6 +1,4 @@
-#define CATCH_CONFIG_MAIN
 #include <catch.hpp>
-
 #include <libcpu/be2_struct.h>
 
 TEST_CASE("be_* address of returns virt_ptr")
@@ -0,0 +1,28 @@
+#include <catch.hpp>
+#include "espresso_decoders.h"
+
+#include <libcpu/espresso/espresso_instructionset.h>
+
+#include <cstdint>
+
+TEST_CASE("espresso flat decode table matches tree decoder")
+{
+   initialiseInstructionSet();
+
+   // Every primary opcode and every value of the extended opcode and rc bits,
+   // with a few patterns for the operand fields in bits 6-20.
+   const uint32_t operandPatterns[] = {
+      0x00000000, 0x03FFF800, 0x02AAA800, 0x01555000,
+      0x00001000, 0x00100000, 0x03E00000, 0x001F0000,
+   };
+
+   for (auto primary = 0u; primary < 64; ++primary) {
+      for (auto extended = 0u; extended < 0x800; ++extended) {
+         for (auto operands : operandPatterns) {
+            auto instr = (primary << 26) | operands | extended;
+            INFO("instr = 0x" << std::hex << instr);
+            REQUIRE(espresso::decodeInstructionID(instr) == treeDecodeID(instr));
+         }
+      }
+   }
+}
@@ -0,0 +1,22 @@
+#pragma once
+#include <libcpu/espresso/espresso_instructionset.h>
+
+#include <cstdint>
+
+inline void
+initialiseInstructionSet()
+{
+   static bool initialised = false;
+
+   if (!initialised) {
+      espresso::initialiseInstructionSet();
+      initialised = true;
+   }
+}
+
+inline espresso::InstructionID
+treeDecodeID(uint32_t instr)
+{
+   auto data = espresso::decodeInstructionTree(instr);
+   return data ? data->id : espresso::InstructionID::Invalid;
+}
@@ -0,0 +1,110 @@
+#include <catch.hpp>
+#include "test_memory.h"
+
+#include <libcpu/be2_struct.h>
+#include <libcpu/cpu.h>
+#include <libcpu/cpu_config.h>
+#include <libcpu/mem.h>
+
+#include <array>
+#include <atomic>
+#include <functional>
+
+static constexpr auto CodeAddress = TestVirtualAddress.getAddress() + 0x1000000u;
+
+// li r3, value; blr
+static void
+writeLoadImmediate(uint32_t address,
+                   uint16_t value)
+{
+   mem::write<uint32_t>(address, 0x38600000u | value);
+   mem::write<uint32_t>(address + 4, 0x4E800020u);
+}
+
+static uint32_t
+callGuest(cpu::Core *core,
+          uint32_t address)
+{
+   core->nia = address;
+   cpu::this_core::executeSub();
+   return core->gpr[3];
+}
+
+static void
+runOnCores(std::function<void(cpu::Core *)> func)
+{
+   getTestMemory();
+   cpu::config::interpreter::block_cache = true;
+   cpu::setCoreEntrypointHandler(func);
+   cpu::start();
+   cpu::join();
+   cpu::clearInstructionCache();
+}
+
+TEST_CASE("interpreter block cache invalidation")
+{
+   std::array<uint32_t, 4> results;
+
+   runOnCores([&](cpu::Core *core) {
+      if (core->id != 1) {
+         return;
+      }
+
+      writeLoadImmediate(CodeAddress, 1);
+      results[0] = callGuest(core, CodeAddress);
+
+      // Without an invalidation the cached block keeps running
+      writeLoadImmediate(CodeAddress, 2);
+      results[1] = callGuest(core, CodeAddress);
+
+      cpu::invalidateInstructionCache(CodeAddress, 8);
+      results[2] = callGuest(core, CodeAddress);
+
+      // Invalidating another range leaves the block alone
+      writeLoadImmediate(CodeAddress, 3);
+      cpu::invalidateInstructionCache(CodeAddress + 0x1000, 8);
+      results[3] = callGuest(core, CodeAddress);
+   });
+
+   REQUIRE(results[0] == 1);
+   REQUIRE(results[1] == 1);
+   REQUIRE(results[2] == 2);
+   REQUIRE(results[3] == 2);
+}
+
+TEST_CASE("interpreter block cache concurrent invalidation")
+{
+   std::atomic<bool> writerDone { false };
+   std::atomic<uint32_t> badResults { 0 };
+   std::array<uint32_t, 3> finalResults { };
+
+   writeLoadImmediate(CodeAddress, 1);
+   runOnCores([&](cpu::Core *core) {
+      if (core->id == 0) {
+         // Keep rewriting the code while the other cores are decoding it
+         for (auto i = 0; i < 20000; ++i) {
+            writeLoadImmediate(CodeAddress, static_cast<uint16_t>(1 + (i & 1)));
+            cpu::invalidateInstructionCache(CodeAddress, 8);
+         }
+
+         writeLoadImmediate(CodeAddress, 3);
+         cpu::invalidateInstructionCache(CodeAddress, 8);
+         writerDone.store(true);
+         return;
+      }
+
+      while (!writerDone.load()) {
+         auto result = callGuest(core, CodeAddress);
+         if (result < 1 || result > 3) {
+            badResults.fetch_add(1);
+         }
+      }
+
+      // Once the last invalidation is done no core may run an older block
+      finalResults[core->id] = callGuest(core, CodeAddress);
+   });
+
+   REQUIRE(badResults.load() == 0);
+   REQUIRE(finalResults[1] == 3);
+   REQUIRE(finalResults[2] == 3);
+}
@@ -0,0 +1,40 @@
+#include <catch.hpp>
+#include "kernel_calls.h"
+
+#include <libcpu/cpu.h>
+
+#include <memory>
+
+TEST_CASE("kernel call dispatch")
+{
+   registerTestKernelCalls();
+   auto core = std::make_unique<cpu::Core>();
+   sTime = 0x123456789ull;
+   sHandlerCalls = 0;
+   sTraceCalls = 0;
+
+   cpu::onKernelCall(core.get(), OSGetTimeId);
+   REQUIRE(core->gpr[3] == 0x1);
+   REQUIRE(core->gpr[4] == 0x2345678A);
+   REQUIRE(sHandlerCalls == 0);
+   REQUIRE(sTraceCalls == 0);
+
+   // Ids without a registered function go to the kernel call handler
+   cpu::onKernelCall(core.get(), UnregisteredId);
+   cpu::onKernelCall(core.get(), 0x800000 | OSGetTimeId);
+   REQUIRE(sHandlerCalls == 2);
+   REQUIRE(sHandlerLastId == (0x800000 | OSGetTimeId));
+
+   // Tracing switches to the trace table, only functions with tracing
+   // enabled have a different entry in it
+   cpu::setKernelCallTraceEnabled(true);
+   cpu::onKernelCall(core.get(), OSGetTimeId);
+   cpu::onKernelCall(core.get(), OSFastMutexLockId);
+   REQUIRE(sTraceCalls == 1);
+   REQUIRE(core->gpr[4] == 0x2345678B);
+
+   cpu::setKernelCallTraceEnabled(false);
+   cpu::onKernelCall(core.get(), OSGetTimeId);
+   REQUIRE(sTraceCalls == 1);
+   REQUIRE(core->gpr[4] == 0x2345678C);
+}
@@ -0,0 +1,69 @@
+#pragma once
+#include <libcpu/cpu.h>
+
+#include <atomic>
+#include <cstdint>
+
+// Ids well past those used by the other tests, registered once per process.
+constexpr auto OSGetTimeId = uint32_t { 0x100 };
+constexpr auto OSFastMutexLockId = uint32_t { 0x101 };
+constexpr auto UnregisteredId = uint32_t { 0x102 };
+
+inline uint32_t sHandlerCalls = 0;
+inline uint32_t sHandlerLastId = 0;
+inline uint32_t sTraceCalls = 0;
+inline uint64_t sTime = 0;
+inline std::atomic<uint32_t> sFastMutex { 0 };
+
+// Does the same work as the HLE OSGetTime, return the time in r3:r4.
+inline void
+osGetTime(cpu::Core *core,
+          void *)
+{
+   sTime += 1;
+   core->gpr[3] = static_cast<uint32_t>(sTime >> 32);
+   core->gpr[4] = static_cast<uint32_t>(sTime);
+}
+
+// Does the uncontended path of the HLE OSFastMutex_Lock.
+inline void
+osFastMutexLock(cpu::Core *core,
+                void *)
+{
+   auto expected = uint32_t { 0 };
+   sFastMutex.compare_exchange_strong(expected, core->gpr[3]);
+   sFastMutex.store(0, std::memory_order_relaxed);
+}
+
+inline void
+traceOsGetTime(cpu::Core *core,
+               void *userData)
+{
+   ++sTraceCalls;
+   osGetTime(core, userData);
+}
+
+inline void
+kernelCallHandler(cpu::Core *core,
+                  uint32_t id)
+{
+   ++sHandlerCalls;
+   sHandlerLastId = id;
+}
+
+inline void
+registerTestKernelCalls()
+{
+   static bool registered = false;
+
+   if (!registered) {
+      cpu::setKernelCallHandler(&kernelCallHandler);
+      cpu::registerKernelCall(OSGetTimeId,
+                              { &osGetTime, nullptr },
+                              { &traceOsGetTime, nullptr });
+      cpu::registerKernelCall(OSFastMutexLockId,
+                              { &osFastMutexLock, nullptr },
+                              { &osFastMutexLock, nullptr });
+      registered = true;
+   }
+}
@@ -0,0 +1,30 @@
+#pragma once
+#include <catch.hpp>
+
+#include <libcpu/cpu.h>
+#include <libcpu/cpu_config.h>
+#include <libcpu/mmu.h>
+
+#include <cstdint>
+
+constexpr auto TestVirtualAddress = cpu::VirtualAddress { 0x10000000 };
+constexpr auto TestPhysicalAddress = cpu::PhysicalAddress { 0x10000000 };
+constexpr auto TestSize = uint32_t { 64 * 1024 * 1024 };
+
+inline uint8_t *
+getTestMemory()
+{
+   static bool initialised = false;
+
+   if (!initialised) {
+      // The tests which run guest code run it in the interpreter
+      cpu::config::jit::enabled = false;
+      cpu::initialise();
+      REQUIRE(cpu::allocateVirtualAddress(TestVirtualAddress, TestSize));
+      REQUIRE(cpu::mapMemory(TestVirtualAddress, TestPhysicalAddress, TestSize,
+                             cpu::MapPermission::ReadWrite));
+      initialised = true;
+   }
+
+   return cpu::internal::translate<uint8_t>(TestVirtualAddress);
+}
@@ -0,0 +1,56 @@
+#include <catch.hpp>
+#include "test_memory.h"
+
+#include <libcpu/mmu.h>
+
+TEST_CASE("physical write tracking")
+{
+   auto memory = getTestMemory();
+   auto generation = cpu::getPhysicalWriteGeneration();
+
+   if (!cpu::trackPhysicalWrites(TestPhysicalAddress, TestSize)) {
+      WARN("Physical write tracking is not supported on this host");
+      return;
+   }
+
+   REQUIRE(!cpu::hasPhysicalWriteSince(TestPhysicalAddress, TestSize, generation));
+
+   // A write through a virtual mapping dirties only its page
+   auto offset = 5 * cpu::WriteTrackPageSize + 16;
+   memory[offset] = 0x42;
+   REQUIRE(memory[offset] == 0x42);
+   REQUIRE(cpu::hasPhysicalWriteSince(TestPhysicalAddress, TestSize, generation));
+   REQUIRE(cpu::hasPhysicalWriteSince(TestPhysicalAddress + offset, 1, generation));
+   REQUIRE(!cpu::hasPhysicalWriteSince(TestPhysicalAddress, 5 * cpu::WriteTrackPageSize, generation));
+   REQUIRE(!cpu::hasPhysicalWriteSince(TestPhysicalAddress + 6 * cpu::WriteTrackPageSize,
+                                       cpu::WriteTrackPageSize, generation));
+
+   // Tracking again protects the page again
+   generation = cpu::getPhysicalWriteGeneration();
+   REQUIRE(cpu::trackPhysicalWrites(TestPhysicalAddress, TestSize));
+   REQUIRE(!cpu::hasPhysicalWriteSince(TestPhysicalAddress, TestSize, generation));
+   memory[offset] = 0x43;
+   REQUIRE(cpu::hasPhysicalWriteSince(TestPhysicalAddress + offset, 1, generation));
+
+   // Writes through physical pointers are tracked too
+   generation = cpu::getPhysicalWriteGeneration();
+   REQUIRE(cpu::trackPhysicalWrites(TestPhysicalAddress, TestSize));
+   cpu::internal::translate<uint8_t>(TestPhysicalAddress)[0] = 0x44;
+   REQUIRE(cpu::hasPhysicalWriteSince(TestPhysicalAddress, 1, generation));
+   REQUIRE(memory[0] == 0x44);
+
+   // Host writes leave their pages writable until they end, even when the
+   // range is tracked again in between
+   auto hostWriteAddress = TestPhysicalAddress + 8 * cpu::WriteTrackPageSize;
+   generation = cpu::getPhysicalWriteGeneration();
+   cpu::beginHostWrite(hostWriteAddress, 2 * cpu::WriteTrackPageSize);
+   REQUIRE(cpu::hasPhysicalWriteSince(hostWriteAddress, 1, generation));
+   REQUIRE(cpu::trackPhysicalWrites(TestPhysicalAddress, TestSize));
+
+   generation = cpu::getPhysicalWriteGeneration();
+   cpu::internal::translate<uint8_t>(hostWriteAddress)[cpu::WriteTrackPageSize] = 0x45;
+   cpu::endHostWrite(hostWriteAddress, 2 * cpu::WriteTrackPageSize);
+   REQUIRE(cpu::hasPhysicalWriteSince(hostWriteAddress, 2 * cpu::WriteTrackPageSize, generation));
+   REQUIRE(!cpu::hasPhysicalWriteSince(hostWriteAddress + 2 * cpu::WriteTrackPageSize,
+                                       cpu::WriteTrackPageSize, generation));
+}
@@ -0,0 +1,85 @@
+#include <catch.hpp>
+#include <filesystem/filesystem.h>
+#include <filesystem/filesystem_host_mapped_filehandle.h>
+
+#include <algorithm>
+#include <array>
+#include <common/platform_dir.h>
+#include <cstdio>
+#include <vector>
+
+TEST_CASE("mapped read only files read the same as stdio files")
+{
+   auto contents = std::vector<uint8_t>(100000);
+
+   for (auto i = 0u; i < contents.size(); ++i) {
+      contents[i] = static_cast<uint8_t>(i * 7 + (i >> 8));
+   }
+
+   REQUIRE(platform::createDirectory("fs-test-mapped"));
+   auto host = std::fopen("fs-test-mapped/file.bin", "wb");
+   REQUIRE(host);
+   std::fwrite(contents.data(), 1, contents.size(), host);
+   std::fclose(host);
+
+   fs::FileSystem fs;
+   REQUIRE(fs.mountHostFolder("/vol/content", "fs-test-mapped", fs::Permissions::Read));
+   REQUIRE(fs.mountHostFolder("/vol/save", "fs-test-mapped", fs::Permissions::ReadWrite));
+
+   auto mapped = fs.openFile("/vol/content/file.bin", fs::File::Read).value();
+   auto stdio = fs.openFile("/vol/save/file.bin", fs::File::Read).value();
+   REQUIRE(dynamic_cast<fs::HostMappedFileHandle *>(mapped.get()));
+   REQUIRE(!dynamic_cast<fs::HostMappedFileHandle *>(stdio.get()));
+   REQUIRE(mapped->size() == contents.size());
+
+   // Handles share the mapping but each has its own position
+   auto other = fs.openFile("/vol/content/file.bin", fs::File::Read).value();
+   auto otherData = std::array<uint8_t, 16> { };
+   other->seek(1000);
+   REQUIRE(other->read(otherData.data(), 1, otherData.size()) == otherData.size());
+   REQUIRE(std::equal(otherData.begin(), otherData.end(), contents.begin() + 1000));
+   REQUIRE(mapped->tell() == 0);
+
+   auto compareRead = [&](size_t size, size_t count) {
+      auto mappedData = std::vector<uint8_t>(size * count);
+      auto stdioData = std::vector<uint8_t>(size * count);
+      auto mappedRead = mapped->read(mappedData.data(), size, count);
+      auto stdioRead = stdio->read(stdioData.data(), size, count);
+      REQUIRE(mappedRead == stdioRead);
+      REQUIRE(std::equal(mappedData.begin(), mappedData.begin() + mappedRead * size,
+                         stdioData.begin()));
+      REQUIRE(mapped->tell() == stdio->tell());
+      REQUIRE(mapped->eof() == stdio->eof());
+   };
+
+   compareRead(1, 17);
+   compareRead(4, 1000);
+   compareRead(1, 70000);
+
+   // Read up to exactly the end, then past it
+   mapped->seek(contents.size() - 64);
+   stdio->seek(contents.size() - 64);
+   compareRead(16, 4);
+   compareRead(16, 4);
+
+   // Seeking clears end of file, and a short read returns whole elements
+   mapped->seek(contents.size() - 10);
+   stdio->seek(contents.size() - 10);
+   REQUIRE(!mapped->eof());
+   compareRead(4, 4);
+
+   mapped->seek(contents.size() + 100);
+   stdio->seek(contents.size() + 100);
+   compareRead(1, 1);
+
+   // Writing to a read only file fails instead of aborting
+   REQUIRE(mapped->write(contents.data(), 1, 16) == 0);
+   REQUIRE(mapped->truncate() == 0);
+   REQUIRE(mapped->size() == contents.size());
+
+   mapped->close();
+   stdio->close();
+   other->close();
+   std::remove("fs-test-mapped/file.bin");
+   std::remove("fs-test-mapped");
+}
@@ -0,0 +1,169 @@
+#include <catch.hpp>
+#include <filesystem/filesystem.h>
+
+#include <atomic>
+#include <common/platform_dir.h>
+#include <cstdio>
+#include <string>
+#include <thread>
+#include <vector>
+
+static bool
+createHostFile(const std::string &path)
+{
+   auto handle = std::fopen(path.c_str(), "wb");
+
+   if (!handle) {
+      return false;
+   }
+
+   std::fclose(handle);
+   return true;
+}
+
+TEST_CASE("path cache sees virtual folders being created and removed")
+{
+   fs::FileSystem fs;
+
+   REQUIRE(!fs.folderExists("/vol/a/b"));
+   REQUIRE(fs.makeFolder("/vol/a/b"));
+   REQUIRE(fs.folderExists("/vol/a/b"));
+   REQUIRE(fs.folderExists("/vol/a/b/"));
+   REQUIRE(fs.folderExists("vol/a"));
+
+   REQUIRE(fs.remove("/vol/a/b") == fs::Error::OK);
+   REQUIRE(!fs.folderExists("/vol/a/b"));
+   REQUIRE(fs.folderExists("/vol/a"));
+
+   REQUIRE(fs.makeFolder("/vol/a/b"));
+   REQUIRE(fs.folderExists("/vol/a/b"));
+}
+
+TEST_CASE("path cache sees host files being created, moved and removed")
+{
+   fs::FileSystem fs;
+   REQUIRE(platform::createDirectory("fs-test-host"));
+   REQUIRE(fs.mountHostFolder("/vol/host", "fs-test-host", fs::Permissions::ReadWrite));
+   REQUIRE(fs.makeFolder("/vol/host/dir"));
+
+   // Cache the file as missing first
+   REQUIRE(!fs.fileExists("/vol/host/dir/a.txt"));
+
+   auto file = fs.openFile("/vol/host/dir/a.txt", fs::File::Write);
+   REQUIRE(file);
+   file.value()->write("decaf", 1, 5);
+   file.value()->close();
+
+   REQUIRE(fs.fileExists("/vol/host/dir/a.txt"));
+   REQUIRE(fs.findEntry("/vol/host/dir/a.txt").value().size == 5);
+
+   REQUIRE(fs.move("/vol/host/dir/a.txt", "/vol/host/dir/b.txt") == fs::Error::OK);
+   REQUIRE(!fs.fileExists("/vol/host/dir/a.txt"));
+   REQUIRE(fs.fileExists("/vol/host/dir/b.txt"));
+
+   REQUIRE(fs.remove("/vol/host/dir/b.txt") == fs::Error::OK);
+   REQUIRE(!fs.fileExists("/vol/host/dir/b.txt"));
+   REQUIRE(fs.remove("/vol/host/dir") == fs::Error::OK);
+   REQUIRE(!fs.folderExists("/vol/host/dir"));
+   std::remove("fs-test-host");
+}
+
+TEST_CASE("path cache drops folders deleted behind its back")
+{
+   fs::FileSystem fs;
+   REQUIRE(platform::createDirectory("fs-test-stale/dir"));
+   REQUIRE(createHostFile("fs-test-stale/dir/file.bin"));
+   REQUIRE(fs.mountHostFolder("/vol/host", "fs-test-stale", fs::Permissions::Read));
+   REQUIRE(fs.fileExists("/vol/host/dir/file.bin"));
+
+   // Removing the folder on the host and looking it up again frees its node
+   std::remove("fs-test-stale/dir/file.bin");
+   std::remove("fs-test-stale/dir");
+   REQUIRE(!fs.fileExists("/vol/host/dir/file.bin"));
+   REQUIRE(!fs.openFolder("/vol/host/dir"));
+   REQUIRE(!fs.fileExists("/vol/host/dir/file.bin"));
+   std::remove("fs-test-stale");
+}
+
+TEST_CASE("path cache lookups race with invalidation")
+{
+   fs::FileSystem fs;
+   REQUIRE(fs.makeFolder("/vol/a/b/c"));
+
+   // Removing something which does not exist invalidates the cache without
+   // changing the tree, so every lookup must still give the same answer
+   auto stop = std::atomic<bool> { false };
+   auto invalidator = std::thread {
+      [&]() {
+         while (!stop) {
+            fs.remove("/vol/a/missing");
+         }
+      } };
+
+   auto readers = std::vector<std::thread> { };
+   auto wrongResults = std::atomic<int> { 0 };
+
+   for (auto i = 0; i < 4; ++i) {
+      readers.emplace_back([&]() {
+         for (auto j = 0; j < 20000; ++j) {
+            if (!fs.folderExists("/vol/a/b/c") || fs.folderExists("/vol/a/b/missing")) {
+               ++wrongResults;
+            }
+         }
+      });
+   }
+
+   for (auto &reader : readers) {
+      reader.join();
+   }
+
+   stop = true;
+   invalidator.join();
+   REQUIRE(wrongResults == 0);
+}
+
+TEST_CASE("path cache lookups race with folders being created")
+{
+   fs::FileSystem fs;
+   REQUIRE(platform::createDirectory("fs-test-race"));
+   REQUIRE(fs.mountHostFolder("/vol/host", "fs-test-race", fs::Permissions::ReadWrite));
+
+   // Readers keep looking up the folder which is about to be created, a
+   // lookup which misses it must not stay cached once it exists
+   auto current = std::atomic<int> { 0 };
+   auto stop = std::atomic<bool> { false };
+   auto readers = std::vector<std::thread> { };
+
+   for (auto i = 0; i < 4; ++i) {
+      readers.emplace_back([&]() {
+         while (!stop) {
+            fs.folderExists("/vol/host/" + std::to_string(current.load()));
+         }
+      });
+   }
+
+   auto numFolders = 1000;
+   auto wrongResults = 0;
+
+   for (auto i = 0; i < numFolders; ++i) {
+      auto path = "/vol/host/" + std::to_string(i);
+      current = i;
+
+      if (!fs.makeFolder(path) || !fs.folderExists(path)) {
+         ++wrongResults;
+      }
+   }
+
+   stop = true;
+
+   for (auto &reader : readers) {
+      reader.join();
+   }
+
+   for (auto i = 0; i < numFolders; ++i) {
+      std::remove(("fs-test-race/" + std::to_string(i)).c_str());
+   }
+
+   std::remove("fs-test-race");
+   REQUIRE(wrongResults == 0);
+}
@@ -0,0 +1,146 @@
+#pragma once
+#include "counting_processor.h"
+
+#include <common/byte_swap.h>
+#include <libgpu/gpu_ringbuffer.h>
+#include <libgpu/latte/latte_pm4_commands.h>
+#include <libgpu/latte/latte_pm4_sizer.h>
+#include <libgpu/latte/latte_pm4_writer.h>
+
+#include <array>
+#include <cstdint>
+#include <vector>
+
+/**
+ * Build a command buffer of type 0 register writes of varying length, in
+ * guest byte order, terminated by a zero word.
+ */
+inline std::vector<uint32_t>
+buildRegisterWrites(size_t numWords)
+{
+   auto buffer = std::vector<uint32_t> { };
+
+   for (auto i = 0u; buffer.size() + 17 < numWords; ++i) {
+      auto count = 1 + (i % 16);
+      auto header = latte::pm4::HeaderType0::get(0)
+         .type(latte::pm4::PacketType::Type0)
+         .baseIndex(0xC000 + (i % 64) * 16)
+         .count(count - 1);
+
+      buffer.push_back(byte_swap(header.value));
+
+      for (auto j = 0u; j < count; ++j) {
+         buffer.push_back(byte_swap(i + j));
+      }
+   }
+
+   buffer.resize(numWords, 0);
+   return buffer;
+}
+
+template<typename Type>
+inline void
+writePM4(uint32_t *buffer,
+         uint32_t &bufferPosWords,
+         Type command)
+{
+   auto sizer = latte::pm4::PacketSizer { };
+   command.serialise(sizer);
+
+   auto writer = latte::pm4::PacketWriter {
+      buffer,
+      bufferPosWords,
+      Type::Opcode,
+      sizer.getSize() + 1
+   };
+   command.serialise(writer);
+}
+
+/**
+ * Append the packets GX2 flushCommandBuffer sends through TCLSubmitToRing,
+ * with the indirect buffer call replaced by a NOP as if
+ * GX2ProfileMode::SkipExecuteCommandBuffers was set.
+ */
+inline void
+appendSubmitCommand(std::vector<uint32_t> &buffer)
+{
+   std::array<uint32_t, 9> submitCommand;
+   auto submitCommandNumWords = 0u;
+   std::array<uint32_t, 1> nopString = { 0 };
+
+   writePM4(submitCommand.data(), submitCommandNumWords,
+            latte::pm4::Nop { 0, gsl::make_span(nopString) });
+   writePM4(submitCommand.data(), submitCommandNumWords,
+            latte::pm4::MemWrite {
+               latte::pm4::MW_ADDR_LO::get(0)
+                  .ADDR_LO(0x1000 >> 2)
+                  .ENDIAN_SWAP(latte::CB_ENDIAN::SWAP_8IN32),
+               latte::pm4::MW_ADDR_HI::get(0)
+                  .CNTR_SEL(latte::pm4::MW_WRITE_DATA)
+                  .DATA32(true),
+               0x12345678u,
+               0u
+            });
+   buffer.insert(buffer.end(), submitCommand.begin(),
+                 submitCommand.begin() + submitCommandNumWords);
+}
+
+/**
+ * Append the EVENT_WRITE_EOP TCL inserts after a submission to update the
+ * retire timestamp.
+ */
+inline void
+appendTimestampCommand(std::vector<uint32_t> &buffer,
+                       uint64_t timestamp)
+{
+   std::array<uint32_t, 6> eopCommand;
+   auto eopCommandNumWords = 0u;
+   writePM4(eopCommand.data(), eopCommandNumWords,
+            latte::pm4::EventWriteEOP {
+               latte::VGT_EVENT_INITIATOR::get(0)
+                  .EVENT_TYPE(latte::VGT_EVENT_TYPE::CACHE_FLUSH_AND_INV_TS_EVENT)
+                  .EVENT_INDEX(latte::VGT_EVENT_INDEX::TS),
+               latte::pm4::EW_ADDR_LO::get(0)
+                  .ADDR_LO(0x2000 >> 2)
+                  .ENDIAN_SWAP(latte::CB_ENDIAN::SWAP_8IN64),
+               latte::pm4::EWP_ADDR_HI::get(0)
+                  .DATA_SEL(latte::pm4::EWP_DATA_64)
+                  .INT_SEL(latte::pm4::EWP_INT_WRITE_CONFIRM),
+               static_cast<uint32_t>(timestamp & 0xFFFFFFFF),
+               static_cast<uint32_t>(timestamp >> 32)
+            });
+   buffer.insert(buffer.end(), eopCommand.begin(),
+                 eopCommand.begin() + eopCommandNumWords);
+}
+
+/**
+ * Submit a command buffer and its timestamp with two writes, as
+ * TCLSubmitToRing does.
+ */
+inline void
+submitCommandBuffer(uint64_t timestamp)
+{
+   static thread_local std::vector<uint32_t> buffer;
+
+   buffer.clear();
+   appendSubmitCommand(buffer);
+   gpu::ringbuffer::write(buffer);
+
+   buffer.clear();
+   appendTimestampCommand(buffer, timestamp);
+   gpu::ringbuffer::write(buffer);
+}
+
+inline void
+consumeUntil(CountingProcessor &processor,
+             uint64_t timestamp)
+{
+   while (processor.lastTimestamp < timestamp) {
+      gpu::ringbuffer::wait();
+
+      auto buffer = gpu::ringbuffer::read();
+      if (!buffer.empty()) {
+         processor.run(buffer);
+      }
+   }
+}
@@ -0,0 +1,57 @@
+#pragma once
+#include <libgpu/src/pm4_processor.h>
+
+#include <cstdint>
+
+/**
+ * A Pm4Processor which does nothing but count the packets a GX2 submission
+ * contains.
+ */
+class CountingProcessor : public Pm4Processor
+{
+public:
+   void run(const gpu::ringbuffer::Buffer &buffer)
+   {
+      runCommandBuffer(buffer);
+   }
+
+   uint64_t memWrites = 0;
+   uint64_t eventWrites = 0;
+   uint64_t lastTimestamp = 0;
+   bool inOrder = true;
+
+protected:
+   void decafSetBuffer(const DecafSetBuffer &data) override { }
+   void decafCopyColorToScan(const DecafCopyColorToScan &data) override { }
+   void decafSwapBuffers(const DecafSwapBuffers &data) override { }
+   void decafCapSyncRegisters(const DecafCapSyncRegisters &data) override { }
+   void decafClearColor(const DecafClearColor &data) override { }
+   void decafClearDepthStencil(const DecafClearDepthStencil &data) override { }
+   void decafOSScreenFlip(const DecafOSScreenFlip &data) override { }
+   void decafCopySurface(const DecafCopySurface &data) override { }
+   void decafExpandColorBuffer(const DecafExpandColorBuffer &data) override { }
+   void drawIndexAuto(const DrawIndexAuto &data) override { }
+   void drawIndex2(const DrawIndex2 &data) override { }
+   void drawIndexImmd(const DrawIndexImmd &data) override { }
+   void eventWrite(const EventWrite &data) override { }
+   void pfpSyncMe(const PfpSyncMe &data) override { }
+   void setPredication(const SetPredication &data) override { }
+   void streamOutBaseUpdate(const StreamOutBaseUpdate &data) override { }
+   void streamOutBufferUpdate(const StreamOutBufferUpdate &data) override { }
+   void surfaceSync(const SurfaceSync &data) override { }
+   void applyRegister(latte::Register reg) override { }
+
+   void memWrite(const MemWrite &data) override
+   {
+      ++memWrites;
+   }
+
+   void eventWriteEOP(const EventWriteEOP &data) override
+   {
+      auto timestamp = static_cast<uint64_t>(data.dataLo) |
+                       (static_cast<uint64_t>(data.dataHi) << 32);
+      inOrder = inOrder && (timestamp == lastTimestamp + 1);
+      lastTimestamp = timestamp;
+      ++eventWrites;
+   }
+};
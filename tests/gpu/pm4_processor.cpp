@@ -0,0 +1,24 @@
+#include <catch.hpp>
+#include "command_buffers.h"
+#include "counting_processor.h"
+
+#include <common/byte_swap.h>
+
+using namespace latte;
+
+TEST_CASE("pm4 processor stops at a zero word")
+{
+   auto processor = CountingProcessor { };
+   auto buffer = buildRegisterWrites(64);
+
+   // The EOP after the terminating zero word must never be processed
+   buffer.push_back(byte_swap(pm4::HeaderType3::get(0)
+                              .type(pm4::PacketType::Type3)
+                              .opcode(pm4::IT_OPCODE::EVENT_WRITE_EOP)
+                              .size(4)
+                              .value));
+   buffer.insert(buffer.end(), { 0u, 0u, 0u, 0u, byte_swap(1u) });
+
+   processor.run(buffer);
+   REQUIRE(processor.eventWrites == 0);
+}
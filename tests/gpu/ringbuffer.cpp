@@ -0,0 +1,110 @@
+#include <catch.hpp>
+#include "command_buffers.h"
+#include "counting_processor.h"
+
+#include <libgpu/gpu_ringbuffer.h>
+
+#include <chrono>
+#include <cstdint>
+#include <thread>
+#include <vector>
+
+TEST_CASE("ringbuffer keeps packets whole and in order across wrap around")
+{
+   auto processor = CountingProcessor { };
+   auto timestamp = uint64_t { 0 };
+
+   // Each submission is 14 words, which does not divide the ring size, so
+   // this wraps around the end of the ring many times.
+   for (auto i = 0; i < 200; ++i) {
+      for (auto j = 0; j < 97; ++j) {
+         submitCommandBuffer(++timestamp);
+      }
+
+      consumeUntil(processor, timestamp);
+   }
+
+   REQUIRE(processor.inOrder);
+   REQUIRE(processor.eventWrites == timestamp);
+   REQUIRE(processor.memWrites == timestamp);
+   REQUIRE(gpu::ringbuffer::read().empty());
+}
+
+TEST_CASE("ringbuffer splits writes larger than the ring")
+{
+   auto processor = CountingProcessor { };
+   auto frame = std::vector<uint32_t> { };
+   auto numSubmissions = uint64_t { 20000 };
+
+   // A whole frame in one write, as pm4-replay submits it, several times
+   // the size of the ring
+   for (auto i = uint64_t { 1 }; i <= numSubmissions; ++i) {
+      appendSubmitCommand(frame);
+      appendTimestampCommand(frame, i);
+   }
+
+   auto producer = std::thread {
+      [&]() {
+         gpu::ringbuffer::write(frame);
+      } };
+
+   consumeUntil(processor, numSubmissions);
+   producer.join();
+
+   REQUIRE(processor.inOrder);
+   REQUIRE(processor.eventWrites == numSubmissions);
+   REQUIRE(processor.memWrites == numSubmissions);
+   REQUIRE(gpu::ringbuffer::read().empty());
+}
+
+TEST_CASE("ringbuffer keeps writes from several producers whole")
+{
+   auto processor = CountingProcessor { };
+   auto buffer = std::vector<uint32_t> { };
+   auto numProducers = 4;
+   auto numWrites = 2000;
+
+   for (auto i = 0; i < 10; ++i) {
+      appendSubmitCommand(buffer);
+   }
+
+   auto producers = std::vector<std::thread> { };
+   for (auto i = 0; i < numProducers; ++i) {
+      producers.emplace_back([&]() {
+         for (auto j = 0; j < numWrites; ++j) {
+            gpu::ringbuffer::write(buffer);
+         }
+      });
+   }
+
+   // A packet torn by another producer's write would show up as a wrong
+   // number of memory writes, or none at all
+   auto expectedMemWrites = uint64_t { 10 } * numProducers * numWrites;
+   while (processor.memWrites < expectedMemWrites) {
+      gpu::ringbuffer::wait();
+
+      auto read = gpu::ringbuffer::read();
+      if (!read.empty()) {
+         processor.run(read);
+      }
+   }
+
+   for (auto &producer : producers) {
+      producer.join();
+   }
+
+   REQUIRE(processor.memWrites == expectedMemWrites);
+   REQUIRE(gpu::ringbuffer::read().empty());
+}
+
+TEST_CASE("ringbuffer wake interrupts an empty wait")
+{
+   auto waiter = std::thread {
+      []() {
+         gpu::ringbuffer::wait();
+      } };
+
+   std::this_thread::sleep_for(std::chrono::milliseconds { 10 });
+   gpu::ringbuffer::wake();
+   waiter.join();
+}
@@ -0,0 +1,161 @@
+#include <catch.hpp>
+
+#include <gpu_shadercache.h>
+#include <spirv/spirv_translate.h>
+
+#include <cstdio>
+#include <fstream>
+#include <vector>
+
+static const char *
+CacheFile = "gpu-test-shadercache.bin";
+
+static const auto
+TranslatorHash = gpu::ShaderCache::Hash { 0x0123456789ABCDEFull, 0xFEDCBA9876543210ull };
+
+static std::vector<uint8_t>
+makeShaderData(size_t size, uint8_t seed)
+{
+   auto data = std::vector<uint8_t>(size);
+   for (auto i = 0u; i < size; ++i) {
+      data[i] = static_cast<uint8_t>(seed + i * 7);
+   }
+
+   return data;
+}
+
+TEST_CASE("translated shaders are read back out of the shader cache")
+{
+   auto vertexHash = gpu::ShaderCache::Hash { 1, 2 };
+   auto pixelHash = gpu::ShaderCache::Hash { 3, 4 };
+   auto vertexData = makeShaderData(1000, 1);
+   auto pixelData = makeShaderData(300, 2);
+   std::remove(CacheFile);
+
+   {
+      auto cache = gpu::ShaderCache { };
+      REQUIRE(cache.open(CacheFile, TranslatorHash));
+      REQUIRE(cache.size() == 0);
+      REQUIRE(cache.find(vertexHash) == nullptr);
+      cache.store(vertexHash, vertexData);
+      cache.store(pixelHash, pixelData);
+
+      // Stored shaders are only loaded on the next open
+      REQUIRE(cache.find(vertexHash) == nullptr);
+      REQUIRE(cache.stats().stores == 2);
+   }
+
+   auto cache = gpu::ShaderCache { };
+   REQUIRE(cache.open(CacheFile, TranslatorHash));
+   REQUIRE(cache.size() == 2);
+   REQUIRE(cache.find(vertexHash) != nullptr);
+   REQUIRE(*cache.find(vertexHash) == vertexData);
+   REQUIRE(*cache.find(pixelHash) == pixelData);
+   REQUIRE(cache.find({ 1, 3 }) == nullptr);
+
+   SECTION("a newer entry replaces an older one")
+   {
+      auto newData = makeShaderData(500, 3);
+      cache.store(pixelHash, newData);
+      REQUIRE(cache.open(CacheFile, TranslatorHash));
+      REQUIRE(cache.size() == 2);
+      REQUIRE(*cache.find(pixelHash) == newData);
+   }
+
+   SECTION("a truncated entry is dropped")
+   {
+      cache.close();
+
+      {
+         auto file = std::ofstream { CacheFile, std::ofstream::binary | std::ofstream::app };
+         auto partial = makeShaderData(20, 4);
+         file.write(reinterpret_cast<const char *>(partial.data()), partial.size());
+      }
+
+      REQUIRE(cache.open(CacheFile, TranslatorHash));
+      REQUIRE(cache.size() == 2);
+
+      // The file was rewritten without it, so it can be appended to again
+      cache.store({ 5, 6 }, vertexData);
+      REQUIRE(cache.open(CacheFile, TranslatorHash));
+      REQUIRE(cache.size() == 3);
+      REQUIRE(*cache.find({ 5, 6 }) == vertexData);
+   }
+
+   SECTION("an entry with a corrupt size is dropped")
+   {
+      cache.close();
+
+      // An entry header claiming more data than the file holds
+      {
+         auto file = std::ofstream { CacheFile, std::ofstream::binary | std::ofstream::app };
+         auto header = std::vector<uint32_t> { 7, 0, 8, 0, 0x7FFFFFFF, 0 };
+         file.write(reinterpret_cast<const char *>(header.data()), header.size() * 4);
+         file.write(reinterpret_cast<const char *>(vertexData.data()), vertexData.size());
+      }
+
+      REQUIRE(cache.open(CacheFile, TranslatorHash));
+      REQUIRE(cache.size() == 2);
+
+      cache.store({ 5, 6 }, vertexData);
+      REQUIRE(cache.open(CacheFile, TranslatorHash));
+      REQUIRE(cache.size() == 3);
+      REQUIRE(*cache.find({ 5, 6 }) == vertexData);
+   }
+
+   SECTION("a cache from another translator is discarded")
+   {
+      auto otherHash = gpu::ShaderCache::Hash { TranslatorHash[0], TranslatorHash[1] + 1 };
+      REQUIRE(cache.open(CacheFile, otherHash));
+      REQUIRE(cache.size() == 0);
+      REQUIRE(cache.find(vertexHash) == nullptr);
+
+      REQUIRE(cache.open(CacheFile, TranslatorHash));
+      REQUIRE(cache.size() == 0);
+   }
+}
+
+#ifdef DECAF_VULKAN
+
+TEST_CASE("spirv shaders round trip through a shader cache entry")
+{
+   auto shader = spirv::VertexShader { };
+   shader.binary = { 0x07230203, 0x10000, 1, 2, 3 };
+   shader.samplerUsed.fill(false);
+   shader.samplerUsed[3] = true;
+   shader.textureUsed.fill(true);
+   shader.cbufferUsed.fill(false);
+   shader.inputBuffers[1] = { true, spirv::InputBuffer::IndexMode::PerInstance, 4 };
+   shader.inputAttribs = { { 1, 8, 4, 3 }, { 2, 0, 1, 4 } };
+   shader.outputSemantics = { 0, 5, 9 };
+   shader.rectStubBinary = { 0x07230203, 4, 5 };
+
+   auto data = std::vector<uint8_t> { };
+   REQUIRE(spirv::saveShader(spirv::ShaderType::Vertex, &shader, data));
+
+   auto loaded = spirv::VertexShader { };
+   REQUIRE(spirv::loadShader(spirv::ShaderType::Vertex, data, &loaded));
+   REQUIRE(loaded.binary == shader.binary);
+   REQUIRE(loaded.samplerUsed == shader.samplerUsed);
+   REQUIRE(loaded.textureUsed == shader.textureUsed);
+   REQUIRE(loaded.cbufferUsed == shader.cbufferUsed);
+   REQUIRE(loaded.inputBuffers[1].isUsed);
+   REQUIRE(loaded.inputBuffers[1].divisor == 4);
+   REQUIRE(loaded.inputAttribs.size() == 2);
+   REQUIRE(loaded.inputAttribs[0].offset == 8);
+   REQUIRE(loaded.outputSemantics == shader.outputSemantics);
+   REQUIRE(loaded.rectStubBinary == shader.rectStubBinary);
+
+   // An entry is only loaded as the type of shader it was saved from
+   auto pixel = spirv::PixelShader { };
+   REQUIRE(!spirv::loadShader(spirv::ShaderType::Pixel, data, &pixel));
+
+   // A truncated entry leaves the shader untouched
+   auto truncated = spirv::VertexShader { };
+   data.pop_back();
+   REQUIRE(!spirv::loadShader(spirv::ShaderType::Vertex, data, &truncated));
+   REQUIRE(truncated.binary.empty());
+   REQUIRE(truncated.outputSemantics.empty());
+}
+
+#endif // ifdef DECAF_VULKAN
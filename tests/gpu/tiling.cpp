@@ -0,0 +1,234 @@
+#include <catch.hpp>
+#include "tiling_reference.h"
+
+#include <gpu7_tiling.h>
+
+#include <algorithm>
+#include <cstring>
+#include <fmt/format.h>
+#include <vector>
+
+using namespace gpu7::tiling;
+
+static constexpr TileMode TileModes[] = {
+   TileMode::LinearGeneral,
+   TileMode::LinearAligned,
+   TileMode::Tiled1DThin1,
+   TileMode::Tiled1DThick,
+   TileMode::Tiled2DThin1,
+   TileMode::Tiled2DThin2,
+   TileMode::Tiled2DThin4,
+   TileMode::Tiled2DThick,
+   TileMode::Tiled2BThin1,
+   TileMode::Tiled2BThin2,
+   TileMode::Tiled2BThin4,
+   TileMode::Tiled2BThick,
+   TileMode::Tiled3DThin1,
+   TileMode::Tiled3DThick,
+   TileMode::Tiled3BThin1,
+   TileMode::Tiled3BThick,
+};
+
+/**
+ * Untile slices [firstSlice, lastSlice) of random tiled memory and check
+ * that every element was read from where AddrLib says it is, and matches
+ * the per element copy.
+ */
+static void
+checkUntileSlices(const SurfaceInfo &surface,
+                  int pitch,
+                  int dstPitch,
+                  int firstSlice,
+                  int lastSlice)
+{
+   const auto bytesPerElement = surface.bpp / 8;
+   auto tiledSize = uint64_t { 0 };
+   auto addresses = getElementAddresses(surface, pitch, firstSlice, lastSlice, tiledSize);
+   tiledSize = std::max<uint64_t>(tiledSize, calculateImageSize(surface));
+   auto tiled = getRandomBytes(tiledSize, static_cast<uint32_t>(tiledSize));
+
+   const auto dstSliceSize = static_cast<size_t>(dstPitch) * surface.height * bytesPerElement;
+   auto untiled = std::vector<uint8_t>(dstSliceSize * (lastSlice - firstSlice));
+   auto expected = untiled;
+   untileSlices(surface, pitch, tiled.data(), untiled.data(), dstPitch, firstSlice, lastSlice);
+   copySlicesPerElement(surface, pitch, tiled.data(), expected.data(), dstPitch,
+                        firstSlice, lastSlice, false);
+
+   auto address = addresses.begin();
+   auto mismatches = 0;
+   auto copyMismatches = 0;
+
+   for (auto slice = firstSlice; slice < lastSlice; ++slice) {
+      for (auto y = 0; y < surface.height; ++y) {
+         for (auto x = 0; x < surface.width; ++x) {
+            auto offset = dstSliceSize * (slice - firstSlice)
+                        + (static_cast<size_t>(y) * dstPitch + x) * bytesPerElement;
+
+            if (std::memcmp(untiled.data() + offset, tiled.data() + *address++, bytesPerElement)) {
+               if (mismatches++ == 0) {
+                  UNSCOPED_INFO("first mismatch at x = " << x << ", y = " << y << ", slice = " << slice);
+               }
+            }
+
+            if (std::memcmp(untiled.data() + offset, expected.data() + offset, bytesPerElement)) {
+               if (copyMismatches++ == 0) {
+                  UNSCOPED_INFO("first per element copy mismatch at x = " << x << ", y = " << y << ", slice = " << slice);
+               }
+            }
+         }
+      }
+   }
+
+   REQUIRE(mismatches == 0);
+   REQUIRE(copyMismatches == 0);
+}
+
+/**
+ * Tile random slices [firstSlice, lastSlice) into random tiled memory, check
+ * that every element was written where AddrLib says it goes, that nothing
+ * else was written, that the tiled memory matches the per element copy byte
+ * for byte and that untiling gives back the same slices.
+ */
+static void
+checkTileSlices(const SurfaceInfo &surface,
+                int pitch,
+                int srcPitch,
+                int firstSlice,
+                int lastSlice)
+{
+   const auto bytesPerElement = surface.bpp / 8;
+   auto tiledSize = uint64_t { 0 };
+   auto addresses = getElementAddresses(surface, pitch, firstSlice, lastSlice, tiledSize);
+   tiledSize = std::max<uint64_t>(tiledSize, calculateImageSize(surface));
+   auto original = getRandomBytes(tiledSize, static_cast<uint32_t>(tiledSize));
+
+   const auto srcSliceSize = static_cast<size_t>(srcPitch) * surface.height * bytesPerElement;
+   auto untiled = getRandomBytes(srcSliceSize * (lastSlice - firstSlice), 1);
+   auto tiled = original;
+   auto expected = original;
+   tileSlices(surface, pitch, untiled.data(), srcPitch, tiled.data(), firstSlice, lastSlice);
+   copySlicesPerElement(surface, pitch, expected.data(), untiled.data(), srcPitch,
+                        firstSlice, lastSlice, true);
+
+   auto written = std::vector<bool>(tiledSize);
+   auto address = addresses.begin();
+   auto mismatches = 0;
+
+   for (auto slice = firstSlice; slice < lastSlice; ++slice) {
+      for (auto y = 0; y < surface.height; ++y) {
+         for (auto x = 0; x < surface.width; ++x) {
+            auto offset = srcSliceSize * (slice - firstSlice)
+                        + (static_cast<size_t>(y) * srcPitch + x) * bytesPerElement;
+
+            if (std::memcmp(untiled.data() + offset, tiled.data() + *address, bytesPerElement)) {
+               if (mismatches++ == 0) {
+                  UNSCOPED_INFO("first mismatch at x = " << x << ", y = " << y << ", slice = " << slice);
+               }
+            }
+
+            std::fill_n(written.begin() + *address++, bytesPerElement, true);
+         }
+      }
+   }
+
+   REQUIRE(mismatches == 0);
+
+   for (auto i = 0u; i < tiledSize; ++i) {
+      if (!written[i] && tiled[i] != original[i]) {
+         if (mismatches++ == 0) {
+            UNSCOPED_INFO("first byte written outside of the image at " << i);
+         }
+      }
+   }
+
+   REQUIRE(mismatches == 0);
+
+   auto mismatch = std::mismatch(tiled.begin(), tiled.end(), expected.begin());
+   if (mismatch.first != tiled.end()) {
+      UNSCOPED_INFO("first per element copy mismatch at byte " << (mismatch.first - tiled.begin()));
+   }
+
+   REQUIRE(mismatch.first == tiled.end());
+
+   // Round trip back to linear, the padding after each row is not written
+   auto roundTrip = std::vector<uint8_t>(untiled.size());
+   untileSlices(surface, pitch, tiled.data(), roundTrip.data(), srcPitch, firstSlice, lastSlice);
+
+   for (auto i = 0u; i < untiled.size(); i += srcPitch * bytesPerElement) {
+      REQUIRE(std::memcmp(untiled.data() + i,
+                          roundTrip.data() + i,
+                          surface.width * bytesPerElement) == 0);
+   }
+}
+
+TEST_CASE("gpu7 untiling matches AddrLib")
+{
+   for (auto tileMode : TileModes) {
+      for (auto bpp : { 8, 16, 32, 64, 128 }) {
+         for (auto isDepth : { false, true }) {
+            auto surface = SurfaceInfo { };
+            surface.bpp = bpp;
+            surface.tileMode = tileMode;
+            surface.width = 75;
+            surface.height = 70;
+            surface.depth = 6;
+            surface.isDepth = isDepth;
+
+            const auto pitch = calculateAlignedPitch(surface);
+            const auto alignedHeight = calculateAlignedHeight(surface);
+
+            for (auto swizzle : { 0, 3, 6 }) {
+               surface.pipeSwizzle = swizzle & 1;
+               surface.bankSwizzle = swizzle >> 1;
+
+               INFO(fmt::format("tileMode {} bpp {} isDepth {} swizzle {}",
+                                static_cast<int>(tileMode), bpp, isDepth, swizzle));
+
+               // Tiled memory with an unaligned height, as the drivers untile
+               // it, and with the aligned height, as the untile functions do.
+               checkUntileSlices(surface, pitch, surface.width + 3, 0, surface.depth);
+
+               auto alignedSurface = surface;
+               alignedSurface.width = pitch;
+               alignedSurface.height = alignedHeight;
+               checkUntileSlices(alignedSurface, pitch, pitch, 1, 5);
+            }
+         }
+      }
+   }
+}
+
+TEST_CASE("gpu7 tiling matches AddrLib")
+{
+   for (auto tileMode : TileModes) {
+      for (auto bpp : { 8, 16, 32, 64, 128 }) {
+         for (auto isDepth : { false, true }) {
+            auto surface = SurfaceInfo { };
+            surface.bpp = bpp;
+            surface.tileMode = tileMode;
+            surface.width = 75;
+            surface.height = 70;
+            surface.depth = 6;
+            surface.isDepth = isDepth;
+            surface.pipeSwizzle = 1;
+            surface.bankSwizzle = bpp % 3;
+
+            const auto pitch = calculateAlignedPitch(surface);
+            INFO(fmt::format("tileMode {} bpp {} isDepth {}",
+                             static_cast<int>(tileMode), bpp, isDepth));
+
+            // With an unaligned height the slices of tiled memory overlap,
+            // so only a single slice of that can be checked.
+            checkTileSlices(surface, pitch, surface.width + 5, 3, 4);
+
+            // Part of each row, as the drivers write back, and whole slices
+            auto alignedSurface = surface;
+            alignedSurface.height = calculateAlignedHeight(surface);
+            checkTileSlices(alignedSurface, pitch, surface.width + 5, 0, surface.depth);
+
+            alignedSurface.width = pitch;
+            checkTileSlices(alignedSurface, pitch, pitch, 2, 5);
+         }
+      }
+   }
+}
@@ -0,0 +1,115 @@
+#pragma once
+#include <gpu_addrlibopt.h>
+#include <gpu_tiling.h>
+#include <gpu7_tiling.h>
+
+#include <addrlib/addrinterface.h>
+#include <algorithm>
+#include <common/align.h>
+#include <cstdint>
+#include <cstring>
+#include <random>
+#include <vector>
+
+inline ADDR_COMPUTE_SURFACE_ADDRFROMCOORD_INPUT
+getAddrFromCoordInput(const gpu7::tiling::SurfaceInfo &surface,
+                      int pitch)
+{
+   ADDR_COMPUTE_SURFACE_ADDRFROMCOORD_INPUT input;
+   std::memset(&input, 0, sizeof(input));
+   input.size = sizeof(input);
+   input.bpp = surface.bpp;
+   input.pitch = pitch;
+   input.height = surface.height;
+   input.numSlices = surface.depth;
+   input.numSamples = 1;
+   input.tileMode = static_cast<AddrTileMode>(surface.tileMode);
+   input.isDepth = surface.isDepth;
+   input.bankSwizzle = surface.bankSwizzle;
+   input.pipeSwizzle = surface.pipeSwizzle;
+   return input;
+}
+
+/**
+ * AddrLib's address of every element in slices [firstSlice, lastSlice), in
+ * the order they are in a linear image.
+ */
+inline std::vector<uint64_t>
+getElementAddresses(const gpu7::tiling::SurfaceInfo &surface,
+                    int pitch,
+                    int firstSlice,
+                    int lastSlice,
+                    uint64_t &tiledSize)
+{
+   auto input = getAddrFromCoordInput(surface, pitch);
+   auto output = ADDR_COMPUTE_SURFACE_ADDRFROMCOORD_OUTPUT { };
+   output.size = sizeof(output);
+
+   auto addresses = std::vector<uint64_t> { };
+   tiledSize = 0;
+
+   // Whole micro tiles are read and written, so tiledSize covers them all
+   for (auto slice = firstSlice; slice < lastSlice; ++slice) {
+      for (auto y = 0; y < align_up(surface.height, 8); ++y) {
+         for (auto x = 0; x < align_up(surface.width, 8); ++x) {
+            input.x = x;
+            input.y = y;
+            input.slice = slice;
+            AddrComputeSurfaceAddrFromCoord(gpu::getAddrLibHandle(), &input, &output);
+            tiledSize = std::max<uint64_t>(tiledSize, output.addr + surface.bpp / 8);
+
+            if (x < surface.width && y < surface.height) {
+               addresses.push_back(output.addr);
+            }
+         }
+      }
+   }
+
+   return addresses;
+}
+
+/**
+ * Copy slices [firstSlice, lastSlice) between tiled and linear memory one
+ * element at a time with addrlibopt, which is what the drivers used before.
+ */
+inline void
+copySlicesPerElement(const gpu7::tiling::SurfaceInfo &surface,
+                     int pitch,
+                     uint8_t *tiled,
+                     uint8_t *linear,
+                     int linearPitch,
+                     int firstSlice,
+                     int lastSlice,
+                     bool toTiled)
+{
+   auto linearSurface = surface;
+   linearSurface.tileMode = gpu7::tiling::TileMode::LinearGeneral;
+
+   auto tiledInput = getAddrFromCoordInput(surface, pitch);
+   auto linearInput = getAddrFromCoordInput(linearSurface, linearPitch);
+
+   for (auto slice = firstSlice; slice < lastSlice; ++slice) {
+      tiledInput.slice = slice;
+      linearInput.slice = slice - firstSlice;
+
+      if (toTiled) {
+         gpu::addrlibopt::copySurfacePixels(tiled, surface.width, surface.height, tiledInput,
+                                            linear, surface.width, surface.height, linearInput,
+                                            surface.bpp, surface.isDepth, 1);
+      } else {
+         gpu::addrlibopt::copySurfacePixels(linear, surface.width, surface.height, linearInput,
+                                            tiled, surface.width, surface.height, tiledInput,
+                                            surface.bpp, surface.isDepth, 1);
+      }
+   }
+}
+
+inline std::vector<uint8_t>
+getRandomBytes(size_t size,
+               uint32_t seed)
+{
+   auto random = std::mt19937 { seed };
+   auto bytes = std::vector<uint8_t>(size);
+   std::generate(bytes.begin(), bytes.end(), [&]() { return static_cast<uint8_t>(random()); });
+   return bytes;
+}
@@ -0,0 +1,25 @@
+#include <catch.hpp>
+#include "export_table.h"
+
+#include <cafe/loader/cafe_loader_exportindex.h>
+
+using namespace cafe::loader::internal;
+
+TEST_CASE("export index finds the same exports as a binary search")
+{
+   auto names = makeSymbolNames("coreinit", 1500);
+   auto table = ExportTable { names };
+   auto index = ExportIndex { };
+   index.build(table.data(), table.size(), table.strings.data());
+   REQUIRE(index.numExports() == table.size());
+
+   for (auto &name : names) {
+      auto found = index.find(name);
+      REQUIRE(found);
+      REQUIRE(found == table.binarySearch(name.c_str()));
+   }
+
+   REQUIRE(!index.find("OSNotAnExport"));
+   REQUIRE(!index.find(""));
+   REQUIRE(!index.find(names[0].substr(0, names[0].size() - 1)));
+}
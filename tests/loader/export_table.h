@@ -0,0 +1,85 @@
+#pragma once
+#include <cafe/loader/cafe_loader_exportindex.h>
+
+#include <algorithm>
+#include <cstring>
+#include <fmt/format.h>
+#include <random>
+#include <string>
+#include <vector>
+
+/**
+ * An export table laid out like the ones in an RPL, with the string table
+ * starting 8 bytes before the exports and the exports sorted by name.
+ */
+struct ExportTable
+{
+   ExportTable(const std::vector<std::string> &names)
+   {
+      auto sortedNames = names;
+      std::sort(sortedNames.begin(), sortedNames.end());
+
+      exports.resize(sortedNames.size());
+      strings.resize(8 + sizeof(cafe::loader::rpl::Export) * sortedNames.size());
+
+      for (auto i = 0u; i < sortedNames.size(); ++i) {
+         exports[i].value = 0x02000000u + i * 8;
+         exports[i].name = static_cast<uint32_t>(strings.size());
+         strings.insert(strings.end(), sortedNames[i].begin(), sortedNames[i].end());
+         strings.push_back(0);
+      }
+
+      std::memcpy(strings.data() + 8, exports.data(), sizeof(cafe::loader::rpl::Export) * exports.size());
+   }
+
+   const cafe::loader::rpl::Export *
+   data() const
+   {
+      return reinterpret_cast<const cafe::loader::rpl::Export *>(strings.data() + 8);
+   }
+
+   uint32_t
+   size() const
+   {
+      return static_cast<uint32_t>(exports.size());
+   }
+
+   //! The search the loader did before ExportIndex.
+   const cafe::loader::rpl::Export *
+   binarySearch(const char *name) const
+   {
+      auto left = 0u;
+      auto right = size();
+
+      while (left < right) {
+         auto index = left + (right - left) / 2;
+         auto cmpValue = std::strcmp(name, strings.data() + (data()[index].name & 0x7FFFFFFF));
+         if (cmpValue == 0) {
+            return data() + index;
+         } else if (cmpValue < 0) {
+            right = index;
+         } else {
+            left = index + 1;
+         }
+      }
+
+      return nullptr;
+   }
+
+   std::vector<cafe::loader::rpl::Export> exports;
+   std::vector<char> strings;
+};
+
+inline std::vector<std::string>
+makeSymbolNames(const char *prefix,
+                size_t count)
+{
+   auto names = std::vector<std::string> { };
+   auto random = std::mt19937 { static_cast<uint32_t>(count) };
+
+   for (auto i = 0u; i < count; ++i) {
+      names.push_back(fmt::format("{}_{}{:08X}", prefix, i % 7 ? "OS" : "__ct__", random()));
+   }
+
+   return names;
+}
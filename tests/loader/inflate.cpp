@@ -0,0 +1,227 @@
+#include <catch.hpp>
+#include "section_data.h"
+
+#include <cafe/loader/cafe_loader_inflate.h>
+
+#include <common/datahash.h>
+#include <common/platform_dir.h>
+#include <cstdio>
+#include <fmt/format.h>
+#include <memory>
+#include <vector>
+#include <zlib.h>
+
+using namespace cafe::loader::internal;
+
+static std::string
+getSectionCacheFile(const std::string &cachePath,
+                    const std::vector<uint8_t> &deflated)
+{
+   auto hash = DataHash { }.write(deflated).value();
+   return fmt::format("{}/{:016X}{:016X}.bin", cachePath, hash[0], hash[1]);
+}
+
+static void
+checkInflateJobs(unsigned numThreads)
+{
+   auto sections = std::vector<std::vector<uint8_t>> { };
+   auto jobs = std::vector<std::shared_ptr<InflateJob>> { };
+   auto inflated = std::vector<std::vector<uint8_t>> { };
+
+   // Mix of sections which are and are not worth a thread
+   for (auto i = 0u; i < 16; ++i) {
+      sections.push_back(makeSectionData((i % 2) ? 1000 + i : 300000 + i * 4096, i));
+      inflated.emplace_back(sections.back().size());
+
+      auto job = std::make_shared<InflateJob>();
+      job->deflated = deflate(sections.back());
+      job->dst = inflated.back().data();
+      job->dstSize = static_cast<uint32_t>(inflated.back().size());
+      jobs.push_back(job);
+      submitInflateJob(job, numThreads);
+   }
+
+   for (auto i = 0u; i < jobs.size(); ++i) {
+      waitInflateJob(jobs[i]);
+      REQUIRE(!jobs[i]->failed());
+      REQUIRE(jobs[i]->inflatedSize == sections[i].size());
+      REQUIRE(inflated[i] == sections[i]);
+      REQUIRE(jobs[i]->crc == crc32(0, sections[i].data(), static_cast<uInt>(sections[i].size())));
+   }
+}
+
+TEST_CASE("inflate jobs match zlib on any number of threads")
+{
+   checkInflateJobs(0);
+   checkInflateJobs(1);
+   checkInflateJobs(4);
+}
+
+TEST_CASE("inflate jobs return the zlib errors the loader reports")
+{
+   auto section = makeSectionData(200000, 1);
+   auto inflated = std::vector<uint8_t>(section.size());
+
+   auto job = InflateJob { };
+   job.deflated = deflate(section);
+   job.dst = inflated.data();
+
+   SECTION("corrupt data")
+   {
+      job.dstSize = static_cast<uint32_t>(inflated.size());
+      job.deflated[0] ^= 0xFF;
+      inflateSection(job);
+      REQUIRE(job.initError == Z_OK);
+      REQUIRE(job.inflateError == Z_DATA_ERROR);
+   }
+
+   SECTION("section larger than its header says")
+   {
+      job.dstSize = static_cast<uint32_t>(inflated.size() - 100);
+      inflateSection(job);
+      REQUIRE(job.inflateError == Z_BUF_ERROR);
+      REQUIRE(job.inflatedSize == job.dstSize);
+   }
+
+   SECTION("section smaller than its header says")
+   {
+      inflated.resize(inflated.size() + 100);
+      job.dst = inflated.data();
+      job.dstSize = static_cast<uint32_t>(inflated.size());
+      inflateSection(job);
+      REQUIRE(!job.failed());
+      REQUIRE(job.inflatedSize == section.size());
+   }
+}
+
+TEST_CASE("inflated sections are read back out of the section cache")
+{
+   auto section = makeSectionData(200000, 2);
+   auto inflated = std::vector<uint8_t>(section.size());
+
+   auto job = InflateJob { };
+   job.deflated = deflate(section);
+   job.dst = inflated.data();
+   job.dstSize = static_cast<uint32_t>(inflated.size());
+   job.cachePath = "loader-test-cache";
+   inflateSectionCached(job);
+   REQUIRE(!job.failed());
+
+   // The cached copy is used even though inflating the data would now fail
+   auto cached = std::vector<uint8_t>(section.size());
+   auto cachedJob = job;
+   cachedJob.dst = cached.data();
+   cachedJob.inflatedSize = 0;
+   cachedJob.crc = 0;
+   inflateSectionCached(cachedJob);
+   REQUIRE(!cachedJob.failed());
+   REQUIRE(cached == section);
+   REQUIRE(cachedJob.crc == job.crc);
+   REQUIRE(cachedJob.inflatedSize == job.inflatedSize);
+
+   // Except when the section would not fit, which has to fail like inflate
+   cachedJob.dstSize -= 100;
+   inflateSectionCached(cachedJob);
+   REQUIRE(cachedJob.inflateError == Z_BUF_ERROR);
+
+   // Different data is not found in the cache
+   auto otherSection = makeSectionData(200000, 3);
+   auto otherJob = InflateJob { };
+   otherJob.deflated = deflate(otherSection);
+   otherJob.dst = cached.data();
+   otherJob.dstSize = static_cast<uint32_t>(cached.size());
+   otherJob.cachePath = "loader-test-cache";
+   otherJob.deflated[0] ^= 0xFF;
+   inflateSectionCached(otherJob);
+   REQUIRE(otherJob.inflateError == Z_DATA_ERROR);
+}
+
+TEST_CASE("damaged section cache files are inflated again")
+{
+   auto section = makeSectionData(200000, 4);
+   auto inflated = std::vector<uint8_t>(section.size());
+
+   auto job = InflateJob { };
+   job.deflated = deflate(section);
+   job.dst = inflated.data();
+   job.dstSize = static_cast<uint32_t>(inflated.size());
+   job.cachePath = "loader-test-cache";
+   inflateSectionCached(job);
+   REQUIRE(!job.failed());
+
+   // Flip a byte of the cached data, leaving the header alone
+   auto path = getSectionCacheFile(job.cachePath, job.deflated);
+   auto file = std::fopen(path.c_str(), "r+b");
+   REQUIRE(file);
+   std::fseek(file, 1000, SEEK_SET);
+   auto byte = std::fgetc(file);
+   std::fseek(file, 1000, SEEK_SET);
+   std::fputc(byte ^ 0xFF, file);
+   std::fclose(file);
+
+   auto cached = std::vector<uint8_t>(section.size());
+   auto cachedJob = job;
+   cachedJob.dst = cached.data();
+   cachedJob.crc = 0;
+   inflateSectionCached(cachedJob);
+   REQUIRE(!cachedJob.failed());
+   REQUIRE(cached == section);
+   REQUIRE(cachedJob.crc == job.crc);
+
+   // Inflating it again replaced the damaged file, so corrupting the
+   // deflated data shows the file is read once more
+   cachedJob.deflated[0] ^= 0xFF;
+   auto corruptPath = getSectionCacheFile(job.cachePath, cachedJob.deflated);
+   std::rename(path.c_str(), corruptPath.c_str());
+   std::fill(cached.begin(), cached.end(), 0);
+   inflateSectionCached(cachedJob);
+   std::remove(corruptPath.c_str());
+   REQUIRE(!cachedJob.failed());
+   REQUIRE(cached == section);
+}
+
+TEST_CASE("section cache removes its oldest files to stay under its size")
+{
+   auto cachePath = std::string { "loader-test-cache-limit" };
+   auto sections = std::vector<std::vector<uint8_t>> { };
+   auto paths = std::vector<std::string> { };
+
+   for (auto i = 0u; i < 4; ++i) {
+      sections.push_back(makeSectionData(100000, 10 + i));
+      paths.push_back(getSectionCacheFile(cachePath, deflate(sections.back())));
+      std::remove(paths.back().c_str());
+   }
+
+   // Room for two sections but not three
+   for (auto i = 0u; i < sections.size(); ++i) {
+      auto inflated = std::vector<uint8_t>(sections[i].size());
+      auto job = InflateJob { };
+      job.deflated = deflate(sections[i]);
+      job.dst = inflated.data();
+      job.dstSize = static_cast<uint32_t>(inflated.size());
+      job.cachePath = cachePath;
+      job.cacheMaxSize = 250000;
+      inflateSectionCached(job);
+      REQUIRE(!job.failed());
+      REQUIRE(platform::fileExists(paths[i]));
+   }
+
+   REQUIRE(!platform::fileExists(paths[0]));
+   REQUIRE(!platform::fileExists(paths[1]));
+   REQUIRE(platform::fileExists(paths[2]));
+   REQUIRE(platform::fileExists(paths[3]));
+
+   // A section larger than the whole cache is never written
+   auto large = makeSectionData(300000, 20);
+   auto inflated = std::vector<uint8_t>(large.size());
+   auto job = InflateJob { };
+   job.deflated = deflate(large);
+   job.dst = inflated.data();
+   job.dstSize = static_cast<uint32_t>(inflated.size());
+   job.cachePath = cachePath;
+   job.cacheMaxSize = 250000;
+   inflateSectionCached(job);
+   REQUIRE(!job.failed());
+   REQUIRE(!platform::fileExists(getSectionCacheFile(cachePath, job.deflated)));
+   REQUIRE(platform::fileExists(paths[3]));
+}
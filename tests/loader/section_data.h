@@ -0,0 +1,43 @@
+#pragma once
+#include <catch.hpp>
+
+#include <cafe/loader/cafe_loader_inflate.h>
+
+#include <chrono>
+#include <cstdint>
+#include <memory>
+#include <random>
+#include <vector>
+#include <zlib.h>
+
+inline std::vector<uint8_t>
+makeSectionData(size_t size,
+                uint32_t seed)
+{
+   // Something between code and zeroes, so it compresses like a real section
+   auto data = std::vector<uint8_t>(size);
+   auto random = std::mt19937 { seed };
+
+   for (auto i = 0u; i < size; ++i) {
+      data[i] = (random() % 4) ? static_cast<uint8_t>(i / 64) : static_cast<uint8_t>(random());
+   }
+
+   return data;
+}
+
+inline std::vector<uint8_t>
+deflate(const std::vector<uint8_t> &data)
+{
+   auto size = compressBound(static_cast<uLong>(data.size()));
+   auto deflated = std::vector<uint8_t>(size);
+   REQUIRE(compress(deflated.data(), &size, data.data(), static_cast<uLong>(data.size())) == Z_OK);
+   deflated.resize(size);
+   return deflated;
+}
+
+inline void
+waitInflateJob(const std::shared_ptr<cafe::loader::internal::InflateJob> &job)
+{
+   while (!cafe::loader::internal::waitInflateJob(job, std::chrono::milliseconds { 1 })) {
+   }
+}
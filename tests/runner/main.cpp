@@ -0,0 +1,17 @@
+#define CATCH_CONFIG_RUNNER
+#include <catch.hpp>
+
+#include <common/log.h>
+#include <memory>
+#include <spdlog/spdlog.h>
+#include <spdlog/sinks/null_sink.h>
+
+std::shared_ptr<spdlog::logger>
+gLog;
+
+int main(int argc, char *argv[])
+{
+   // The code under test logs what it does, which we do not want to see here
+   gLog = std::make_shared<spdlog::logger>("logger", std::make_shared<spdlog::sinks::null_sink_mt>());
+   return Catch::Session().run(argc, argv);
+}
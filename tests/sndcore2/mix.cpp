@@ -0,0 +1,291 @@
+#include <catch.hpp>
+#include "test_memory.h"
+
+#include <cafe/libraries/sndcore2/sndcore2_mix.h>
+
+#include <cstring>
+#include <fmt/format.h>
+#include <random>
+
+using namespace cafe::sndcore2;
+using namespace cafe::sndcore2::internal;
+
+static constexpr auto VoiceAddress = TestVirtualAddress.getAddress();
+static constexpr auto SampleDataAddress = TestVirtualAddress.getAddress() + 0x100000u;
+static constexpr auto SampleDataSize = 0x10000u;
+
+// ADPCM frames are 8 bytes, a header byte then 14 four bit samples
+static constexpr auto AdpcmFrameSamples = 14u;
+
+static virt_ptr<AXVoiceExtras>
+getTestVoice(uint32_t index)
+{
+   return virt_cast<AXVoiceExtras *>(virt_addr { VoiceAddress }) + index;
+}
+
+static void
+fillSampleData(std::mt19937 &rng)
+{
+   auto data = virt_cast<uint8_t *>(virt_addr { SampleDataAddress });
+   auto dist = std::uniform_int_distribution<int> { 0, 255 };
+
+   for (auto i = 0u; i < SampleDataSize; ++i) {
+      data[i] = static_cast<uint8_t>(dist(rng));
+   }
+}
+
+/**
+ * Offset of the n'th sample of the test data, in the units the voice uses.
+ * ADPCM offsets count nibbles and step over the frame headers.
+ */
+static virt_addr
+getSampleOffset(AXVoiceFormat format,
+                uint32_t sample)
+{
+   switch (format) {
+   case AXVoiceFormat::ADPCM:
+      return virt_addr { SampleDataAddress * 2 + (sample / AdpcmFrameSamples) * 16 + 2 + sample % AdpcmFrameSamples };
+   case AXVoiceFormat::LPCM8:
+      return virt_addr { SampleDataAddress + sample };
+   default:
+      return virt_addr { SampleDataAddress / 2 + sample };
+   }
+}
+
+static uint16_t
+getAdpcmHeader(uint32_t sample)
+{
+   auto data = virt_cast<uint8_t *>(virt_addr { SampleDataAddress });
+   return data[(sample / AdpcmFrameSamples) * 8];
+}
+
+struct VoiceLayout
+{
+   uint32_t begin;
+   uint32_t loop;
+   uint32_t end;
+};
+
+static void
+initialiseVoice(virt_ptr<AXVoiceExtras> extras,
+                AXVoiceFormat format,
+                AXVoiceType type,
+                AXVoiceLoop loop,
+                uint32_t ratio,
+                uint16_t frac,
+                const VoiceLayout &layout,
+                std::mt19937 &rng)
+{
+   auto sampleDist = std::uniform_int_distribution<int> { -32768, 32767 };
+   auto coeffDist = std::uniform_int_distribution<int> { -8192, 8191 };
+   std::memset(extras.get(), 0, sizeof(AXVoiceExtras));
+
+   extras->type = type;
+   extras->data.loopFlag = loop;
+   extras->data.format = format;
+   extras->data.memPageNumber = uint16_t { 0 };
+   extras->data.loopOffsetAbs = getSampleOffset(format, layout.loop);
+   extras->data.endOffsetAbs = getSampleOffset(format, layout.end);
+   extras->data.currentOffsetAbs = getSampleOffset(format, layout.begin);
+
+   for (auto i = 0u; i < extras->adpcm.coefficients.size(); ++i) {
+      extras->adpcm.coefficients[i] = static_cast<int16_t>(coeffDist(rng));
+   }
+
+   extras->adpcm.predScale = getAdpcmHeader(layout.begin);
+   extras->adpcm.prevSample[0] = static_cast<int16_t>(sampleDist(rng));
+   extras->adpcm.prevSample[1] = static_cast<int16_t>(sampleDist(rng));
+   extras->adpcmLoop.predScale = getAdpcmHeader(layout.loop);
+   extras->adpcmLoop.prevSample[0] = static_cast<int16_t>(sampleDist(rng));
+   extras->adpcmLoop.prevSample[1] = static_cast<int16_t>(sampleDist(rng));
+
+   extras->src.ratio = ufixed1616_t::from_data(ratio);
+   extras->src.currentOffsetFrac = ufixed016_t::from_data(frac);
+
+   for (auto i = 0u; i < extras->src.lastSample.size(); ++i) {
+      extras->src.lastSample[i] = static_cast<int16_t>(sampleDist(rng));
+   }
+}
+
+TEST_CASE("sndcore2 block decode matches the per-sample decode")
+{
+   static constexpr AXVoiceFormat Formats[] = {
+      AXVoiceFormat::ADPCM,
+      AXVoiceFormat::LPCM8,
+      AXVoiceFormat::LPCM16,
+   };
+
+   // Native rate, slower, faster, just off native and fast enough to use
+   // the per-sample fallback
+   static constexpr uint32_t Ratios[] = {
+      0x10000, 0x10001, 0xFFFF, 0x8000, 0x4000, 0x18000, 0x2A000, 0x80000,
+   };
+
+   // Voices which run for a while, reach their end in the first frame, end
+   // on the last sample of a 96 or 144 sample frame, loop several times a
+   // frame, start on their last sample, and loop on a single sample
+   static constexpr VoiceLayout Layouts[] = {
+      { 0, 0, 3000 },
+      { 190, 20, 200 },
+      { 10, 0, 105 },
+      { 0, 0, 143 },
+      { 0, 5, 30 },
+      { 100, 60, 100 },
+      { 40, 50, 50 },
+   };
+
+   initialiseTestMemory();
+   auto rng = std::mt19937 { 0x5d2c0e11 };
+   fillSampleData(rng);
+
+   auto reference = getTestVoice(0);
+   auto block = getTestVoice(1);
+   auto mismatches = 0;
+
+   for (auto format : Formats) {
+      for (auto type : { AXVoiceType::Default, AXVoiceType::Streaming }) {
+         for (auto loop : { AXVoiceLoop::Disabled, AXVoiceLoop::Enabled }) {
+            for (auto ratio : Ratios) {
+               for (auto frac : { 0u, 0x4000u, 0xFFFFu }) {
+                  for (auto numSamples : { 96, 144 }) {
+                     for (auto &layout : Layouts) {
+                        initialiseVoice(reference, format, type, loop, ratio,
+                                        static_cast<uint16_t>(frac), layout, rng);
+                        *block = *reference;
+
+                        for (auto frame = 0; frame < 12; ++frame) {
+                           Pcm16Sample referenceSamples[AXMaxFrameSamples];
+                           Pcm16Sample blockSamples[AXMaxFrameSamples];
+                           auto referenceEof = sampleVoiceReference(reference, referenceSamples, numSamples);
+                           auto blockEof = sampleVoice(block, blockSamples, numSamples);
+
+                           if (referenceEof != blockEof ||
+                               std::memcmp(referenceSamples, blockSamples, numSamples * sizeof(Pcm16Sample)) != 0 ||
+                               std::memcmp(reference.get(), block.get(), sizeof(AXVoiceExtras)) != 0) {
+                              if (!mismatches) {
+                                 UNSCOPED_INFO(fmt::format("first mismatch with format {}, type {}, loop {}, ratio 0x{:X}, frac 0x{:X}, {} samples, layout {}/{}/{}, frame {}",
+                                                           static_cast<int>(format), static_cast<int>(type), static_cast<int>(loop),
+                                                           ratio, frac, numSamples, layout.begin, layout.loop, layout.end, frame));
+                              }
+
+                              ++mismatches;
+                              break;
+                           }
+
+                           if (referenceEof) {
+                              break;
+                           }
+                        }
+                     }
+                  }
+               }
+            }
+         }
+      }
+   }
+
+   REQUIRE(mismatches == 0);
+}
+
+TEST_CASE("sndcore2 block mix matches the per-sample mix")
+{
+   static constexpr auto NumVoices = 6u;
+   static constexpr AXDeviceType DeviceTypes[] = {
+      AXDeviceType::TV,
+      AXDeviceType::DRC,
+      AXDeviceType::RMT,
+   };
+
+   static BusSamples reference[AXDeviceType::Max];
+   static MixSums sums;
+
+   initialiseTestMemory();
+   auto rng = std::mt19937 { 0x3a7b9c01 };
+   auto sampleDist = std::uniform_int_distribution<int> { -32768, 32767 };
+   auto volumeDist = std::uniform_int_distribution<int> { 0, 0xFFFF };
+
+   for (auto numSamples : { 96u, 144u }) {
+      for (auto i = 0u; i < NumVoices; ++i) {
+         auto extras = getTestVoice(i);
+         std::memset(extras.get(), 0, sizeof(AXVoiceExtras));
+         extras->numSamples = numSamples;
+
+         for (auto j = 0u; j < numSamples; ++j) {
+            extras->samples[j] = Pcm16Sample::from_data(static_cast<int16_t>(sampleDist(rng)));
+         }
+
+         // Leave a third of the channels unrouted, the rest cover volumes
+         // with and without the top bit set
+         for (auto type : DeviceTypes) {
+            for (auto deviceId = 0u; deviceId < getDeviceNumDevices(type); ++deviceId) {
+               for (auto channel = 0u; channel < getDeviceNumChannels(type); ++channel) {
+                  for (auto bus = 0u; bus < getDeviceNumBuses(type); ++bus) {
+                     auto &volume = getVoiceMixVolume(extras, type, deviceId, channel, bus);
+
+                     if (volumeDist(rng) % 3) {
+                        volume.volume = ufixed_1_15_t::from_data(static_cast<uint16_t>(volumeDist(rng)));
+                     }
+
+                     volume.delta = ufixed_1_15_t::from_data(static_cast<uint16_t>(volumeDist(rng) & 0xFF));
+                  }
+               }
+            }
+         }
+
+         // Keep a copy to check the volumes against after mixing
+         *getTestVoice(NumVoices + i) = *extras;
+      }
+
+      for (auto type : DeviceTypes) {
+         std::memset(reference[type], 0, sizeof(BusSamples));
+
+         for (auto i = 0u; i < NumVoices; ++i) {
+            mixVoiceReference(getTestVoice(i), type, numSamples, reference[type]);
+         }
+      }
+
+      std::memset(sums, 0, sizeof(MixSums));
+
+      for (auto i = 0u; i < NumVoices; ++i) {
+         mixVoice(getTestVoice(i), numSamples, sums);
+      }
+
+      auto mismatches = 0;
+      auto volumeMismatches = 0;
+
+      for (auto type : DeviceTypes) {
+         auto row = getDeviceMixRowBase(type);
+
+         for (auto bus = 0u; bus < getDeviceNumBuses(type); ++bus) {
+            for (auto deviceId = 0u; deviceId < getDeviceNumDevices(type); ++deviceId) {
+               for (auto channel = 0u; channel < getDeviceNumChannels(type); ++channel, ++row) {
+                  Pcm16Sample samples[AXMaxFrameSamples];
+                  storeBusSamples(samples, sums[row], numSamples);
+
+                  if (std::memcmp(samples, reference[type][bus][deviceId][channel], numSamples * sizeof(Pcm16Sample)) != 0) {
+                     if (!mismatches) {
+                        UNSCOPED_INFO(fmt::format("first mismatch on device type {}, bus {}, device {}, channel {}",
+                                                  static_cast<int>(type), bus, deviceId, channel));
+                     }
+
+                     ++mismatches;
+                  }
+
+                  // mixVoice advances every volume by its delta
+                  for (auto i = 0u; i < NumVoices; ++i) {
+                     auto &initialVolume = getVoiceMixVolume(getTestVoice(NumVoices + i), type, deviceId, channel, bus);
+                     auto &volume = getVoiceMixVolume(getTestVoice(i), type, deviceId, channel, bus);
+
+                     if (volume.volume.data() != static_cast<uint16_t>(initialVolume.volume.data() + initialVolume.delta.data())) {
+                        ++volumeMismatches;
+                     }
+                  }
+               }
+            }
+         }
+      }
+
+      REQUIRE(mismatches == 0);
+      REQUIRE(volumeMismatches == 0);
+   }
+}
@@ -0,0 +1,27 @@
+#pragma once
+#include <catch.hpp>
+
+#include <libcpu/cpu.h>
+#include <libcpu/mmu.h>
+
+#include <cstdint>
+
+// Voice data is read relative to memory page 0, so the test memory is mapped
+// at a fixed guest address and sample offsets are absolute guest addresses.
+constexpr auto TestVirtualAddress = cpu::VirtualAddress { 0x10000000 };
+constexpr auto TestPhysicalAddress = cpu::PhysicalAddress { 0x10000000 };
+constexpr auto TestSize = uint32_t { 16 * 1024 * 1024 };
+
+inline void
+initialiseTestMemory()
+{
+   static bool initialised = false;
+
+   if (!initialised) {
+      cpu::initialise();
+      REQUIRE(cpu::allocateVirtualAddress(TestVirtualAddress, TestSize));
+      REQUIRE(cpu::mapMemory(TestVirtualAddress, TestPhysicalAddress, TestSize,
+                             cpu::MapPermission::ReadWrite));
+      initialised = true;
+   }
+}
@@ -0,0 +1,135 @@
+#include <catch.hpp>
+#include "test_memory.h"
+
+#include <cafe/libraries/sndcore2/sndcore2_mix.h>
+
+#include <cstring>
+#include <fmt/format.h>
+#include <random>
+
+using namespace cafe::sndcore2;
+using namespace cafe::sndcore2::internal;
+
+static constexpr auto VoiceAddress = TestVirtualAddress.getAddress();
+static constexpr auto SampleDataAddress = TestVirtualAddress.getAddress() + 0x100000u;
+static constexpr auto SampleDataSize = 0x10000u;
+
+// Enough voices that every thread count below gets some of them
+static constexpr auto NumVoices = 3 * MinParallelVoices + 1;
+
+static virt_ptr<AXVoiceExtras>
+getTestVoice(uint32_t index)
+{
+   return virt_cast<AXVoiceExtras *>(virt_addr { VoiceAddress }) + index;
+}
+
+/**
+ * Looping LPCM16 voices at assorted rates over random sample data, each
+ * routed to a random half of the TV, DRC and RMT mix volumes.
+ */
+static void
+initialiseVoices(std::mt19937 &rng)
+{
+   auto data = virt_cast<uint8_t *>(virt_addr { SampleDataAddress });
+   auto byteDist = std::uniform_int_distribution<int> { 0, 255 };
+   auto volumeDist = std::uniform_int_distribution<int> { 0, 0xFFFF };
+   auto ratioDist = std::uniform_int_distribution<uint32_t> { 0x8000, 0x20000 };
+
+   for (auto i = 0u; i < SampleDataSize; ++i) {
+      data[i] = static_cast<uint8_t>(byteDist(rng));
+   }
+
+   for (auto i = 0u; i < NumVoices; ++i) {
+      auto extras = getTestVoice(i);
+      auto begin = SampleDataAddress / 2 + i * 256;
+      std::memset(extras.get(), 0, sizeof(AXVoiceExtras));
+
+      extras->data.loopFlag = AXVoiceLoop::Enabled;
+      extras->data.format = AXVoiceFormat::LPCM16;
+      extras->data.memPageNumber = uint16_t { 0 };
+      extras->data.currentOffsetAbs = virt_addr { begin };
+      extras->data.loopOffsetAbs = virt_addr { begin };
+      extras->data.endOffsetAbs = virt_addr { begin + 200 + i };
+      extras->src.ratio = ufixed1616_t::from_data(ratioDist(rng));
+
+      for (auto type : { AXDeviceType::TV, AXDeviceType::DRC, AXDeviceType::RMT }) {
+         for (auto deviceId = 0u; deviceId < getDeviceNumDevices(type); ++deviceId) {
+            for (auto channel = 0u; channel < getDeviceNumChannels(type); ++channel) {
+               for (auto bus = 0u; bus < getDeviceNumBuses(type); ++bus) {
+                  auto &volume = getVoiceMixVolume(extras, type, deviceId, channel, bus);
+
+                  if (volumeDist(rng) & 1) {
+                     volume.volume = ufixed_1_15_t::from_data(static_cast<uint16_t>(volumeDist(rng)));
+                     volume.delta = ufixed_1_15_t::from_data(static_cast<uint16_t>(volumeDist(rng) & 0xFF));
+                  }
+               }
+            }
+         }
+      }
+   }
+}
+
+static void
+renderVoice(virt_ptr<AXVoiceExtras> extras,
+            uint32_t numSamples,
+            MixSums &sums)
+{
+   extras->numSamples = numSamples;
+   sampleVoice(extras, extras->samples, numSamples);
+   mixVoice(extras, numSamples, sums);
+}
+
+TEST_CASE("sndcore2 voice render pool matches a serial mix")
+{
+   static constexpr auto NumSamples = 144u;
+   static constexpr auto NumFrames = 4;
+   static MixSums serialSums;
+   static MixSums pooledSums;
+
+   initialiseTestMemory();
+   auto rng = std::mt19937 { 0x6c1f4a2d };
+   initialiseVoices(rng);
+
+   // The pooled voices are a copy of the serial ones, past the end of them
+   auto serialVoices = getTestVoice(0);
+   auto pooledVoices = getTestVoice(NumVoices);
+
+   for (auto i = 0u; i < NumVoices; ++i) {
+      pooledVoices[i] = serialVoices[i];
+   }
+
+   // One pool for every case, so the threads also get restarted as the
+   // thread count changes. Below MinParallelVoices the pool renders on the
+   // calling thread only.
+   auto pool = VoiceRenderPool { };
+   auto mismatches = 0;
+
+   for (auto numVoices : { NumVoices, MinParallelVoices, MinParallelVoices - 1 }) {
+      for (auto numThreads : { 0u, 1u, 2u, 3u, 7u }) {
+         for (auto frame = 0; frame < NumFrames; ++frame) {
+            std::memset(serialSums, 0, sizeof(MixSums));
+
+            for (auto i = 0u; i < numVoices; ++i) {
+               renderVoice(serialVoices + i, NumSamples, serialSums);
+            }
+
+            pool.render(numVoices, numThreads, pooledSums,
+               [&](size_t index, MixSums &sums) {
+                  renderVoice(pooledVoices + static_cast<uint32_t>(index), NumSamples, sums);
+               });
+
+            if (std::memcmp(serialSums, pooledSums, sizeof(MixSums)) != 0 ||
+                std::memcmp(serialVoices.get(), pooledVoices.get(), NumVoices * sizeof(AXVoiceExtras)) != 0) {
+               if (!mismatches) {
+                  UNSCOPED_INFO(fmt::format("first mismatch with {} voices, {} threads, frame {}",
+                                            numVoices, numThreads, frame));
+               }
+
+               ++mismatches;
+            }
+         }
+      }
+   }
+
+   REQUIRE(mismatches == 0);
+}
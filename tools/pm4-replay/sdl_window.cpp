@@ -172,9 +172,9 @@ public:
             mFile.read(reinterpret_cast<char *>(mRegisterStorage.getRawPointer()), packet.size);
 
             // Swap it into big endian, so we can write LOAD_ commands
-            for (auto i = 0u; i < numRegisters; ++i) {
-               mRegisterStorage[i] = byte_swap(mRegisterStorage[i]);
-            }
+            byte_swap_to(mRegisterStorage.getRawPointer(),
+                         mRegisterStorage.getRawPointer(),
+                         numRegisters);
 
             handleRegisterSnapshot(mRegisterStorage, numRegisters);
             mRingBuffer.flushCommandBuffer();
@@ -0,0 +1,178 @@
+#include "shader_collector.h"
+
+#include <atomic>
+#include <common/log.h>
+#include <common/platform_dir.h>
+#include <excmd.h>
+#include <gpu_shadercache.h>
+#include <iostream>
+#include <libcpu/mmu.h>
+#include <spdlog/spdlog.h>
+#include <spdlog/sinks/stdout_sinks.h>
+#include <thread>
+
+std::shared_ptr<spdlog::logger>
+gLog;
+
+/**
+ * Call func for every item across numThreads threads.
+ */
+template<typename Type, typename Func>
+static void
+parallelFor(std::vector<Type> &items,
+            unsigned numThreads,
+            Func func)
+{
+   auto next = std::atomic<size_t> { 0 };
+   auto threads = std::vector<std::thread> { };
+
+   for (auto i = 0u; i < numThreads; ++i) {
+      threads.emplace_back([&]() {
+         for (auto index = next++; index < items.size(); index = next++) {
+            func(items[index]);
+         }
+      });
+   }
+
+   for (auto &thread : threads) {
+      thread.join();
+   }
+}
+
+
+/**
+ * Translate every shader drawn with in a PM4 capture into the shader cache
+ * in outputDir.
+ *
+ * The cache is appended to, so running this over several captures of the
+ * same title builds up a single cache.
+ */
+static bool
+buildShaderCache(const std::string &capturePath,
+                 const std::string &outputDir,
+                 unsigned numThreads)
+{
+   auto collector = ShaderCollector { };
+   auto cache = gpu::ShaderCache { };
+
+   if (!cpu::initialiseMemory()) {
+      gLog->error("Failed to initialise memory");
+      return false;
+   }
+
+   if (!platform::createDirectory(outputDir)) {
+      gLog->error("Failed to create output directory {}", outputDir);
+      return false;
+   }
+
+   if (!cache.open(fmt::format("{}/spirv.bin", outputDir), spirv::getTranslatorHash())) {
+      return false;
+   }
+
+   if (!collector.readCapture(capturePath)) {
+      return false;
+   }
+
+   auto vertexShaders = collector.getVertexShaders();
+   auto geometryShaders = collector.getGeometryShaders();
+   gLog->info("Found {} draws using {} vertex, {} geometry and {} pixel shader combinations",
+              collector.numDraws(), vertexShaders.size(), geometryShaders.size(),
+              collector.numPendingPixelShaders());
+
+   auto failed = std::atomic<size_t> { 0 };
+
+   // Vertex and geometry shaders first, the pixel shader descriptions need
+   // their outputs.
+   parallelFor(vertexShaders, numThreads, [&](CollectedVertexShader *vs) {
+      vs->translated = spirv::translate(cache, vs->desc, vs->hash, &vs->shader);
+      failed += vs->translated ? 0 : 1;
+   });
+
+   parallelFor(geometryShaders, numThreads, [&](CollectedGeometryShader *gs) {
+      gs->translated = spirv::translate(cache, gs->desc, gs->hash, &gs->shader);
+      failed += gs->translated ? 0 : 1;
+   });
+
+   auto pixelShaders = collector.resolvePixelShaders();
+
+   parallelFor(pixelShaders, numThreads, [&](CollectedPixelShader *ps) {
+      ps->translated = spirv::translate(cache, ps->desc, ps->hash, &ps->shader);
+      failed += ps->translated ? 0 : 1;
+   });
+
+   auto &stats = cache.stats();
+   gLog->info("{} shaders: {} already cached, {} translated, {} failed",
+              vertexShaders.size() + geometryShaders.size() + pixelShaders.size(),
+              stats.hits.load(), stats.stores.load(), failed.load());
+   return true;
+}
+
+
+int main(int argc, char **argv)
+{
+   excmd::parser parser;
+   excmd::option_state options;
+   using excmd::description;
+   using excmd::optional;
+   using excmd::value;
+
+   parser.global_options()
+      .add_option("h,help",
+                  description { "Show help." });
+
+   auto buildOptions = parser.add_option_group("Build Options")
+      .add_option("output",
+                  description { "Folder to write the shader cache to, load it by setting gpu.shader_cache_path to this." },
+                  value<std::string> {})
+      .add_option("threads",
+                  description { "Number of threads to translate shaders with, defaults to one per host core." },
+                  value<uint32_t> {});
+
+   parser.add_command("help")
+      .add_argument("help-command",
+                    optional {},
+                    value<std::string> {});
+
+   parser.add_command("build")
+      .add_argument("trace file",
+                    value<std::string> {})
+      .add_option_group(buildOptions);
+
+   try {
+      options = parser.parse(argc, argv);
+   } catch (excmd::exception ex) {
+      std::cout << "Error parsing command line: " << ex.what() << std::endl;
+      std::exit(-1);
+   }
+
+   if (argc == 1 || options.has("help")) {
+      if (options.has("help-command")) {
+         std::cout << parser.format_help("shader-cache-tool", options.get<std::string>("help-command")) << std::endl;
+      } else {
+         std::cout << parser.format_help("shader-cache-tool") << std::endl;
+      }
+
+      std::exit(0);
+   }
+
+   gLog = std::make_shared<spdlog::logger>("shader-cache-tool", std::make_shared<spdlog::sinks::stdout_sink_mt>());
+   gLog->set_pattern("[%l] %v");
+
+   if (!options.has("build")) {
+      return -1;
+   }
+
+   auto outputDir = std::string { "shadercache" };
+   auto numThreads = std::max(1u, std::thread::hardware_concurrency());
+
+   if (options.has("output")) {
+      outputDir = options.get<std::string>("output");
+   }
+
+   if (options.has("threads")) {
+      numThreads = std::max(1u, options.get<uint32_t>("threads"));
+   }
+
+   auto tracePath = options.get<std::string>("trace file");
+   return buildShaderCache(tracePath, outputDir, numThreads) ? 0 : -1;
+}
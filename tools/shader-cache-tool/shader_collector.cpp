@@ -0,0 +1,228 @@
+#include "shader_collector.h"
+
+#include <algorithm>
+#include <common/log.h>
+#include <fstream>
+#include <libdecaf/decaf_pm4replay.h>
+#include <libgpu/gpu_memory.h>
+
+/**
+ * Copy a shader binary out of guest memory and point the description at
+ * the copy instead.
+ */
+static void
+ownBinary(gsl::span<const uint8_t> &binary,
+          std::vector<uint8_t> &storage)
+{
+   storage.assign(binary.begin(), binary.end());
+   binary = gsl::make_span(static_cast<const uint8_t *>(storage.data()), storage.size());
+}
+
+
+/**
+ * Run every packet in a PM4 capture file.
+ */
+bool
+ShaderCollector::readCapture(const std::string &path)
+{
+   auto file = std::ifstream { path, std::ifstream::binary };
+   if (!file.is_open()) {
+      gLog->error("Could not open capture {}", path);
+      return false;
+   }
+
+   auto magic = std::array<char, 4> { };
+   file.read(magic.data(), magic.size());
+
+   if (!file || magic != decaf::pm4::CaptureMagic) {
+      gLog->error("{} is not a PM4 capture", path);
+      return false;
+   }
+
+   auto buffer = std::vector<uint32_t> { };
+
+   while (file.peek() != std::ifstream::traits_type::eof()) {
+      auto packet = decaf::pm4::CapturePacket { };
+      file.read(reinterpret_cast<char *>(&packet), sizeof(packet));
+
+      if (!file) {
+         gLog->error("Truncated capture {}", path);
+         return false;
+      }
+
+      switch (packet.type) {
+      case decaf::pm4::CapturePacket::CommandBuffer:
+      {
+         buffer.resize(packet.size / 4);
+         file.read(reinterpret_cast<char *>(buffer.data()), packet.size);
+
+         if (!file) {
+            gLog->error("Truncated capture {}", path);
+            return false;
+         }
+
+         runCommandBuffer(gsl::make_span(buffer));
+         break;
+      }
+      case decaf::pm4::CapturePacket::RegisterSnapshot:
+      {
+         // Register snapshots are stored in host endian, exactly as they
+         // were in the capturing processor's register file.
+         auto size = std::min<size_t>(packet.size, mRegisters.size() * 4);
+         file.read(reinterpret_cast<char *>(mRegisters.data()), size);
+         file.seekg(packet.size - size, std::ifstream::cur);
+         break;
+      }
+      case decaf::pm4::CapturePacket::MemoryLoad:
+      {
+         auto load = decaf::pm4::CaptureMemoryLoad { };
+         file.read(reinterpret_cast<char *>(&load), sizeof(load));
+
+         if (!file || packet.size < sizeof(load)) {
+            gLog->error("Truncated capture {}", path);
+            return false;
+         }
+
+         file.read(gpu::internal::translateAddress<char>(load.address),
+                   packet.size - sizeof(load));
+         break;
+      }
+      default:
+         file.seekg(packet.size, std::ifstream::cur);
+      }
+
+      if (!file) {
+         gLog->error("Truncated capture {}", path);
+         return false;
+      }
+   }
+
+   return true;
+}
+
+
+/**
+ * Collect the shader descriptions for the current draw.
+ */
+void
+ShaderCollector::collectDraw()
+{
+   auto vgt_primitive_type = getRegister<latte::VGT_PRIMITIVE_TYPE>(latte::Register::VGT_PRIMITIVE_TYPE);
+   auto isRectDraw = (vgt_primitive_type.PRIM_TYPE() == latte::VGT_DI_PRIMITIVE_TYPE::RECTLIST);
+   mNumDraws++;
+
+   auto vsDesc = spirv::getVertexShaderDesc(mRegisters, isRectDraw);
+   auto vsHash = vsDesc.hash();
+
+   if (!mVertexShaders.count(vsHash)) {
+      auto &vs = mVertexShaders[vsHash];
+      vs.hash = vsHash;
+      vs.desc = vsDesc;
+      ownBinary(vs.desc.binary, vs.binary);
+      ownBinary(vs.desc.fsBinary, vs.fsBinary);
+   }
+
+   auto gsDesc = spirv::getGeometryShaderDesc(mRegisters);
+   auto gsHash = DataHash { };
+   auto afterGeometryShader = (gsDesc.type != spirv::ShaderType::Unknown);
+
+   if (afterGeometryShader) {
+      gsHash = gsDesc.hash();
+
+      if (!mGeometryShaders.count(gsHash)) {
+         auto &gs = mGeometryShaders[gsHash];
+         gs.hash = gsHash;
+         gs.desc = gsDesc;
+         ownBinary(gs.desc.binary, gs.binary);
+         ownBinary(gs.desc.dcBinary, gs.dcBinary);
+      }
+   }
+
+   // The pixel shader inputs are not known yet, so identify it by the rest
+   // of its description plus the shader stage its inputs will come from.
+   auto psDesc = spirv::getPixelShaderDesc(mRegisters, { });
+   auto stageHash = afterGeometryShader ? gsHash : vsHash;
+   auto pendingHash = psDesc.hash().write(stageHash.value());
+
+   if (!mPendingPixelShaders.count(pendingHash)) {
+      auto &pending = mPendingPixelShaders[pendingHash];
+      pending.shader.desc = psDesc;
+      pending.stageHash = stageHash;
+      pending.afterGeometryShader = afterGeometryShader;
+      ownBinary(pending.shader.desc.binary, pending.shader.binary);
+   }
+}
+
+
+std::vector<CollectedVertexShader *>
+ShaderCollector::getVertexShaders()
+{
+   auto shaders = std::vector<CollectedVertexShader *> { };
+
+   for (auto &itr : mVertexShaders) {
+      shaders.push_back(&itr.second);
+   }
+
+   return shaders;
+}
+
+
+std::vector<CollectedGeometryShader *>
+ShaderCollector::getGeometryShaders()
+{
+   auto shaders = std::vector<CollectedGeometryShader *> { };
+
+   for (auto &itr : mGeometryShaders) {
+      shaders.push_back(&itr.second);
+   }
+
+   return shaders;
+}
+
+
+/**
+ * Complete the pixel shader descriptions using the outputs of the
+ * translated vertex and geometry shaders they were drawn with.
+ *
+ * Pixel shaders drawn after a shader which failed to translate are dropped,
+ * the emulator skips those draws too.
+ */
+std::vector<CollectedPixelShader *>
+ShaderCollector::resolvePixelShaders()
+{
+   auto shaders = std::vector<CollectedPixelShader *> { };
+
+   for (auto &itr : mPendingPixelShaders) {
+      auto &pending = itr.second;
+      const std::vector<uint32_t> *outputSemantics = nullptr;
+
+      if (pending.afterGeometryShader) {
+         auto &gs = mGeometryShaders[pending.stageHash];
+         if (gs.translated) {
+            outputSemantics = &gs.shader.outputSemantics;
+         }
+      } else {
+         auto &vs = mVertexShaders[pending.stageHash];
+         if (vs.translated) {
+            outputSemantics = &vs.shader.outputSemantics;
+         }
+      }
+
+      if (!outputSemantics) {
+         continue;
+      }
+
+      pending.shader.desc.vsOutputSemantics = *outputSemantics;
+      auto hash = pending.shader.desc.hash();
+
+      if (!mPixelShaders.count(hash)) {
+         auto &ps = mPixelShaders[hash];
+         ps.hash = hash;
+         ps.desc = pending.shader.desc;
+         ownBinary(ps.desc.binary, ps.binary);
+         shaders.push_back(&ps);
+      }
+   }
+
+   return shaders;
+}
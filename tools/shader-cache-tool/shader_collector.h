@@ -0,0 +1,133 @@
+#pragma once
+#include <pm4_processor.h>
+#include <spirv/spirv_translate.h>
+
+#include <common/datahash.h>
+#include <cstdint>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+/*
+ * Collected shaders own a copy of the shader binaries their description
+ * refers to, as the guest memory those were read from is overwritten by
+ * later memory loads in the capture.
+ */
+struct CollectedVertexShader
+{
+   DataHash hash;
+   spirv::VertexShaderDesc desc;
+   std::vector<uint8_t> binary;
+   std::vector<uint8_t> fsBinary;
+   spirv::VertexShader shader;
+   bool translated = false;
+};
+
+struct CollectedGeometryShader
+{
+   DataHash hash;
+   spirv::GeometryShaderDesc desc;
+   std::vector<uint8_t> binary;
+   std::vector<uint8_t> dcBinary;
+   spirv::GeometryShader shader;
+   bool translated = false;
+};
+
+struct CollectedPixelShader
+{
+   DataHash hash;
+   spirv::PixelShaderDesc desc;
+   std::vector<uint8_t> binary;
+   spirv::PixelShader shader;
+   bool translated = false;
+};
+
+/**
+ * A Pm4Processor which runs a PM4 capture without a GPU, and collects the
+ * description of every unique set of shaders drawn with.
+ *
+ * The inputs of a pixel shader are part of its description, but they are
+ * only known once the vertex or geometry shader it was drawn with has been
+ * translated. So pixel shaders are held back until resolvePixelShaders is
+ * called after those have been translated.
+ */
+class ShaderCollector : public Pm4Processor
+{
+   struct PendingPixelShader
+   {
+      CollectedPixelShader shader;
+      DataHash stageHash;
+      bool afterGeometryShader;
+   };
+
+public:
+   bool
+   readCapture(const std::string &path);
+
+   std::vector<CollectedVertexShader *>
+   getVertexShaders();
+
+   std::vector<CollectedGeometryShader *>
+   getGeometryShaders();
+
+   std::vector<CollectedPixelShader *>
+   resolvePixelShaders();
+
+   uint64_t
+   numDraws() const
+   {
+      return mNumDraws;
+   }
+
+   size_t
+   numPendingPixelShaders() const
+   {
+      return mPendingPixelShaders.size();
+   }
+
+protected:
+   void decafSetBuffer(const DecafSetBuffer &data) override { }
+   void decafCopyColorToScan(const DecafCopyColorToScan &data) override { }
+   void decafSwapBuffers(const DecafSwapBuffers &data) override { }
+   void decafCapSyncRegisters(const DecafCapSyncRegisters &data) override { }
+   void decafClearColor(const DecafClearColor &data) override { }
+   void decafClearDepthStencil(const DecafClearDepthStencil &data) override { }
+   void decafOSScreenFlip(const DecafOSScreenFlip &data) override { }
+   void decafCopySurface(const DecafCopySurface &data) override { }
+   void decafExpandColorBuffer(const DecafExpandColorBuffer &data) override { }
+   void memWrite(const MemWrite &data) override { }
+   void eventWrite(const EventWrite &data) override { }
+   void eventWriteEOP(const EventWriteEOP &data) override { }
+   void pfpSyncMe(const PfpSyncMe &data) override { }
+   void setPredication(const SetPredication &data) override { }
+   void streamOutBaseUpdate(const StreamOutBaseUpdate &data) override { }
+   void streamOutBufferUpdate(const StreamOutBufferUpdate &data) override { }
+   void surfaceSync(const SurfaceSync &data) override { }
+   void applyRegister(latte::Register reg) override { }
+
+   void drawIndexAuto(const DrawIndexAuto &data) override
+   {
+      collectDraw();
+   }
+
+   void drawIndex2(const DrawIndex2 &data) override
+   {
+      collectDraw();
+   }
+
+   void drawIndexImmd(const DrawIndexImmd &data) override
+   {
+      collectDraw();
+   }
+
+private:
+   void
+   collectDraw();
+
+private:
+   uint64_t mNumDraws = 0;
+   std::unordered_map<DataHash, CollectedVertexShader> mVertexShaders;
+   std::unordered_map<DataHash, CollectedGeometryShader> mGeometryShaders;
+   std::unordered_map<DataHash, PendingPixelShader> mPendingPixelShaders;
+   std::unordered_map<DataHash, CollectedPixelShader> mPixelShaders;
+};